@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicLong;
+
+public class InterpreterIntrinsicsBenchmark {
+    public static final String string36 = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";  // length = 36
+    public static final String string36Copy = new String(string36);
+
+    private final char[] chars = new char[64];
+    private final int[] ints = new int[64];
+    private final Object[] objects = new Object[64];
+    private final AtomicInteger atomicInt = new AtomicInteger();
+    private final AtomicLong atomicLong = new AtomicLong();
+
+    public void timeSystemArrayCopyChar(int count) {
+        char[] src = chars;
+        char[] dst = new char[64];
+        for (int i = 0; i < count; ++i) {
+            System.arraycopy(src, 0, dst, 0, 64);
+        }
+    }
+
+    public void timeSystemArrayCopyInt(int count) {
+        Object src = ints;
+        Object dst = new int[64];
+        for (int i = 0; i < count; ++i) {
+            System.arraycopy(src, 0, dst, 0, 64);
+        }
+    }
+
+    public void timeSystemArrayCopyObject(int count) {
+        Object[] src = objects;
+        Object[] dst = new Object[64];
+        for (int i = 0; i < count; ++i) {
+            System.arraycopy(src, 0, dst, 0, 64);
+        }
+    }
+
+    public void timeStringEquals(int count) {
+        String s1 = string36;
+        String s2 = string36Copy;
+        for (int i = 0; i < count; ++i) {
+            s1.equals(s2);
+        }
+    }
+
+    public void timeStringIndexOfChar(int count) {
+        String s = string36;
+        for (int i = 0; i < count; ++i) {
+            s.indexOf('Z');
+        }
+    }
+
+    public void timeStringIndexOfString(int count) {
+        String s = string36;
+        for (int i = 0; i < count; ++i) {
+            s.indexOf("XYZ");
+        }
+    }
+
+    public void timeAtomicIntegerCompareAndSet(int count) {
+        AtomicInteger a = atomicInt;
+        for (int i = 0; i < count; ++i) {
+            a.compareAndSet(i, i + 1);
+        }
+    }
+
+    public void timeAtomicLongCompareAndSet(int count) {
+        AtomicLong a = atomicLong;
+        for (int i = 0; i < count; ++i) {
+            a.compareAndSet(i, i + 1);
+        }
+    }
+
+    public void timeMathMinMaxDouble(int count) {
+        double d = 0.5;
+        for (int i = 0; i < count; ++i) {
+            d = Math.max(Math.min(d, 1.0), 0.0);
+        }
+    }
+
+    public void timeMathRound(int count) {
+        long sum = 0;
+        for (int i = 0; i < count; ++i) {
+            sum += Math.round(i * 0.5);
+        }
+    }
+
+    public void timeFloatToIntBits(int count) {
+        int sum = 0;
+        for (int i = 0; i < count; ++i) {
+            sum += Float.floatToIntBits(i);
+        }
+    }
+
+    public void timeThreadCurrentThread(int count) {
+        for (int i = 0; i < count; ++i) {
+            Thread.currentThread();
+        }
+    }
+}
@@ -16,7 +16,10 @@
 
 #include "jni.h"
 
+#include <vector>
+
 #include "java_vm_ext.h"
+#include "jni_env_ext.h"
 #include "mirror/class-inl.h"
 #include "scoped_thread_state_change-inl.h"
 
@@ -46,6 +49,40 @@ extern "C" JNIEXPORT void JNICALL Java_JObjectBenchmark_timeDecodeLocal(
   soa.Env()->DeleteLocalRef(ref);
 }
 
+// Keeps several chunks of the local reference table populated and removes every other reference,
+// so that the adds fill holes instead of appending.
+extern "C" JNIEXPORT void JNICALL Java_JObjectBenchmark_timeAddRemoveManyLocals(
+    JNIEnv* env, jobject jobj, jint reps) {
+  static constexpr size_t kNumRefs = 4 * kLocalsInitial;
+  ScopedObjectAccess soa(env);
+  ObjPtr<mirror::Object> obj = soa.Decode<mirror::Object>(jobj);
+  CHECK(obj != nullptr);
+  std::vector<jobject> refs(kNumRefs);
+  for (jint i = 0; i < reps; ++i) {
+    for (size_t j = 0; j != kNumRefs; ++j) {
+      refs[j] = soa.Env()->AddLocalReference<jobject>(obj);
+    }
+    for (size_t j = 0; j < kNumRefs; j += 2) {
+      soa.Env()->DeleteLocalRef(refs[j]);
+    }
+    for (size_t j = 0; j < kNumRefs; j += 2) {
+      refs[j] = soa.Env()->AddLocalReference<jobject>(obj);
+    }
+    for (size_t j = 0; j != kNumRefs; ++j) {
+      soa.Env()->DeleteLocalRef(refs[j]);
+    }
+  }
+}
+
+extern "C" JNIEXPORT void JNICALL Java_JObjectBenchmark_timePushPopLocalFrame(
+    JNIEnv* env, jobject jobj, jint reps) {
+  for (jint i = 0; i < reps; ++i) {
+    CHECK_EQ(env->PushLocalFrame(4), JNI_OK);
+    jobject ref = env->NewLocalRef(jobj);
+    env->PopLocalFrame(ref);
+  }
+}
+
 extern "C" JNIEXPORT void JNICALL Java_JObjectBenchmark_timeAddRemoveGlobal(
     JNIEnv* env, jobject jobj, jint reps) {
   ScopedObjectAccess soa(env);
@@ -20,6 +20,8 @@ public class JObjectBenchmark {
     System.loadLibrary("artbenchmark");
     timeAddRemoveLocal(1);
     timeDecodeLocal(1);
+    timeAddRemoveManyLocals(1);
+    timePushPopLocalFrame(1);
     timeAddRemoveGlobal(1);
     timeDecodeGlobal(1);
     timeAddRemoveWeakGlobal(1);
@@ -27,8 +29,62 @@ public class JObjectBenchmark {
     timeDecodeHandleScopeRef(1);
   }
 
+  private static final int THREADS = 4;
+
+  private interface Body {
+    void run(int reps);
+  }
+
+  // Runs body on THREADS threads at the same time, each with its share of reps, to measure the
+  // contention on the global reference tables.
+  private static void runConcurrently(int reps, final Body body) {
+    final int repsPerThread = Math.max(reps / THREADS, 1);
+    Thread[] threads = new Thread[THREADS];
+    for (int i = 0; i < THREADS; ++i) {
+      threads[i] = new Thread() {
+        public void run() {
+          body.run(repsPerThread);
+        }
+      };
+      threads[i].start();
+    }
+    for (Thread thread : threads) {
+      try {
+        thread.join();
+      } catch (InterruptedException e) {
+        throw new RuntimeException(e);
+      }
+    }
+  }
+
+  public void timeAddRemoveGlobalConcurrent(int reps) {
+    runConcurrently(reps, new Body() {
+      public void run(int threadReps) {
+        timeAddRemoveGlobal(threadReps);
+      }
+    });
+  }
+
+  public void timeAddRemoveWeakGlobalConcurrent(int reps) {
+    runConcurrently(reps, new Body() {
+      public void run(int threadReps) {
+        timeAddRemoveWeakGlobal(threadReps);
+      }
+    });
+  }
+
+  public void timeDecodeGlobalConcurrent(int reps) {
+    runConcurrently(reps, new Body() {
+      public void run(int threadReps) {
+        timeDecodeGlobal(threadReps);
+      }
+    });
+  }
+
   public native void timeAddRemoveLocal(int reps);
   public native void timeDecodeLocal(int reps);
+  public native void timeAddRemoveManyLocals(int reps);
+  public native void timePushPopLocalFrame(int reps);
   public native void timeAddRemoveGlobal(int reps);
   public native void timeDecodeGlobal(int reps);
   public native void timeAddRemoveWeakGlobal(int reps);
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class StackWalkBenchmark {
+    private static final int DEPTH = 100;
+
+    private interface Walker {
+        int walk();
+    }
+
+    private static final Walker STACK_TRACE = new Walker() {
+        public int walk() {
+            return Thread.currentThread().getStackTrace().length;
+        }
+    };
+
+    private static final Walker THROWABLE = new Walker() {
+        public int walk() {
+            return new Throwable().getStackTrace().length;
+        }
+    };
+
+    private static final Walker EXCEPTION = new Walker() {
+        public int walk() {
+            try {
+                throw new IllegalStateException();
+            } catch (IllegalStateException e) {
+                return 1;
+            }
+        }
+    };
+
+    private int sink;
+
+    // Recurses with several call sites per method so that compiled frames have enough stack
+    // maps for the lookup of their return address to matter.
+    private static int recurse(int depth, int count, Walker walker) {
+        if (depth == 0) {
+            int result = 0;
+            for (int i = 0; i < count; ++i) {
+                result += walker.walk();
+            }
+            return result;
+        }
+        switch (depth % 4) {
+            case 0:
+                return step0(depth - 1, count, walker) + 1;
+            case 1:
+                return step1(depth - 1, count, walker) + 2;
+            case 2:
+                return recurse(depth - 1, count, walker) + 3;
+            default:
+                return step0(depth - 1, count, walker) + step1(0, 0, walker);
+        }
+    }
+
+    private static int step0(int depth, int count, Walker walker) {
+        if ((depth & 1) == 0) {
+            return recurse(depth, count, walker);
+        }
+        return step1(depth, count, walker) ^ Integer.bitCount(depth);
+    }
+
+    private static int step1(int depth, int count, Walker walker) {
+        if (depth == 0 && count == 0) {
+            return 0;
+        }
+        return recurse(depth, count, walker) - Integer.numberOfLeadingZeros(depth);
+    }
+
+    public void timeGetStackTrace(int count) {
+        sink = recurse(DEPTH, count, STACK_TRACE);
+    }
+
+    public void timeThrowableGetStackTrace(int count) {
+        sink = recurse(DEPTH, count, THROWABLE);
+    }
+
+    public void timeThrowAndCatch(int count) {
+        sink = recurse(DEPTH, count, EXCEPTION);
+    }
+}
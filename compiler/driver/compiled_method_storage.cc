@@ -192,6 +192,10 @@ void CompiledMethodStorage::DumpMemoryUsage(std::ostream& os, bool extended) con
   }
   if (extended) {
     Thread* self = Thread::Current();
+    if (swap_space_.get() != nullptr) {
+      os << "\n";
+      swap_space_->DumpStats(os);
+    }
     os << "\nCode dedupe: " << dedupe_code_.DumpStats(self);
     os << "\nVmap table dedupe: " << dedupe_vmap_table_.DumpStats(self);
     os << "\nCFI info dedupe: " << dedupe_cfi_info_.DumpStats(self);
@@ -1943,11 +1943,13 @@ static void LoadAndUpdateStatus(const DexFile& dex_file,
 
 bool CompilerDriver::FastVerify(jobject jclass_loader,
                                 const std::vector<const DexFile*>& dex_files,
-                                TimingLogger* timings) {
+                                TimingLogger* timings,
+                                /*out*/ std::vector<const DexFile*>* dex_files_to_verify) {
   verifier::VerifierDeps* verifier_deps =
       Runtime::Current()->GetCompilerCallbacks()->GetVerifierDeps();
   // If there is an existing `VerifierDeps`, try to use it for fast verification.
   if (verifier_deps == nullptr) {
+    dex_files_to_verify->insert(dex_files_to_verify->end(), dex_files.begin(), dex_files.end());
     return false;
   }
   TimingLogger::ScopedTiming t("Fast Verify", timings);
@@ -1955,18 +1957,21 @@ bool CompilerDriver::FastVerify(jobject jclass_loader,
   StackHandleScope<2> hs(soa.Self());
   Handle<mirror::ClassLoader> class_loader(
       hs.NewHandle(soa.Decode<mirror::ClassLoader>(jclass_loader)));
-  if (!verifier_deps->ValidateDependencies(class_loader, soa.Self())) {
-    return false;
-  }
 
   bool compiler_only_verifies = !GetCompilerOptions().IsAnyCompilationEnabled();
 
-  // We successfully validated the dependencies, now update class status
-  // of verified classes. Note that the dependencies also record which classes
-  // could not be fully verified; we could try again, but that would hurt verification
-  // time. So instead we assume these classes still need to be verified at
-  // runtime.
+  // Validate the dependencies of each dex file separately, and update class status
+  // of verified classes in the dex files whose dependencies still hold. Note that the
+  // dependencies also record which classes could not be fully verified; we could try
+  // again, but that would hurt verification time. So instead we assume these classes
+  // still need to be verified at runtime.
   for (const DexFile* dex_file : dex_files) {
+    if (!verifier_deps->ValidateDexFileDependencies(class_loader, *dex_file, soa.Self())) {
+      VLOG(compiler) << "Verifier dependencies of " << dex_file->GetLocation()
+                     << " do not hold anymore";
+      dex_files_to_verify->push_back(dex_file);
+      continue;
+    }
     // Fetch the list of unverified classes and turn it into a set for faster
     // lookups.
     const std::vector<dex::TypeIndex>& unverified_classes =
@@ -2004,13 +2009,14 @@ bool CompilerDriver::FastVerify(jobject jclass_loader,
       }
     }
   }
-  return true;
+  return dex_files_to_verify->empty();
 }
 
 void CompilerDriver::Verify(jobject jclass_loader,
                             const std::vector<const DexFile*>& dex_files,
                             TimingLogger* timings) {
-  if (FastVerify(jclass_loader, dex_files, timings)) {
+  std::vector<const DexFile*> dex_files_to_verify;
+  if (FastVerify(jclass_loader, dex_files, timings, &dex_files_to_verify)) {
     return;
   }
 
@@ -2021,6 +2027,16 @@ void CompilerDriver::Verify(jobject jclass_loader,
   if (!GetCompilerOptions().IsBootImage()) {
     // Create the main VerifierDeps, and set it to this thread.
     verifier::VerifierDeps* verifier_deps = new verifier::VerifierDeps(dex_files);
+    // Keep the dependencies of the dex files that did not need to be verified again.
+    verifier::VerifierDeps* old_verifier_deps =
+        Runtime::Current()->GetCompilerCallbacks()->GetVerifierDeps();
+    if (old_verifier_deps != nullptr) {
+      for (const DexFile* dex_file : dex_files) {
+        if (!ContainsElement(dex_files_to_verify, dex_file)) {
+          verifier_deps->CopyDexFileDeps(*old_verifier_deps, *dex_file);
+        }
+      }
+    }
     Runtime::Current()->GetCompilerCallbacks()->SetVerifierDeps(verifier_deps);
     Thread::Current()->SetVerifierDeps(verifier_deps);
     // Create per-thread VerifierDeps to avoid contention on the main one.
@@ -2035,7 +2051,7 @@ void CompilerDriver::Verify(jobject jclass_loader,
   ThreadPool* verify_thread_pool =
       force_determinism ? single_thread_pool_.get() : parallel_thread_pool_.get();
   size_t verify_thread_count = force_determinism ? 1U : parallel_thread_count_;
-  for (const DexFile* dex_file : dex_files) {
+  for (const DexFile* dex_file : dex_files_to_verify) {
     CHECK(dex_file != nullptr);
     VerifyDexFile(jclass_loader,
                   *dex_file,
@@ -394,12 +394,14 @@ class CompilerDriver {
       REQUIRES(!Locks::mutator_lock_);
 
   // Do fast verification through VerifierDeps if possible. Return whether
-  // verification was successful.
+  // verification was successful for all dex files. Dex files whose dependencies
+  // do not hold anymore are added to `dex_files_to_verify`.
   // NO_THREAD_SAFETY_ANALYSIS as the method accesses a guarded value in a
   // single-threaded way.
   bool FastVerify(jobject class_loader,
                   const std::vector<const DexFile*>& dex_files,
-                  TimingLogger* timings)
+                  TimingLogger* timings,
+                  /*out*/ std::vector<const DexFile*>* dex_files_to_verify)
       NO_THREAD_SAFETY_ANALYSIS;
 
   void Verify(jobject class_loader,
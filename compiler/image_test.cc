@@ -56,6 +56,8 @@ struct CompilationHelper {
   std::vector<ScratchFile> oat_files;
   std::vector<ScratchFile> vdex_files;
   std::string image_dir;
+  // Descriptors of the classes to pack into the known dirty bin.
+  std::unordered_set<std::string> dirty_image_objects;
 
   void Compile(CompilerDriver* driver,
                ImageHeader::StorageMode storage_mode);
@@ -72,7 +74,8 @@ class ImageTest : public CommonCompilerTest {
     CommonCompilerTest::SetUp();
   }
 
-  void TestWriteRead(ImageHeader::StorageMode storage_mode);
+  void TestWriteRead(ImageHeader::StorageMode storage_mode,
+                     const std::unordered_set<std::string>& dirty_image_objects = {});
 
   void Compile(ImageHeader::StorageMode storage_mode,
                CompilationHelper& out_helper,
@@ -210,7 +213,8 @@ void CompilationHelper::Compile(CompilerDriver* driver,
                                                       /*compile_app_image*/false,
                                                       storage_mode,
                                                       oat_filename_vector,
-                                                      dex_file_to_oat_index_map));
+                                                      dex_file_to_oat_index_map,
+                                                      &dirty_image_objects));
   {
     {
       jobject class_loader = nullptr;
@@ -382,8 +386,10 @@ void ImageTest::Compile(ImageHeader::StorageMode storage_mode,
   }
 }
 
-void ImageTest::TestWriteRead(ImageHeader::StorageMode storage_mode) {
+void ImageTest::TestWriteRead(ImageHeader::StorageMode storage_mode,
+                              const std::unordered_set<std::string>& dirty_image_objects) {
   CompilationHelper helper;
+  helper.dirty_image_objects = dirty_image_objects;
   Compile(storage_mode, /*out*/ helper);
   std::vector<uint64_t> image_file_sizes;
   for (ScratchFile& image_file : helper.image_files) {
@@ -486,6 +492,22 @@ void ImageTest::TestWriteRead(ImageHeader::StorageMode storage_mode) {
       EXPECT_TRUE(Monitor::IsValidLockWord(klass->GetLockWord(false)));
     }
   }
+
+  // Known dirty classes are the first objects of their image.
+  for (const std::string& descriptor : dirty_image_objects) {
+    mirror::Class* klass = class_linker_->FindSystemClass(soa.Self(), descriptor.c_str());
+    ASSERT_TRUE(klass != nullptr) << descriptor;
+    gc::space::ImageSpace* image_space = heap->GetBootImageSpaces()[0];
+    for (gc::space::ImageSpace* space : heap->GetBootImageSpaces()) {
+      if (space->HasAddress(klass)) {
+        image_space = space;
+      }
+    }
+    ASSERT_TRUE(image_space->HasAddress(klass)) << descriptor;
+    EXPECT_EQ(RoundUp(sizeof(ImageHeader), kObjectAlignment),
+              static_cast<size_t>(reinterpret_cast<uint8_t*>(klass) - image_space->Begin()))
+        << descriptor;
+  }
 }
 
 TEST_F(ImageTest, WriteReadUncompressed) {
@@ -500,6 +522,10 @@ TEST_F(ImageTest, WriteReadLZ4HC) {
   TestWriteRead(ImageHeader::kStorageModeLZ4HC);
 }
 
+TEST_F(ImageTest, WriteReadDirtyImageObjects) {
+  TestWriteRead(ImageHeader::kStorageModeUncompressed, {"Ljava/lang/Object;"});
+}
+
 TEST_F(ImageTest, TestImageLayout) {
   std::vector<size_t> image_sizes;
   std::vector<size_t> image_sizes_extra;
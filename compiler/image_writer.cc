@@ -69,6 +69,7 @@
 #include "runtime.h"
 #include "scoped_thread_state_change-inl.h"
 #include "handle_scope-inl.h"
+#include "thread_pool.h"
 #include "utils/dex_cache_arrays_layout-inl.h"
 
 using ::art::mirror::Class;
@@ -179,20 +180,31 @@ bool ImageWriter::Write(int image_fd,
   CHECK(!oat_filenames.empty());
   CHECK_EQ(image_filenames.size(), oat_filenames.size());
 
+  // The copy and fixup passes only write to the object's own copy in the image, so they can be
+  // split into address ranges and run on the compiler threads.
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (compiler_driver_.GetThreadCount() > 1u) {
+    thread_pool.reset(
+        new ThreadPool("Image writer thread pool", compiler_driver_.GetThreadCount() - 1u));
+  }
+
   {
     ScopedObjectAccess soa(Thread::Current());
     for (size_t i = 0; i < oat_filenames.size(); ++i) {
       CreateHeader(i);
-      CopyAndFixupNativeData(i);
     }
   }
+  for (size_t i = 0; i < oat_filenames.size(); ++i) {
+    CopyAndFixupNativeData(i, thread_pool.get());
+  }
 
   {
     // TODO: heap validation can't handle these fix up passes.
     ScopedObjectAccess soa(Thread::Current());
     Runtime::Current()->GetHeap()->DisableObjectValidation();
-    CopyAndFixupObjects();
   }
+  CopyAndFixupObjects(thread_pool.get());
+  thread_pool.reset();
 
   for (size_t i = 0; i < image_filenames.size(); ++i) {
     const char* image_filename = image_filenames[i];
@@ -591,6 +603,16 @@ void ImageWriter::AssignImageBinSlot(mirror::Object* object, size_t oat_index) {
           }
         }
       }
+
+      // Classes that a runtime profile (e.g. from imgdiag) reports as dirty are packed together
+      // at the start of the image so that they share as few pages as possible.
+      if (dirty_image_objects_ != nullptr) {
+        std::string temp;
+        if (dirty_image_objects_->find(klass->GetDescriptor(&temp)) !=
+            dirty_image_objects_->end()) {
+          bin = kBinKnownDirty;
+        }
+      }
     } else if (object->GetClass<kVerifyNone>()->IsStringClass()) {
       bin = kBinString;  // Strings are almost always immutable (except for object header).
     } else if (object->GetClass<kVerifyNone>() ==
@@ -1907,67 +1929,125 @@ void ImageWriter::CopyAndFixupImtConflictTable(ImtConflictTable* orig, ImtConfli
   }
 }
 
-void ImageWriter::CopyAndFixupNativeData(size_t oat_index) {
-  const ImageInfo& image_info = GetImageInfo(oat_index);
-  // Copy ArtFields and methods to their locations and update the array for convenience.
-  for (auto& pair : native_object_relocations_) {
-    NativeObjectRelocation& relocation = pair.second;
-    // Only work with fields and methods that are in the current oat file.
-    if (relocation.oat_index != oat_index) {
-      continue;
+// Runs a range of a parallel copy and fixup pass on a thread pool worker.
+class ImageWriter::FixupRangeTask FINAL : public Task {
+ public:
+  FixupRangeTask(const std::function<void(size_t, size_t)>& fn, size_t begin, size_t end)
+      : fn_(fn), begin_(begin), end_(end) {}
+
+  void Run(Thread* self) OVERRIDE {
+    ScopedObjectAccess soa(self);
+    fn_(begin_, end_);
+  }
+
+ private:
+  const std::function<void(size_t, size_t)>& fn_;
+  const size_t begin_;
+  const size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(FixupRangeTask);
+};
+
+void ImageWriter::RunInParallel(ThreadPool* thread_pool,
+                                size_t count,
+                                const std::function<void(size_t, size_t)>& fn) {
+  // Below this many work units, the cost of waking up the workers is larger than the work.
+  static constexpr size_t kMinParallelWorkUnits = 1024u;
+  // Use a few ranges per thread so that workers that finish early can pick up more work.
+  static constexpr size_t kRangesPerThread = 4u;
+  Thread* self = Thread::Current();
+  if (thread_pool == nullptr || count < kMinParallelWorkUnits) {
+    ScopedObjectAccess soa(self);
+    fn(0u, count);
+    return;
+  }
+  const size_t num_ranges = (thread_pool->GetThreadCount() + 1u) * kRangesPerThread;
+  const size_t range_size = RoundUp(count, num_ranges) / num_ranges;
+  std::vector<std::unique_ptr<FixupRangeTask>> tasks;
+  for (size_t begin = 0u; begin < count; begin += range_size) {
+    tasks.emplace_back(new FixupRangeTask(fn, begin, std::min(begin + range_size, count)));
+    thread_pool->AddTask(self, tasks.back().get());
+  }
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+  thread_pool->StopWorkers(self);
+}
+
+void ImageWriter::CopyAndFixupNativeObject(void* orig,
+                                           const NativeObjectRelocation& relocation,
+                                           const ImageInfo& image_info) {
+  auto* dest = image_info.image_->Begin() + relocation.offset;
+  DCHECK_GE(dest, image_info.image_->Begin() + image_info.image_end_);
+  DCHECK(!IsInBootImage(orig));
+  switch (relocation.type) {
+    case kNativeObjectRelocationTypeArtField: {
+      memcpy(dest, orig, sizeof(ArtField));
+      CopyReference(
+          reinterpret_cast<ArtField*>(dest)->GetDeclaringClassAddressWithoutBarrier(),
+          reinterpret_cast<ArtField*>(orig)->GetDeclaringClass().Ptr());
+      break;
     }
-    auto* dest = image_info.image_->Begin() + relocation.offset;
-    DCHECK_GE(dest, image_info.image_->Begin() + image_info.image_end_);
-    DCHECK(!IsInBootImage(pair.first));
-    switch (relocation.type) {
-      case kNativeObjectRelocationTypeArtField: {
-        memcpy(dest, pair.first, sizeof(ArtField));
-        CopyReference(
-            reinterpret_cast<ArtField*>(dest)->GetDeclaringClassAddressWithoutBarrier(),
-            reinterpret_cast<ArtField*>(pair.first)->GetDeclaringClass().Ptr());
-        break;
-      }
-      case kNativeObjectRelocationTypeRuntimeMethod:
-      case kNativeObjectRelocationTypeArtMethodClean:
-      case kNativeObjectRelocationTypeArtMethodDirty: {
-        CopyAndFixupMethod(reinterpret_cast<ArtMethod*>(pair.first),
-                           reinterpret_cast<ArtMethod*>(dest),
-                           image_info);
-        break;
-      }
-      // For arrays, copy just the header since the elements will get copied by their corresponding
-      // relocations.
-      case kNativeObjectRelocationTypeArtFieldArray: {
-        memcpy(dest, pair.first, LengthPrefixedArray<ArtField>::ComputeSize(0));
-        break;
-      }
-      case kNativeObjectRelocationTypeArtMethodArrayClean:
-      case kNativeObjectRelocationTypeArtMethodArrayDirty: {
-        size_t size = ArtMethod::Size(target_ptr_size_);
-        size_t alignment = ArtMethod::Alignment(target_ptr_size_);
-        memcpy(dest, pair.first, LengthPrefixedArray<ArtMethod>::ComputeSize(0, size, alignment));
-        // Clear padding to avoid non-deterministic data in the image (and placate valgrind).
-        reinterpret_cast<LengthPrefixedArray<ArtMethod>*>(dest)->ClearPadding(size, alignment);
-        break;
-      }
-      case kNativeObjectRelocationTypeDexCacheArray:
-        // Nothing to copy here, everything is done in FixupDexCache().
-        break;
-      case kNativeObjectRelocationTypeIMTable: {
-        ImTable* orig_imt = reinterpret_cast<ImTable*>(pair.first);
-        ImTable* dest_imt = reinterpret_cast<ImTable*>(dest);
-        CopyAndFixupImTable(orig_imt, dest_imt);
-        break;
-      }
-      case kNativeObjectRelocationTypeIMTConflictTable: {
-        auto* orig_table = reinterpret_cast<ImtConflictTable*>(pair.first);
-        CopyAndFixupImtConflictTable(
-            orig_table,
-            new(dest)ImtConflictTable(orig_table->NumEntries(target_ptr_size_), target_ptr_size_));
-        break;
-      }
+    case kNativeObjectRelocationTypeRuntimeMethod:
+    case kNativeObjectRelocationTypeArtMethodClean:
+    case kNativeObjectRelocationTypeArtMethodDirty: {
+      CopyAndFixupMethod(reinterpret_cast<ArtMethod*>(orig),
+                         reinterpret_cast<ArtMethod*>(dest),
+                         image_info);
+      break;
+    }
+    // For arrays, copy just the header since the elements will get copied by their corresponding
+    // relocations.
+    case kNativeObjectRelocationTypeArtFieldArray: {
+      memcpy(dest, orig, LengthPrefixedArray<ArtField>::ComputeSize(0));
+      break;
+    }
+    case kNativeObjectRelocationTypeArtMethodArrayClean:
+    case kNativeObjectRelocationTypeArtMethodArrayDirty: {
+      size_t size = ArtMethod::Size(target_ptr_size_);
+      size_t alignment = ArtMethod::Alignment(target_ptr_size_);
+      memcpy(dest, orig, LengthPrefixedArray<ArtMethod>::ComputeSize(0, size, alignment));
+      // Clear padding to avoid non-deterministic data in the image (and placate valgrind).
+      reinterpret_cast<LengthPrefixedArray<ArtMethod>*>(dest)->ClearPadding(size, alignment);
+      break;
+    }
+    case kNativeObjectRelocationTypeDexCacheArray:
+      // Nothing to copy here, everything is done in FixupDexCache().
+      break;
+    case kNativeObjectRelocationTypeIMTable: {
+      ImTable* orig_imt = reinterpret_cast<ImTable*>(orig);
+      ImTable* dest_imt = reinterpret_cast<ImTable*>(dest);
+      CopyAndFixupImTable(orig_imt, dest_imt);
+      break;
+    }
+    case kNativeObjectRelocationTypeIMTConflictTable: {
+      auto* orig_table = reinterpret_cast<ImtConflictTable*>(orig);
+      CopyAndFixupImtConflictTable(
+          orig_table,
+          new(dest)ImtConflictTable(orig_table->NumEntries(target_ptr_size_), target_ptr_size_));
+      break;
+    }
+  }
+}
+
+void ImageWriter::CopyAndFixupNativeData(size_t oat_index, ThreadPool* thread_pool) {
+  const ImageInfo& image_info = GetImageInfo(oat_index);
+  // Gather the fields and methods that are in the current oat file, each one is copied to its own
+  // location so they can be processed in parallel.
+  std::vector<std::pair<void*, const NativeObjectRelocation*>> relocations;
+  for (const auto& pair : native_object_relocations_) {
+    if (pair.second.oat_index == oat_index) {
+      relocations.emplace_back(pair.first, &pair.second);
     }
   }
+  // Copy ArtFields and methods to their locations and update the array for convenience.
+  auto copy_range = [&](size_t begin, size_t end) REQUIRES_SHARED(Locks::mutator_lock_) {
+    for (size_t i = begin; i != end; ++i) {
+      CopyAndFixupNativeObject(relocations[i].first, *relocations[i].second, image_info);
+    }
+  };
+  RunInParallel(thread_pool, relocations.size(), copy_range);
+
+  ScopedObjectAccess soa(Thread::Current());
   // Fixup the image method roots.
   auto* image_header = reinterpret_cast<ImageHeader*>(image_info.image_->Begin());
   for (size_t i = 0; i < ImageHeader::kImageMethodsCount; ++i) {
@@ -2023,9 +2103,24 @@ void ImageWriter::CopyAndFixupNativeData(size_t oat_index) {
   }
 }
 
-void ImageWriter::CopyAndFixupObjects() {
-  gc::Heap* heap = Runtime::Current()->GetHeap();
-  heap->VisitObjects(CopyAndFixupObjectsCallback, this);
+void ImageWriter::CopyAndFixupObjects(ThreadPool* thread_pool) {
+  std::vector<Object*> objects;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    Runtime::Current()->GetHeap()->VisitObjects(CollectObjectsCallback, &objects);
+  }
+  // Each object is only copied to its own slot in the image. The lock words of the original
+  // objects still hold the forwarding addresses, so they are only restored afterwards.
+  auto copy_range = [&](size_t begin, size_t end) REQUIRES_SHARED(Locks::mutator_lock_) {
+    for (size_t i = begin; i != end; ++i) {
+      CopyAndFixupObject(objects[i]);
+    }
+  };
+  RunInParallel(thread_pool, objects.size(), copy_range);
+  // All the pointer arrays have been fixed up.
+  pointer_arrays_.clear();
+
+  ScopedObjectAccess soa(Thread::Current());
   // Fix up the object previously had hash codes.
   for (const auto& hash_pair : saved_hashcode_map_) {
     Object* obj = hash_pair.first;
@@ -2035,10 +2130,10 @@ void ImageWriter::CopyAndFixupObjects() {
   saved_hashcode_map_.clear();
 }
 
-void ImageWriter::CopyAndFixupObjectsCallback(Object* obj, void* arg) {
+void ImageWriter::CollectObjectsCallback(Object* obj, void* arg) {
   DCHECK(obj != nullptr);
   DCHECK(arg != nullptr);
-  reinterpret_cast<ImageWriter*>(arg)->CopyAndFixupObject(obj);
+  reinterpret_cast<std::vector<Object*>*>(arg)->push_back(obj);
 }
 
 void ImageWriter::FixupPointerArray(mirror::Object* dst,
@@ -2086,7 +2181,9 @@ void ImageWriter::CopyAndFixupObject(Object* obj) {
   DCHECK_LT(offset, image_info.image_end_);
   const auto* src = reinterpret_cast<const uint8_t*>(obj);
 
-  image_info.image_bitmap_->Set(dst);  // Mark the obj as live.
+  // Mark the obj as live. Other objects in the same bitmap word may be copied concurrently.
+  const bool was_marked = image_info.image_bitmap_->AtomicTestAndSet(dst);
+  DCHECK(!was_marked);
 
   const size_t n = obj->SizeOf();
   DCHECK_LE(offset + n, image_info.image_->Size());
@@ -2242,7 +2339,6 @@ void ImageWriter::FixupObject(Object* orig, Object* copy) {
     if (it != pointer_arrays_.end()) {
       // Should only need to fixup every pointer array exactly once.
       FixupPointerArray(copy, down_cast<mirror::PointerArray*>(orig), klass, it->second);
-      pointer_arrays_.erase(it);
       return;
     }
   }
@@ -2651,7 +2747,8 @@ ImageWriter::ImageWriter(
     bool compile_app_image,
     ImageHeader::StorageMode image_storage_mode,
     const std::vector<const char*>& oat_filenames,
-    const std::unordered_map<const DexFile*, size_t>& dex_file_oat_index_map)
+    const std::unordered_map<const DexFile*, size_t>& dex_file_oat_index_map,
+    const std::unordered_set<std::string>* dirty_image_objects)
     : compiler_driver_(compiler_driver),
       global_image_begin_(reinterpret_cast<uint8_t*>(image_begin)),
       image_objects_offset_begin_(0),
@@ -2663,7 +2760,8 @@ ImageWriter::ImageWriter(
       clean_methods_(0u),
       image_storage_mode_(image_storage_mode),
       oat_filenames_(oat_filenames),
-      dex_file_oat_index_map_(dex_file_oat_index_map) {
+      dex_file_oat_index_map_(dex_file_oat_index_map),
+      dirty_image_objects_(dirty_image_objects) {
   CHECK_NE(image_begin, 0U);
   std::fill_n(image_methods_, arraysize(image_methods_), nullptr);
   CHECK_EQ(compile_app_image, !Runtime::Current()->GetHeap()->GetBootImageSpaces().empty())
@@ -21,11 +21,13 @@
 #include "base/memory_tool.h"
 
 #include <cstddef>
+#include <functional>
 #include <memory>
 #include <set>
 #include <stack>
 #include <string>
 #include <ostream>
+#include <unordered_set>
 
 #include "art_method.h"
 #include "base/bit_utils.h"
@@ -59,6 +61,7 @@ class ClassLoader;
 class ClassLoaderVisitor;
 class ClassTable;
 class ImtConflictTable;
+class ThreadPool;
 
 static constexpr int kInvalidFd = -1;
 
@@ -71,7 +74,8 @@ class ImageWriter FINAL {
               bool compile_app_image,
               ImageHeader::StorageMode image_storage_mode,
               const std::vector<const char*>& oat_filenames,
-              const std::unordered_map<const DexFile*, size_t>& dex_file_oat_index_map);
+              const std::unordered_map<const DexFile*, size_t>& dex_file_oat_index_map,
+              const std::unordered_set<std::string>* dirty_image_objects);
 
   bool PrepareImageAddressSpace();
 
@@ -168,6 +172,7 @@ class ImageWriter FINAL {
   // Classify different kinds of bins that objects end up getting packed into during image writing.
   // Ordered from dirtiest to cleanest (until ArtMethods).
   enum Bin {
+    kBinKnownDirty,               // Class objects known to be dirtied at runtime (from a profile).
     kBinMiscDirty,                // Dex caches, object locks, etc...
     kBinClassVerified,            // Class verified, but initializers haven't been run
     // Unknown mix of clean/dirty:
@@ -202,6 +207,8 @@ class ImageWriter FINAL {
   };
   friend std::ostream& operator<<(std::ostream& stream, const Bin& bin);
 
+  struct NativeObjectRelocation;
+
   enum NativeObjectRelocationType {
     kNativeObjectRelocationTypeArtField,
     kNativeObjectRelocationTypeArtFieldArray,
@@ -431,9 +438,20 @@ class ImageWriter FINAL {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Creates the contiguous image in memory and adjusts pointers.
-  void CopyAndFixupNativeData(size_t oat_index) REQUIRES_SHARED(Locks::mutator_lock_);
-  void CopyAndFixupObjects() REQUIRES_SHARED(Locks::mutator_lock_);
-  static void CopyAndFixupObjectsCallback(mirror::Object* obj, void* arg)
+  // Run `fn` over [0, count) split into ranges, on the workers of `thread_pool` if it is not null
+  // or on the current thread otherwise. `fn` is called with the mutator lock held.
+  void RunInParallel(ThreadPool* thread_pool,
+                     size_t count,
+                     const std::function<void(size_t, size_t)>& fn)
+      REQUIRES(!Locks::mutator_lock_);
+  void CopyAndFixupNativeData(size_t oat_index, ThreadPool* thread_pool)
+      REQUIRES(!Locks::mutator_lock_);
+  void CopyAndFixupNativeObject(void* orig,
+                                const NativeObjectRelocation& relocation,
+                                const ImageInfo& image_info)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+  void CopyAndFixupObjects(ThreadPool* thread_pool) REQUIRES(!Locks::mutator_lock_);
+  static void CollectObjectsCallback(mirror::Object* obj, void* arg)
       REQUIRES_SHARED(Locks::mutator_lock_);
   void CopyAndFixupObject(mirror::Object* obj) REQUIRES_SHARED(Locks::mutator_lock_);
   void CopyAndFixupMethod(ArtMethod* orig, ArtMethod* copy, const ImageInfo& image_info)
@@ -619,8 +637,12 @@ class ImageWriter FINAL {
   // Map of dex files to the indexes of oat files that they were compiled into.
   const std::unordered_map<const DexFile*, size_t>& dex_file_oat_index_map_;
 
+  // Descriptors of classes whose class objects are known to be dirtied at runtime, may be null.
+  const std::unordered_set<std::string>* dirty_image_objects_;
+
   class ComputeLazyFieldsForClassesVisitor;
   class FixupClassVisitor;
+  class FixupRangeTask;
   class FixupRootVisitor;
   class FixupVisitor;
   class GetRootsVisitor;
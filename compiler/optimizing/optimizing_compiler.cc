@@ -343,6 +343,10 @@ class OptimizingCompiler FINAL : public Compiler {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
  private:
+  // Compiles the JNI stub of a native method into the code cache.
+  bool JitCompileJniStub(Thread* self, jit::JitCodeCache* code_cache, ArtMethod* method)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   void RunOptimizations(HGraph* graph,
                         CodeGenerator* codegen,
                         CompilerDriver* driver,
@@ -1133,6 +1137,93 @@ bool CanEncodeInlinedMethodInStackMap(const DexFile& caller_dex_file, ArtMethod*
   return false;
 }
 
+bool OptimizingCompiler::JitCompileJniStub(Thread* self,
+                                           jit::JitCodeCache* code_cache,
+                                           ArtMethod* method) {
+  DCHECK(method->IsNative());
+  const DexFile* dex_file = method->GetDexFile();
+  const uint16_t class_def_idx = method->GetClassDefIndex();
+  const uint32_t method_idx = method->GetDexMethodIndex();
+  const uint32_t access_flags = method->GetAccessFlags();
+  // Query any JNI optimization annotations such as @FastNative or @CriticalNative.
+  Compiler::JniOptimizationFlags optimization_flags = Compiler::kNone;
+  if (method->IsAnnotatedWithFastNative()) {
+    optimization_flags = Compiler::kFastNative;
+  } else if (method->IsAnnotatedWithCriticalNative()) {
+    optimization_flags = Compiler::kCriticalNative;
+  }
+  DCHECK(!self->IsExceptionPending());
+
+  CompiledMethod* compiled_method;
+  {
+    // Go to native so that we don't block GC during compilation.
+    ScopedThreadSuspension sts(self, kNative);
+    compiled_method = JniCompile(access_flags, method_idx, *dex_file, optimization_flags);
+  }
+  if (compiled_method == nullptr) {
+    return false;
+  }
+  ArrayRef<const uint8_t> quick_code = compiled_method->GetQuickCode();
+  // JNI stubs have no stack maps and reference no objects.
+  StackHandleScope<1> hs(self);
+  Handle<mirror::ObjectArray<mirror::Object>> roots(
+      hs.NewHandle<mirror::ObjectArray<mirror::Object>>(nullptr));
+  ArenaAllocator arena(Runtime::Current()->GetJitArenaPool());
+  ArenaSet<ArtMethod*> cha_single_implementation_list(arena.Adapter(kArenaAllocCHA));
+  const void* code = code_cache->CommitCode(
+      self,
+      method,
+      /* stack_map */ nullptr,
+      /* method_info */ nullptr,
+      /* roots_data */ nullptr,
+      compiled_method->GetFrameSizeInBytes(),
+      compiled_method->GetCoreSpillMask(),
+      compiled_method->GetFpSpillMask(),
+      quick_code.data(),
+      quick_code.size(),
+      /* data_size */ 0u,
+      /* osr */ false,
+      roots,
+      /* has_should_deoptimize_flag */ false,
+      cha_single_implementation_list);
+  if (code == nullptr) {
+    CompiledMethod::ReleaseSwapAllocatedCompiledMethod(GetCompilerDriver(), compiled_method);
+    return false;
+  }
+
+  const CompilerOptions& compiler_options = GetCompilerDriver()->GetCompilerOptions();
+  if (compiler_options.GetGenerateDebugInfo()) {
+    const auto* method_header = reinterpret_cast<const OatQuickMethodHeader*>(code);
+    const uintptr_t code_address = reinterpret_cast<uintptr_t>(method_header->GetCode());
+    debug::MethodDebugInfo info = debug::MethodDebugInfo();
+    info.trampoline_name = nullptr;
+    info.dex_file = dex_file;
+    info.class_def_index = class_def_idx;
+    info.dex_method_index = method_idx;
+    info.access_flags = access_flags;
+    info.code_item = nullptr;
+    info.isa = compiled_method->GetInstructionSet();
+    info.deduped = false;
+    info.is_native_debuggable = compiler_options.GetNativeDebuggable();
+    info.is_optimized = false;
+    info.is_code_address_text_relative = false;
+    info.code_address = code_address;
+    info.code_size = quick_code.size();
+    info.frame_size_in_bytes = method_header->GetFrameSizeInBytes();
+    info.code_info = nullptr;
+    info.cfi = compiled_method->GetCFIInfo();
+    std::vector<uint8_t> elf_file = debug::WriteDebugElfFileForMethods(
+        GetCompilerDriver()->GetInstructionSet(),
+        GetCompilerDriver()->GetInstructionSetFeatures(),
+        ArrayRef<const debug::MethodDebugInfo>(&info, 1));
+    CreateJITCodeEntryForAddress(code_address, std::move(elf_file));
+  }
+
+  CompiledMethod::ReleaseSwapAllocatedCompiledMethod(GetCompilerDriver(), compiled_method);
+  Runtime::Current()->GetJit()->AddMemoryUsage(method, arena.BytesUsed());
+  return true;
+}
+
 bool OptimizingCompiler::JitCompile(Thread* self,
                                     jit::JitCodeCache* code_cache,
                                     ArtMethod* method,
@@ -1150,6 +1241,10 @@ bool OptimizingCompiler::JitCompile(Thread* self,
   const uint32_t access_flags = method->GetAccessFlags();
   const InvokeType invoke_type = method->GetInvokeType();
 
+  if (UNLIKELY(method->IsNative())) {
+    return JitCompileJniStub(self, code_cache, method);
+  }
+
   ArenaAllocator arena(Runtime::Current()->GetJitArenaPool());
   CodeVectorAllocator code_allocator(&arena);
   VariableSizedHandleScope handles(self);
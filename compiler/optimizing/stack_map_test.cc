@@ -1011,4 +1011,58 @@ TEST(StackMapTest, TestInvokeInfo) {
   EXPECT_EQ(invoke3.GetNativePcOffset(encoding.invoke_info.encoding, kRuntimeISA), 16u);
 }
 
+// Fills in a code info with `count` stack maps at native pc offsets `first_native_pc`,
+// `first_native_pc` + 16, ..., whose dex pc is their index, into `memory`.
+static CodeInfo FillInStackMapsAt(ArenaAllocator* arena,
+                                  size_t count,
+                                  uint32_t first_native_pc,
+                                  void* memory,
+                                  size_t memory_size) {
+  StackMapStream stream(arena, kRuntimeISA);
+  ArenaBitVector sp_mask(arena, 0, false);
+  for (size_t i = 0; i < count; ++i) {
+    stream.BeginStackMapEntry(i, first_native_pc + 16 * i, 0x3, &sp_mask, 0, 0);
+    stream.EndStackMapEntry();
+  }
+  size_t size = stream.PrepareForFillIn();
+  CHECK_LE(size, memory_size);
+  MemoryRegion region(memory, size);
+  stream.FillInCodeInfo(region);
+  return CodeInfo(region);
+}
+
+TEST(StackMapTest, TestLookupCache) {
+  ArenaPool pool;
+  ArenaAllocator arena(&pool);
+  static constexpr size_t kNumStackMaps = 4 * StackMapLookupCache::kMinStackMaps;
+  static constexpr size_t kMemorySize = 4 * KB;
+  void* memory = arena.Alloc(kMemorySize, kArenaAllocMisc);
+  StackMapLookupCache::Clear();
+
+  CodeInfo code_info = FillInStackMapsAt(&arena, kNumStackMaps, 16, memory, kMemorySize);
+  CodeInfoEncoding encoding = code_info.ExtractEncoding();
+  ASSERT_EQ(kNumStackMaps, code_info.GetNumberOfStackMaps(encoding));
+  // The first round fills the cache, the second one hits it.
+  for (size_t round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < kNumStackMaps; ++i) {
+      StackMap stack_map = code_info.GetStackMapForNativePcOffset(16 * (i + 1), encoding);
+      ASSERT_TRUE(stack_map.IsValid());
+      ASSERT_TRUE(stack_map.Equals(code_info.GetStackMapAt(i, encoding)));
+      ASSERT_EQ(i, stack_map.GetDexPc(encoding.stack_map.encoding));
+    }
+    ASSERT_FALSE(code_info.GetStackMapForNativePcOffset(8, encoding).IsValid());
+  }
+
+  // Reuse the memory for a code info with shifted stack maps, as happens when JIT code is freed.
+  // The stale entries of the old code info must not be returned.
+  CodeInfo shifted = FillInStackMapsAt(&arena, kNumStackMaps, 32, memory, kMemorySize);
+  CodeInfoEncoding shifted_encoding = shifted.ExtractEncoding();
+  for (size_t i = 0; i < kNumStackMaps; ++i) {
+    StackMap stack_map = shifted.GetStackMapForNativePcOffset(16 * (i + 2), shifted_encoding);
+    ASSERT_TRUE(stack_map.IsValid());
+    ASSERT_EQ(i, stack_map.GetDexPc(shifted_encoding.stack_map.encoding));
+  }
+  ASSERT_FALSE(shifted.GetStackMapForNativePcOffset(16, shifted_encoding).IsValid());
+}
+
 }  // namespace art
@@ -19,11 +19,13 @@
 #include <algorithm>
 #include <numeric>
 #include <sys/mman.h>
+#include <sys/resource.h>
 
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/mutex.h"
 #include "thread-inl.h"
+#include "utils.h"
 
 namespace art {
 
@@ -32,10 +34,17 @@ static constexpr size_t kMininumMapSize = 16 * MB;
 
 static constexpr bool kCheckFreeMaps = false;
 
-template <typename FreeBySizeSet>
-static void DumpFreeMap(const FreeBySizeSet& free_by_size) {
+static uint64_t GetProcessPageFaults() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0u;
+  }
+  return static_cast<uint64_t>(usage.ru_minflt) + static_cast<uint64_t>(usage.ru_majflt);
+}
+
+void SwapSpace::FreeList::Dump() const {
   size_t last_size = static_cast<size_t>(-1);
-  for (const auto& entry : free_by_size) {
+  for (const auto& entry : free_by_size_) {
     if (last_size != entry.size) {
       last_size = entry.size;
       LOG(INFO) << "Size " << last_size;
@@ -45,117 +54,270 @@ static void DumpFreeMap(const FreeBySizeSet& free_by_size) {
   }
 }
 
-void SwapSpace::RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos) {
+size_t SwapSpace::FreeList::CollectFree() const {
+  if (free_by_start_.size() != free_by_size_.size()) {
+    LOG(FATAL) << "Size: " << free_by_start_.size() << " vs " << free_by_size_.size();
+  }
+
+  // Calculate over free_by_size.
+  size_t sum1 = 0;
+  for (const auto& entry : free_by_size_) {
+    sum1 += entry.free_by_start_entry->size;
+  }
+
+  // Calculate over free_by_start.
+  size_t sum2 = 0;
+  for (const auto& entry : free_by_start_) {
+    sum2 += entry.size;
+  }
+
+  if (sum1 != sum2) {
+    LOG(FATAL) << "Sum: " << sum1 << " vs " << sum2;
+  }
+  return sum1;
+}
+
+void SwapSpace::FreeList::RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos) {
   auto free_by_start_pos = free_by_size_pos->free_by_start_entry;
   free_by_size_.erase(free_by_size_pos);
   free_by_start_.erase(free_by_start_pos);
 }
 
-inline void SwapSpace::InsertChunk(const SpaceChunk& chunk) {
+inline void SwapSpace::FreeList::InsertChunk(const SpaceChunk& chunk) {
   DCHECK_NE(chunk.size, 0u);
   auto insert_result = free_by_start_.insert(chunk);
   DCHECK(insert_result.second);
   free_by_size_.emplace(chunk.size, insert_result.first);
 }
 
+SwapSpace::SpaceChunk SwapSpace::FreeList::Take(size_t size) {
+  // Check the free list for something that fits.
+  // TODO: Smarter implementation. Global biggest chunk, ...
+  auto it = free_by_start_.empty()
+      ? free_by_size_.end()
+      : free_by_size_.lower_bound(FreeBySizeEntry { size, free_by_start_.begin() });
+  if (it == free_by_size_.end()) {
+    return SpaceChunk { nullptr, 0u, nullptr };
+  }
+  auto entry = it->free_by_start_entry;
+  SpaceChunk old_chunk = *entry;
+  if (old_chunk.size == size) {
+    RemoveChunk(it);
+  } else {
+    // Try to avoid deallocating and allocating the std::set<> nodes.
+    // This would be much simpler if we could use replace() from Boost.Bimap.
+
+    // The free_by_start map contains disjoint intervals ordered by the `ptr`.
+    // Shrinking the interval does not affect the ordering.
+    it->free_by_start_entry->ptr += size;
+    it->free_by_start_entry->size -= size;
+
+    // The free_by_size map is ordered by the `size` and then `free_by_start_entry->ptr`.
+    // Adjusting the `ptr` above does not change that ordering but decreasing `size` can
+    // push the node before the previous node(s).
+    if (it == free_by_size_.begin()) {
+      it->size -= size;
+    } else {
+      auto prev = it;
+      --prev;
+      FreeBySizeEntry new_value(old_chunk.size - size, entry);
+      if (free_by_size_.key_comp()(*prev, new_value)) {
+        it->size -= size;
+      } else {
+        // Changing in place would break the std::set<> ordering, we need to remove and insert.
+        free_by_size_.erase(it);
+        free_by_size_.insert(new_value);
+      }
+    }
+  }
+  return SpaceChunk { old_chunk.ptr, size, old_chunk.slab };
+}
+
+// TODO: Full coalescing.
+void SwapSpace::FreeList::Insert(SpaceChunk chunk) {
+  auto it = free_by_start_.lower_bound(chunk);
+  if (it != free_by_start_.begin()) {
+    auto prev = it;
+    --prev;
+    CHECK_LE(prev->End(), chunk.Start());
+    if (prev->End() == chunk.Start() && prev->slab == chunk.slab) {
+      // Merge *prev with this chunk.
+      chunk.size += prev->size;
+      chunk.ptr -= prev->size;
+      auto erase_pos = free_by_size_.find(FreeBySizeEntry { prev->size, prev });
+      DCHECK(erase_pos != free_by_size_.end());
+      RemoveChunk(erase_pos);
+      // "prev" is invalidated but "it" remains valid.
+    }
+  }
+  if (it != free_by_start_.end()) {
+    CHECK_LE(chunk.End(), it->Start());
+    if (chunk.End() == it->Start() && chunk.slab == it->slab) {
+      // Merge *it with this chunk.
+      chunk.size += it->size;
+      auto erase_pos = free_by_size_.find(FreeBySizeEntry { it->size, it });
+      DCHECK(erase_pos != free_by_size_.end());
+      RemoveChunk(erase_pos);
+      // "it" is invalidated but we don't need it anymore.
+    }
+  }
+  InsertChunk(chunk);
+}
+
+void SwapSpace::FreeList::Remove(const SpaceChunk& chunk) {
+  auto it = free_by_start_.find(chunk);
+  CHECK(it != free_by_start_.end());
+  CHECK_EQ(it->size, chunk.size);
+  auto erase_pos = free_by_size_.find(FreeBySizeEntry { it->size, it });
+  DCHECK(erase_pos != free_by_size_.end());
+  RemoveChunk(erase_pos);
+}
+
+SwapSpace::Arena::Arena(const char* name)
+    : idle_slab_(nullptr),
+      lock_(name, static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 1)) {
+}
+
 SwapSpace::SwapSpace(int fd, size_t initial_size)
     : fd_(fd),
       size_(0),
-      lock_("SwapSpace lock", static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 1)) {
+      pending_release_bytes_(0u),
+      madvise_remove_supported_(true),
+      initial_page_faults_(GetProcessPageFaults()),
+      bytes_in_use_(0u),
+      bytes_swapped_(0u),
+      bytes_released_(0u),
+      file_lock_("SwapSpace file lock",
+                 static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 2)),
+      slabs_lock_("SwapSpace slabs lock",
+                  static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 3)) {
   // Assume that the file is unlinked.
 
-  InsertChunk(NewFileChunk(initial_size));
+  for (size_t i = 0; i != kNumArenas; ++i) {
+    arenas_[i].reset(new Arena("SwapSpace arena lock"));
+  }
+  MutexLock lock(Thread::Current(), file_lock_);
+  pool_.Insert(NewFileChunk(initial_size));
 }
 
 SwapSpace::~SwapSpace() {
-  // Unmap all mmapped chunks. Nothing should be allocated anymore at
-  // this point, so there should be only full size chunks in free_by_start_.
-  for (const SpaceChunk& chunk : free_by_start_) {
+  // Unmap all mmapped chunks. Nothing should be allocated anymore at this point.
+  MutexLock lock(Thread::Current(), file_lock_);
+  for (const SpaceChunk& chunk : mappings_) {
     if (munmap(chunk.ptr, chunk.size) != 0) {
       PLOG(ERROR) << "Failed to unmap swap space chunk at "
           << static_cast<const void*>(chunk.ptr) << " size=" << chunk.size;
     }
   }
-  // All arenas are backed by the same file. Just close the descriptor.
+  // All mappings are backed by the same file. Just close the descriptor.
   close(fd_);
 }
 
-template <typename FreeByStartSet, typename FreeBySizeSet>
-static size_t CollectFree(const FreeByStartSet& free_by_start, const FreeBySizeSet& free_by_size) {
-  if (free_by_start.size() != free_by_size.size()) {
-    LOG(FATAL) << "Size: " << free_by_start.size() << " vs " << free_by_size.size();
-  }
+size_t SwapSpace::GetSize() const {
+  MutexLock lock(Thread::Current(), file_lock_);
+  return size_;
+}
 
-  // Calculate over free_by_size.
-  size_t sum1 = 0;
-  for (const auto& entry : free_by_size) {
-    sum1 += entry.free_by_start_entry->size;
-  }
+uint64_t SwapSpace::GetPageFaults() const {
+  return GetProcessPageFaults() - initial_page_faults_;
+}
 
-  // Calculate over free_by_start.
-  size_t sum2 = 0;
-  for (const auto& entry : free_by_start) {
-    sum2 += entry.size;
+void SwapSpace::DumpStats(std::ostream& os) const {
+  size_t size;
+  size_t num_mappings;
+  {
+    MutexLock lock(Thread::Current(), file_lock_);
+    size = size_;
+    num_mappings = mappings_.size();
   }
+  os << "Swap space: size=" << PrettySize(size)
+     << " chunks=" << num_mappings
+     << " in use=" << PrettySize(GetBytesInUse())
+     << " swapped=" << PrettySize(GetBytesSwapped())
+     << " released=" << PrettySize(GetBytesReleased())
+     << " page faults=" << GetPageFaults();
+}
 
-  if (sum1 != sum2) {
-    LOG(FATAL) << "Sum: " << sum1 << " vs " << sum2;
-  }
-  return sum1;
+inline SwapSpace::Arena* SwapSpace::GetArena(Thread* self) {
+  size_t index = (self != nullptr) ? static_cast<size_t>(self->GetTid()) % kNumArenas : 0u;
+  return arenas_[index].get();
 }
 
 void* SwapSpace::Alloc(size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
+  Thread* self = Thread::Current();
+  Arena* arena = GetArena(self);
+  MutexLock lock(self, arena->lock_);
   size = RoundUp(size, 8U);
+  bytes_in_use_.FetchAndAddRelaxed(size);
+  bytes_swapped_.FetchAndAddRelaxed(size);
 
-  // Check the free list for something that fits.
-  // TODO: Smarter implementation. Global biggest chunk, ...
-  auto it = free_by_start_.empty()
-      ? free_by_size_.end()
-      : free_by_size_.lower_bound(FreeBySizeEntry { size, free_by_start_.begin() });
-  if (it != free_by_size_.end()) {
-    auto entry = it->free_by_start_entry;
-    SpaceChunk old_chunk = *entry;
-    if (old_chunk.size == size) {
-      RemoveChunk(it);
-    } else {
-      // Try to avoid deallocating and allocating the std::set<> nodes.
-      // This would be much simpler if we could use replace() from Boost.Bimap.
-
-      // The free_by_start_ map contains disjoint intervals ordered by the `ptr`.
-      // Shrinking the interval does not affect the ordering.
-      it->free_by_start_entry->ptr += size;
-      it->free_by_start_entry->size -= size;
-
-      // The free_by_size_ map is ordered by the `size` and then `free_by_start_entry->ptr`.
-      // Adjusting the `ptr` above does not change that ordering but decreasing `size` can
-      // push the node before the previous node(s).
-      if (it == free_by_size_.begin()) {
-        it->size -= size;
+  SpaceChunk chunk = arena->free_list_.Take(size);
+  if (chunk.ptr == nullptr) {
+    // Not a big enough free chunk, need a new slab.
+    Slab* slab = NewSlab(arena, size);
+    arena->free_list_.Insert(SpaceChunk { slab->begin, slab->size, slab });
+    chunk = arena->free_list_.Take(size);
+    DCHECK(chunk.ptr != nullptr);
+  }
+  Slab* slab = chunk.slab;
+  if (slab == arena->idle_slab_) {
+    arena->idle_slab_ = nullptr;
+  }
+  slab->bytes_in_use += size;
+  return chunk.ptr;
+}
+
+SwapSpace::Slab* SwapSpace::NewSlab(Arena* arena, size_t min_size) {
+  Thread* self = Thread::Current();
+  size_t size = std::max(kSlabSize, RoundUp(min_size, kPageSize));
+  SpaceChunk chunk;
+  {
+    MutexLock lock(self, file_lock_);
+    chunk = TakeFromPool(size);
+  }
+  WriterMutexLock mu(self, slabs_lock_);
+  auto insert_result = slabs_.emplace(chunk.ptr, Slab { chunk.ptr, chunk.size, arena, 0u });
+  DCHECK(insert_result.second);
+  return &insert_result.first->second;
+}
+
+SwapSpace::Slab* SwapSpace::FindSlab(const void* ptr) {
+  ReaderMutexLock mu(Thread::Current(), slabs_lock_);
+  auto it = slabs_.upper_bound(reinterpret_cast<const uint8_t*>(ptr));
+  CHECK(it != slabs_.begin()) << "Not allocated from the swap space: " << ptr;
+  --it;
+  Slab* slab = &it->second;
+  DCHECK_LT(reinterpret_cast<const uint8_t*>(ptr), slab->begin + slab->size);
+  return slab;
+}
+
+SwapSpace::SpaceChunk SwapSpace::TakeFromPool(size_t size) {
+  DCHECK_ALIGNED(size, kPageSize);
+  // Idle slabs that have not been released yet are still resident, prefer them.
+  for (auto it = pending_release_.begin(); it != pending_release_.end(); ++it) {
+    if (it->size >= size) {
+      SpaceChunk chunk = { it->ptr, size, nullptr };
+      pending_release_bytes_ -= size;
+      if (it->size == size) {
+        pending_release_.erase(it);
       } else {
-        auto prev = it;
-        --prev;
-        FreeBySizeEntry new_value(old_chunk.size - size, entry);
-        if (free_by_size_.key_comp()(*prev, new_value)) {
-          it->size -= size;
-        } else {
-          // Changing in place would break the std::set<> ordering, we need to remove and insert.
-          free_by_size_.erase(it);
-          free_by_size_.insert(new_value);
-        }
+        it->ptr += size;
+        it->size -= size;
       }
+      return chunk;
     }
-    return old_chunk.ptr;
-  } else {
+  }
+  SpaceChunk chunk = pool_.Take(size);
+  if (chunk.ptr == nullptr) {
     // Not a big enough free chunk, need to increase file size.
     SpaceChunk new_chunk = NewFileChunk(size);
     if (new_chunk.size != size) {
       // Insert the remainder.
-      SpaceChunk remainder = { new_chunk.ptr + size, new_chunk.size - size };
-      InsertChunk(remainder);
+      pool_.Insert(SpaceChunk { new_chunk.ptr + size, new_chunk.size - size, nullptr });
     }
-    return new_chunk.ptr;
+    chunk = SpaceChunk { new_chunk.ptr, size, nullptr };
   }
+  return chunk;
 }
 
 SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
@@ -170,13 +332,14 @@ SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
   if (ptr == MAP_FAILED) {
     LOG(ERROR) << "Unable to mmap new swap file chunk.";
     LOG(ERROR) << "Current size: " << size_ << " requested: " << next_part << "/" << min_size;
-    LOG(ERROR) << "Free list:";
-    DumpFreeMap(free_by_size_);
-    LOG(ERROR) << "In free list: " << CollectFree(free_by_start_, free_by_size_);
+    LOG(ERROR) << "Free list of the pool:";
+    pool_.Dump();
+    LOG(ERROR) << "In free list: " << pool_.CollectFree();
     LOG(FATAL) << "Aborting...";
   }
   size_ += next_part;
-  SpaceChunk new_chunk = {ptr, next_part};
+  SpaceChunk new_chunk = {ptr, next_part, nullptr};
+  mappings_.push_back(new_chunk);
   return new_chunk;
 #else
   UNUSED(min_size, kMininumMapSize);
@@ -185,52 +348,109 @@ SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
 #endif
 }
 
-// TODO: Full coalescing.
-void SwapSpace::Free(void* ptr, size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
-  size = RoundUp(size, 8U);
+void SwapSpace::ReleasePages(const SpaceChunk& chunk) {
+  DCHECK_ALIGNED(chunk.ptr, kPageSize);
+  DCHECK_ALIGNED(chunk.size, kPageSize);
+#if defined(MADV_REMOVE)
+  // For a shared file mapping MADV_DONTNEED only drops our page table entries and the dirty
+  // pages still need to be written back. Prefer punching a hole into the swap file.
+  if (madvise_remove_supported_.LoadRelaxed()) {
+    if (madvise(chunk.ptr, chunk.size, MADV_REMOVE) == 0) {
+      bytes_released_.FetchAndAddRelaxed(chunk.size);
+      return;
+    }
+    madvise_remove_supported_.StoreRelaxed(false);
+  }
+#endif
+  if (madvise(chunk.ptr, chunk.size, MADV_DONTNEED) == 0) {
+    bytes_released_.FetchAndAddRelaxed(chunk.size);
+  }
+}
 
-  size_t free_before = 0;
-  if (kCheckFreeMaps) {
-    free_before = CollectFree(free_by_start_, free_by_size_);
+void SwapSpace::ReleaseAndReturn(const std::vector<SpaceChunk>& chunks) {
+  // Nobody owns the chunks, so their pages can be released without holding a lock.
+  for (const SpaceChunk& chunk : chunks) {
+    ReleasePages(chunk);
   }
+  MutexLock lock(Thread::Current(), file_lock_);
+  for (const SpaceChunk& chunk : chunks) {
+    pool_.Insert(chunk);
+  }
+}
 
-  SpaceChunk chunk = { reinterpret_cast<uint8_t*>(ptr), size };
-  auto it = free_by_start_.lower_bound(chunk);
-  if (it != free_by_start_.begin()) {
-    auto prev = it;
-    --prev;
-    CHECK_LE(prev->End(), chunk.Start());
-    if (prev->End() == chunk.Start()) {
-      // Merge *prev with this chunk.
-      chunk.size += prev->size;
-      chunk.ptr -= prev->size;
-      auto erase_pos = free_by_size_.find(FreeBySizeEntry { prev->size, prev });
-      DCHECK(erase_pos != free_by_size_.end());
-      RemoveChunk(erase_pos);
-      // "prev" is invalidated but "it" remains valid.
+void SwapSpace::ReturnToPool(const SpaceChunk& chunk) {
+  std::vector<SpaceChunk> batch;
+  {
+    MutexLock lock(Thread::Current(), file_lock_);
+    pending_release_.push_back(chunk);
+    pending_release_bytes_ += chunk.size;
+    if (pending_release_bytes_ < kReleaseBatchSize) {
+      return;
     }
+    batch.swap(pending_release_);
+    pending_release_bytes_ = 0u;
   }
-  if (it != free_by_start_.end()) {
-    CHECK_LE(chunk.End(), it->Start());
-    if (chunk.End() == it->Start()) {
-      // Merge *it with this chunk.
-      chunk.size += it->size;
-      auto erase_pos = free_by_size_.find(FreeBySizeEntry { it->size, it });
-      DCHECK(erase_pos != free_by_size_.end());
-      RemoveChunk(erase_pos);
-      // "it" is invalidated but we don't need it anymore.
-    }
+  ReleaseAndReturn(batch);
+}
+
+void SwapSpace::ReleaseIdleSlabs() {
+  std::vector<SpaceChunk> batch;
+  {
+    MutexLock lock(Thread::Current(), file_lock_);
+    batch.swap(pending_release_);
+    pending_release_bytes_ = 0u;
   }
-  InsertChunk(chunk);
+  ReleaseAndReturn(batch);
+}
 
-  if (kCheckFreeMaps) {
-    size_t free_after = CollectFree(free_by_start_, free_by_size_);
+void SwapSpace::Free(void* ptr, size_t size) {
+  Thread* self = Thread::Current();
+  size = RoundUp(size, 8U);
+  bytes_in_use_.FetchAndSubRelaxed(size);
+
+  // Free to the arena owning the block, not the one of this thread.
+  Slab* slab = FindSlab(ptr);
+  Arena* arena = slab->arena;
+  bool slab_deleted = false;
+  {
+    MutexLock lock(self, arena->lock_);
+    FreeList& free_list = arena->free_list_;
+    size_t free_before = 0;
+    if (kCheckFreeMaps) {
+      free_before = free_list.CollectFree();
+    }
 
-    if (free_after != free_before + size) {
-      DumpFreeMap(free_by_size_);
-      CHECK_EQ(free_after, free_before + size) << "Should be " << size << " difference from " << free_before;
+    free_list.Insert(SpaceChunk { reinterpret_cast<uint8_t*>(ptr), size, slab });
+
+    if (kCheckFreeMaps) {
+      size_t free_after = free_list.CollectFree();
+
+      if (free_after != free_before + size) {
+        free_list.Dump();
+        CHECK_EQ(free_after, free_before + size) << "Should be " << size << " difference from " << free_before;
+      }
+    }
+
+    DCHECK_GE(slab->bytes_in_use, size);
+    slab->bytes_in_use -= size;
+    if (slab->bytes_in_use == 0u) {
+      if (arena->idle_slab_ == nullptr && slab->size == kSlabSize) {
+        arena->idle_slab_ = slab;
+      } else {
+        // Chunks do not coalesce across slabs, so the idle slab is a single free chunk. Once it
+        // is out of the free list nobody can allocate from it.
+        free_list.Remove(SpaceChunk { slab->begin, slab->size, slab });
+        slab_deleted = true;
+      }
+    }
+  }
+  if (slab_deleted) {
+    SpaceChunk chunk = { slab->begin, slab->size, nullptr };
+    {
+      WriterMutexLock mu(self, slabs_lock_);
+      slabs_.erase(slab->begin);
     }
+    ReturnToPool(chunk);
   }
 }
 
@@ -19,36 +19,95 @@
 
 #include <cstdlib>
 #include <list>
+#include <map>
+#include <memory>
+#include <ostream>
 #include <vector>
 #include <set>
 #include <stdint.h>
 #include <stddef.h>
 
+#include "atomic.h"
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/mutex.h"
+#include "globals.h"
 
 namespace art {
 
 // An arena pool that creates arenas backed by an mmaped file.
+//
+// The space is split into several independently locked arenas, each with its own free list.
+// A thread allocates from the arena selected by its tid, so compiling threads do not serialize
+// on a single lock. Arenas carve their allocations out of slabs, page aligned ranges of the file
+// which they take from a pool shared by all arenas. Only the pool grows the file, under
+// `file_lock_`, so the slabs of all arenas are packed into the same mappings. A block is always
+// freed to the arena owning its slab, whichever thread frees it.
+//
+// When all blocks of a slab are freed the slab is idle. Each arena keeps one idle slab to absorb
+// alloc/free cycles and gives the others back to the pool. The pool releases their pages with
+// madvise() in batches and outside of any lock, so freeing memory does not normally make a
+// system call.
 class SwapSpace {
  public:
   SwapSpace(int fd, size_t initial_size);
   ~SwapSpace();
-  void* Alloc(size_t size) REQUIRES(!lock_);
-  void Free(void* ptr, size_t size) REQUIRES(!lock_);
+  void* Alloc(size_t size) REQUIRES(!file_lock_, !slabs_lock_);
+  void Free(void* ptr, size_t size) REQUIRES(!file_lock_, !slabs_lock_);
 
-  size_t GetSize() {
-    return size_;
+  // Release the pages of the idle slabs that are waiting for the next batch.
+  void ReleaseIdleSlabs() REQUIRES(!file_lock_);
+
+  size_t GetSize() const REQUIRES(!file_lock_);
+
+  // Bytes currently handed out to users of the swap space.
+  size_t GetBytesInUse() const {
+    return bytes_in_use_.LoadRelaxed();
+  }
+
+  // Total bytes ever handed out, i.e. the volume of data moved to swap.
+  size_t GetBytesSwapped() const {
+    return bytes_swapped_.LoadRelaxed();
+  }
+
+  // Bytes given back to the kernel through madvise().
+  size_t GetBytesReleased() const {
+    return bytes_released_.LoadRelaxed();
   }
 
+  // Page faults taken by the process since the swap space was created. This is a process-wide
+  // count and therefore also includes faults not caused by the swap space.
+  uint64_t GetPageFaults() const;
+
+  void DumpStats(std::ostream& os) const REQUIRES(!file_lock_);
+
  private:
+  // Number of arenas. Threads are mapped to arenas by tid.
+  static constexpr size_t kNumArenas = 16;
+  // Size of the slabs arenas take from the pool. Larger blocks get a slab of their own.
+  static constexpr size_t kSlabSize = 1 * MB;
+  // Idle slabs are released once this many bytes of them are waiting.
+  static constexpr size_t kReleaseBatchSize = 8 * MB;
+
+  struct Arena;
+
+  // A range of the swap file owned by an arena. Its blocks are freed to that arena.
+  struct Slab {
+    uint8_t* const begin;
+    const size_t size;
+    Arena* const arena;
+    // Bytes allocated from the slab. Guarded by the lock of the arena.
+    size_t bytes_in_use;
+  };
+
   // Chunk of space.
   struct SpaceChunk {
     // We need mutable members as we keep these objects in a std::set<> (providing only const
     // access) but we modify these members while carefully preserving the std::set<> ordering.
     mutable uint8_t* ptr;
     mutable size_t size;
+    // The slab containing the chunk, null for chunks of the pool.
+    Slab* slab;
 
     uintptr_t Start() const {
       return reinterpret_cast<uintptr_t>(ptr);
@@ -88,22 +147,86 @@ class SwapSpace {
   };
   typedef std::set<FreeBySizeEntry, FreeBySizeComparator> FreeBySizeSet;
 
-  SpaceChunk NewFileChunk(size_t min_size) REQUIRES(lock_);
+  // A best fit free list. Not thread safe, guarded by the lock of its owner.
+  class FreeList {
+   public:
+    // Returns `size` bytes from the smallest free chunk that is big enough. Returns a chunk with
+    // a null `ptr` if there is none.
+    SpaceChunk Take(size_t size);
+    // Inserts a free chunk, coalescing it with the adjacent free chunks of the same slab.
+    void Insert(SpaceChunk chunk);
+    // Removes a free chunk, which must be in the list as is.
+    void Remove(const SpaceChunk& chunk);
+
+    void Dump() const;
+    size_t CollectFree() const;
+
+   private:
+    void RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos);
+    void InsertChunk(const SpaceChunk& chunk);
+
+    // NOTE: Boost.Bimap would be useful for the two following members.
+
+    // Map start of a free chunk to its size.
+    FreeByStartSet free_by_start_;
+    // Free chunks ordered by size.
+    FreeBySizeSet free_by_size_;
+  };
 
-  void RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos) REQUIRES(lock_);
-  void InsertChunk(const SpaceChunk& chunk) REQUIRES(lock_);
+  struct Arena {
+    explicit Arena(const char* name);
 
-  int fd_;
-  size_t size_;
+    FreeList free_list_ GUARDED_BY(lock_);
+    // An idle slab kept in the free list rather than given back to the pool.
+    Slab* idle_slab_ GUARDED_BY(lock_);
+
+    Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  };
 
-  // NOTE: Boost.Bimap would be useful for the two following members.
+  Arena* GetArena(Thread* self);
 
-  // Map start of a free chunk to its size.
-  FreeByStartSet free_by_start_ GUARDED_BY(lock_);
-  // Free chunks ordered by size.
-  FreeBySizeSet free_by_size_ GUARDED_BY(lock_);
+  // Takes a new slab for `arena` from the pool, growing the file if needed.
+  Slab* NewSlab(Arena* arena, size_t min_size)
+      REQUIRES(arena->lock_) REQUIRES(!file_lock_, !slabs_lock_);
+  Slab* FindSlab(const void* ptr) REQUIRES(!slabs_lock_);
+  // Hands the pages of a deleted slab back to the pool.
+  void ReturnToPool(const SpaceChunk& chunk) REQUIRES(!file_lock_);
+
+  // Returns a page aligned chunk of at least `size` bytes that no arena owns.
+  SpaceChunk TakeFromPool(size_t size) REQUIRES(file_lock_);
+  SpaceChunk NewFileChunk(size_t min_size) REQUIRES(file_lock_);
+
+  // Release the pages of chunks that nobody owns and put them into the pool free list.
+  void ReleaseAndReturn(const std::vector<SpaceChunk>& chunks) REQUIRES(!file_lock_);
+  void ReleasePages(const SpaceChunk& chunk);
+
+  int fd_;
+  size_t size_ GUARDED_BY(file_lock_);
+  // The mmapped parts of the file.
+  std::vector<SpaceChunk> mappings_ GUARDED_BY(file_lock_);
+  // Free pages of the file that are not in any slab.
+  FreeList pool_ GUARDED_BY(file_lock_);
+  // Chunks of idle slabs whose pages have not been released yet. They are reused before the
+  // free list of the pool as their pages are still resident.
+  std::vector<SpaceChunk> pending_release_ GUARDED_BY(file_lock_);
+  size_t pending_release_bytes_ GUARDED_BY(file_lock_);
+  // Whether madvise(MADV_REMOVE) is supported by the file system backing the swap file.
+  Atomic<bool> madvise_remove_supported_;
+  const uint64_t initial_page_faults_;
+
+  Atomic<size_t> bytes_in_use_;
+  Atomic<size_t> bytes_swapped_;
+  Atomic<size_t> bytes_released_;
+
+  std::unique_ptr<Arena> arenas_[kNumArenas];
+
+  // Guards the pool and growing the swap file. Acquired while holding an arena lock.
+  mutable Mutex file_lock_;
+
+  // The slabs by start address, to find the owning arena of a freed block.
+  std::map<const uint8_t*, Slab> slabs_ GUARDED_BY(slabs_lock_);
+  ReaderWriterMutex slabs_lock_;
 
-  mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   DISALLOW_COPY_AND_ASSIGN(SwapSpace);
 };
 
@@ -25,6 +25,7 @@
 #include "base/unix_file/fd_file.h"
 #include "common_runtime_test.h"
 #include "os.h"
+#include "thread_pool.h"
 
 namespace art {
 
@@ -78,4 +79,131 @@ TEST_F(SwapSpaceTest, Swap) {
   SwapTest(true);
 }
 
+class SwapAllocTask : public Task {
+ public:
+  SwapAllocTask(SwapSpace* pool, int32_t seed) : pool_(pool), seed_(seed) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+    SwapAllocator<void> alloc(pool_);
+    for (size_t round = 0; round != 10u; ++round) {
+      SwapVector<int32_t> v(alloc);
+      for (int32_t i = 0; i < 100000; ++i) {
+        v.push_back(seed_ + i);
+      }
+      for (int32_t i = 0; i < 100000; ++i) {
+        EXPECT_EQ(seed_ + i, v[i]);
+      }
+    }
+  }
+
+ private:
+  SwapSpace* const pool_;
+  const int32_t seed_;
+};
+
+TEST_F(SwapSpaceTest, SwapMultiThreaded) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  static constexpr size_t kNumThreads = 8;
+  SwapSpace pool(fd, 1 * MB);
+  {
+    Thread* self = Thread::Current();
+    ThreadPool thread_pool("Swap space test thread pool", kNumThreads);
+    std::vector<std::unique_ptr<SwapAllocTask>> tasks;
+    for (size_t i = 0; i != kNumThreads; ++i) {
+      tasks.emplace_back(new SwapAllocTask(&pool, static_cast<int32_t>(i) * 1000000));
+      thread_pool.AddTask(self, tasks.back().get());
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+  }
+  EXPECT_EQ(0u, pool.GetBytesInUse());
+  EXPECT_LE(kNumThreads * 10u * 100000u * sizeof(int32_t), pool.GetBytesSwapped());
+
+  scratch.Close();
+}
+
+TEST_F(SwapSpaceTest, ReleaseIdleSlabs) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  static constexpr size_t kNumBlocks = 32;
+  SwapSpace pool(fd, 1 * MB);
+  std::vector<void*> blocks;
+  for (size_t i = 0; i != kNumBlocks; ++i) {
+    // Each block fills a slab of its own.
+    blocks.push_back(pool.Alloc(1 * MB));
+    memset(blocks.back(), 0xff, 1 * MB);
+  }
+  EXPECT_EQ(kNumBlocks * MB, pool.GetBytesInUse());
+  pool.Free(blocks[0], 1 * MB);
+  // The first idle slab stays with its arena and nothing is released on a single free.
+  EXPECT_EQ(0u, pool.GetBytesReleased());
+  for (size_t i = 1; i != kNumBlocks; ++i) {
+    pool.Free(blocks[i], 1 * MB);
+  }
+  EXPECT_EQ(0u, pool.GetBytesInUse());
+  // The other idle slabs are released in batches.
+  EXPECT_LT(0u, pool.GetBytesReleased());
+  pool.ReleaseIdleSlabs();
+  EXPECT_EQ((kNumBlocks - 1u) * MB, pool.GetBytesReleased());
+
+  // The released pages are reused without growing the file.
+  size_t size = pool.GetSize();
+  for (size_t i = 0; i != kNumBlocks; ++i) {
+    blocks[i] = pool.Alloc(1 * MB);
+    memset(blocks[i], 0x55, 1 * MB);
+  }
+  EXPECT_EQ(size, pool.GetSize());
+  for (size_t i = 0; i != kNumBlocks; ++i) {
+    pool.Free(blocks[i], 1 * MB);
+  }
+
+  scratch.Close();
+}
+
+class SwapFreeTask : public Task {
+ public:
+  SwapFreeTask(SwapSpace* pool, void* ptr, size_t size) : pool_(pool), ptr_(ptr), size_(size) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+    pool_->Free(ptr_, size_);
+  }
+
+ private:
+  SwapSpace* const pool_;
+  void* const ptr_;
+  const size_t size_;
+};
+
+TEST_F(SwapSpaceTest, FreeToOwningArena) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  SwapSpace pool(fd, 1 * MB);
+  void* ptr = pool.Alloc(kPageSize);
+  void* other = pool.Alloc(kPageSize);
+  {
+    // Free the first block on another thread, which may use another arena.
+    Thread* self = Thread::Current();
+    ThreadPool thread_pool("Swap space test thread pool", 1u);
+    SwapFreeTask task(&pool, ptr, kPageSize);
+    thread_pool.AddTask(self, &task);
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+  }
+  EXPECT_EQ(kPageSize, pool.GetBytesInUse());
+  // The block went back to the arena of this thread, which hands it out again.
+  EXPECT_EQ(ptr, pool.Alloc(kPageSize));
+  pool.Free(ptr, kPageSize);
+  pool.Free(other, kPageSize);
+  EXPECT_EQ(0u, pool.GetBytesInUse());
+
+  scratch.Close();
+}
+
 }  // namespace art
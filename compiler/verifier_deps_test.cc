@@ -1517,6 +1517,61 @@ TEST_F(VerifierDepsTest, CompilerDriver) {
   }
 }
 
+TEST_F(VerifierDepsTest, PartialFastVerify) {
+  SetupCompilerDriver();
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    LoadDexFile(&soa, "VerifierDeps", "MultiDex");
+  }
+  VerifyWithCompilerDriver(/* verifier_deps */ nullptr);
+  ASSERT_EQ(2u, NumberOfCompiledDexFiles());
+
+  std::vector<uint8_t> buffer;
+  verifier_deps_->Encode(dex_files_, &buffer);
+
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    LoadDexFile(&soa, "VerifierDeps", "MultiDex");
+  }
+  const DexFile* valid_dex_file =
+      (dex_files_[0] == primary_dex_file_) ? dex_files_[1] : dex_files_[0];
+  verifier::VerifierDeps decoded_deps(dex_files_, ArrayRef<const uint8_t>(buffer));
+  {
+    // Taint the dependencies of the primary dex file only.
+    VerifierDeps::DexFileDeps* deps = decoded_deps.GetDexFileDeps(*primary_dex_file_);
+    bool found = false;
+    for (const auto& entry : deps->classes_) {
+      if (entry.IsResolved()) {
+        deps->classes_.insert(VerifierDeps::ClassResolution(
+            entry.GetDexTypeIndex(), VerifierDeps::kUnresolvedMarker));
+        found = true;
+        break;
+      }
+    }
+    ASSERT_TRUE(found);
+  }
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    StackHandleScope<1> hs(soa.Self());
+    Handle<mirror::ClassLoader> class_loader_handle(
+        hs.NewHandle(soa.Decode<mirror::ClassLoader>(class_loader_)));
+    ASSERT_FALSE(decoded_deps.ValidateDexFileDependencies(
+        class_loader_handle, *primary_dex_file_, soa.Self()));
+    ASSERT_TRUE(decoded_deps.ValidateDexFileDependencies(
+        class_loader_handle, *valid_dex_file, soa.Self()));
+  }
+
+  VerifyWithCompilerDriver(&decoded_deps);
+
+  // Only the primary dex file was verified again, the dependencies of the other one
+  // are carried over to the new `VerifierDeps`.
+  ASSERT_FALSE(verifier_deps_ == nullptr);
+  ASSERT_FALSE(verifier_deps_->Equals(decoded_deps));
+  ASSERT_TRUE(verifier_deps_->GetDexFileDeps(*valid_dex_file)->Equals(
+      *decoded_deps.GetDexFileDeps(*valid_dex_file)));
+  VerifyClassStatus(*verifier_deps_);
+}
+
 TEST_F(VerifierDepsTest, MultiDexVerification) {
   VerifyDexFile("VerifierDepsMulti");
   ASSERT_EQ(NumberOfCompiledDexFiles(), 2u);
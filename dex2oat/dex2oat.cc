@@ -245,6 +245,12 @@ NO_RETURN static void Usage(const char* fmt, ...) {
   UsageError("  --image-classes=<classname-file>: specifies classes to include in an image.");
   UsageError("      Example: --image=frameworks/base/preloaded-classes");
   UsageError("");
+  UsageError("  --dirty-image-objects=<classname-file>: specifies classes whose class objects are");
+  UsageError("      known to be dirtied at runtime, as reported by imgdiag. Their class objects are");
+  UsageError("      packed together at the start of the image to minimize dirty pages. Only valid");
+  UsageError("      with --image or --app-image-file.");
+  UsageError("      Example: --dirty-image-objects=frameworks/base/config/dirty-image-objects");
+  UsageError("");
   UsageError("  --base=<hex-address>: specifies the base address when creating a boot image.");
   UsageError("      Example: --base=0x50000000");
   UsageError("");
@@ -535,6 +541,7 @@ class Dex2Oat FINAL {
       image_base_(0U),
       image_classes_zip_filename_(nullptr),
       image_classes_filename_(nullptr),
+      dirty_image_objects_filename_(nullptr),
       image_storage_mode_(ImageHeader::kStorageModeUncompressed),
       compiled_classes_zip_filename_(nullptr),
       compiled_classes_filename_(nullptr),
@@ -792,6 +799,10 @@ class Dex2Oat FINAL {
       Usage("--image-classes-zip should be used with --image-classes");
     }
 
+    if (dirty_image_objects_filename_ != nullptr && !IsImage()) {
+      Usage("--dirty-image-objects should only be used with --image or --app-image-file");
+    }
+
     if (compiled_classes_filename_ != nullptr && !IsBootImage()) {
       Usage("--compiled-classes should only be used with --image");
     }
@@ -1161,6 +1172,8 @@ class Dex2Oat FINAL {
         image_filenames_.push_back(option.substr(strlen("--image=")).data());
       } else if (option.starts_with("--image-classes=")) {
         image_classes_filename_ = option.substr(strlen("--image-classes=")).data();
+      } else if (option.starts_with("--dirty-image-objects=")) {
+        dirty_image_objects_filename_ = option.substr(strlen("--dirty-image-objects=")).data();
       } else if (option.starts_with("--image-classes-zip=")) {
         image_classes_zip_filename_ = option.substr(strlen("--image-classes-zip=")).data();
       } else if (option.starts_with("--image-format=")) {
@@ -1460,7 +1473,10 @@ class Dex2Oat FINAL {
   dex2oat::ReturnCode Setup() {
     TimingLogger::ScopedTiming t("dex2oat Setup", timings_);
 
-    if (!PrepareImageClasses() || !PrepareCompiledClasses() || !PrepareCompiledMethods()) {
+    if (!PrepareImageClasses() ||
+        !PrepareCompiledClasses() ||
+        !PrepareCompiledMethods() ||
+        !PrepareDirtyObjects()) {
       return dex2oat::ReturnCode::kOther;
     }
 
@@ -1853,7 +1869,8 @@ class Dex2Oat FINAL {
                                           IsAppImage(),
                                           image_storage_mode_,
                                           oat_filenames_,
-                                          dex_file_oat_index_map_));
+                                          dex_file_oat_index_map_,
+                                          dirty_image_objects_.get()));
 
       // We need to prepare method offsets in the image address space for direct method patching.
       TimingLogger::ScopedTiming t2("dex2oat Prepare image address space", timings_);
@@ -2317,6 +2334,21 @@ class Dex2Oat FINAL {
     return true;
   }
 
+  bool PrepareDirtyObjects() {
+    // If --dirty-image-objects was specified, read the classes known to be dirtied at runtime.
+    if (dirty_image_objects_filename_ != nullptr) {
+      dirty_image_objects_.reset(ReadImageClassesFromFile(dirty_image_objects_filename_));
+      if (dirty_image_objects_ == nullptr) {
+        LOG(ERROR) << "Failed to create list of dirty objects from '"
+            << dirty_image_objects_filename_ << "'";
+        return false;
+      }
+    } else {
+      dirty_image_objects_.reset(nullptr);
+    }
+    return true;
+  }
+
   void PruneNonExistentDexFiles() {
     DCHECK_EQ(dex_filenames_.size(), dex_locations_.size());
     size_t kept = 0u;
@@ -2726,6 +2758,7 @@ class Dex2Oat FINAL {
   uintptr_t image_base_;
   const char* image_classes_zip_filename_;
   const char* image_classes_filename_;
+  const char* dirty_image_objects_filename_;
   ImageHeader::StorageMode image_storage_mode_;
   const char* compiled_classes_zip_filename_;
   const char* compiled_classes_filename_;
@@ -2735,6 +2768,7 @@ class Dex2Oat FINAL {
   std::unique_ptr<std::unordered_set<std::string>> image_classes_;
   std::unique_ptr<std::unordered_set<std::string>> compiled_classes_;
   std::unique_ptr<std::unordered_set<std::string>> compiled_methods_;
+  std::unique_ptr<std::unordered_set<std::string>> dirty_image_objects_;
   std::unique_ptr<std::vector<std::string>> passes_to_run_;
   bool multi_image_;
   bool is_host_;
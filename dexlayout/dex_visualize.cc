@@ -27,8 +27,11 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
+#include "dex_file-inl.h"
 #include "dex_ir.h"
 #include "dexlayout.h"
 #include "jit/profile_compilation_info.h"
@@ -47,7 +50,8 @@ class Dumper {
   explicit Dumper(dex_ir::Header* header)
       : out_file_(nullptr),
         sorted_sections_(
-            dex_ir::GetSortedDexFileSections(header, dex_ir::SortDirection::kSortDescending)) { }
+            dex_ir::GetSortedDexFileSections(header, dex_ir::SortDirection::kSortDescending)),
+        touched_pages_(RoundUp(header->FileSize(), kPageSize) / kPageSize, false) { }
 
   bool OpenAndPrintHeader(size_t dex_index) {
     // Open the file and emit the gnuplot prologue.
@@ -99,7 +103,23 @@ class Dumper {
     const uint32_t low_page = from / kPageSize;
     const uint32_t high_page = (size > 0) ? (from + size - 1) / kPageSize : low_page;
     const uint32_t size_delta = high_page - low_page;
-    fprintf(out_file_, "%d %d %d 0 %d\n", low_page, class_index, size_delta, GetColor(from));
+    for (uint32_t page = low_page; page <= high_page && page < touched_pages_.size(); ++page) {
+      touched_pages_[page] = true;
+    }
+    if (out_file_ != nullptr) {
+      fprintf(out_file_, "%d %d %d 0 %d\n", low_page, class_index, size_delta, GetColor(from));
+    }
+  }
+
+  // Returns the number of pages in [begin_page, end_page) touched by the dumped items.
+  uint32_t CountTouchedPages(uint32_t begin_page, uint32_t end_page) const {
+    uint32_t count = 0;
+    for (uint32_t page = begin_page; page < end_page && page < touched_pages_.size(); ++page) {
+      if (touched_pages_[page]) {
+        ++count;
+      }
+    }
+    return count;
   }
 
   void DumpAddressRange(const dex_ir::Item* item, int class_index) {
@@ -168,6 +188,41 @@ class Dumper {
     DumpStringId(method_id->Name(), class_index);
   }
 
+  void DumpAnnotationSetItem(dex_ir::AnnotationSetItem* set_item, int class_index) {
+    DumpAddressRange(set_item, class_index);
+    if (set_item == nullptr) {
+      return;
+    }
+    for (const dex_ir::AnnotationItem* annotation : *set_item->GetItems()) {
+      DumpAddressRange(annotation, class_index);
+    }
+  }
+
+  void DumpAnnotationsDirectory(dex_ir::AnnotationsDirectoryItem* annotations,
+                                const DexFile* dex_file,
+                                int class_index,
+                                ProfileCompilationInfo* profile_info) {
+    DumpAddressRange(annotations, class_index);
+    if (annotations == nullptr) {
+      return;
+    }
+    DumpAnnotationSetItem(annotations->GetClassAnnotation(), class_index);
+    if (annotations->GetFieldAnnotations() != nullptr) {
+      for (auto& field : *annotations->GetFieldAnnotations()) {
+        DumpAnnotationSetItem(field->GetAnnotationSetItem(), class_index);
+      }
+    }
+    if (annotations->GetMethodAnnotations() != nullptr) {
+      for (auto& method : *annotations->GetMethodAnnotations()) {
+        uint32_t method_idx = method->GetMethodId()->GetIndex();
+        if (profile_info == nullptr ||
+            profile_info->ContainsMethod(MethodReference(dex_file, method_idx))) {
+          DumpAnnotationSetItem(method->GetAnnotationSetItem(), class_index);
+        }
+      }
+    }
+  }
+
   void DumpMethodItem(dex_ir::MethodItem* method,
                       const DexFile* dex_file,
                       int class_index,
@@ -209,7 +264,9 @@ class Dumper {
   }
 
   ~Dumper() {
-    fclose(out_file_);
+    if (out_file_ != nullptr) {
+      fclose(out_file_);
+    }
   }
 
  private:
@@ -236,24 +293,20 @@ class Dumper {
 
   FILE* out_file_;
   std::vector<dex_ir::DexFileSection> sorted_sections_;
+  // Pages of the dex file referenced by any dumped item.
+  std::vector<bool> touched_pages_;
 
   DISALLOW_COPY_AND_ASSIGN(Dumper);
 };
 
 /*
- * Dumps a gnuplot data file showing the parts of the dex_file that belong to each class.
- * If profiling information is present, it dumps only those classes that are marked as hot.
+ * Walks the parts of the dex_file that belong to each class, reporting them to the dumper.
+ * If profiling information is present, it walks only those classes that are marked as hot.
  */
-void VisualizeDexLayout(dex_ir::Header* header,
+static void DumpClasses(Dumper* dumper,
+                        dex_ir::Header* header,
                         const DexFile* dex_file,
-                        size_t dex_file_index,
                         ProfileCompilationInfo* profile_info) {
-  std::unique_ptr<Dumper> dumper(new Dumper(header));
-  if (!dumper->OpenAndPrintHeader(dex_file_index)) {
-    fprintf(stderr, "Could not open output file.\n");
-    return;
-  }
-
   const uint32_t class_defs_size = header->GetCollections().ClassDefsSize();
   for (uint32_t class_index = 0; class_index < class_defs_size; class_index++) {
     dex_ir::ClassDef* class_def = header->GetCollections().GetClassDef(class_index);
@@ -273,8 +326,7 @@ void VisualizeDexLayout(dex_ir::Header* header,
     // Source file info.
     dumper->DumpStringId(class_def->SourceFile(), class_index);
     // Annotations.
-    dumper->DumpAddressRange(class_def->Annotations(), class_index);
-    // TODO(sehr): walk the annotations and dump them.
+    dumper->DumpAnnotationsDirectory(class_def->Annotations(), dex_file, class_index, profile_info);
     // Class data.
     dex_ir::ClassData* class_data = class_def->GetClassData();
     if (class_data != nullptr) {
@@ -303,6 +355,22 @@ void VisualizeDexLayout(dex_ir::Header* header,
   }  // for
 }
 
+/*
+ * Dumps a gnuplot data file showing the parts of the dex_file that belong to each class.
+ * If profiling information is present, it dumps only those classes that are marked as hot.
+ */
+void VisualizeDexLayout(dex_ir::Header* header,
+                        const DexFile* dex_file,
+                        size_t dex_file_index,
+                        ProfileCompilationInfo* profile_info) {
+  std::unique_ptr<Dumper> dumper(new Dumper(header));
+  if (!dumper->OpenAndPrintHeader(dex_file_index)) {
+    fprintf(stderr, "Could not open output file.\n");
+    return;
+  }
+  DumpClasses(dumper.get(), header, dex_file, profile_info);
+}
+
 static uint32_t FindNextByteAfterSection(dex_ir::Header* header,
                                          const std::vector<dex_ir::DexFileSection>& sorted_sections,
                                          size_t section_index) {
@@ -344,4 +412,125 @@ void ShowDexSectionStatistics(dex_ir::Header* header, size_t dex_file_index) {
   fprintf(stdout, "\n");
 }
 
+// Accumulates the size of items that could be shared between the dex files of a container.
+class SharedDataCounter {
+ public:
+  explicit SharedDataCounter(const char* name) : name_(name) { }
+
+  void Add(std::string key, uint32_t size) {
+    total_bytes_ += size;
+    if (keys_.insert(std::move(key)).second) {
+      unique_bytes_ += size;
+    }
+  }
+
+  void Print() const {
+    const uint64_t shared = total_bytes_ - unique_bytes_;
+    fprintf(stdout,
+            "%-10s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %%%02" PRIu64 "\n",
+            name_,
+            total_bytes_,
+            unique_bytes_,
+            shared,
+            total_bytes_ != 0 ? 100 * shared / total_bytes_ : 0);
+  }
+
+ private:
+  const char* const name_;
+  std::unordered_set<std::string> keys_;
+  uint64_t total_bytes_ = 0;
+  uint64_t unique_bytes_ = 0;
+};
+
+/*
+ * Dumps the bytes of string data and ids duplicated between the dex files of a multidex
+ * container. This is the amount a shared data section would save.
+ */
+void ShowDexSharedDataStatistics(const std::vector<std::unique_ptr<const DexFile>>& dex_files) {
+  SharedDataCounter strings("strings");
+  SharedDataCounter type_ids("type_ids");
+  SharedDataCounter proto_ids("proto_ids");
+  SharedDataCounter field_ids("field_ids");
+  SharedDataCounter method_ids("method_ids");
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    for (size_t i = 0; i < dex_file->NumStringIds(); ++i) {
+      const DexFile::StringId& string_id = dex_file->GetStringId(dex::StringIndex(i));
+      const char* data = dex_file->GetStringData(string_id);
+      // String data item: ULEB128 length, MUTF-8 data and a null terminator.
+      const uint8_t* item = dex_file->Begin() + string_id.string_data_off_;
+      const uint32_t size = (reinterpret_cast<const uint8_t*>(data) - item) + strlen(data) + 1;
+      strings.Add(data, sizeof(DexFile::StringId) + size);
+    }
+    for (size_t i = 0; i < dex_file->NumTypeIds(); ++i) {
+      type_ids.Add(dex_file->StringByTypeIdx(dex::TypeIndex(i)), sizeof(DexFile::TypeId));
+    }
+    for (size_t i = 0; i < dex_file->NumProtoIds(); ++i) {
+      const DexFile::ProtoId& proto_id = dex_file->GetProtoId(i);
+      proto_ids.Add(dex_file->GetProtoSignature(proto_id).ToString(), sizeof(DexFile::ProtoId));
+    }
+    for (size_t i = 0; i < dex_file->NumFieldIds(); ++i) {
+      const DexFile::FieldId& field_id = dex_file->GetFieldId(i);
+      std::string key = std::string(dex_file->GetFieldDeclaringClassDescriptor(field_id)) + "->" +
+          dex_file->GetFieldName(field_id) + ":" + dex_file->GetFieldTypeDescriptor(field_id);
+      field_ids.Add(std::move(key), sizeof(DexFile::FieldId));
+    }
+    for (size_t i = 0; i < dex_file->NumMethodIds(); ++i) {
+      const DexFile::MethodId& method_id = dex_file->GetMethodId(i);
+      std::string key = std::string(dex_file->GetMethodDeclaringClassDescriptor(method_id)) +
+          "->" + dex_file->GetMethodName(method_id) +
+          dex_file->GetMethodSignature(method_id).ToString();
+      method_ids.Add(std::move(key), sizeof(DexFile::MethodId));
+    }
+  }
+  fprintf(stdout, "%zu dex files\n", dex_files.size());
+  fprintf(stdout, "data            total     unique     shared pct\n");
+  strings.Print();
+  type_ids.Print();
+  proto_ids.Print();
+  field_ids.Print();
+  method_ids.Print();
+  fprintf(stdout, "\n");
+}
+
+/*
+ * Dumps, for each section, the number of pages touched by the classes and methods in the
+ * profile. This approximates the page faults taken in the dex file during startup.
+ */
+void ShowDexPageTouchReport(dex_ir::Header* header,
+                            const DexFile* dex_file,
+                            size_t dex_file_index,
+                            ProfileCompilationInfo* profile_info) {
+  std::unique_ptr<Dumper> dumper(new Dumper(header));
+  DumpClasses(dumper.get(), header, dex_file, profile_info);
+
+  fprintf(stdout, "%s (%d bytes)\n",
+          MultidexName("classes", dex_file_index, ".dex").c_str(),
+          header->FileSize());
+  fprintf(stdout, "section      offset    pages  touched pct\n");
+  std::vector<dex_ir::DexFileSection> sorted_sections =
+      GetSortedDexFileSections(header, dex_ir::SortDirection::kSortAscending);
+  for (size_t i = 0; i < sorted_sections.size(); ++i) {
+    const dex_ir::DexFileSection& file_section = sorted_sections[i];
+    if (file_section.size == 0) {
+      continue;
+    }
+    const uint32_t end = FindNextByteAfterSection(header, sorted_sections, i);
+    const uint32_t begin_page = file_section.offset / kPageSize;
+    const uint32_t end_page = RoundUp(end, kPageSize) / kPageSize;
+    const uint32_t pages = end_page - begin_page;
+    const uint32_t touched = dumper->CountTouchedPages(begin_page, end_page);
+    fprintf(stdout,
+            "%-10s %8d %8d %8d %%%02d\n",
+            file_section.name.c_str(),
+            file_section.offset,
+            pages,
+            touched,
+            pages != 0 ? 100 * touched / pages : 0);
+  }
+  const uint32_t total_pages = RoundUp(header->FileSize(), kPageSize) / kPageSize;
+  const uint32_t total_touched = dumper->CountTouchedPages(0, total_pages);
+  fprintf(stdout, "total                 %8d %8d\n", total_pages, total_touched);
+  fprintf(stdout, "\n");
+}
+
 }  // namespace art
@@ -25,6 +25,9 @@
 
 #include <stddef.h>
 
+#include <memory>
+#include <vector>
+
 namespace art {
 
 class DexFile;
@@ -40,6 +43,13 @@ void VisualizeDexLayout(dex_ir::Header* header,
 
 void ShowDexSectionStatistics(dex_ir::Header* header, size_t dex_file_index);
 
+void ShowDexPageTouchReport(dex_ir::Header* header,
+                            const DexFile* dex_file,
+                            size_t dex_file_index,
+                            ProfileCompilationInfo* profile_info);
+
+void ShowDexSharedDataStatistics(const std::vector<std::unique_ptr<const DexFile>>& dex_files);
+
 }  // namespace art
 
 #endif  // ART_DEXLAYOUT_DEX_VISUALIZE_H_
@@ -104,8 +104,8 @@ size_t EncodeDoubleValue(double value, uint8_t* buffer) {
 }
 
 size_t DexWriter::Write(const void* buffer, size_t length, size_t offset) {
-  DCHECK_LE(offset + length, mem_map_->Size());
-  memcpy(mem_map_->Begin() + offset, buffer, length);
+  DCHECK_LE(base_offset_ + offset + length, mem_map_->Size());
+  memcpy(mem_map_->Begin() + base_offset_ + offset, buffer, length);
   return length;
 }
 
@@ -586,7 +586,7 @@ void DexWriter::WriteMapItem() {
     queue.push(MapItemContainer(DexFile::kDexTypeCodeItem, collection.CodeItemsSize(),
         collection.CodeItemsOffset()));
   }
-  if (collection.StringDatasSize() != 0) {
+  if (collection.StringDatasSize() != 0 && !shared_string_data_) {
     queue.push(MapItemContainer(DexFile::kDexTypeStringDataItem, collection.StringDatasSize(),
         collection.StringDatasOffset()));
   }
@@ -680,7 +680,12 @@ void DexWriter::WriteMemMap() {
 }
 
 void DexWriter::Output(dex_ir::Header* header, MemMap* mem_map) {
-  DexWriter dex_writer(header, mem_map);
+  DexWriter dex_writer(header, mem_map, /*base_offset*/ 0u, /*shared_string_data*/ false);
+  dex_writer.WriteMemMap();
+}
+
+void DexWriter::OutputToContainer(dex_ir::Header* header, MemMap* mem_map, size_t base_offset) {
+  DexWriter dex_writer(header, mem_map, base_offset, /*shared_string_data*/ true);
   dex_writer.WriteMemMap();
 }
 
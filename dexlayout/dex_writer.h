@@ -28,10 +28,21 @@ namespace art {
 
 class DexWriter {
  public:
-  DexWriter(dex_ir::Header* header, MemMap* mem_map) : header_(header), mem_map_(mem_map) { }
+  DexWriter(dex_ir::Header* header,
+            MemMap* mem_map,
+            size_t base_offset,
+            bool shared_string_data)
+      : header_(header),
+        mem_map_(mem_map),
+        base_offset_(base_offset),
+        shared_string_data_(shared_string_data) { }
 
   static void Output(dex_ir::Header* header, MemMap* mem_map);
 
+  // Writes the dex file at base_offset of a shared-data container. The string data offsets of
+  // header point into the container's shared section, which is not listed in the map.
+  static void OutputToContainer(dex_ir::Header* header, MemMap* mem_map, size_t base_offset);
+
  private:
   void WriteMemMap();
 
@@ -66,6 +77,9 @@ class DexWriter {
 
   dex_ir::Header* const header_;
   MemMap* const mem_map_;
+  // Offset of the dex file within mem_map_. All item offsets are relative to it.
+  const size_t base_offset_;
+  const bool shared_string_data_;
 
   DISALLOW_COPY_AND_ASSIGN(DexWriter);
 };
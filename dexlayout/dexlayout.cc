@@ -25,14 +25,18 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <sys/mman.h>  // For the PROT_* and MAP_* constants.
+#include <zlib.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 
 #include "android-base/stringprintf.h"
 
+#include "base/time_utils.h"
 #include "dex_ir_builder.h"
 #include "dex_file-inl.h"
 #include "dex_file_verifier.h"
@@ -1635,6 +1639,83 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
   }
 }
 
+// Moves the annotation sets of profiled classes and methods to the start of their section.
+// The string, type and method id sections must stay sorted as required by the dex format, so the
+// annotations are the remaining index-like data that can be clustered. Annotation items are left
+// in place because the IR does not track their size.
+void DexLayout::LayoutAnnotationSets(const DexFile* dex_file) {
+  std::unordered_set<const dex_ir::AnnotationSetItem*> hot_sets;
+  for (std::unique_ptr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
+    dex_ir::AnnotationsDirectoryItem* annotations = class_def->Annotations();
+    if (annotations == nullptr) {
+      continue;
+    }
+    const bool is_profile_class =
+        info_->ContainsClass(*dex_file, dex::TypeIndex(class_def->ClassType()->GetIndex()));
+    if (is_profile_class) {
+      if (annotations->GetClassAnnotation() != nullptr) {
+        hot_sets.insert(annotations->GetClassAnnotation());
+      }
+      if (annotations->GetFieldAnnotations() != nullptr) {
+        for (auto& field : *annotations->GetFieldAnnotations()) {
+          hot_sets.insert(field->GetAnnotationSetItem());
+        }
+      }
+    }
+    if (annotations->GetMethodAnnotations() != nullptr) {
+      for (auto& method : *annotations->GetMethodAnnotations()) {
+        if (info_->ContainsMethod(MethodReference(dex_file, method->GetMethodId()->GetIndex()))) {
+          hot_sets.insert(method->GetAnnotationSetItem());
+        }
+      }
+    }
+    if (annotations->GetParameterAnnotations() != nullptr) {
+      for (auto& parameter : *annotations->GetParameterAnnotations()) {
+        if (info_->ContainsMethod(
+                MethodReference(dex_file, parameter->GetMethodId()->GetIndex()))) {
+          for (dex_ir::AnnotationSetItem* set_item : *parameter->GetAnnotations()->GetItems()) {
+            if (set_item != nullptr) {
+              hot_sets.insert(set_item);
+            }
+          }
+        }
+      }
+    }
+  }
+  if (hot_sets.empty()) {
+    return;
+  }
+  std::vector<dex_ir::AnnotationSetItem*> set_items;
+  uint32_t min_offset = std::numeric_limits<uint32_t>::max();
+  uint32_t max_offset = 0;
+  for (auto& set_item_pair : header_->GetCollections().AnnotationSetItems()) {
+    dex_ir::AnnotationSetItem* set_item = set_item_pair.second.get();
+    set_items.push_back(set_item);
+    min_offset = std::min(min_offset, set_item->GetOffset());
+    max_offset = std::max(max_offset, set_item->GetOffset() + set_item->GetSize());
+  }
+  VLOG(compiler) << "Hot annotation sets " << hot_sets.size() << "/" << set_items.size();
+  std::sort(set_items.begin(),
+            set_items.end(),
+            [&hot_sets](const dex_ir::AnnotationSetItem* a, const dex_ir::AnnotationSetItem* b) {
+    const bool a_is_hot = hot_sets.find(a) != hot_sets.end();
+    const bool b_is_hot = hot_sets.find(b) != hot_sets.end();
+    if (a_is_hot != b_is_hot) {
+      return a_is_hot;
+    }
+    // Preserve order.
+    return a->GetOffset() < b->GetOffset();
+  });
+  // Annotation sets are 4-byte aligned lists of 4-byte offsets, so they can be packed back to back
+  // without changing the size of the section.
+  uint32_t offset = min_offset;
+  for (dex_ir::AnnotationSetItem* set_item : set_items) {
+    set_item->SetOffset(offset);
+    offset += set_item->GetSize();
+  }
+  CHECK_LE(offset, max_offset);
+}
+
 // Orders code items according to specified class data ordering.
 // NOTE: If the section following the code items is byte aligned, the last code item is left in
 // place to preserve alignment. Layout needs an overhaul to handle movement of other sections.
@@ -1844,6 +1925,9 @@ void DexLayout::FixupSections(uint32_t offset, uint32_t diff) {
 
 void DexLayout::LayoutOutputFile(const DexFile* dex_file) {
   LayoutStringData(dex_file);
+  if (options_.layout_annotations_) {
+    LayoutAnnotationSets(dex_file);
+  }
   std::vector<dex_ir::ClassData*> new_class_data_order = LayoutClassDefsAndClassData(dex_file);
   int32_t diff = LayoutCodeItems(dex_file, new_class_data_order);
   // Move sections after ClassData by diff bytes.
@@ -1852,10 +1936,30 @@ void DexLayout::LayoutOutputFile(const DexFile* dex_file) {
   header_->SetFileSize(header_->FileSize() + diff);
 }
 
-void DexLayout::OutputDexFile(const DexFile* dex_file) {
-  const std::string& dex_file_location = dex_file->GetLocation();
+void DexLayout::RemoveStringDataSection() {
+  dex_ir::Collections& collections = header_->GetCollections();
+  const uint32_t section_offset = collections.StringDatasOffset();
+  uint32_t section_end = section_offset;
+  for (auto& string_data_pair : collections.StringDatas()) {
+    dex_ir::StringData* string_data = string_data_pair.second.get();
+    // The size of a string data item does not include the terminating NUL.
+    section_end = std::max(section_end, string_data->GetOffset() + string_data->GetSize() + 1u);
+  }
+  // Only move the following sections by a multiple of 4 bytes so they keep their alignment. The
+  // remainder becomes zero padding.
+  const uint32_t diff = RoundDown(section_end - section_offset, sizeof(uint32_t));
+  if (diff == 0u) {
+    return;
+  }
+  FixupSections(section_offset, -diff);
+  header_->SetFileSize(header_->FileSize() - diff);
+  header_->SetDataSize(header_->DataSize() - diff);
+}
+
+bool DexLayout::CreateOutputMemMap(const std::string& dex_file_location,
+                                   size_t size,
+                                   std::unique_ptr<File>* new_file) {
   std::string error_msg;
-  std::unique_ptr<File> new_file;
   if (!options_.output_to_memmap_) {
     std::string output_location(options_.output_dex_directory_);
     size_t last_slash = dex_file_location.rfind('/');
@@ -1867,27 +1971,37 @@ void DexLayout::OutputDexFile(const DexFile* dex_file) {
     } else {
       output_location += "/" + dex_file_location + ".new";
     }
-    new_file.reset(OS::CreateEmptyFile(output_location.c_str()));
-    if (new_file == nullptr) {
+    new_file->reset(OS::CreateEmptyFile(output_location.c_str()));
+    if (*new_file == nullptr) {
       LOG(ERROR) << "Could not create dex writer output file: " << output_location;
-      return;
+      return false;
     }
-    if (ftruncate(new_file->Fd(), header_->FileSize()) != 0) {
+    if (ftruncate((*new_file)->Fd(), size) != 0) {
       LOG(ERROR) << "Could not grow dex writer output file: " << output_location;;
-      new_file->Erase();
-      return;
+      (*new_file)->Erase();
+      return false;
     }
-    mem_map_.reset(MemMap::MapFile(header_->FileSize(), PROT_READ | PROT_WRITE, MAP_SHARED,
-        new_file->Fd(), 0, /*low_4gb*/ false, output_location.c_str(), &error_msg));
+    mem_map_.reset(MemMap::MapFile(size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        (*new_file)->Fd(), 0, /*low_4gb*/ false, output_location.c_str(), &error_msg));
   } else {
-    mem_map_.reset(MemMap::MapAnonymous("layout dex", nullptr, header_->FileSize(),
+    mem_map_.reset(MemMap::MapAnonymous("layout dex", nullptr, size,
         PROT_READ | PROT_WRITE, /* low_4gb */ false, /* reuse */ false, &error_msg));
   }
   if (mem_map_ == nullptr) {
     LOG(ERROR) << "Could not create mem map for dex writer output: " << error_msg;
-    if (new_file != nullptr) {
-      new_file->Erase();
+    if (*new_file != nullptr) {
+      (*new_file)->Erase();
     }
+    return false;
+  }
+  return true;
+}
+
+void DexLayout::OutputDexFile(const DexFile* dex_file) {
+  const std::string& dex_file_location = dex_file->GetLocation();
+  std::string error_msg;
+  std::unique_ptr<File> new_file;
+  if (!CreateOutputMemMap(dex_file_location, header_->FileSize(), &new_file)) {
     return;
   }
   DexWriter::Output(header_, mem_map_.get());
@@ -1915,6 +2029,150 @@ void DexLayout::OutputDexFile(const DexFile* dex_file) {
   }
 }
 
+bool DexLayout::OutputSharedDataContainer(
+    const std::vector<std::unique_ptr<const DexFile>>& dex_files) {
+  std::vector<std::unique_ptr<dex_ir::Header>> headers;
+  std::vector<uint32_t> dex_offsets;
+  uint32_t offset = 0u;
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    headers.emplace_back(dex_ir::DexIrBuilder(*dex_file));
+    SetHeader(headers.back().get());
+    if (info_ != nullptr) {
+      LayoutOutputFile(dex_file.get());
+    }
+    RemoveStringDataSection();
+    dex_offsets.push_back(offset);
+    offset = RoundUp(offset + header_->FileSize(), sizeof(uint32_t));
+  }
+
+  // Place each distinct string once, in the order the dex files first use it. This keeps the
+  // string order chosen by the profile-guided layout of the first dex file.
+  const uint32_t shared_data_offset = offset;
+  std::unordered_map<std::string, uint32_t> shared_strings;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    std::vector<dex_ir::StringData*> string_datas;
+    for (auto& string_data_pair : headers[i]->GetCollections().StringDatas()) {
+      string_datas.push_back(string_data_pair.second.get());
+    }
+    std::sort(string_datas.begin(),
+              string_datas.end(),
+              [](const dex_ir::StringData* a, const dex_ir::StringData* b) {
+                return a->GetOffset() < b->GetOffset();
+              });
+    for (dex_ir::StringData* string_data : string_datas) {
+      auto it = shared_strings.emplace(string_data->Data(), offset);
+      if (it.second) {
+        offset += string_data->GetSize() + 1u;
+      }
+      string_data->SetOffset(it.first->second - dex_offsets[i]);
+    }
+  }
+  const uint32_t shared_data_size = offset - shared_data_offset;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    headers[i]->SetLinkOffset(shared_data_offset - dex_offsets[i]);
+    headers[i]->SetLinkSize(shared_data_size);
+  }
+
+  const std::string& location = dex_files[0]->GetLocation();
+  std::unique_ptr<File> new_file;
+  if (!CreateOutputMemMap(location, offset, &new_file)) {
+    return false;
+  }
+  for (size_t i = 0; i < headers.size(); ++i) {
+    DexWriter::OutputToContainer(headers[i].get(), mem_map_.get(), dex_offsets[i]);
+    // The checksum of each dex file covers its own bytes. The shared string data is checked by
+    // the verifier when the container is opened.
+    uint8_t* dex_begin = mem_map_->Begin() + dex_offsets[i];
+    const uint32_t non_sum = OFFSETOF_MEMBER(DexFile::Header, signature_);
+    reinterpret_cast<DexFile::Header*>(dex_begin)->checksum_ =
+        adler32(adler32(0L, Z_NULL, 0), dex_begin + non_sum, headers[i]->FileSize() - non_sum);
+  }
+  if (new_file != nullptr) {
+    UNUSED(new_file->FlushCloseOrErase());
+  }
+  // Verify the container's structure for debug builds.
+  std::string error_msg;
+  if (kIsDebugBuild) {
+    std::vector<std::unique_ptr<const DexFile>> output_dex_files;
+    bool opened = DexFile::OpenContainer(mem_map_->Begin(),
+                                         mem_map_->Size(),
+                                         "memory mapped container for " + location,
+                                         /*verify*/ true,
+                                         /*verify_checksum*/ true,
+                                         &error_msg,
+                                         &output_dex_files);
+    DCHECK(opened) << "Failed to re-open output container:" << error_msg;
+    DCHECK_EQ(output_dex_files.size(), dex_files.size());
+  }
+  if (options_.verify_output_) {
+    for (size_t i = 0; i < dex_files.size(); ++i) {
+      std::unique_ptr<dex_ir::Header> orig_header(dex_ir::DexIrBuilder(*dex_files[i]));
+      CHECK(VerifyOutputDexFile(orig_header.get(), headers[i].get(), &error_msg)) << error_msg;
+    }
+  }
+  SetHeader(nullptr);
+  return true;
+}
+
+void DexLayout::BenchmarkSharedDataContainer(
+    const std::vector<std::unique_ptr<const DexFile>>& dex_files) {
+  static constexpr size_t kIterations = 15u;
+  size_t standard_size = 0u;
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    standard_size += dex_file->Size();
+  }
+  if (!OutputSharedDataContainer(dex_files)) {
+    return;
+  }
+  const DexFile::Header& first_header =
+      *reinterpret_cast<const DexFile::Header*>(mem_map_->Begin());
+  const size_t container_size = mem_map_->Size();
+
+  // Time opening and verifying all dex files, which touches all of their string data.
+  std::vector<uint64_t> standard_times;
+  std::vector<uint64_t> container_times;
+  std::string error_msg;
+  for (size_t n = 0; n < kIterations; ++n) {
+    uint64_t start = NanoTime();
+    for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+      std::unique_ptr<const DexFile> opened = DexFile::Open(dex_file->Begin(),
+                                                            dex_file->Size(),
+                                                            dex_file->GetLocation(),
+                                                            dex_file->GetLocationChecksum(),
+                                                            /*oat_dex_file*/ nullptr,
+                                                            /*verify*/ true,
+                                                            /*verify_checksum*/ true,
+                                                            &error_msg);
+      CHECK(opened != nullptr) << error_msg;
+    }
+    standard_times.push_back(NanoTime() - start);
+
+    start = NanoTime();
+    std::vector<std::unique_ptr<const DexFile>> opened;
+    CHECK(DexFile::OpenContainer(mem_map_->Begin(),
+                                 container_size,
+                                 dex_files[0]->GetLocation(),
+                                 /*verify*/ true,
+                                 /*verify_checksum*/ true,
+                                 &error_msg,
+                                 &opened)) << error_msg;
+    container_times.push_back(NanoTime() - start);
+  }
+  std::sort(standard_times.begin(), standard_times.end());
+  std::sort(container_times.begin(), container_times.end());
+
+  fprintf(out_file_, "dex files:          %zu\n", dex_files.size());
+  fprintf(out_file_, "standard size:      %zu bytes\n", standard_size);
+  fprintf(out_file_, "container size:     %zu bytes (%.2f%%)\n",
+          container_size, 100.0 * container_size / standard_size);
+  fprintf(out_file_, "shared string data: %u bytes\n", first_header.link_size_);
+  fprintf(out_file_, "open+verify median over %zu runs: standard %" PRIu64 " us, "
+          "container %" PRIu64 " us\n",
+          kIterations,
+          standard_times[kIterations / 2] / 1000u,
+          container_times[kIterations / 2] / 1000u);
+}
+
 /*
  * Dumps the requested sections of the file.
  */
@@ -1939,6 +2197,11 @@ void DexLayout::ProcessDexFile(const char* file_name,
     return;
   }
 
+  if (options_.show_page_touch_report_) {
+    ShowDexPageTouchReport(header_, dex_file, dex_file_index, info_);
+    return;
+  }
+
   // Dump dex file.
   if (options_.dump_) {
     DumpDexFile();
@@ -1978,6 +2241,14 @@ int DexLayout::ProcessFile(const char* file_name) {
   // all dex files found in given file.
   if (options_.checksum_only_) {
     fprintf(out_file_, "Checksum verified\n");
+  } else if (options_.show_shared_data_statistics_) {
+    ShowDexSharedDataStatistics(dex_files);
+  } else if (options_.benchmark_shared_data_) {
+    BenchmarkSharedDataContainer(dex_files);
+  } else if (options_.output_shared_data_) {
+    if (!OutputSharedDataContainer(dex_files)) {
+      return -1;
+    }
   } else {
     for (size_t i = 0; i < dex_files.size(); i++) {
       ProcessDexFile(file_name, dex_files[i].get(), i);
@@ -28,6 +28,7 @@
 
 #include "dex_ir.h"
 #include "mem_map.h"
+#include "os.h"
 
 namespace art {
 
@@ -47,16 +48,21 @@ class Options {
   Options() = default;
 
   bool dump_ = false;
+  bool benchmark_shared_data_ = false;
   bool build_dex_ir_ = false;
   bool checksum_only_ = false;
   bool disassemble_ = false;
   bool exports_only_ = false;
   bool ignore_bad_checksum_ = false;
+  bool layout_annotations_ = false;
+  bool output_shared_data_ = false;
   bool output_to_memmap_ = false;
   bool show_annotations_ = false;
   bool show_file_headers_ = false;
+  bool show_page_touch_report_ = false;
   bool show_section_headers_ = false;
   bool show_section_statistics_ = false;
+  bool show_shared_data_statistics_ = false;
   bool verbose_ = false;
   bool verify_output_ = false;
   bool visualize_pattern_ = false;
@@ -111,14 +117,27 @@ class DexLayout {
   int32_t LayoutCodeItems(const DexFile* dex_file,
                           std::vector<dex_ir::ClassData*> new_class_data_order);
   void LayoutStringData(const DexFile* dex_file);
+  void LayoutAnnotationSets(const DexFile* dex_file);
   bool IsNextSectionCodeItemAligned(uint32_t offset);
   template<class T> void FixupSection(std::map<uint32_t, std::unique_ptr<T>>& map, uint32_t diff);
   void FixupSections(uint32_t offset, uint32_t diff);
 
   // Creates a new layout for the dex file based on profile info.
-  // Currently reorders ClassDefs, ClassDataItems, and CodeItems.
+  // Currently reorders ClassDefs, ClassDataItems, CodeItems and StringDatas, and optionally
+  // AnnotationSetItems.
   void LayoutOutputFile(const DexFile* dex_file);
+  // Drops the string data section of header_ so that its strings can be placed in the shared
+  // section of a container.
+  void RemoveStringDataSection();
+  bool CreateOutputMemMap(const std::string& dex_file_location,
+                          size_t size,
+                          std::unique_ptr<File>* new_file);
   void OutputDexFile(const DexFile* dex_file);
+  // Writes all dex files into one container that stores each distinct string once, see
+  // DexFile::OpenContainer. Returns false if the output could not be created.
+  bool OutputSharedDataContainer(const std::vector<std::unique_ptr<const DexFile>>& dex_files);
+  // Compares size and open/verify time of the input dex files with their shared-data container.
+  void BenchmarkSharedDataContainer(const std::vector<std::unique_ptr<const DexFile>>& dex_files);
 
   void DumpCFG(const DexFile* dex_file, int idx);
   void DumpCFG(const DexFile* dex_file, uint32_t dex_method_idx, const DexFile::CodeItem* code);
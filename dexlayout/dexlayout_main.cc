@@ -44,7 +44,8 @@ static const char* kProgramName = "dexlayout";
 static void Usage(void) {
   fprintf(stderr, "Copyright (C) 2016 The Android Open Source Project\n\n");
   fprintf(stderr, "%s: [-a] [-c] [-d] [-e] [-f] [-h] [-i] [-l layout] [-o outfile] [-p profile]"
-                  " [-s] [-t] [-v] [-w directory] dexfile...\n\n", kProgramName);
+                  " [-r] [-s] [-t] [-u] [-v] [-w directory] [-x] [-y] [-z] dexfile...\n\n",
+                  kProgramName);
   fprintf(stderr, " -a : display annotations\n");
   fprintf(stderr, " -b : build dex_ir\n");
   fprintf(stderr, " -c : verify checksum and exit\n");
@@ -56,10 +57,15 @@ static void Usage(void) {
   fprintf(stderr, " -l : output layout, either 'plain' or 'xml'\n");
   fprintf(stderr, " -o : output file name (defaults to stdout)\n");
   fprintf(stderr, " -p : profile file name (defaults to no profile)\n");
+  fprintf(stderr, " -r : display pages touched by profiled classes per section\n");
   fprintf(stderr, " -s : visualize reference pattern\n");
   fprintf(stderr, " -t : display file section sizes\n");
+  fprintf(stderr, " -u : cluster annotations of profiled classes and methods\n");
   fprintf(stderr, " -v : verify output file is canonical to input (IR level comparison)\n");
   fprintf(stderr, " -w : output dex directory \n");
+  fprintf(stderr, " -x : display data duplicated across the dex files of a container\n");
+  fprintf(stderr, " -y : output all dex files as one container with shared string data\n");
+  fprintf(stderr, " -z : benchmark size and open time of the shared string data container\n");
 }
 
 /*
@@ -77,7 +83,7 @@ int DexlayoutDriver(int argc, char** argv) {
 
   // Parse all arguments.
   while (1) {
-    const int ic = getopt(argc, argv, "abcdefghil:mo:p:stvw:");
+    const int ic = getopt(argc, argv, "abcdefghil:mo:p:rstuvw:xyz");
     if (ic < 0) {
       break;  // done
     }
@@ -125,6 +131,10 @@ int DexlayoutDriver(int argc, char** argv) {
       case 'p':  // profile file
         options.profile_file_name_ = optarg;
         break;
+      case 'r':  // display page touch report
+        options.show_page_touch_report_ = true;
+        options.verbose_ = false;
+        break;
       case 's':  // visualize access pattern
         options.visualize_pattern_ = true;
         options.verbose_ = false;
@@ -133,12 +143,27 @@ int DexlayoutDriver(int argc, char** argv) {
         options.show_section_statistics_ = true;
         options.verbose_ = false;
         break;
+      case 'u':  // layout annotations
+        options.layout_annotations_ = true;
+        break;
       case 'v':  // verify output
         options.verify_output_ = true;
         break;
       case 'w':  // output dex files directory
         options.output_dex_directory_ = optarg;
         break;
+      case 'x':  // display shared data statistics
+        options.show_shared_data_statistics_ = true;
+        options.verbose_ = false;
+        break;
+      case 'y':  // output shared data container
+        options.output_shared_data_ = true;
+        break;
+      case 'z':  // benchmark shared data container
+        options.benchmark_shared_data_ = true;
+        options.output_to_memmap_ = true;
+        options.verbose_ = false;
+        break;
       default:
         want_usage = true;
         break;
@@ -154,6 +179,11 @@ int DexlayoutDriver(int argc, char** argv) {
     fprintf(stderr, "Can't specify both -c and -i\n");
     want_usage = true;
   }
+  if (options.output_shared_data_ &&
+      options.output_dex_directory_ == nullptr && !options.output_to_memmap_) {
+    fprintf(stderr, "-y requires -w or -m\n");
+    want_usage = true;
+  }
   if (want_usage) {
     Usage();
     return 2;
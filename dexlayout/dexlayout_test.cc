@@ -18,12 +18,15 @@
 #include <vector>
 #include <sstream>
 
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "base/unix_file/fd_file.h"
 #include "common_runtime_test.h"
+#include "dex_file-inl.h"
 #include "exec_utils.h"
+#include "mem_map.h"
 #include "utils.h"
 
 namespace art {
@@ -318,7 +321,7 @@ class DexLayoutTest : public CommonRuntimeTest {
   }
 
   // Runs DexFileLayout test.
-  bool DexFileLayoutExec(std::string* error_msg) {
+  bool DexFileLayoutExec(std::string* error_msg, bool layout_annotations = false) {
     ScratchFile tmp_file;
     std::string tmp_name = tmp_file.GetFilename();
     size_t tmp_last_slash = tmp_name.rfind("/");
@@ -335,7 +338,11 @@ class DexLayoutTest : public CommonRuntimeTest {
     EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
 
     std::vector<std::string> dexlayout_exec_argv =
-        { dexlayout, "-v", "-w", tmp_dir, "-o", tmp_name, "-p", profile_file, dex_file };
+        { dexlayout, "-v", "-w", tmp_dir, "-o", tmp_name, "-p", profile_file };
+    if (layout_annotations) {
+      dexlayout_exec_argv.push_back("-u");
+    }
+    dexlayout_exec_argv.push_back(dex_file);
     if (!::art::Exec(dexlayout_exec_argv, error_msg)) {
       return false;
     }
@@ -427,6 +434,129 @@ TEST_F(DexLayoutTest, DexFileLayout) {
   ASSERT_TRUE(DexFileLayoutExec(&error_msg)) << error_msg;
 }
 
+TEST_F(DexLayoutTest, DexFileLayoutAnnotations) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  std::string error_msg;
+  ASSERT_TRUE(DexFileLayoutExec(&error_msg, /* layout_annotations */ true)) << error_msg;
+}
+
+TEST_F(DexLayoutTest, PageTouchReport) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  ScratchFile temp_dex;
+  ScratchFile temp_profile;
+  std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+  EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+  std::vector<std::string> dexlayout_exec_argv =
+      { dexlayout, "-r", "-p", temp_profile.GetFilename(), "-o", "/dev/null",
+        temp_dex.GetFilename() };
+  ASSERT_TRUE(DexLayoutExec(&temp_dex,
+                            kDexFileLayoutInputDex,
+                            &temp_profile,
+                            kDexFileLayoutInputProfile,
+                            dexlayout_exec_argv));
+}
+
+TEST_F(DexLayoutTest, SharedDataStatistics) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+  EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+  std::vector<std::string> dexlayout_exec_argv = { dexlayout, "-x", "-o", "/dev/null" };
+  for (const std::string& dex_file : GetLibCoreDexFileNames()) {
+    dexlayout_exec_argv.push_back(dex_file);
+  }
+  std::string error_msg;
+  ASSERT_TRUE(::art::Exec(dexlayout_exec_argv, &error_msg)) << error_msg;
+}
+
+TEST_F(DexLayoutTest, SharedDataContainer) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  ScratchFile tmp_file;
+  const std::string& tmp_name = tmp_file.GetFilename();
+  std::string tmp_dir = tmp_name.substr(0, tmp_name.rfind('/') + 1);
+  std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+  EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+  std::string multidex = GetTestDexFileName("MultiDex");
+  std::vector<std::string> dexlayout_exec_argv =
+      { dexlayout, "-y", "-v", "-w", tmp_dir, "-o", "/dev/null", multidex };
+  std::string error_msg;
+  ASSERT_TRUE(::art::Exec(dexlayout_exec_argv, &error_msg)) << error_msg;
+
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  ASSERT_TRUE(DexFile::Open(multidex.c_str(), multidex, true, &error_msg, &dex_files))
+      << error_msg;
+  ASSERT_GT(dex_files.size(), 1u);
+  size_t standard_size = 0u;
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    standard_size += dex_file->Size();
+  }
+
+  std::string container_name = tmp_dir + multidex.substr(multidex.rfind('/'));
+  std::unique_ptr<File> container_file(OS::OpenFileForReading(container_name.c_str()));
+  ASSERT_TRUE(container_file != nullptr) << container_name;
+  std::unique_ptr<MemMap> container(MemMap::MapFile(container_file->GetLength(),
+                                                    PROT_READ | PROT_WRITE,
+                                                    MAP_PRIVATE,
+                                                    container_file->Fd(),
+                                                    0,
+                                                    /*low_4gb*/ false,
+                                                    container_name.c_str(),
+                                                    &error_msg));
+  ASSERT_TRUE(container != nullptr) << error_msg;
+  // Strings such as "<init>" and "Ljava/lang/Object;" are stored once.
+  EXPECT_LT(container->Size(), standard_size);
+
+  std::vector<std::unique_ptr<const DexFile>> container_dex_files;
+  ASSERT_TRUE(DexFile::OpenContainer(container->Begin(),
+                                     container->Size(),
+                                     container_name,
+                                     /*verify*/ true,
+                                     /*verify_checksum*/ true,
+                                     &error_msg,
+                                     &container_dex_files)) << error_msg;
+  ASSERT_EQ(dex_files.size(), container_dex_files.size());
+  for (size_t i = 0; i < dex_files.size(); ++i) {
+    const DexFile* expected = dex_files[i].get();
+    const DexFile* actual = container_dex_files[i].get();
+    EXPECT_EQ(DexFile::GetMultiDexLocation(i, container_name.c_str()), actual->GetLocation());
+    EXPECT_EQ(container->Begin() + container->Size() - actual->SharedDataSize(),
+              actual->SharedDataBegin());
+    ASSERT_EQ(expected->NumStringIds(), actual->NumStringIds());
+    for (uint32_t j = 0; j < expected->NumStringIds(); ++j) {
+      EXPECT_STREQ(expected->StringDataByIdx(dex::StringIndex(j)),
+                   actual->StringDataByIdx(dex::StringIndex(j)));
+    }
+    EXPECT_EQ(expected->NumClassDefs(), actual->NumClassDefs());
+  }
+
+  // Dex files that disagree about the shared section are rejected.
+  DexFile::Header* second_header =
+      const_cast<DexFile::Header*>(&container_dex_files[1]->GetHeader());
+  second_header->link_size_ += 1u;
+  std::vector<std::unique_ptr<const DexFile>> bad_dex_files;
+  EXPECT_FALSE(DexFile::OpenContainer(container->Begin(),
+                                      container->Size(),
+                                      container_name,
+                                      /*verify*/ true,
+                                      /*verify_checksum*/ false,
+                                      &error_msg,
+                                      &bad_dex_files));
+}
+
+TEST_F(DexLayoutTest, SharedDataBenchmark) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+  EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+  std::vector<std::string> dexlayout_exec_argv =
+      { dexlayout, "-z", "-o", "/dev/null", GetTestDexFileName("MultiDex") };
+  std::string error_msg;
+  ASSERT_TRUE(::art::Exec(dexlayout_exec_argv, &error_msg)) << error_msg;
+}
+
 TEST_F(DexLayoutTest, UnreferencedCatchHandler) {
   // Disable test on target.
   TEST_DISABLED_FOR_TARGET();
@@ -612,6 +612,28 @@ const OatQuickMethodHeader* ArtMethod::GetOatQuickMethodHeader(uintptr_t pc) {
   CHECK(existing_entry_point != nullptr) << PrettyMethod() << "@" << this;
   ClassLinker* class_linker = runtime->GetClassLinker();
 
+  if (IsNative() && pc != 0u) {
+    // The entrypoint of a native method changes when its JNI stub gets JIT-compiled or collected,
+    // also while a call is in flight, so look for the code that contains the pc instead.
+    jit::Jit* jit = runtime->GetJit();
+    if (jit != nullptr) {
+      OatQuickMethodHeader* method_header = jit->GetCodeCache()->LookupMethodHeader(pc, this);
+      if (method_header != nullptr) {
+        return method_header;
+      }
+    }
+    const void* oat_code = GetOatMethodQuickCode(class_linker->GetImagePointerSize());
+    if (oat_code != nullptr && !class_linker->IsQuickGenericJniStub(oat_code)) {
+      OatQuickMethodHeader* method_header = OatQuickMethodHeader::FromEntryPoint(oat_code);
+      if (method_header->Contains(pc)) {
+        return method_header;
+      }
+    }
+    // Native methods only run compiled JNI stubs or the GenericJNI trampoline, whose extent is not
+    // exported by the assembly, so any other pc is in the trampoline.
+    return nullptr;
+  }
+
   if (class_linker->IsQuickGenericJniStub(existing_entry_point)) {
     // The generic JNI does not have any method header.
     return nullptr;
@@ -18,6 +18,7 @@
 #define ART_RUNTIME_ASM_SUPPORT_H_
 
 #if defined(__cplusplus)
+#include "art_field.h"
 #include "art_method.h"
 #include "base/bit_utils.h"
 #include "gc/allocator/rosalloc.h"
@@ -79,7 +80,7 @@ ADD_TEST_EQ(static_cast<size_t>(1U << POINTER_SIZE_SHIFT),
 ADD_TEST_EQ(THREAD_EXCEPTION_OFFSET,
             art::Thread::ExceptionOffset<POINTER_SIZE>().Int32Value())
 
-// Offset of field Thread::tlsPtr_.managed_stack.top_quick_frame_.
+// Offset of field Thread::tlsPtr_.managed_stack.tagged_top_quick_frame_.
 #define THREAD_TOP_QUICK_FRAME_OFFSET (THREAD_CARD_TABLE_OFFSET + (3 * __SIZEOF_POINTER__))
 ADD_TEST_EQ(THREAD_TOP_QUICK_FRAME_OFFSET,
             art::Thread::TopOfManagedStackOffset<POINTER_SIZE>().Int32Value())
@@ -120,13 +121,26 @@ ADD_TEST_EQ(THREAD_ALT_IBASE_OFFSET,
 ADD_TEST_EQ(THREAD_ROSALLOC_RUNS_OFFSET,
             art::Thread::RosAllocRunsOffset<POINTER_SIZE>().Int32Value())
 // Offset of field Thread::tlsPtr_.thread_local_alloc_stack_top.
-#define THREAD_LOCAL_ALLOC_STACK_TOP_OFFSET (THREAD_ROSALLOC_RUNS_OFFSET + 16 * __SIZEOF_POINTER__)
+#define THREAD_LOCAL_ALLOC_STACK_TOP_OFFSET (THREAD_ROSALLOC_RUNS_OFFSET + 41 * __SIZEOF_POINTER__)
 ADD_TEST_EQ(THREAD_LOCAL_ALLOC_STACK_TOP_OFFSET,
             art::Thread::ThreadLocalAllocStackTopOffset<POINTER_SIZE>().Int32Value())
 // Offset of field Thread::tlsPtr_.thread_local_alloc_stack_end.
-#define THREAD_LOCAL_ALLOC_STACK_END_OFFSET (THREAD_ROSALLOC_RUNS_OFFSET + 17 * __SIZEOF_POINTER__)
+#define THREAD_LOCAL_ALLOC_STACK_END_OFFSET (THREAD_ROSALLOC_RUNS_OFFSET + 42 * __SIZEOF_POINTER__)
 ADD_TEST_EQ(THREAD_LOCAL_ALLOC_STACK_END_OFFSET,
             art::Thread::ThreadLocalAllocStackEndOffset<POINTER_SIZE>().Int32Value())
+// Offset of field Thread::tlsPtr_.interpreter_cache.
+#define THREAD_INTERPRETER_CACHE_OFFSET (THREAD_ROSALLOC_RUNS_OFFSET + 43 * __SIZEOF_POINTER__)
+ADD_TEST_EQ(THREAD_INTERPRETER_CACHE_OFFSET,
+            art::Thread::InterpreterCacheOffset<POINTER_SIZE>().Int32Value())
+
+// The InterpreterCache has 1 << INTERPRETER_CACHE_SIZE_LOG2 entries of a key and a value pointer.
+#define INTERPRETER_CACHE_SIZE_LOG2 8
+ADD_TEST_EQ(static_cast<size_t>(1U << INTERPRETER_CACHE_SIZE_LOG2), art::InterpreterCache::kSize)
+ADD_TEST_EQ(static_cast<size_t>(2 * __SIZEOF_POINTER__), sizeof(art::InterpreterCache::Entry))
+
+// Offset of field ArtField::offset_.
+#define ART_FIELD_OFFSET_OFFSET 12
+ADD_TEST_EQ(ART_FIELD_OFFSET_OFFSET, art::ArtField::OffsetOffset().Int32Value())
 
 // Offsets within ShadowFrame.
 #define SHADOWFRAME_LINK_OFFSET 0
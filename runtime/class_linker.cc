@@ -8824,6 +8824,11 @@ void ClassLinker::CleanupClassLoaders() {
       }
     }
   }
+  if (!to_delete.empty()) {
+    // The interpreter caches may hold fields and methods of the unloaded classes, keyed by dex
+    // instructions whose memory is about to be reused.
+    Thread::ClearAllInterpreterCaches();
+  }
   for (ClassLoaderData& data : to_delete) {
     DeleteClassLoader(self, data);
   }
@@ -3153,7 +3153,10 @@ void Dbg::ProcessDeoptimizationRequest(const DeoptimizationRequest& request) {
     case DeoptimizationRequest::kRegisterForEvent:
       VLOG(jdwp) << StringPrintf("Add debugger as listener for instrumentation event 0x%x",
                                  request.InstrumentationEvent());
-      instrumentation->AddListener(&gDebugInstrumentationListener, request.InstrumentationEvent());
+      // Native method entry and exit are not reported, see DebugInstrumentationListener.
+      instrumentation->AddListener(&gDebugInstrumentationListener,
+                                   request.InstrumentationEvent(),
+                                   /* ignored_access_flags */ kAccNative);
       instrumentation_events_ |= request.InstrumentationEvent();
       break;
     case DeoptimizationRequest::kUnregisterForEvent:
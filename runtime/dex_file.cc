@@ -179,6 +179,71 @@ std::unique_ptr<const DexFile> DexFile::Open(const uint8_t* base,
                     error_msg);
 }
 
+bool DexFile::OpenContainer(const uint8_t* base,
+                            size_t size,
+                            const std::string& location,
+                            bool verify,
+                            bool verify_checksum,
+                            std::string* error_msg,
+                            std::vector<std::unique_ptr<const DexFile>>* dex_files) {
+  ScopedTrace trace(std::string("Open dex container from RAM ") + location);
+  DCHECK(dex_files != nullptr) << location;
+  if (size < sizeof(Header)) {
+    *error_msg = StringPrintf("Dex container '%s' too short: %zu", location.c_str(), size);
+    return false;
+  }
+  const Header* first_header = reinterpret_cast<const Header*>(base);
+  const size_t shared_data_offset = first_header->link_off_;
+  const size_t shared_data_size = first_header->link_size_;
+  if (shared_data_offset == 0u ||
+      shared_data_offset > size ||
+      shared_data_size > size - shared_data_offset) {
+    *error_msg = StringPrintf("Bad shared data section in dex container '%s': %zx, size %zx",
+                              location.c_str(), shared_data_offset, shared_data_size);
+    return false;
+  }
+  size_t offset = 0u;
+  for (size_t i = 0; offset < shared_data_offset; ++i) {
+    const std::string multidex_location = GetMultiDexLocation(i, location.c_str());
+    if (shared_data_offset - offset < sizeof(Header)) {
+      *error_msg = StringPrintf("Truncated dex file header in '%s'", multidex_location.c_str());
+      return false;
+    }
+    const Header* header = reinterpret_cast<const Header*>(base + offset);
+    if (!IsMagicValid(header->magic_) || !IsVersionValid(header->magic_)) {
+      *error_msg = StringPrintf("Bad magic in dex container entry '%s'",
+                                multidex_location.c_str());
+      return false;
+    }
+    // All dex files have to agree on where the shared data lives.
+    if (header->file_size_ < sizeof(Header) ||
+        header->file_size_ > shared_data_offset - offset ||
+        header->link_off_ != shared_data_offset - offset ||
+        header->link_size_ != shared_data_size) {
+      *error_msg = StringPrintf("Dex file '%s' does not match its container layout",
+                                multidex_location.c_str());
+      return false;
+    }
+    std::unique_ptr<const DexFile> dex_file = OpenCommon(base + offset,
+                                                         header->file_size_,
+                                                         multidex_location,
+                                                         header->checksum_,
+                                                         /* oat_dex_file */ nullptr,
+                                                         verify,
+                                                         verify_checksum,
+                                                         error_msg,
+                                                         /* verify_result */ nullptr,
+                                                         base + shared_data_offset,
+                                                         shared_data_size);
+    if (dex_file == nullptr) {
+      return false;
+    }
+    dex_files->push_back(std::move(dex_file));
+    offset = RoundUp(offset + header->file_size_, alignof(Header));
+  }
+  return true;
+}
+
 std::unique_ptr<const DexFile> DexFile::Open(const std::string& location,
                                              uint32_t location_checksum,
                                              std::unique_ptr<MemMap> map,
@@ -485,7 +550,9 @@ std::unique_ptr<DexFile> DexFile::OpenCommon(const uint8_t* base,
                                              bool verify,
                                              bool verify_checksum,
                                              std::string* error_msg,
-                                             VerifyResult* verify_result) {
+                                             VerifyResult* verify_result,
+                                             const uint8_t* shared_data_begin,
+                                             size_t shared_data_size) {
   if (verify_result != nullptr) {
     *verify_result = VerifyResult::kVerifyNotAttempted;
   }
@@ -499,6 +566,8 @@ std::unique_ptr<DexFile> DexFile::OpenCommon(const uint8_t* base,
                               error_msg->c_str());
     return nullptr;
   }
+  dex_file->shared_data_begin_ = shared_data_begin;
+  dex_file->shared_data_size_ = shared_data_size;
   if (!dex_file->Init(error_msg)) {
     dex_file.reset();
     return nullptr;
@@ -527,6 +596,8 @@ DexFile::DexFile(const uint8_t* base,
                  const OatDexFile* oat_dex_file)
     : begin_(base),
       size_(size),
+      shared_data_begin_(nullptr),
+      shared_data_size_(0u),
       location_(location),
       location_checksum_(location_checksum),
       header_(reinterpret_cast<const Header*>(base)),
@@ -447,6 +447,19 @@ class DexFile {
                                              bool verify_checksum,
                                              std::string* error_msg);
 
+  // Opens the dex files of a shared-data container backed by existing memory. A container is a
+  // sequence of 4-byte aligned dex files followed by one section of string data that they all
+  // reference. Each dex file's link_off/link_size describe that shared section relative to its own
+  // header, and the first link_off marks where the dex files end. The memory must outlive the
+  // returned dex files.
+  static bool OpenContainer(const uint8_t* base,
+                            size_t size,
+                            const std::string& location,
+                            bool verify,
+                            bool verify_checksum,
+                            std::string* error_msg,
+                            std::vector<std::unique_ptr<const DexFile>>* dex_files);
+
   // Opens .dex file that has been memory-mapped by the caller.
   static std::unique_ptr<const DexFile> Open(const std::string& location,
                                              uint32_t location_checkum,
@@ -1054,6 +1067,16 @@ class DexFile {
     return size_;
   }
 
+  // Start of the string data shared with the other dex files of a container, or null if this dex
+  // file is self-contained. Shared string data lies outside [Begin(), Begin() + Size()).
+  const uint8_t* SharedDataBegin() const {
+    return shared_data_begin_;
+  }
+
+  size_t SharedDataSize() const {
+    return shared_data_size_;
+  }
+
   // Return the name of the index-th classes.dex in a multidex zip file. This is classes.dex for
   // index == 0, and classes{index + 1}.dex else.
   static std::string GetMultiDexClassesDexName(size_t index);
@@ -1148,7 +1171,9 @@ class DexFile {
                                              bool verify,
                                              bool verify_checksum,
                                              std::string* error_msg,
-                                             VerifyResult* verify_result = nullptr);
+                                             VerifyResult* verify_result = nullptr,
+                                             const uint8_t* shared_data_begin = nullptr,
+                                             size_t shared_data_size = 0u);
 
 
   // Opens a .dex file at the given address, optionally backed by a MemMap
@@ -1181,6 +1206,10 @@ class DexFile {
   // The size of the underlying memory allocation in bytes.
   const size_t size_;
 
+  // String data shared with the other dex files of a container, see SharedDataBegin().
+  const uint8_t* shared_data_begin_;
+  size_t shared_data_size_;
+
   // Typically the dex file name when available, alternatively some identifying string.
   //
   // The ClassLinker will use this to match DexFiles the boot class
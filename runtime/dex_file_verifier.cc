@@ -18,6 +18,7 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 
@@ -106,6 +107,14 @@ const char* DexFileVerifier::CheckLoadStringByIdx(dex::StringIndex idx, const ch
   return dex_file_->StringDataByIdx(idx);
 }
 
+// Returns the end of the memory that string_data_off values may point into. That is the end of
+// the file, or the end of the shared string data for dex files of a container. The link fields
+// must have been checked by CheckHeader().
+static const uint8_t* StringDataLimit(const uint8_t* begin, const DexFile::Header* header) {
+  uint64_t link_end = static_cast<uint64_t>(header->link_off_) + header->link_size_;
+  return begin + std::max<uint64_t>(header->file_size_, link_end);
+}
+
 // Try to find the name of the method with the given index. We do not want to rely on DexFile
 // infrastructure at this point, so do it all by hand. begin and header correspond to begin_ and
 // header_ of the DexFileVerifier. str will contain the pointer to the method name on success
@@ -129,13 +138,14 @@ static bool FindMethodName(uint32_t method_index,
   uint32_t string_off =
       (reinterpret_cast<const DexFile::StringId*>(begin + header->string_ids_off_) + string_idx)->
           string_data_off_;
-  if (string_off >= header->file_size_) {
+  const uint8_t* limit = StringDataLimit(begin, header);
+  if (string_off >= static_cast<size_t>(limit - begin)) {
     *error_msg = "String offset out of bounds for method flags verification";
     return false;
   }
   const uint8_t* str_data_ptr = begin + string_off;
   uint32_t dummy;
-  if (!DecodeUnsignedLeb128Checked(&str_data_ptr, begin + header->file_size_, &dummy)) {
+  if (!DecodeUnsignedLeb128Checked(&str_data_ptr, limit, &dummy)) {
     *error_msg = "String size out of bounds for method flags verification";
     return false;
   }
@@ -390,12 +400,25 @@ bool DexFileVerifier::CheckHeader() {
     return false;
   }
 
+  // Dex files of a container point the link section at the string data they share, which lies
+  // after the file.
+  const uint8_t* shared_data_begin = dex_file_->SharedDataBegin();
+  if (shared_data_begin != nullptr) {
+    if (begin_ + header_->link_off_ != shared_data_begin ||
+        header_->link_size_ != dex_file_->SharedDataSize()) {
+      ErrorStringPrintf("Link section %x, size %x does not match the shared data of the container",
+                        header_->link_off_, header_->link_size_);
+      return false;
+    }
+  }
+
   // Check that all offsets are inside the file.
   bool result =
-      CheckValidOffsetAndSize(header_->link_off_,
-                              header_->link_size_,
-                              0 /* unaligned */,
-                              "link") &&
+      (shared_data_begin != nullptr ||
+       CheckValidOffsetAndSize(header_->link_off_,
+                               header_->link_size_,
+                               0 /* unaligned */,
+                               "link")) &&
       CheckValidOffsetAndSize(header_->map_off_,
                               header_->map_off_,
                               4,
@@ -1309,9 +1332,12 @@ bool DexFileVerifier::CheckIntraCodeItem() {
   return true;
 }
 
-bool DexFileVerifier::CheckIntraStringDataItem() {
-  DECODE_UNSIGNED_CHECKED_FROM(ptr_, size);
-  const uint8_t* file_end = begin_ + size_;
+bool DexFileVerifier::CheckIntraStringDataItem(const uint8_t* file_end) {
+  uint32_t size;
+  if (!DecodeUnsignedLeb128Checked(&ptr_, file_end, &size)) {
+    ErrorStringPrintf("Read out of bounds");
+    return false;
+  }
 
   for (uint32_t i = 0; i < size; i++) {
     CHECK_LT(i, size);  // b/15014252 Prevents hitting the impossible case below
@@ -1709,7 +1735,7 @@ bool DexFileVerifier::CheckIntraSectionIterate(size_t offset, uint32_t section_c
         break;
       }
       case DexFile::kDexTypeStringDataItem: {
-        if (!CheckIntraStringDataItem()) {
+        if (!CheckIntraStringDataItem(begin_ + size_)) {
           return false;
         }
         break;
@@ -1844,6 +1870,38 @@ bool DexFileVerifier::CheckIntraDataSection(size_t offset,
   return true;
 }
 
+bool DexFileVerifier::CheckSharedStringData() {
+  const uint8_t* shared_data_begin = dex_file_->SharedDataBegin();
+  if (shared_data_begin == nullptr) {
+    return true;
+  }
+  const uint8_t* shared_data_end = shared_data_begin + dex_file_->SharedDataSize();
+  const DexFile::StringId* string_ids =
+      reinterpret_cast<const DexFile::StringId*>(begin_ + header_->string_ids_off_);
+  if (!CheckListSize(string_ids, header_->string_ids_size_, sizeof(DexFile::StringId),
+                     "string_ids")) {
+    return false;
+  }
+  for (uint32_t i = 0; i < header_->string_ids_size_; ++i) {
+    uint32_t offset = string_ids[i].string_data_off_;
+    if (offset < header_->link_off_) {
+      // Local string data, checked with the rest of the data section.
+      continue;
+    }
+    if (UNLIKELY(offset - header_->link_off_ >= header_->link_size_)) {
+      ErrorStringPrintf("String data offset %x beyond shared data", offset);
+      return false;
+    }
+    ptr_ = begin_ + offset;
+    if (!CheckIntraStringDataItem(shared_data_end)) {
+      return false;
+    }
+    offset_to_type_map_.Insert(std::pair<uint32_t, uint16_t>(offset,
+                                                             DexFile::kDexTypeStringDataItem));
+  }
+  return true;
+}
+
 bool DexFileVerifier::CheckIntraSection() {
   const DexFile::MapList* map = reinterpret_cast<const DexFile::MapList*>(begin_ + header_->map_off_);
   const DexFile::MapItem* item = map->list_;
@@ -2841,6 +2899,12 @@ bool DexFileVerifier::Verify() {
     return false;
   }
 
+  // Check string data shared with the other dex files of a container. This comes first as the
+  // class data checks already look up method names.
+  if (!CheckSharedStringData()) {
+    return false;
+  }
+
   // Check structure within remaining sections.
   if (!CheckIntraSection()) {
     return false;
@@ -2891,7 +2955,7 @@ static std::string GetStringOrError(const uint8_t* const begin,
 
   const uint8_t* ptr = begin + string_id->string_data_off_;
   uint32_t dummy;
-  if (!DecodeUnsignedLeb128Checked(&ptr, begin + header->file_size_, &dummy)) {
+  if (!DecodeUnsignedLeb128Checked(&ptr, StringDataLimit(begin, header), &dummy)) {
     return "(error)";
   }
   return reinterpret_cast<const char*>(ptr);
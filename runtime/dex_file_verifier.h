@@ -118,7 +118,7 @@ class DexFileVerifier {
                                       const DexFile::ClassDef** class_def);
 
   bool CheckIntraCodeItem();
-  bool CheckIntraStringDataItem();
+  bool CheckIntraStringDataItem(const uint8_t* file_end);
   bool CheckIntraDebugInfoItem();
   bool CheckIntraAnnotationItem();
   bool CheckIntraAnnotationsDirectoryItem();
@@ -126,6 +126,9 @@ class DexFileVerifier {
   bool CheckIntraSectionIterate(size_t offset, uint32_t count, DexFile::MapItemType type);
   bool CheckIntraIdSection(size_t offset, uint32_t count, DexFile::MapItemType type);
   bool CheckIntraDataSection(size_t offset, uint32_t count, DexFile::MapItemType type);
+  // Checks the shared string data referenced by a dex file of a container and records it in
+  // offset_to_type_map_ so the inter-section checks accept those string ids.
+  bool CheckSharedStringData();
   bool CheckIntraSection();
 
   bool CheckOffsetToTypeMap(size_t offset, uint16_t type);
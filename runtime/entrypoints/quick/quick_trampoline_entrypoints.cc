@@ -15,6 +15,7 @@
  */
 
 #include "art_method-inl.h"
+#include "atomic.h"
 #include "base/enums.h"
 #include "callee_save_frame.h"
 #include "common_throws.h"
@@ -26,6 +27,7 @@
 #include "imt_conflict_table.h"
 #include "imtable-inl.h"
 #include "interpreter/interpreter.h"
+#include "jit/jit.h"
 #include "linear_alloc.h"
 #include "method_handles.h"
 #include "method_reference.h"
@@ -1700,6 +1702,84 @@ class ComputeNativeCallFrameSize {
   uint32_t num_stack_entries_;
 };
 
+// Global direct-mapped cache of the sizes that ComputeGenericJniFrameSize::Walk() computes. They
+// only depend on the argument types of the shorty and on whether the method is @CriticalNative,
+// and native methods that share a signature are common, so most GenericJNI calls skip the walk.
+//
+// The key is exact: the categories of up to kMaxArgs arguments, 3 bits each, the critical native
+// bit and a marker bit. An entry packs the key with the two sizes in one word, which threads read
+// and write with relaxed atomics and no lock. Shorties with more arguments are not cached.
+class GenericJniFrameSizeCache {
+ public:
+  static constexpr size_t kMaxArgs = 12;
+  // The number of entries, a power of two.
+  static constexpr size_t kSizeLog2 = 6;
+  static constexpr size_t kSize = 1u << kSizeLog2;
+
+  // Returns zero if the shorty has too many arguments to be cached.
+  static uint64_t GetKey(const char* shorty, uint32_t shorty_len, bool critical_native) {
+    if (shorty_len - 1u > kMaxArgs) {
+      return 0u;
+    }
+    uint64_t key = critical_native ? 3u : 2u;
+    for (uint32_t i = 1; i < shorty_len; ++i) {
+      key = (key << 3) | GetCategory(shorty[i]);
+    }
+    return key;
+  }
+
+  static bool Lookup(uint64_t key,
+                     /* out */ uint32_t* num_stack_entries,
+                     /* out */ uint32_t* num_handle_scope_references) {
+    const uint64_t entry = entries_[IndexOf(key)].LoadRelaxed();
+    if ((entry & kKeyMask) != key) {
+      return false;
+    }
+    *num_stack_entries = static_cast<uint32_t>((entry >> kStackEntriesShift) & 0xffu);
+    *num_handle_scope_references = static_cast<uint32_t>(entry >> kHandleScopeReferencesShift);
+    return true;
+  }
+
+  static void Insert(uint64_t key,
+                     uint32_t num_stack_entries,
+                     uint32_t num_handle_scope_references) {
+    DCHECK_NE(key, 0u);
+    if (num_stack_entries > 0xffu || num_handle_scope_references > 0xffu) {
+      return;
+    }
+    entries_[IndexOf(key)].StoreRelaxed(
+        key |
+        (static_cast<uint64_t>(num_stack_entries) << kStackEntriesShift) |
+        (static_cast<uint64_t>(num_handle_scope_references) << kHandleScopeReferencesShift));
+  }
+
+ private:
+  static constexpr size_t kStackEntriesShift = 40;
+  static constexpr size_t kHandleScopeReferencesShift = 48;
+  static constexpr uint64_t kKeyMask = (UINT64_C(1) << kStackEntriesShift) - 1u;
+  static_assert(2 + 3 * kMaxArgs <= kStackEntriesShift, "Key too wide");
+
+  // Arguments of the same category take the same registers and stack slots.
+  static uint64_t GetCategory(char shorty_char) {
+    switch (shorty_char) {
+      case 'L': return 1u;
+      case 'J': return 2u;
+      case 'F': return 3u;
+      case 'D': return 4u;
+      default: return 5u;  // ZBCSI.
+    }
+  }
+
+  static size_t IndexOf(uint64_t key) {
+    static constexpr uint64_t kGoldenRatio = UINT64_C(0x9e3779b97f4a7c15);
+    return static_cast<size_t>((key * kGoldenRatio) >> (64 - kSizeLog2));
+  }
+
+  static Atomic<uint64_t> entries_[kSize];
+};
+
+Atomic<uint64_t> GenericJniFrameSizeCache::entries_[GenericJniFrameSizeCache::kSize];
+
 class ComputeGenericJniFrameSize FINAL : public ComputeNativeCallFrameSize {
  public:
   explicit ComputeGenericJniFrameSize(bool critical_native)
@@ -1770,7 +1850,15 @@ class ComputeGenericJniFrameSize FINAL : public ComputeNativeCallFrameSize {
                          HandleScope** handle_scope, uintptr_t** start_stack, uintptr_t** start_gpr,
                          uint32_t** start_fpr)
       REQUIRES_SHARED(Locks::mutator_lock_) {
-    Walk(shorty, shorty_len);
+    const uint64_t key = GenericJniFrameSizeCache::GetKey(shorty, shorty_len, critical_native_);
+    if (key == 0u || !GenericJniFrameSizeCache::Lookup(key,
+                                                       &num_stack_entries_,
+                                                       &num_handle_scope_references_)) {
+      Walk(shorty, shorty_len);
+      if (key != 0u) {
+        GenericJniFrameSizeCache::Insert(key, num_stack_entries_, num_handle_scope_references_);
+      }
+    }
 
     // JNI part.
     uint8_t* sp8 = LayoutJNISaveFrame(self, m, reinterpret_cast<void*>(*m), handle_scope);
@@ -2106,6 +2194,12 @@ extern "C" TwoWordReturn artQuickGenericJniTrampoline(Thread* self, ArtMethod**
     self->ClearException();
   }
   bool normal_native = !critical_native && !fast_native;
+  // Count the call so that the JIT compiles a JNI stub for hot native methods, which then no
+  // longer come through here.
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit != nullptr) {
+    jit->AddSamples(self, called, 1, /* with_backedges */ false);
+  }
   // Restore the initial ArtMethod pointer at `*sp`.
   *sp = called;
 
@@ -2123,8 +2217,10 @@ extern "C" TwoWordReturn artQuickGenericJniTrampoline(Thread* self, ArtMethod**
     visitor.FinalizeHandleScope(self);
   }
 
-  // Fix up managed-stack things in Thread.
-  self->SetTopOfStack(sp);
+  // Fix up managed-stack things in Thread. After this the stack walk can't rely on the
+  // entrypoint of the method to recognize the GenericJNI frame, as it may be replaced by a
+  // JIT-compiled JNI stub while the native code runs, so tag the frame instead.
+  self->SetTopOfStackTagged(sp);
 
   self->VerifyStack();
 
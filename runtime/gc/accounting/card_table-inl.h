@@ -17,6 +17,14 @@
 #ifndef ART_RUNTIME_GC_ACCOUNTING_CARD_TABLE_INL_H_
 #define ART_RUNTIME_GC_ACCOUNTING_CARD_TABLE_INL_H_
 
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "atomic.h"
 #include "base/bit_utils.h"
 #include "base/logging.h"
@@ -49,6 +57,44 @@ static inline bool byte_cas(uint8_t old_value, uint8_t new_value, uint8_t* addre
 #endif
 }
 
+// Number of cards the scanning loops look at with a single vector test.
+static constexpr size_t kCardBlockSize = 32;
+static constexpr size_t kCardBlockWords = kCardBlockSize / sizeof(uintptr_t);
+
+// Returns true if all kCardBlockSize cards starting at cards are below minimum_age. May return
+// false negatives for ages above one when there are no vector instructions, the callers then
+// look at the cards one word at a time.
+static inline bool CardBlockIsBelowAge(const uint8_t* cards, uint8_t minimum_age) {
+  static_assert(kCardBlockSize == 32, "The vector code loads two 16 byte vectors");
+  if (minimum_age == 0) {
+    return false;
+  }
+#if defined(__SSE2__)
+  const __m128i* vectors = reinterpret_cast<const __m128i*>(cards);
+  const __m128i max = _mm_max_epu8(_mm_loadu_si128(vectors), _mm_loadu_si128(vectors + 1));
+  // Cards below minimum_age saturate to zero.
+  const __m128i over = _mm_subs_epu8(max, _mm_set1_epi8(static_cast<char>(minimum_age - 1)));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(over, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t max = vmaxq_u8(vld1q_u8(cards), vld1q_u8(cards + 16));
+  return vmaxvq_u8(max) < minimum_age;
+#elif defined(__ARM_NEON)
+  const uint8x16_t max16 = vmaxq_u8(vld1q_u8(cards), vld1q_u8(cards + 16));
+  uint8x8_t max8 = vmax_u8(vget_low_u8(max16), vget_high_u8(max16));
+  max8 = vpmax_u8(max8, max8);
+  max8 = vpmax_u8(max8, max8);
+  max8 = vpmax_u8(max8, max8);
+  return vget_lane_u8(max8, 0) < minimum_age;
+#else
+  const uintptr_t* words = reinterpret_cast<const uintptr_t*>(cards);
+  uintptr_t any = 0;
+  for (size_t i = 0; i < kCardBlockWords; ++i) {
+    any |= words[i];
+  }
+  return any == 0;
+#endif
+}
+
 template <bool kClearCard, typename Visitor>
 inline size_t CardTable::Scan(ContinuousSpaceBitmap* bitmap,
                               uint8_t* const scan_begin,
@@ -79,33 +125,37 @@ inline size_t CardTable::Scan(ContinuousSpaceBitmap* bitmap,
       (reinterpret_cast<uintptr_t>(card_end) & (sizeof(uintptr_t) - 1));
 
   uintptr_t* word_end = reinterpret_cast<uintptr_t*>(aligned_end);
-  for (uintptr_t* word_cur = reinterpret_cast<uintptr_t*>(card_cur); word_cur < word_end;
-      ++word_cur) {
-    while (LIKELY(*word_cur == 0)) {
-      ++word_cur;
-      if (UNLIKELY(word_cur >= word_end)) {
-        goto exit_for;
-      }
+  uintptr_t* word_cur = reinterpret_cast<uintptr_t*>(card_cur);
+  while (word_cur < word_end) {
+    // Skip whole blocks of cards that are too young to scan, most of a large table is clean.
+    const size_t block_words = std::min(kCardBlockWords, static_cast<size_t>(word_end - word_cur));
+    if (block_words == kCardBlockWords &&
+        CardBlockIsBelowAge(reinterpret_cast<uint8_t*>(word_cur), minimum_age)) {
+      word_cur += kCardBlockWords;
+      continue;
     }
-
-    // Find the first dirty card.
-    uintptr_t start_word = *word_cur;
-    uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(reinterpret_cast<uint8_t*>(word_cur)));
-    // TODO: Investigate if processing continuous runs of dirty cards with a single bitmap visit is
-    // more efficient.
-    for (size_t i = 0; i < sizeof(uintptr_t); ++i) {
-      if (static_cast<uint8_t>(start_word) >= minimum_age) {
-        auto* card = reinterpret_cast<uint8_t*>(word_cur) + i;
-        DCHECK(*card == static_cast<uint8_t>(start_word) || *card == kCardDirty)
-            << "card " << static_cast<size_t>(*card) << " intptr_t " << (start_word & 0xFF);
-        bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
-        ++cards_scanned;
+    for (uintptr_t* block_end = word_cur + block_words; word_cur < block_end; ++word_cur) {
+      uintptr_t start_word = *word_cur;
+      if (LIKELY(start_word == 0)) {
+        continue;
+      }
+      uintptr_t start =
+          reinterpret_cast<uintptr_t>(AddrFromCard(reinterpret_cast<uint8_t*>(word_cur)));
+      // TODO: Investigate if processing continuous runs of dirty cards with a single bitmap visit
+      // is more efficient.
+      for (size_t i = 0; i < sizeof(uintptr_t); ++i) {
+        if (static_cast<uint8_t>(start_word) >= minimum_age) {
+          auto* card = reinterpret_cast<uint8_t*>(word_cur) + i;
+          DCHECK(*card == static_cast<uint8_t>(start_word) || *card == kCardDirty)
+              << "card " << static_cast<size_t>(*card) << " intptr_t " << (start_word & 0xFF);
+          bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
+          ++cards_scanned;
+        }
+        start_word >>= 8;
+        start += kCardSize;
       }
-      start_word >>= 8;
-      start += kCardSize;
     }
   }
-  exit_for:
 
   // Handle any unaligned cards at the end.
   card_cur = reinterpret_cast<uint8_t*>(word_end);
@@ -184,6 +234,12 @@ inline void CardTable::ModifyCardsAtomic(uint8_t* scan_begin,
 
   // TODO: Parallelize.
   while (word_cur < word_end) {
+    // Clean cards stay clean, skip whole blocks of them.
+    if (static_cast<size_t>(word_end - word_cur) >= kCardBlockWords &&
+        CardBlockIsBelowAge(reinterpret_cast<uint8_t*>(word_cur), kCardClean + 1)) {
+      word_cur += kCardBlockWords;
+      continue;
+    }
     while (true) {
       expected_word = *word_cur;
       if (LIKELY(expected_word == 0)) {
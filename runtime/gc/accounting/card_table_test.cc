@@ -19,7 +19,9 @@
 #include <string>
 
 #include "atomic.h"
+#include "base/time_utils.h"
 #include "common_runtime_test.h"
+#include "gc/accounting/space_bitmap-inl.h"
 #include "handle_scope-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/string-inl.h"  // Strings are easiest to allocate
@@ -144,7 +146,113 @@ TEST_F(CardTableTest, TestModifyCardsAtomic) {
   }
 }
 
-// TODO: Add test for CardTable::Scan.
+class CountVisitor {
+ public:
+  explicit CountVisitor(size_t* count) : count_(count) {}
+  void operator()(mirror::Object* /*obj*/) const {
+    ++*count_;
+  }
+
+ private:
+  size_t* const count_;
+};
+
+class AgeVisitor {
+ public:
+  uint8_t operator()(uint8_t card) const {
+    return (card == CardTable::kCardDirty) ? card - 1 : 0;
+  }
+};
+
+// Dirty, aged or clean, mostly clean with runs longer than a scan block.
+static uint8_t SparseCard(size_t index) {
+  const size_t hash = (index * 2654435761u) >> 8;
+  if (hash % 97 == 0) {
+    return CardTable::kCardDirty;
+  }
+  if (hash % 89 == 0) {
+    return CardTable::kCardDirty - 1;
+  }
+  return CardTable::kCardClean;
+}
+
+TEST_F(CardTableTest, TestScan) {
+  CommonSetup();
+  std::unique_ptr<ContinuousSpaceBitmap> bitmap(ContinuousSpaceBitmap::Create(
+      "card table test bitmap", HeapBegin(), HeapLimit() - HeapBegin()));
+  ASSERT_TRUE(bitmap != nullptr);
+  // One marked object per card.
+  for (uint8_t* addr = HeapBegin(); addr < HeapLimit(); addr += CardTable::kCardSize) {
+    bitmap->Set(reinterpret_cast<mirror::Object*>(addr));
+  }
+  const uint8_t kAgedCard = CardTable::kCardDirty - 1;
+  for (uint8_t minimum_age : {CardTable::kCardDirty, kAgedCard}) {
+    // Vary the start and end so that the unaligned head and tail are covered.
+    for (size_t start_card = 0; start_card < 80; start_card += 7) {
+      for (size_t end_card = 0; end_card < 80; end_card += 11) {
+        uint8_t* start = HeapBegin() + start_card * CardTable::kCardSize;
+        uint8_t* end = HeapLimit() - end_card * CardTable::kCardSize;
+        size_t expected = 0;
+        for (uint8_t* addr = start; addr < end; addr += CardTable::kCardSize) {
+          const size_t index = (addr - HeapBegin()) / CardTable::kCardSize;
+          *card_table_->CardFromAddr(addr) = SparseCard(index);
+          if (SparseCard(index) >= minimum_age) {
+            ++expected;
+          }
+        }
+        size_t visited = 0;
+        size_t scanned = card_table_->Scan<false>(bitmap.get(), start, end,
+                                                  CountVisitor(&visited), minimum_age);
+        EXPECT_EQ(expected, scanned);
+        EXPECT_EQ(expected, visited);
+        ClearCardTable();
+      }
+    }
+  }
+}
+
+// Throughput of scanning and aging a sparsely dirty card table covering a large heap.
+TEST_F(CardTableTest, ScanBenchmark) {
+  static constexpr size_t kHeapSize = 256 * MB;
+  static constexpr size_t kIterations = 10;
+  uint8_t* const heap_begin = HeapBegin();
+  std::unique_ptr<CardTable> card_table(CardTable::Create(heap_begin, kHeapSize));
+  ASSERT_TRUE(card_table != nullptr);
+  std::unique_ptr<ContinuousSpaceBitmap> bitmap(
+      ContinuousSpaceBitmap::Create("card table benchmark bitmap", heap_begin, kHeapSize));
+  ASSERT_TRUE(bitmap != nullptr);
+  const size_t num_cards = kHeapSize / CardTable::kCardSize;
+  size_t expected = 0;
+  for (size_t i = 0; i < num_cards; ++i) {
+    uint8_t* addr = heap_begin + i * CardTable::kCardSize;
+    bitmap->Set(reinterpret_cast<mirror::Object*>(addr));
+    *card_table->CardFromAddr(addr) = SparseCard(i);
+    if (SparseCard(i) == CardTable::kCardDirty) {
+      ++expected;
+    }
+  }
+  uint64_t start_time = NanoTime();
+  for (size_t i = 0; i < kIterations; ++i) {
+    size_t visited = 0;
+    size_t scanned = card_table->Scan<false>(bitmap.get(), heap_begin, heap_begin + kHeapSize,
+                                             CountVisitor(&visited), CardTable::kCardDirty);
+    EXPECT_EQ(expected, scanned);
+  }
+  const uint64_t scan_ns = NanoTime() - start_time;
+  start_time = NanoTime();
+  for (size_t i = 0; i < kIterations; ++i) {
+    // After the first pass this only ages aged cards to clean and then skips clean ones.
+    card_table->ModifyCardsAtomic(heap_begin, heap_begin + kHeapSize, AgeVisitor(), VoidFunctor());
+  }
+  const uint64_t age_ns = NanoTime() - start_time;
+  LOG(INFO) << "Scanned " << num_cards * kIterations << " cards in " << PrettyDuration(scan_ns)
+            << ", aged them in " << PrettyDuration(age_ns);
+  for (size_t i = 0; i < num_cards; ++i) {
+    ASSERT_EQ(*card_table->CardFromAddr(heap_begin + i * CardTable::kCardSize),
+              CardTable::kCardClean);
+  }
+}
+
 }  // namespace accounting
 }  // namespace gc
 }  // namespace art
@@ -81,7 +81,7 @@ class ReadBarrierTable {
     return true;
   }
 
-  // This should match RegionSpace::kRegionSize. static_assert'ed in concurrent_copying.h.
+  // This should match the RegionSpace region size. CHECK'ed when the region space is created.
   static constexpr size_t kRegionSize = 256 * KB;
 
  private:
@@ -16,6 +16,10 @@
 
 #include "allocation_record.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "art_method-inl.h"
 #include "base/enums.h"
 #include "base/stl_util.h"
@@ -90,6 +94,19 @@ void AllocRecordObjectMap::SetProperties() {
       max_stack_depth_ = value;
     }
   }
+  // Check whether there's a system property asking to sample allocations.
+  propertyName = "dalvik.vm.allocTrackerSampleBytes";
+  char sampleBytesString[PROPERTY_VALUE_MAX];
+  if (property_get(propertyName, sampleBytesString, "") > 0) {
+    char* end;
+    size_t value = strtoul(sampleBytesString, &end, 10);
+    if (*end != '\0') {
+      LOG(ERROR) << "Ignoring  " << propertyName << " '" << sampleBytesString
+                 << "' --- invalid";
+    } else {
+      SetSampleIntervalBytes(value);
+    }
+  }
 #endif  // ART_TARGET_ANDROID
 }
 
@@ -117,6 +134,15 @@ void AllocRecordObjectMap::VisitRoots(RootVisitor* visitor) {
       element.GetMethod()->VisitRoots(buffered_visitor, kRuntimePointerSize);
     }
   }
+  // The sampled call sites keep their methods alive the same way.
+  for (const auto& pair : call_sites_) {
+    const AllocRecordStackTrace& trace = pair.first;
+    for (size_t i = 0, depth = trace.GetDepth(); i < depth; ++i) {
+      const AllocRecordStackTraceElement& element = trace.GetStackElement(i);
+      DCHECK(element.GetMethod() != nullptr);
+      element.GetMethod()->VisitRoots(buffered_visitor, kRuntimePointerSize);
+    }
+  }
 }
 
 static inline void SweepClassObject(AllocRecord* record, IsMarkedVisitor* visitor)
@@ -212,7 +238,7 @@ class AllocRecordStackVisitor : public StackVisitor {
   AllocRecordStackTrace* const trace_;
 };
 
-void AllocRecordObjectMap::SetAllocTrackingEnabled(bool enable) {
+void AllocRecordObjectMap::SetAllocTrackingEnabled(bool enable, size_t sample_interval_bytes) {
   Thread* self = Thread::Current();
   Heap* heap = Runtime::Current()->GetHeap();
   if (enable) {
@@ -228,6 +254,9 @@ void AllocRecordObjectMap::SetAllocTrackingEnabled(bool enable) {
       }
       CHECK(records != nullptr);
       records->SetProperties();
+      if (sample_interval_bytes != 0u) {
+        records->SetSampleIntervalBytes(sample_interval_bytes);
+      }
       std::string self_name;
       self->GetThreadName(self_name);
       if (self_name == "JDWP") {
@@ -238,6 +267,20 @@ void AllocRecordObjectMap::SetAllocTrackingEnabled(bool enable) {
       LOG(INFO) << "Enabling alloc tracker (" << records->alloc_record_max_ << " entries of "
                 << records->max_stack_depth_ << " frames, taking up to "
                 << PrettySize(sz * records->alloc_record_max_) << ")";
+      if (records->GetSampleIntervalBytes() != 0u) {
+        LOG(INFO) << "Sampling one allocation every "
+                  << PrettySize(records->GetSampleIntervalBytes()) << " per thread";
+      }
+      // Sampling hooks the TLAB refill slow path, which the uninstrumented entrypoints reach once
+      // a thread allocates up to its next sample point. The other allocators have thread-local
+      // fast paths that never leave the entrypoints, and only the CC collector's region TLAB
+      // allocator is guaranteed not to change while tracking is on.
+      records->instrumented_entrypoints_ = records->GetSampleIntervalBytes() == 0u ||
+          heap->GetCurrentAllocator() != kAllocatorTypeRegionTLAB;
+      if (!records->instrumented_entrypoints_) {
+        heap->SetAllocTrackingEnabled(true);
+        return;
+      }
     }
     Runtime::Current()->GetInstrumentation()->InstrumentQuickAllocEntryPoints();
     {
@@ -247,6 +290,7 @@ void AllocRecordObjectMap::SetAllocTrackingEnabled(bool enable) {
   } else {
     // Delete outside of the critical section to avoid possible lock violations like the runtime
     // shutdown lock.
+    bool instrumented_entrypoints;
     {
       MutexLock mu(self, *Locks::alloc_tracker_lock_);
       if (!heap->IsAllocTrackingEnabled()) {
@@ -256,15 +300,30 @@ void AllocRecordObjectMap::SetAllocTrackingEnabled(bool enable) {
       LOG(INFO) << "Disabling alloc tracker";
       AllocRecordObjectMap* records = heap->GetAllocationRecords();
       records->Clear();
+      instrumented_entrypoints = records->instrumented_entrypoints_;
+      records->instrumented_entrypoints_ = false;
     }
     // If an allocation comes in before we uninstrument, we will safely drop it on the floor.
-    Runtime::Current()->GetInstrumentation()->UninstrumentQuickAllocEntryPoints();
+    if (instrumented_entrypoints) {
+      Runtime::Current()->GetInstrumentation()->UninstrumentQuickAllocEntryPoints();
+    }
   }
 }
 
 void AllocRecordObjectMap::RecordAllocation(Thread* self,
                                             ObjPtr<mirror::Object>* obj,
                                             size_t byte_count) {
+  // When sampling, skip the allocation before doing any work unless an allocation slow path
+  // flagged it as reaching the thread's sample point, see Heap::CountAllocationForSampling.
+  const size_t sample_interval = GetSampleIntervalBytes();
+  if (sample_interval != 0u) {
+    Thread::AllocSampleState* sample_state = self->GetAllocSampleState();
+    if (!sample_state->sample_pending) {
+      return;
+    }
+    sample_state->sample_pending = false;
+  }
+
   // Get stack trace outside of lock in case there are allocations during the stack walk.
   // b/27858645.
   AllocRecordStackTrace trace;
@@ -304,6 +363,15 @@ void AllocRecordObjectMap::RecordAllocation(Thread* self,
 
   DCHECK_LE(Size(), alloc_record_max_);
 
+  if (sample_interval != 0u) {
+    // Aggregate the sample with the ones taken at the same call site by any thread.
+    AllocRecordCallSite& call_site = call_sites_[trace];
+    ++call_site.samples;
+    call_site.sampled_bytes += byte_count;
+    call_site.estimated_bytes += static_cast<size_t>(
+        byte_count / -std::expm1(-static_cast<double>(byte_count) / sample_interval));
+  }
+
   // Erase extra unfilled elements.
   trace.SetTid(self->GetTid());
 
@@ -314,10 +382,52 @@ void AllocRecordObjectMap::RecordAllocation(Thread* self,
 
 void AllocRecordObjectMap::Clear() {
   entries_.clear();
+  call_sites_.clear();
+}
+
+void AllocRecordObjectMap::SetSampleIntervalBytes(size_t bytes) {
+  if (bytes != GetSampleIntervalBytes()) {
+    // Samples taken with another interval are not comparable.
+    call_sites_.clear();
+    sample_interval_bytes_.StoreRelaxed(bytes);
+  }
+}
+
+void AllocRecordObjectMap::DumpCallSites(std::ostream& os, size_t max_call_sites) const {
+  if (GetSampleIntervalBytes() == 0u) {
+    return;
+  }
+  std::vector<const CallSiteMap::value_type*> sorted;
+  sorted.reserve(call_sites_.size());
+  size_t total_estimated_bytes = 0u;
+  for (const auto& pair : call_sites_) {
+    sorted.push_back(&pair);
+    total_estimated_bytes += pair.second.estimated_bytes;
+  }
+  std::sort(sorted.begin(),
+            sorted.end(),
+            [](const CallSiteMap::value_type* lhs, const CallSiteMap::value_type* rhs) {
+              return lhs->second.estimated_bytes > rhs->second.estimated_bytes;
+            });
+  os << "Sampled allocations: " << call_sites_.size() << " call sites, "
+     << PrettySize(total_estimated_bytes) << " estimated, one sample every "
+     << PrettySize(GetSampleIntervalBytes()) << " per thread\n";
+  for (size_t i = 0, count = std::min(max_call_sites, sorted.size()); i != count; ++i) {
+    const AllocRecordStackTrace& trace = sorted[i]->first;
+    const AllocRecordCallSite& call_site = sorted[i]->second;
+    os << "  " << PrettySize(call_site.estimated_bytes) << " estimated in "
+       << call_site.samples << " samples (" << PrettySize(call_site.sampled_bytes) << ")\n";
+    for (size_t j = 0, depth = trace.GetDepth(); j < depth; ++j) {
+      const AllocRecordStackTraceElement& element = trace.GetStackElement(j);
+      os << "    at " << element.GetMethod()->PrettyMethod() << " (dex_pc "
+         << element.GetDexPc() << ")\n";
+    }
+  }
 }
 
 AllocRecordObjectMap::AllocRecordObjectMap()
-    : new_record_condition_("New allocation record condition", *Locks::alloc_tracker_lock_) {}
+    : new_record_condition_("New allocation record condition", *Locks::alloc_tracker_lock_),
+      sample_interval_bytes_(0u) {}
 
 }  // namespace gc
 }  // namespace art
@@ -19,7 +19,10 @@
 
 #include <list>
 #include <memory>
+#include <ostream>
+#include <unordered_map>
 
+#include "atomic.h"
 #include "base/mutex.h"
 #include "obj_ptr.h"
 #include "object_callbacks.h"
@@ -153,6 +156,17 @@ template <typename T> struct EqAllocRecordTypesPtr {
   }
 };
 
+// Allocations sampled at one call site, aggregated over all threads.
+struct AllocRecordCallSite {
+  // Number of allocations sampled at the call site.
+  size_t samples = 0;
+  // Sum of the sizes of the sampled allocations.
+  size_t sampled_bytes = 0;
+  // Estimate of the bytes allocated at the call site. An allocation of s bytes is sampled with
+  // probability 1 - exp(-s / interval), so each sample stands for s divided by that.
+  size_t estimated_bytes = 0;
+};
+
 class AllocRecord {
  public:
   // All instances of AllocRecord should be managed by an instance of AllocRecordObjectMap.
@@ -207,6 +221,9 @@ class AllocRecordObjectMap {
   // Both types of pointers need read barriers, do not directly access them.
   using EntryPair = std::pair<GcRoot<mirror::Object>, AllocRecord>;
   typedef std::list<EntryPair> EntryList;
+  // Sampled call sites, keyed by stack traces without a thread id.
+  using CallSiteMap =
+      std::unordered_map<AllocRecordStackTrace, AllocRecordCallSite, HashAllocRecordTypes>;
 
   // Caller needs to check that it is enabled before calling since we read the stack trace before
   // checking the enabled boolean.
@@ -216,7 +233,12 @@ class AllocRecordObjectMap {
       REQUIRES(!Locks::alloc_tracker_lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
-  static void SetAllocTrackingEnabled(bool enabled) REQUIRES(!Locks::alloc_tracker_lock_);
+  // When enabling with a non-zero sample_interval_bytes, or with the
+  // dalvik.vm.allocTrackerSampleBytes property set, only sampled allocations are recorded, on
+  // average one for every sample_interval_bytes allocated by a thread. With the region TLAB
+  // allocator sampling keeps the uninstrumented allocation entrypoints.
+  static void SetAllocTrackingEnabled(bool enabled, size_t sample_interval_bytes = 0u)
+      REQUIRES(!Locks::alloc_tracker_lock_);
 
   AllocRecordObjectMap() REQUIRES(Locks::alloc_tracker_lock_);
   ~AllocRecordObjectMap();
@@ -290,11 +312,27 @@ class AllocRecordObjectMap {
 
   void Clear() REQUIRES(Locks::alloc_tracker_lock_);
 
+  // Mean number of bytes a thread allocates between two sampled allocations, zero when every
+  // allocation is recorded.
+  size_t GetSampleIntervalBytes() const {
+    return sample_interval_bytes_.LoadRelaxed();
+  }
+
+  const CallSiteMap& GetCallSites() const REQUIRES(Locks::alloc_tracker_lock_) {
+    return call_sites_;
+  }
+
+  // Dump the `max_call_sites` sampled call sites with the most estimated bytes.
+  void DumpCallSites(std::ostream& os, size_t max_call_sites = kDefaultNumDumpedCallSites) const
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(Locks::alloc_tracker_lock_);
+
  private:
   static constexpr size_t kDefaultNumAllocRecords = 512 * 1024;
   static constexpr size_t kDefaultNumRecentRecords = 64 * 1024 - 1;
   static constexpr size_t kDefaultAllocStackDepth = 16;
   static constexpr size_t kMaxSupportedStackDepth = 128;
+  static constexpr size_t kDefaultNumDumpedCallSites = 32;
   size_t alloc_record_max_ GUARDED_BY(Locks::alloc_tracker_lock_) = kDefaultNumAllocRecords;
   size_t recent_record_max_ GUARDED_BY(Locks::alloc_tracker_lock_) = kDefaultNumRecentRecords;
   size_t max_stack_depth_ = kDefaultAllocStackDepth;
@@ -303,8 +341,16 @@ class AllocRecordObjectMap {
   ConditionVariable new_record_condition_ GUARDED_BY(Locks::alloc_tracker_lock_);
   // see the comment in typedef of EntryList
   EntryList entries_ GUARDED_BY(Locks::alloc_tracker_lock_);
+  // Read without the lock by RecordAllocation() to skip unsampled allocations.
+  Atomic<size_t> sample_interval_bytes_;
+  CallSiteMap call_sites_ GUARDED_BY(Locks::alloc_tracker_lock_);
+  // Whether enabling tracking instrumented the allocation entrypoints.
+  bool instrumented_entrypoints_ GUARDED_BY(Locks::alloc_tracker_lock_) = false;
 
   void SetProperties() REQUIRES(Locks::alloc_tracker_lock_);
+  // Samples allocations instead of recording every one, zero disables sampling. Sampled
+  // allocations are also aggregated per call site.
+  void SetSampleIntervalBytes(size_t bytes) REQUIRES(Locks::alloc_tracker_lock_);
 };
 
 }  // namespace gc
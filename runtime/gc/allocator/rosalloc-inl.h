@@ -100,11 +100,14 @@ inline void* RosAlloc::AllocFromThreadLocalRun(Thread* self, size_t size,
 }
 
 inline size_t RosAlloc::MaxBytesBulkAllocatedFor(size_t size) {
-  if (UNLIKELY(!IsSizeForThreadLocal(size))) {
+  if (UNLIKELY(size > kLargeSizeThreshold)) {
     return size;
   }
   size_t bracket_size;
   size_t idx = SizeToIndexAndBracketSize(size, &bracket_size);
+  if (UNLIKELY(idx >= num_thread_local_size_brackets_)) {
+    return size;
+  }
   return numOfSlots[idx] * bracket_size;
 }
 
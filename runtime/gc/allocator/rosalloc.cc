@@ -16,6 +16,8 @@
 
 #include "rosalloc.h"
 
+#include <sched.h>
+
 #include <map>
 #include <list>
 #include <sstream>
@@ -26,6 +28,7 @@
 #include "base/memory_tool.h"
 #include "base/mutex-inl.h"
 #include "gc/space/memory_tool_settings.h"
+#include "gc/trim_budget.h"
 #include "mem_map.h"
 #include "mirror/class-inl.h"
 #include "mirror/object.h"
@@ -61,7 +64,9 @@ RosAlloc::RosAlloc(void* base, size_t capacity, size_t max_capacity,
       bulk_free_lock_("rosalloc bulk free lock", kRosAllocBulkFreeLock),
       page_release_mode_(page_release_mode),
       page_release_size_threshold_(page_release_size_threshold),
-      is_running_on_memory_tool_(running_on_memory_tool) {
+      is_running_on_memory_tool_(running_on_memory_tool),
+      release_pages_cursor_(0),
+      num_thread_local_size_brackets_(kNumThreadLocalSizeBrackets) {
   DCHECK_ALIGNED(base, kPageSize);
   DCHECK_EQ(RoundUp(capacity, kPageSize), capacity);
   DCHECK_EQ(RoundUp(max_capacity, kPageSize), max_capacity);
@@ -648,6 +653,20 @@ void* RosAlloc::AllocFromRunThreadUnsafe(Thread* self, size_t size, size_t* byte
   return slot_addr;
 }
 
+inline bool RosAlloc::UseThreadLocalRun(Thread* self, size_t idx) {
+  if (LIKELY(idx < kNumThreadLocalSizeBrackets)) {
+    return true;
+  }
+  if (idx >= num_thread_local_size_brackets_) {
+    return false;
+  }
+  const uint8_t allocations = self->IncrementRosAllocBracketAllocations(idx);
+  // Keep using the shared run until the thread has shown that it allocates this size often, so
+  // that threads don't sit on mostly empty runs of the sizes they rarely use.
+  return self->GetRosAllocRun(idx) != dedicated_full_run_ ||
+      allocations >= kThreadLocalRunPromotionAllocations;
+}
+
 void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated,
                              size_t* usable_size, size_t* bytes_tl_bulk_allocated) {
   DCHECK(bytes_allocated != nullptr);
@@ -657,7 +676,7 @@ void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated,
   size_t bracket_size;
   size_t idx = SizeToIndexAndBracketSize(size, &bracket_size);
   void* slot_addr;
-  if (LIKELY(idx < kNumThreadLocalSizeBrackets)) {
+  if (LIKELY(UseThreadLocalRun(self, idx))) {
     // Use a thread-local run.
     Run* thread_local_run = reinterpret_cast<Run*>(self->GetRosAllocRun(idx));
     // Allow invalid since this will always fail the allocation.
@@ -701,6 +720,11 @@ void* RosAlloc::AllocFromRun(Thread* self, size_t size, size_t* bytes_allocated,
           DCHECK(full_runs_[idx].find(thread_local_run) != full_runs_[idx].end());
         }
 
+        if (idx >= kNumThreadLocalSizeBrackets && thread_local_run == dedicated_full_run_) {
+          // The thread gets its first run of an optional bracket. Count from here on to tell
+          // whether it goes idle.
+          self->ResetRosAllocBracketAllocations(idx);
+        }
         thread_local_run = RefillRun(self, idx);
         if (UNLIKELY(thread_local_run == nullptr)) {
           self->SetRosAllocRun(idx, dedicated_full_run_);
@@ -769,7 +793,7 @@ size_t RosAlloc::FreeFromRun(Thread* self, void* ptr, Run* run) {
   }
   if (LIKELY(run->IsThreadLocal())) {
     // It's a thread-local run. Just mark the thread-local free bit map and return.
-    DCHECK_LT(run->size_bracket_idx_, kNumThreadLocalSizeBrackets);
+    DCHECK_LT(run->size_bracket_idx_, num_thread_local_size_brackets_);
     DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
     DCHECK(full_runs_[idx].find(run) == full_runs_[idx].end());
     run->AddToThreadLocalFreeList(ptr);
@@ -1103,7 +1127,7 @@ size_t RosAlloc::BulkFree(Thread* self, void** ptrs, size_t num_ptrs) {
     size_t idx = run->size_bracket_idx_;
     MutexLock brackets_mu(self, *size_bracket_locks_[idx]);
     if (run->IsThreadLocal()) {
-      DCHECK_LT(run->size_bracket_idx_, kNumThreadLocalSizeBrackets);
+      DCHECK_LT(run->size_bracket_idx_, num_thread_local_size_brackets_);
       DCHECK(non_full_runs_[idx].find(run) == non_full_runs_[idx].end());
       DCHECK(full_runs_[idx].find(run) == full_runs_[idx].end());
       run->MergeBulkFreeListToThreadLocalFreeList();
@@ -1506,38 +1530,68 @@ void RosAlloc::SetFootprintLimit(size_t new_capacity) {
 size_t RosAlloc::RevokeThreadLocalRuns(Thread* thread) {
   Thread* self = Thread::Current();
   size_t free_bytes = 0U;
-  for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; idx++) {
+  for (size_t idx = 0; idx < num_thread_local_size_brackets_; idx++) {
     MutexLock mu(self, *size_bracket_locks_[idx]);
-    Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(idx));
-    CHECK(thread_local_run != nullptr);
-    // Invalid means already revoked.
-    DCHECK(thread_local_run->IsThreadLocal());
-    if (thread_local_run != dedicated_full_run_) {
-      // Note the thread local run may not be full here.
-      thread->SetRosAllocRun(idx, dedicated_full_run_);
-      DCHECK_EQ(thread_local_run->magic_num_, kMagicNum);
-      // Count the number of free slots left.
-      size_t num_free_slots = thread_local_run->NumberOfFreeSlots();
-      free_bytes += num_free_slots * bracketSizes[idx];
-      // The above bracket index lock guards thread local free list to avoid race condition
-      // with unioning bulk free list to thread local free list by GC thread in BulkFree.
-      // If thread local run is true, GC thread will help update thread local free list
-      // in BulkFree. And the latest thread local free list will be merged to free list
-      // either when this thread local run is full or when revoking this run here. In this
-      // case the free list wll be updated. If thread local run is false, GC thread will help
-      // merge bulk free list in next BulkFree.
-      // Thus no need to merge bulk free list to free list again here.
-      bool dont_care;
-      thread_local_run->MergeThreadLocalFreeListToFreeList(&dont_care);
-      thread_local_run->SetIsThreadLocal(false);
-      DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
-      DCHECK(full_runs_[idx].find(thread_local_run) == full_runs_[idx].end());
-      RevokeRun(self, idx, thread_local_run);
+    free_bytes += RevokeThreadLocalRun(self, thread, idx);
+    if (idx >= kNumThreadLocalSizeBrackets) {
+      thread->ResetRosAllocBracketAllocations(idx);
+    }
+  }
+  return free_bytes;
+}
+
+size_t RosAlloc::RevokeIdleThreadLocalRuns(Thread* thread) {
+  Thread* self = Thread::Current();
+  size_t free_bytes = 0U;
+  for (size_t idx = kNumThreadLocalSizeBrackets; idx < num_thread_local_size_brackets_; idx++) {
+    if (thread->GetRosAllocBracketAllocations(idx) == 0) {
+      MutexLock mu(self, *size_bracket_locks_[idx]);
+      free_bytes += RevokeThreadLocalRun(self, thread, idx);
     }
+    thread->ResetRosAllocBracketAllocations(idx);
   }
   return free_bytes;
 }
 
+size_t RosAlloc::RevokeThreadLocalRun(Thread* self, Thread* thread, size_t idx) {
+  size_bracket_locks_[idx]->AssertHeld(self);
+  Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(idx));
+  CHECK(thread_local_run != nullptr);
+  // Invalid means already revoked.
+  DCHECK(thread_local_run->IsThreadLocal());
+  if (thread_local_run == dedicated_full_run_) {
+    return 0U;
+  }
+  // Note the thread local run may not be full here.
+  thread->SetRosAllocRun(idx, dedicated_full_run_);
+  DCHECK_EQ(thread_local_run->magic_num_, kMagicNum);
+  // Count the number of free slots left.
+  size_t num_free_slots = thread_local_run->NumberOfFreeSlots();
+  // The above bracket index lock guards thread local free list to avoid race condition
+  // with unioning bulk free list to thread local free list by GC thread in BulkFree.
+  // If thread local run is true, GC thread will help update thread local free list
+  // in BulkFree. And the latest thread local free list will be merged to free list
+  // either when this thread local run is full or when revoking this run here. In this
+  // case the free list wll be updated. If thread local run is false, GC thread will help
+  // merge bulk free list in next BulkFree.
+  // Thus no need to merge bulk free list to free list again here.
+  bool dont_care;
+  thread_local_run->MergeThreadLocalFreeListToFreeList(&dont_care);
+  thread_local_run->SetIsThreadLocal(false);
+  DCHECK(non_full_runs_[idx].find(thread_local_run) == non_full_runs_[idx].end());
+  DCHECK(full_runs_[idx].find(thread_local_run) == full_runs_[idx].end());
+  RevokeRun(self, idx, thread_local_run);
+  return num_free_slots * bracketSizes[idx];
+}
+
+void RosAlloc::SetMaxThreadLocalBracketSize(size_t size) {
+  size_t num_brackets = kNumThreadLocalSizeBrackets;
+  while (num_brackets < kMaxNumThreadLocalSizeBrackets && bracketSizes[num_brackets] <= size) {
+    ++num_brackets;
+  }
+  num_thread_local_size_brackets_ = num_brackets;
+}
+
 void RosAlloc::RevokeRun(Thread* self, size_t idx, Run* run) {
   size_bracket_locks_[idx]->AssertHeld(self);
   DCHECK(run != dedicated_full_run_);
@@ -1597,7 +1651,7 @@ void RosAlloc::AssertThreadLocalRunsAreRevoked(Thread* thread) {
     Thread* self = Thread::Current();
     // Avoid race conditions on the bulk free bit maps with BulkFree() (GC).
     ReaderMutexLock wmu(self, bulk_free_lock_);
-    for (size_t idx = 0; idx < kNumThreadLocalSizeBrackets; idx++) {
+    for (size_t idx = 0; idx < num_thread_local_size_brackets_; idx++) {
       MutexLock mu(self, *size_bracket_locks_[idx]);
       Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(idx));
       DCHECK(thread_local_run == nullptr || thread_local_run == dedicated_full_run_);
@@ -1840,7 +1894,7 @@ void RosAlloc::Verify() {
   }
   std::list<Thread*> threads = Runtime::Current()->GetThreadList()->GetList();
   for (Thread* thread : threads) {
-    for (size_t i = 0; i < kNumThreadLocalSizeBrackets; ++i) {
+    for (size_t i = 0; i < num_thread_local_size_brackets_; ++i) {
       MutexLock brackets_mu(self, *size_bracket_locks_[i]);
       Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(i));
       CHECK(thread_local_run != nullptr);
@@ -1884,7 +1938,7 @@ void RosAlloc::Run::Verify(Thread* self, RosAlloc* rosalloc, bool running_on_mem
     std::list<Thread*> thread_list = Runtime::Current()->GetThreadList()->GetList();
     for (auto it = thread_list.begin(); it != thread_list.end(); ++it) {
       Thread* thread = *it;
-      for (size_t i = 0; i < kNumThreadLocalSizeBrackets; i++) {
+      for (size_t i = 0; i < rosalloc->num_thread_local_size_brackets_; i++) {
         MutexLock mu(self, *rosalloc->size_bracket_locks_[i]);
         Run* thread_local_run = reinterpret_cast<Run*>(thread->GetRosAllocRun(i));
         if (thread_local_run == this) {
@@ -1977,12 +2031,17 @@ void RosAlloc::Run::Verify(Thread* self, RosAlloc* rosalloc, bool running_on_mem
   }
 }
 
-size_t RosAlloc::ReleasePages() {
+size_t RosAlloc::ReleasePages(TrimBudget* budget) {
   VLOG(heap) << "RosAlloc::ReleasePages()";
   DCHECK(!DoesReleaseAllPages());
   Thread* self = Thread::Current();
   size_t reclaimed_bytes = 0;
   size_t i = 0;
+  if (budget != nullptr) {
+    // Resume the pass that an earlier call did not finish.
+    i = release_pages_cursor_;
+    release_pages_cursor_ = 0;
+  }
   // Check the page map size which might have changed due to grow/shrink.
   while (i < page_map_size_) {
     // Reading the page map without a lock is racy but the race is benign since it should only
@@ -1992,31 +2051,52 @@ size_t RosAlloc::ReleasePages() {
       case kPageMapReleased:
         // Fall through.
       case kPageMapEmpty: {
-        // This is currently the start of a free page run.
-        // Acquire the lock to prevent other threads racing in and modifying the page map.
-        MutexLock mu(self, lock_);
-        // Check that it's still empty after we acquired the lock since another thread could have
-        // raced in and placed an allocation here.
-        if (IsFreePage(i)) {
-          // Free page runs can start with a released page if we coalesced a released page free
-          // page run with an empty page run.
-          FreePageRun* fpr = reinterpret_cast<FreePageRun*>(base_ + i * kPageSize);
-          // There is a race condition where FreePage can coalesce fpr with the previous
-          // free page run before we acquire lock_. In that case free_page_runs_.find will not find
-          // a run starting at fpr. To handle this race, we skip reclaiming the page range and go
-          // to the next page.
-          if (free_page_runs_.find(fpr) != free_page_runs_.end()) {
-            size_t fpr_size = fpr->ByteSize(this);
-            DCHECK_ALIGNED(fpr_size, kPageSize);
-            uint8_t* start = reinterpret_cast<uint8_t*>(fpr);
-            reclaimed_bytes += ReleasePageRange(start, start + fpr_size);
-            size_t pages = fpr_size / kPageSize;
-            CHECK_GT(pages, 0U) << "Infinite loop probable";
-            i += pages;
-            DCHECK_LE(i, page_map_size_);
-            break;
+        size_t batch_bytes = 0;
+        {
+          // This is currently the start of a free page run.
+          // Acquire the lock to prevent other threads racing in and modifying the page map.
+          MutexLock mu(self, lock_);
+          // Check that it's still empty after we acquired the lock since another thread could
+          // have raced in and placed an allocation here.
+          if (IsFreePage(i)) {
+            // Free page runs can start with a released page if we coalesced a released page free
+            // page run with an empty page run.
+            FreePageRun* fpr = reinterpret_cast<FreePageRun*>(base_ + i * kPageSize);
+            // There is a race condition where FreePage can coalesce fpr with the previous
+            // free page run before we acquire lock_. In that case free_page_runs_.find will not
+            // find a run starting at fpr. To handle this race, we skip reclaiming the page range
+            // and go to the next page.
+            if (free_page_runs_.find(fpr) != free_page_runs_.end()) {
+              size_t fpr_size = fpr->ByteSize(this);
+              DCHECK_ALIGNED(fpr_size, kPageSize);
+              if (budget != nullptr) {
+                batch_bytes = ReleaseFreePageRunTail(fpr, budget->BatchBytes(), &reclaimed_bytes);
+              }
+              if (batch_bytes == 0) {
+                if (budget == nullptr) {
+                  uint8_t* start = reinterpret_cast<uint8_t*>(fpr);
+                  reclaimed_bytes += ReleasePageRange(start, start + fpr_size);
+                }
+                size_t pages = fpr_size / kPageSize;
+                CHECK_GT(pages, 0U) << "Infinite loop probable";
+                i += pages;
+                DCHECK_LE(i, page_map_size_);
+                break;
+              }
+            }
           }
         }
+        if (batch_bytes != 0) {
+          // Stay on this run, the next batch comes from the pages in front of this one. Let the
+          // threads waiting for the lock in before taking it again.
+          budget->AddReleasedBytes(batch_bytes);
+          if (budget->IsExhausted()) {
+            release_pages_cursor_ = i;
+            return reclaimed_bytes;
+          }
+          sched_yield();
+          break;
+        }
         FALLTHROUGH_INTENDED;
       }
       case kPageMapLargeObject:      // Fall through.
@@ -2047,6 +2127,36 @@ size_t RosAlloc::ReleasePageRange(uint8_t* start, uint8_t* end) {
       return 0;
     }
   }
+  return ReleaseFreePages(start, end);
+}
+
+size_t RosAlloc::ReleaseFreePageRunTail(FreePageRun* fpr,
+                                        size_t batch_bytes,
+                                        size_t* reclaimed_bytes) {
+  uint8_t* const start = reinterpret_cast<uint8_t*>(fpr);
+  // In the debug build the first page holds the magic number and is never released.
+  uint8_t* const first_releasable = kIsDebugBuild ? start + kPageSize : start;
+  uint8_t* end = start + fpr->ByteSize(this);
+  // Skip the tail released by the previous batches.
+  while (end > first_releasable &&
+         page_map_[ToPageMapIndex(end - kPageSize)] == kPageMapReleased) {
+    end -= kPageSize;
+  }
+  if (end <= first_releasable) {
+    return 0;
+  }
+  const size_t max_bytes = std::max(RoundDown(batch_bytes, kPageSize), kPageSize);
+  uint8_t* const begin = static_cast<size_t>(end - first_releasable) > max_bytes
+      ? end - max_bytes
+      : first_releasable;
+  *reclaimed_bytes += ReleaseFreePages(begin, end);
+  return end - begin;
+}
+
+size_t RosAlloc::ReleaseFreePages(uint8_t* start, uint8_t* end) {
+  DCHECK_ALIGNED(start, kPageSize);
+  DCHECK_ALIGNED(end, kPageSize);
+  DCHECK_LT(start, end);
   if (!kMadviseZeroes) {
     // TODO: Do this when we resurrect the page instead.
     memset(start, 0, end - start);
@@ -38,6 +38,9 @@ namespace art {
 class MemMap;
 
 namespace gc {
+
+class TrimBudget;
+
 namespace allocator {
 
 // A runs-of-slots memory allocator.
@@ -658,14 +661,22 @@ class RosAlloc {
   // The default value for page_release_size_threshold_.
   static constexpr size_t kDefaultPageReleaseSizeThreshold = 4 * MB;
 
-  // We use thread-local runs for the size brackets whose indexes
-  // are less than this index. We use shared (current) runs for the rest.
-  // Sync this with the length of Thread::rosalloc_runs_.
+  // We always use thread-local runs for the size brackets whose indexes
+  // are less than this index. The allocation entrypoints rely on it.
   static const size_t kNumThreadLocalSizeBrackets = 16;
-  static_assert(kNumThreadLocalSizeBrackets == kNumRosAllocThreadLocalSizeBracketsInThread,
-                "Mismatch between kNumThreadLocalSizeBrackets and "
+
+  // The brackets up to this index may also get thread-local runs, see
+  // SetMaxThreadLocalBracketSize(). We use shared (current) runs for the rest.
+  // Sync this with the length of Thread::rosalloc_runs_.
+  static const size_t kMaxNumThreadLocalSizeBrackets = kNumOfSizeBrackets - 1;
+  static_assert(kMaxNumThreadLocalSizeBrackets == kNumRosAllocThreadLocalSizeBracketsInThread,
+                "Mismatch between kMaxNumThreadLocalSizeBrackets and "
                 "kNumRosAllocThreadLocalSizeBracketsInThread");
 
+  // A thread gets a thread-local run for one of the optional brackets once it has allocated this
+  // many objects of the bracket from the shared run since its runs were last revoked.
+  static constexpr uint8_t kThreadLocalRunPromotionAllocations = 32;
+
   // The size of the largest bracket we use thread-local runs for.
   // This should be equal to bracketSizes[kNumThreadLocalSizeBrackets - 1].
   static const size_t kMaxThreadLocalBracketSize = 128;
@@ -767,6 +778,14 @@ class RosAlloc {
   // Whether this allocator is running under Valgrind.
   bool is_running_on_memory_tool_;
 
+  // The page map index where an incremental ReleasePages() resumes. Only used by ReleasePages(),
+  // which the heap trim serializes.
+  size_t release_pages_cursor_;
+
+  // The brackets whose indexes are less than this may have thread-local runs, at least
+  // kNumThreadLocalSizeBrackets.
+  size_t num_thread_local_size_brackets_;
+
   // The base address of the memory region that's managed by this allocator.
   uint8_t* Begin() { return base_; }
   // The end address of the memory region that's managed by this allocator.
@@ -811,11 +830,26 @@ class RosAlloc {
   // Revoke a run by adding it to non_full_runs_ or freeing the pages.
   void RevokeRun(Thread* self, size_t idx, Run* run) REQUIRES(!lock_);
 
+  // Revoke the thread-local run of the given bracket of a thread, returns the bytes of its free
+  // slots. The caller holds size_bracket_locks_[idx].
+  size_t RevokeThreadLocalRun(Thread* self, Thread* thread, size_t idx) REQUIRES(!lock_);
+
+  // Returns true if the allocation should come from a thread-local run. For the optional brackets
+  // this also counts the allocation towards getting one.
+  ALWAYS_INLINE bool UseThreadLocalRun(Thread* self, size_t idx);
+
   // Revoke the current runs which share an index with the thread local runs.
   void RevokeThreadUnsafeCurrentRuns() REQUIRES(!lock_);
 
   // Release a range of pages.
   size_t ReleasePageRange(uint8_t* start, uint8_t* end) REQUIRES(lock_);
+  // Release a range of free pages that does not start a free page run.
+  size_t ReleaseFreePages(uint8_t* start, uint8_t* end) REQUIRES(lock_);
+  // Release the last batch_bytes of the not yet released pages of a free page run. Releasing from
+  // the end keeps the start of the run in place while the lock is dropped between batches. Returns
+  // the number of bytes passed to madvise, zero if the whole run is already released.
+  size_t ReleaseFreePageRunTail(FreePageRun* fpr, size_t batch_bytes, size_t* reclaimed_bytes)
+      REQUIRES(lock_);
 
   // Dumps the page map for debugging.
   std::string DumpPageMap() REQUIRES(lock_);
@@ -881,8 +915,9 @@ class RosAlloc {
                   void* arg)
       REQUIRES(!lock_);
 
-  // Release empty pages.
-  size_t ReleasePages() REQUIRES(!lock_);
+  // Release empty pages. With a budget the pages are released in batches, and a pass that runs out
+  // of budget resumes where it stopped on the next call.
+  size_t ReleasePages(TrimBudget* budget = nullptr) REQUIRES(!lock_);
   // Returns the current footprint.
   size_t Footprint() REQUIRES(!lock_);
   // Returns the current capacity, maximum footprint.
@@ -898,6 +933,10 @@ class RosAlloc {
   // Returns the total bytes of free slots in the revoked thread local runs. This is to be
   // subtracted from Heap::num_bytes_allocated_ to cancel out the ahead-of-time counting.
   size_t RevokeAllThreadLocalRuns() REQUIRES(!Locks::thread_list_lock_, !lock_, !bulk_free_lock_);
+  // Releases the thread-local runs of the optional brackets that the given thread has not
+  // allocated from since it got them or since the last call. Returns the total bytes of free
+  // slots in the revoked runs, like RevokeThreadLocalRuns(). Called from a checkpoint.
+  size_t RevokeIdleThreadLocalRuns(Thread* thread) REQUIRES(!lock_, !bulk_free_lock_);
   // Assert the thread local runs of a thread are revoked.
   void AssertThreadLocalRunsAreRevoked(Thread* thread) REQUIRES(!bulk_free_lock_);
   // Assert all the thread local runs are revoked.
@@ -906,6 +945,15 @@ class RosAlloc {
   static Run* GetDedicatedFullRun() {
     return dedicated_full_run_;
   }
+
+  // Also use thread-local runs for the brackets up to the given size, at most 1 KB. Threads only
+  // get runs of these brackets for the sizes they allocate often. Must be called before any thread
+  // allocates.
+  void SetMaxThreadLocalBracketSize(size_t size);
+  // The size of the largest bracket that may have thread-local runs.
+  size_t GetMaxThreadLocalBracketSize() const {
+    return bracketSizes[num_thread_local_size_brackets_ - 1];
+  }
   bool IsFreePage(size_t idx) const {
     DCHECK_LT(idx, capacity_ / kPageSize);
     uint8_t pm_type = page_map_[idx];
@@ -933,6 +981,7 @@ class RosAlloc {
 
  private:
   friend std::ostream& operator<<(std::ostream& os, const RosAlloc::PageMapKind& rhs);
+  friend class RosAllocTest;  // For SizeToIndex.
 
   DISALLOW_COPY_AND_ASSIGN(RosAlloc);
 };
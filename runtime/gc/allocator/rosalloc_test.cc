@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rosalloc-inl.h"
+
+#include <memory>
+#include <vector>
+
+#include "common_runtime_test.h"
+#include "gc/heap.h"
+#include "mem_map.h"
+#include "thread-inl.h"
+
+namespace art {
+namespace gc {
+namespace allocator {
+
+class RosAllocTest : public CommonRuntimeTest {
+ protected:
+  static constexpr size_t kCapacity = 8 * MB;
+
+  void SetUp() OVERRIDE {
+    CommonRuntimeTest::SetUp();
+    std::string error_msg;
+    mem_map_.reset(MemMap::MapAnonymous("rosalloc test", nullptr, kCapacity,
+                                        PROT_READ | PROT_WRITE, false, false, &error_msg));
+    ASSERT_TRUE(mem_map_ != nullptr) << error_msg;
+    // The whole capacity is in the footprint so that the allocator never calls back into the
+    // heap for more memory.
+    rosalloc_.reset(new RosAlloc(mem_map_->Begin(), kCapacity, kCapacity,
+                                 RosAlloc::kPageReleaseModeAll, false));
+    // The thread-local runs of the heap's allocator must not be mixed with ours.
+    Runtime::Current()->GetHeap()->RevokeRosAllocThreadLocalBuffers(Thread::Current());
+  }
+
+  void TearDown() OVERRIDE {
+    rosalloc_->RevokeThreadLocalRuns(Thread::Current());
+    rosalloc_.reset();
+    mem_map_.reset();
+    CommonRuntimeTest::TearDown();
+  }
+
+  static size_t SizeToIndex(size_t size) {
+    return RosAlloc::SizeToIndex(size);
+  }
+
+  bool HasThreadLocalRun(size_t size) {
+    Thread* self = Thread::Current();
+    return self->GetRosAllocRun(SizeToIndex(size)) != RosAlloc::GetDedicatedFullRun();
+  }
+
+  void* Alloc(size_t size) {
+    size_t bytes_allocated, usable_size, bytes_tl_bulk_allocated;
+    void* ptr = rosalloc_->Alloc(Thread::Current(), size, &bytes_allocated, &usable_size,
+                                 &bytes_tl_bulk_allocated);
+    EXPECT_TRUE(ptr != nullptr);
+    allocations_.push_back(ptr);
+    return ptr;
+  }
+
+  void FreeAll() {
+    for (void* ptr : allocations_) {
+      rosalloc_->Free(Thread::Current(), ptr);
+    }
+    allocations_.clear();
+  }
+
+  std::unique_ptr<MemMap> mem_map_;
+  std::unique_ptr<RosAlloc> rosalloc_;
+  std::vector<void*> allocations_;
+};
+
+TEST_F(RosAllocTest, ThreadLocalBracketPromotion) {
+  rosalloc_->SetMaxThreadLocalBracketSize(256);
+  EXPECT_EQ(256u, rosalloc_->GetMaxThreadLocalBracketSize());
+  // A thread-local run is counted as allocated in bulk.
+  EXPECT_GT(rosalloc_->MaxBytesBulkAllocatedFor(256), 256u);
+  // A bracket above the limit keeps using the shared run however often it is used.
+  for (size_t i = 0; i < 4 * RosAlloc::kThreadLocalRunPromotionAllocations; ++i) {
+    Alloc(512);
+  }
+  EXPECT_FALSE(HasThreadLocalRun(512));
+  EXPECT_EQ(512u, rosalloc_->MaxBytesBulkAllocatedFor(512));
+  // An optional bracket gets a thread-local run once the thread allocated enough from it.
+  for (size_t i = 1; i < RosAlloc::kThreadLocalRunPromotionAllocations; ++i) {
+    Alloc(256);
+  }
+  EXPECT_FALSE(HasThreadLocalRun(256));
+  Alloc(256);
+  EXPECT_TRUE(HasThreadLocalRun(256));
+  FreeAll();
+  // Revoking the runs restarts the count.
+  rosalloc_->RevokeThreadLocalRuns(Thread::Current());
+  EXPECT_FALSE(HasThreadLocalRun(256));
+  Alloc(256);
+  EXPECT_FALSE(HasThreadLocalRun(256));
+  FreeAll();
+}
+
+TEST_F(RosAllocTest, RevokeIdleThreadLocalRuns) {
+  Thread* self = Thread::Current();
+  rosalloc_->SetMaxThreadLocalBracketSize(1 * KB);
+  for (size_t i = 0; i < RosAlloc::kThreadLocalRunPromotionAllocations; ++i) {
+    Alloc(256);
+    Alloc(1 * KB);
+  }
+  ASSERT_TRUE(HasThreadLocalRun(256));
+  ASSERT_TRUE(HasThreadLocalRun(1 * KB));
+  // The 256 byte run is used again, the 1 KB run stays idle.
+  Alloc(256);
+  EXPECT_GT(rosalloc_->RevokeIdleThreadLocalRuns(self), 0u);
+  EXPECT_TRUE(HasThreadLocalRun(256));
+  EXPECT_FALSE(HasThreadLocalRun(1 * KB));
+  // The 256 byte run was not used since the last check.
+  EXPECT_GT(rosalloc_->RevokeIdleThreadLocalRuns(self), 0u);
+  EXPECT_FALSE(HasThreadLocalRun(256));
+  // Nothing left to revoke.
+  EXPECT_EQ(0u, rosalloc_->RevokeIdleThreadLocalRuns(self));
+  FreeAll();
+}
+
+}  // namespace allocator
+}  // namespace gc
+}  // namespace art
@@ -101,8 +101,6 @@ ConcurrentCopying::ConcurrentCopying(Heap* heap,
       gc_grays_immune_objects_(false),
       immune_gray_stack_lock_("concurrent copying immune gray stack lock",
                               kMarkSweepMarkStackLock) {
-  static_assert(space::RegionSpace::kRegionSize == accounting::ReadBarrierTable::kRegionSize,
-                "The region space size and the read barrier table region size must match");
   Thread* self = Thread::Current();
   {
     ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
@@ -355,6 +353,15 @@ class ConcurrentCopying::FlipCallback : public Closure {
     CHECK(thread == self);
     Locks::mutator_lock_->AssertExclusiveHeld(self);
     cc->region_space_->SetFromSpace(cc->rb_table_, cc->force_evacuate_all_);
+    if (VLOG_IS_ON(gc)) {
+      space::RegionSpace::EvacuationStats stats = cc->region_space_->GetLastEvacuationStats();
+      LOG(INFO) << "Regions evacuated: " << stats.evacuated_regions
+                << " (newly allocated " << stats.newly_allocated_regions << ")"
+                << " unevacuated: " << stats.unevacuated_regions
+                << " capped: " << stats.capped_regions
+                << " expected copied: " << PrettySize(stats.expected_copied_bytes)
+                << " expected reclaimed: " << PrettySize(stats.expected_reclaimed_bytes);
+    }
     cc->SwapStacks();
     if (ConcurrentCopying::kEnableFromSpaceAccountingCheck) {
       cc->RecordLiveStackFreezeSize(self);
@@ -539,6 +546,11 @@ void ConcurrentCopying::FlipThreadRoots() {
   }
   Thread* self = Thread::Current();
   Locks::mutator_lock_->AssertNotHeld(self);
+  if (!force_evacuate_all_) {
+    // Sort the evacuation candidates outside of the pause.
+    TimingLogger::ScopedTiming split2("RankEvacuationCandidates", GetTimings());
+    region_space_->RankEvacuationCandidates();
+  }
   gc_barrier_->Init(self, 0);
   ThreadFlipVisitor thread_flip_visitor(this, heap_->use_tlab_);
   FlipCallback flip_callback(this);
@@ -2250,7 +2262,7 @@ mirror::Object* ConcurrentCopying::Copy(mirror::Object* from_ref,
       FillWithDummyObject(to_ref, bytes_allocated);
       if (!fall_back_to_non_moving) {
         DCHECK(region_space_->IsInToSpace(to_ref));
-        if (bytes_allocated > space::RegionSpace::kRegionSize) {
+        if (bytes_allocated > region_space_->RegionSize()) {
           // Free the large alloc.
           region_space_->FreeLarge(to_ref, bytes_allocated);
         } else {
@@ -2584,6 +2596,9 @@ mirror::Object* ConcurrentCopying::MarkFromReadBarrierWithMeasurements(mirror::O
 
 void ConcurrentCopying::DumpPerformanceInfo(std::ostream& os) {
   GarbageCollector::DumpPerformanceInfo(os);
+  if (region_space_ != nullptr) {
+    region_space_->DumpEvacuationStats(os);
+  }
   MutexLock mu(Thread::Current(), rb_slow_path_histogram_lock_);
   if (rb_slow_path_time_histogram_.SampleSize() > 0) {
     Histogram<uint64_t>::CumulativeData cumulative_data;
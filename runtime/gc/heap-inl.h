@@ -155,6 +155,10 @@ inline mirror::Object* Heap::AllocObjectWithAllocator(Thread* self,
     QuasiAtomic::ThreadFenceForConstructor();
     new_num_bytes_allocated = static_cast<size_t>(
         num_bytes_allocated_.FetchAndAddRelaxed(bytes_tl_bulk_allocated)) + bytes_tl_bulk_allocated;
+    if (!IsTLABAllocator(allocator)) {
+      // TLAB allocations are counted when the TLAB is refilled.
+      CountAllocationForSampling(self, bytes_allocated);
+    }
   }
   if (kIsDebugBuild && Runtime::Current()->IsStarted()) {
     CHECK_LE(obj->SizeOf(), usable_size);
@@ -185,8 +189,14 @@ inline mirror::Object* Heap::AllocObjectWithAllocator(Thread* self,
       // Otherwise we'd have to perform this under a lock.
       l->ObjectAllocated(self, &obj, bytes_allocated);
     }
-  } else {
-    DCHECK(!IsAllocTrackingEnabled());
+  } else if (UNLIKELY(self->GetAllocSampleState()->sample_pending)) {
+    // Sampled allocation tracking can keep the uninstrumented entrypoints. The allocation slow
+    // paths flag the allocations to record.
+    if (IsAllocTrackingEnabled()) {
+      allocation_records_->RecordAllocation(self, &obj, bytes_allocated);
+    } else {
+      self->GetAllocSampleState()->sample_pending = false;
+    }
   }
   if (AllocatorHasAllocationStack(allocator)) {
     PushOnAllocationStack(self, &obj);
@@ -16,6 +16,7 @@
 
 #include "heap.h"
 
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <vector>
@@ -49,6 +50,7 @@
 #include "gc/collector/partial_mark_sweep.h"
 #include "gc/collector/semi_space.h"
 #include "gc/collector/sticky_mark_sweep.h"
+#include "gc/numa_topology.h"
 #include "gc/reference_processor.h"
 #include "gc/scoped_gc_critical_section.h"
 #include "gc/space/bump_pointer_space.h"
@@ -60,6 +62,7 @@
 #include "gc/space/space-inl.h"
 #include "gc/space/zygote_space.h"
 #include "gc/task_processor.h"
+#include "gc/trim_budget.h"
 #include "gc/verification.h"
 #include "entrypoints/quick/quick_alloc_entrypoints.h"
 #include "gc_pause_listener.h"
@@ -141,9 +144,18 @@ static const char* kRegionSpaceName = "main space (region space)";
 // If true, we log all GCs in the both the foreground and background. Used for debugging.
 static constexpr bool kLogAllGCs = false;
 
-// How much we grow the TLAB if we can do it.
+// How much we grow the TLAB if we can do it. This is the starting point of the adaptive sizing
+// below.
 static constexpr size_t kPartialTlabSize = 16 * KB;
 static constexpr bool kUsePartialTlabs = true;
+static_assert(space::RegionSpace::kMinRegionSize >= kPartialTlabSize &&
+                  space::RegionSpace::kMinRegionSize >= Heap::kDefaultTLABSize,
+              "A region must be able to hold a TLAB");
+// Fraction of the bytes a thread allocates between two GCs that we are willing to lose in its
+// TLAB when the GC revokes it. On average half of the last refill is left unused, so the refill
+// size targets this many refills per GC cycle.
+static constexpr size_t kTlabWasteTargetPercent = 2;
+static constexpr size_t kTlabTargetRefillsPerGc = 100 / (2 * kTlabWasteTargetPercent);
 
 #if defined(__LP64__) || !defined(ADDRESS_SANITIZER)
 // 300 MB (0x12c00000) - (default non-moving space capacity).
@@ -172,6 +184,14 @@ Heap::Heap(size_t initial_size,
            CollectorType background_collector_type,
            space::LargeObjectSpaceType large_object_space_type,
            size_t large_object_threshold,
+           size_t region_size,
+           size_t region_evacuation_limit,
+           size_t heap_trim_batch_size,
+           size_t heap_trim_rate,
+           size_t rosalloc_thread_local_bracket_size,
+           uint64_t gc_pause_target,
+           double gc_max_cpu_fraction,
+           bool numa_aware_region_space,
            size_t parallel_gc_threads,
            size_t conc_gc_threads,
            bool low_memory_mode,
@@ -207,6 +227,15 @@ Heap::Heap(size_t initial_size,
       zygote_creation_lock_("zygote creation lock", kZygoteCreationLock),
       zygote_space_(nullptr),
       large_object_threshold_(large_object_threshold),
+      heap_trim_batch_size_(heap_trim_batch_size),
+      heap_trim_rate_(heap_trim_rate),
+      rosalloc_thread_local_bracket_size_(rosalloc_thread_local_bracket_size),
+      gc_pause_target_(gc_pause_target),
+      gc_max_cpu_fraction_(gc_max_cpu_fraction),
+      last_gc_end_time_(0u),
+      bytes_allocated_after_last_gc_(0u),
+      allocation_rate_(0.0),
+      concurrent_start_scale_(1.0),
       disable_thread_flip_count_(0),
       thread_flip_running_(false),
       collector_type_running_(kCollectorTypeNone),
@@ -276,6 +305,8 @@ Heap::Heap(size_t initial_size,
       gc_count_rate_histogram_("gc count rate histogram", 1U, kGcCountRateMaxBucketCount),
       blocking_gc_count_rate_histogram_("blocking gc count rate histogram", 1U,
                                         kGcCountRateMaxBucketCount),
+      gcs_completed_(0U),
+      tlab_refills_(0U),
       alloc_tracking_enabled_(false),
       backtrace_lock_(nullptr),
       seen_backtrace_count_(0u),
@@ -431,11 +462,23 @@ Heap::Heap(size_t initial_size,
   // Create other spaces based on whether or not we have a moving GC.
   if (foreground_collector_type_ == kCollectorTypeCC) {
     CHECK(separate_non_moving_space);
-    MemMap* region_space_mem_map = space::RegionSpace::CreateMemMap(kRegionSpaceName,
-                                                                    capacity_ * 2,
-                                                                    request_begin);
+    MemMap* region_space_mem_map =
+        space::RegionSpace::CreateMemMap(kRegionSpaceName,
+                                         RoundUp(capacity_ * 2, region_size),
+                                         request_begin,
+                                         region_size);
     CHECK(region_space_mem_map != nullptr) << "No region space mem map";
-    region_space_ = space::RegionSpace::Create(kRegionSpaceName, region_space_mem_map);
+    region_space_ = space::RegionSpace::Create(kRegionSpaceName, region_space_mem_map, region_size);
+    region_space_->SetEvacuationLimit(region_evacuation_limit);
+    if (numa_aware_region_space) {
+      numa_topology_ = NumaTopology::FromSystem();
+      if (numa_topology_->NumNodes() > 1) {
+        region_space_->SetNumaTopology(numa_topology_.get());
+      } else {
+        VLOG(heap) << "Single NUMA node, the region space is not NUMA aware";
+        numa_topology_.reset();
+      }
+    }
     AddSpace(region_space_);
   } else if (IsMovingGc(foreground_collector_type_) &&
       foreground_collector_type_ != kCollectorTypeGSS) {
@@ -666,7 +709,8 @@ space::MallocSpace* Heap::CreateMallocSpaceFromMemMap(MemMap* mem_map,
     // Create rosalloc space.
     malloc_space = space::RosAllocSpace::CreateFromMemMap(mem_map, name, kDefaultStartingSize,
                                                           initial_size, growth_limit, capacity,
-                                                          low_memory_mode_, can_move_objects);
+                                                          low_memory_mode_, can_move_objects,
+                                                          rosalloc_thread_local_bracket_size_);
   } else {
     malloc_space = space::DlMallocSpace::CreateFromMemMap(mem_map, name, kDefaultStartingSize,
                                                           initial_size, growth_limit, capacity,
@@ -896,6 +940,14 @@ void Heap::CreateThreadPool() {
   const size_t num_threads = std::max(parallel_gc_threads_, conc_gc_threads_);
   if (num_threads != 0) {
     thread_pool_.reset(new ThreadPool("Heap thread pool", num_threads));
+    if (numa_topology_ != nullptr) {
+      // Spread the workers over the nodes. Parallel GC work then mostly touches regions of the
+      // node it runs on, since evacuation regions come from the node of the allocating thread.
+      const std::vector<ThreadPoolWorker*>& workers = thread_pool_->GetWorkers();
+      for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->SetCpuAffinity(numa_topology_->GetNodeCpus(i % numa_topology_->NumNodes()));
+      }
+    }
   }
 }
 
@@ -1117,6 +1169,14 @@ void Heap::DumpGcPerformanceInfo(std::ostream& os) {
   os << "Total GC time: " << PrettyDuration(GetGcTime()) << "\n";
   os << "Total blocking GC count: " << GetBlockingGcCount() << "\n";
   os << "Total blocking GC time: " << PrettyDuration(GetBlockingGcTime()) << "\n";
+  if (gc_pause_target_ != 0u || gc_max_cpu_fraction_ > 0.0) {
+    os << "Allocation rate: " << PrettySize(static_cast<uint64_t>(allocation_rate_)) << "/s\n";
+    os << "Concurrent start scale: " << concurrent_start_scale_ << "\n";
+  }
+  if (region_space_ != nullptr) {
+    os << "Total TLAB refills: " << tlab_refills_.LoadRelaxed() << "\n";
+    os << "Total TLAB waste: " << PrettySize(region_space_->GetTlabWasteBytes()) << "\n";
+  }
 
   {
     MutexLock mu(Thread::Current(), *gc_complete_lock_);
@@ -1155,6 +1215,10 @@ void Heap::ResetGcPerformanceInfo() {
   blocking_gc_time_ = 0;
   gc_count_last_window_ = 0;
   blocking_gc_count_last_window_ = 0;
+  tlab_refills_.StoreRelaxed(0);
+  if (region_space_ != nullptr) {
+    region_space_->ResetTlabWasteBytes();
+  }
   last_update_time_gc_count_rate_histograms_ =  // Round down by the window duration.
       (NanoTime() / kGcCountRateHistogramWindowDuration) * kGcCountRateHistogramWindowDuration;
   {
@@ -1370,6 +1434,7 @@ void Heap::Trim(Thread* self) {
         << PrettyDuration(NanoTime() - start_time);
   }
   TrimIndirectReferenceTables(self);
+  TrimRosAllocThreadLocalRuns(self);
   TrimSpaces(self);
   // Trim arenas that may have been used by JIT or verifier.
   runtime->GetArenaPool()->TrimMaps();
@@ -1406,6 +1471,40 @@ void Heap::TrimIndirectReferenceTables(Thread* self) {
   }
 }
 
+class TrimRosAllocThreadLocalRunsClosure : public Closure {
+ public:
+  TrimRosAllocThreadLocalRunsClosure(Heap* heap, Barrier* barrier)
+      : heap_(heap), barrier_(barrier) {
+  }
+  virtual void Run(Thread* thread) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    // The thread is either running this itself or suspended, so its runs and allocation counts
+    // can't change under us.
+    heap_->RevokeIdleRosAllocThreadLocalBuffers(thread);
+    barrier_->Pass(Thread::Current());
+  }
+
+ private:
+  Heap* const heap_;
+  Barrier* const barrier_;
+};
+
+void Heap::TrimRosAllocThreadLocalRuns(Thread* self) {
+  if (rosalloc_space_ == nullptr ||
+      rosalloc_thread_local_bracket_size_ <= allocator::RosAlloc::kMaxThreadLocalBracketSize) {
+    // Only the brackets that always have thread-local runs are in use.
+    return;
+  }
+  ScopedObjectAccess soa(self);
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  Barrier barrier(0);
+  TrimRosAllocThreadLocalRunsClosure closure(this, &barrier);
+  ScopedThreadStateChange tsc(self, kWaitingForCheckPointsToRun);
+  size_t barrier_count = Runtime::Current()->GetThreadList()->RunCheckpoint(&closure);
+  if (barrier_count != 0) {
+    barrier.Increment(self, barrier_count);
+  }
+}
+
 void Heap::StartGC(Thread* self, GcCause cause, CollectorType collector_type) {
   // Need to do this before acquiring the locks since we don't want to get suspended while
   // holding any locks.
@@ -1427,6 +1526,7 @@ void Heap::TrimSpaces(Thread* self) {
   uint64_t total_alloc_space_allocated = 0;
   uint64_t total_alloc_space_size = 0;
   uint64_t managed_reclaimed = 0;
+  std::vector<space::MallocSpace*> trimmed_spaces;
   {
     ScopedObjectAccess soa(self);
     for (const auto& space : continuous_spaces_) {
@@ -1435,12 +1535,27 @@ void Heap::TrimSpaces(Thread* self) {
         if (malloc_space->IsRosAllocSpace() || !CareAboutPauseTimes()) {
           // Don't trim dlmalloc spaces if we care about pauses since this can hold the space lock
           // for a long period of time.
-          managed_reclaimed += malloc_space->Trim();
+          trimmed_spaces.push_back(malloc_space);
         }
         total_alloc_space_size += malloc_space->Size();
       }
     }
   }
+  // Trimming does not need the mutator lock, the spaces can't go away while we pretend to be a GC.
+  // Spacing the steps by kHeapTrimStepWait limits the release rate.
+  const size_t step_bytes = (heap_trim_rate_ == 0u)
+      ? 0u
+      : std::max(heap_trim_rate_ * static_cast<size_t>(NsToMs(kHeapTrimStepWait)) / 1000u,
+                 kPageSize);
+  TrimBudget budget(heap_trim_batch_size_, step_bytes);
+  for (space::MallocSpace* malloc_space : trimmed_spaces) {
+    if (budget.IsExhausted()) {
+      break;
+    }
+    managed_reclaimed += malloc_space->IsRosAllocSpace()
+        ? malloc_space->AsRosAllocSpace()->Trim(&budget)
+        : malloc_space->Trim();
+  }
   total_alloc_space_allocated = GetBytesAllocated();
   if (large_object_space_ != nullptr) {
     total_alloc_space_allocated -= large_object_space_->GetBytesAllocated();
@@ -1460,6 +1575,10 @@ void Heap::TrimSpaces(Thread* self) {
   VLOG(heap) << "Heap trim of managed (duration=" << PrettyDuration(gc_heap_end_ns - start_ns)
       << ", advised=" << PrettySize(managed_reclaimed) << ") heap. Managed heap utilization of "
       << static_cast<int>(100 * managed_utilization) << "%.";
+  if (budget.IsExhausted()) {
+    // Release the rest of the pages in a later step.
+    AddHeapTrimTask(self, kHeapTrimStepWait, /*is_step*/ true);
+  }
 }
 
 bool Heap::IsValidObjectAddress(const void* addr) const {
@@ -2818,6 +2937,8 @@ void Heap::FinishGC(Thread* self, collector::GcType gc_type) {
     }
     // Update the gc count rate histograms if due.
     UpdateGcCountRateHistograms();
+    // Lets allocating threads resize their TLABs on their next refill.
+    gcs_completed_.FetchAndAddRelaxed(1);
   }
   // Reset.
   running_collection_is_blocking_ = false;
@@ -3530,6 +3651,13 @@ void Heap::DumpForSigQuit(std::ostream& os) {
   os << "Heap: " << GetPercentFree() << "% free, " << PrettySize(GetBytesAllocated()) << "/"
      << PrettySize(GetTotalMemory()) << "; " << GetObjectsAllocated() << " objects\n";
   DumpGcPerformanceInfo(os);
+  if (IsAllocTrackingEnabled()) {
+    ScopedObjectAccess soa(Thread::Current());
+    MutexLock mu(soa.Self(), *Locks::alloc_tracker_lock_);
+    if (IsAllocTrackingEnabled()) {
+      GetAllocationRecords()->DumpCallSites(os);
+    }
+  }
 }
 
 size_t Heap::GetPercentFree() {
@@ -3579,6 +3707,14 @@ void Heap::GrowForUtilization(collector::GarbageCollector* collector_ran,
   // We know what our utilization is at this moment.
   // This doesn't actually resize any memory. It just lets the heap grow more when necessary.
   const uint64_t bytes_allocated = GetBytesAllocated();
+  const uint64_t freed_bytes = current_gc_iteration_.GetFreedBytes() +
+      current_gc_iteration_.GetFreedLargeObjectBytes() +
+      current_gc_iteration_.GetFreedRevokeBytes();
+  // Bytes allocated will shrink by freed_bytes after the GC runs, so if we want to figure out
+  // how many bytes were allocated during the GC we need to add freed_bytes back on.
+  const uint64_t bytes_allocated_during_gc = bytes_allocated + freed_bytes -
+      std::min(bytes_allocated + freed_bytes, bytes_allocated_before_gc);
+  UpdateAllocationRate(bytes_allocated, bytes_allocated_before_gc, bytes_allocated_during_gc);
   uint64_t target_size;
   collector::GcType gc_type = collector_ran->GetGcType();
   const double multiplier = HeapGrowthMultiplier();  // Use the multiplier to grow more for
@@ -3617,23 +3753,30 @@ void Heap::GrowForUtilization(collector::GarbageCollector* collector_ran,
       target_size = std::max(bytes_allocated, static_cast<uint64_t>(max_allowed_footprint_));
     }
   }
+  if (gc_max_cpu_fraction_ > 0.0 && collector_ran->NumberOfIterations() > 0) {
+    // The mutators run for about free bytes / allocation rate between two GCs of this type, which
+    // each take the mean duration of the collector. Leave enough free bytes to keep the share of
+    // time spent in GC within the budget.
+    const double mean_gc_seconds = static_cast<double>(
+        collector_ran->GetCumulativeTimings().GetTotalNs() / collector_ran->NumberOfIterations()) /
+        static_cast<double>(MsToNs(1000));
+    target_size =
+        ApplyGcCpuBudget(target_size, bytes_allocated, adjusted_max_free, mean_gc_seconds);
+  }
   if (!ignore_max_footprint_) {
     SetIdealFootprint(target_size);
     if (IsGcConcurrent()) {
-      const uint64_t freed_bytes = current_gc_iteration_.GetFreedBytes() +
-          current_gc_iteration_.GetFreedLargeObjectBytes() +
-          current_gc_iteration_.GetFreedRevokeBytes();
-      // Bytes allocated will shrink by freed_bytes after the GC runs, so if we want to figure out
-      // how many bytes were allocated during the GC we need to add freed_bytes back on.
       CHECK_GE(bytes_allocated + freed_bytes, bytes_allocated_before_gc);
-      const uint64_t bytes_allocated_during_gc = bytes_allocated + freed_bytes -
-          bytes_allocated_before_gc;
+      UpdateConcurrentStartScale(GetObservedGcPause());
       // Calculate when to perform the next ConcurrentGC.
       // Calculate the estimated GC duration.
       const double gc_duration_seconds = NsToMs(current_gc_iteration_.GetDurationNs()) / 1000.0;
       // Estimate how many remaining bytes we will have when we need to start the next GC.
       size_t remaining_bytes = bytes_allocated_during_gc * gc_duration_seconds;
-      remaining_bytes = std::min(remaining_bytes, kMaxConcurrentRemainingBytes);
+      // The pause target scales the head room up after GCs that blocked the mutators.
+      remaining_bytes = std::min(static_cast<size_t>(remaining_bytes * concurrent_start_scale_),
+                                 static_cast<size_t>(kMaxConcurrentRemainingBytes *
+                                                     concurrent_start_scale_));
       remaining_bytes = std::max(remaining_bytes, kMinConcurrentRemainingBytes);
       if (UNLIKELY(remaining_bytes > max_allowed_footprint_)) {
         // A never going to happen situation that from the estimated allocation rate we will exceed
@@ -3652,6 +3795,60 @@ void Heap::GrowForUtilization(collector::GarbageCollector* collector_ran,
   }
 }
 
+void Heap::UpdateAllocationRate(uint64_t bytes_allocated,
+                                uint64_t bytes_allocated_before_gc,
+                                uint64_t bytes_allocated_during_gc) {
+  const uint64_t now = NanoTime();
+  if (last_gc_end_time_ != 0u &&
+      now > last_gc_end_time_ &&
+      bytes_allocated_before_gc >= bytes_allocated_after_last_gc_) {
+    const uint64_t bytes_since_last_gc =
+        bytes_allocated_before_gc - bytes_allocated_after_last_gc_ + bytes_allocated_during_gc;
+    const double rate = static_cast<double>(bytes_since_last_gc) * MsToNs(1000) /
+        static_cast<double>(now - last_gc_end_time_);
+    allocation_rate_ = allocation_rate_ == 0.0 ? rate : (allocation_rate_ + rate) / 2.0;
+  }
+  last_gc_end_time_ = now;
+  bytes_allocated_after_last_gc_ = bytes_allocated;
+}
+
+uint64_t Heap::ApplyGcCpuBudget(uint64_t target_size,
+                                uint64_t bytes_allocated,
+                                uint64_t adjusted_max_free,
+                                double mean_gc_seconds) const {
+  DCHECK_GT(gc_max_cpu_fraction_, 0.0);
+  const double min_free = allocation_rate_ * mean_gc_seconds * (1.0 / gc_max_cpu_fraction_ - 1.0);
+  const uint64_t capped_min_free = std::min(static_cast<uint64_t>(min_free),
+                                            adjusted_max_free * kMaxGcCpuFreeMultiplier);
+  return std::max(target_size, bytes_allocated + capped_min_free);
+}
+
+uint64_t Heap::GetObservedGcPause() const {
+  // An allocation that had to wait for this GC saw the whole GC as a pause.
+  uint64_t observed_pause = 0u;
+  if (current_gc_iteration_.GetGcCause() == kGcCauseForAlloc) {
+    observed_pause = current_gc_iteration_.GetDurationNs();
+  }
+  for (uint64_t pause : current_gc_iteration_.GetPauseTimes()) {
+    observed_pause = std::max(observed_pause, pause);
+  }
+  return observed_pause;
+}
+
+void Heap::UpdateConcurrentStartScale(uint64_t observed_pause) {
+  if (gc_pause_target_ == 0u) {
+    return;
+  }
+  if (observed_pause > gc_pause_target_) {
+    // Start the next concurrent GC earlier so that it finishes before the mutators run out of
+    // memory.
+    concurrent_start_scale_ = std::min(concurrent_start_scale_ * 2.0, kMaxConcurrentStartScale);
+  } else {
+    // Slowly give the head room back to the heap.
+    concurrent_start_scale_ = std::max(concurrent_start_scale_ * 0.9, 1.0);
+  }
+}
+
 void Heap::ClampGrowthLimit() {
   // Use heap bitmap lock to guard against races with BindLiveToMarkBitmap.
   ScopedObjectAccess soa(Thread::Current());
@@ -3807,12 +4004,21 @@ void Heap::RequestCollectorTransition(CollectorType desired_collector_type, uint
 
 class Heap::HeapTrimTask : public HeapTask {
  public:
-  explicit HeapTrimTask(uint64_t delta_time) : HeapTask(NanoTime() + delta_time) { }
+  HeapTrimTask(uint64_t delta_time, bool is_step)
+      : HeapTask(NanoTime() + delta_time), is_step_(is_step) { }
   virtual void Run(Thread* self) OVERRIDE {
     gc::Heap* heap = Runtime::Current()->GetHeap();
-    heap->Trim(self);
+    // Clear first so that the trim can request its next step.
     heap->ClearPendingTrim(self);
+    if (is_step_) {
+      heap->TrimSpaces(self);
+    } else {
+      heap->Trim(self);
+    }
   }
+
+ private:
+  const bool is_step_;
 };
 
 void Heap::ClearPendingTrim(Thread* self) {
@@ -3836,6 +4042,13 @@ void Heap::RequestTrim(Thread* self) {
   // to utilization (which is probably inversely proportional to how much benefit we can expect).
   // We could try mincore(2) but that's only a measure of how many pages we haven't given away,
   // not how much use we're making of those pages.
+  AddHeapTrimTask(self, kHeapTrimWait, /*is_step*/ false);
+}
+
+void Heap::AddHeapTrimTask(Thread* self, uint64_t delta_time, bool is_step) {
+  if (!CanAddHeapTask(self)) {
+    return;
+  }
   HeapTrimTask* added_task = nullptr;
   {
     MutexLock mu(self, *pending_task_lock_);
@@ -3843,7 +4056,7 @@ void Heap::RequestTrim(Thread* self) {
       // Already have a heap trim request in task processor, ignore this request.
       return;
     }
-    added_task = new HeapTrimTask(kHeapTrimWait);
+    added_task = new HeapTrimTask(delta_time, is_step);
     pending_heap_trim_ = added_task;
   }
   task_processor_->AddTask(self, added_task);
@@ -3865,6 +4078,16 @@ void Heap::RevokeThreadLocalBuffers(Thread* thread) {
   }
 }
 
+void Heap::RevokeIdleRosAllocThreadLocalBuffers(Thread* thread) {
+  if (rosalloc_space_ != nullptr) {
+    size_t freed_bytes_revoke = rosalloc_space_->RevokeIdleThreadLocalBuffers(thread);
+    if (freed_bytes_revoke > 0U) {
+      num_bytes_freed_revoke_.FetchAndAddSequentiallyConsistent(freed_bytes_revoke);
+      CHECK_GE(num_bytes_allocated_.LoadRelaxed(), num_bytes_freed_revoke_.LoadRelaxed());
+    }
+  }
+}
+
 void Heap::RevokeRosAllocThreadLocalBuffers(Thread* thread) {
   if (rosalloc_space_ != nullptr) {
     size_t freed_bytes_revoke = rosalloc_space_->RevokeThreadLocalBuffers(thread);
@@ -4191,6 +4414,80 @@ void Heap::RemoveGcPauseListener() {
   gc_pause_listener_.StoreRelaxed(nullptr);
 }
 
+size_t Heap::GetTlabRefillSize(Thread* self) {
+  Thread::TlabSizingState* state = self->GetTlabSizingState();
+  const uint32_t gcs_completed = gcs_completed_.LoadRelaxed();
+  if (state->refill_size == 0u) {
+    state->refill_size = kPartialTlabSize;
+    state->gcs_completed = gcs_completed;
+  } else if (state->gcs_completed != gcs_completed) {
+    // Resize from what the thread allocated per GC cycle since the last resize. Threads that
+    // allocate little end up with small TLABs, so they waste little when the GC revokes them.
+    const uint32_t cycles = gcs_completed - state->gcs_completed;
+    const size_t target = std::min(
+        std::max(state->bytes_since_resize / cycles / kTlabTargetRefillsPerGc, kMinTlabRefillSize),
+        kMaxTlabRefillSize);
+    // Only go half way so that one unusual cycle does not swing the size.
+    state->refill_size = RoundUp((state->refill_size + target) / 2, kObjectAlignment);
+    state->bytes_since_resize = 0;
+    state->gcs_completed = gcs_completed;
+  }
+  return state->refill_size;
+}
+
+void Heap::RecordTlabRefill(Thread* self, size_t bytes) {
+  self->GetTlabSizingState()->bytes_since_resize += bytes;
+  tlab_refills_.FetchAndAddRelaxed(1);
+}
+
+// Draws the bytes until the next sampled allocation from an exponential distribution with the
+// given mean. A fixed interval would alias with allocation patterns that repeat with the same
+// period and always sample the same call site.
+static size_t NextAllocSampleInterval(Thread::AllocSampleState* state, size_t mean) {
+  // xorshift64*, good enough for sampling and cheap to keep per thread.
+  uint64_t x = state->random_state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  state->random_state = x;
+  const double uniform =
+      static_cast<double>((x * UINT64_C(2685821657736338717)) >> 11) / (UINT64_C(1) << 53);
+  // Cap the tail so that one unlucky draw does not stop sampling a thread.
+  const double interval = std::min(-std::log1p(-uniform), 20.0) * mean;
+  return static_cast<size_t>(interval) + 1u;
+}
+
+// Returns the TLAB bytes to reserve past an allocation, at most `bytes`, so that the TLAB ends at
+// the next sample point. `bytes` must be object aligned.
+static size_t CapAtAllocSamplePoint(size_t bytes, size_t bytes_until_sample) {
+  return (bytes_until_sample < bytes) ? RoundUp(bytes_until_sample, kObjectAlignment) : bytes;
+}
+
+size_t Heap::CountAllocationForSampling(Thread* self, size_t alloc_size) {
+  if (LIKELY(!IsAllocTrackingEnabled())) {
+    return std::numeric_limits<size_t>::max();
+  }
+  // allocation_records_ never becomes null once allocation tracking has been enabled.
+  const size_t mean = allocation_records_->GetSampleIntervalBytes();
+  if (mean == 0u) {
+    return std::numeric_limits<size_t>::max();
+  }
+  Thread::AllocSampleState* state = self->GetAllocSampleState();
+  if (UNLIKELY(state->random_state == 0u)) {
+    // Seed each thread differently so that threads do not sample in lockstep.
+    state->random_state = ((static_cast<uint64_t>(self->GetTid()) << 32) ^ NanoTime()) | 1u;
+    state->bytes_until_sample = NextAllocSampleInterval(state, mean);
+  }
+  const size_t bytes = self->TakeUncountedTlabBytes() + alloc_size;
+  if (bytes < state->bytes_until_sample) {
+    state->bytes_until_sample -= bytes;
+  } else {
+    state->sample_pending = true;
+    state->bytes_until_sample = NextAllocSampleInterval(state, mean);
+  }
+  return state->bytes_until_sample;
+}
+
 mirror::Object* Heap::AllocWithNewTLAB(Thread* self,
                                        size_t alloc_size,
                                        bool grow,
@@ -4198,23 +4495,30 @@ mirror::Object* Heap::AllocWithNewTLAB(Thread* self,
                                        size_t* usable_size,
                                        size_t* bytes_tl_bulk_allocated) {
   const AllocatorType allocator_type = GetCurrentAllocator();
+  // When sampling allocations, end the TLAB at the next sample point. The allocation that crosses
+  // it then comes back here even from the uninstrumented entrypoints.
+  const size_t bytes_until_sample = CountAllocationForSampling(self, alloc_size);
   if (kUsePartialTlabs && alloc_size <= self->TlabRemainingCapacity()) {
     DCHECK_GT(alloc_size, self->TlabSize());
     // There is enough space if we grow the TLAB. Lets do that. This increases the
     // TLAB bytes.
     const size_t min_expand_size = alloc_size - self->TlabSize();
-    const size_t expand_bytes = std::max(
+    const size_t refill_bytes = std::max(
         min_expand_size,
-        std::min(self->TlabRemainingCapacity() - self->TlabSize(), kPartialTlabSize));
+        std::min(self->TlabRemainingCapacity() - self->TlabSize(), GetTlabRefillSize(self)));
+    const size_t expand_bytes = min_expand_size +
+        CapAtAllocSamplePoint(refill_bytes - min_expand_size, bytes_until_sample);
     if (UNLIKELY(IsOutOfMemoryOnAllocation(allocator_type, expand_bytes, grow))) {
       return nullptr;
     }
     *bytes_tl_bulk_allocated = expand_bytes;
     self->ExpandTlab(expand_bytes);
+    RecordTlabRefill(self, expand_bytes);
     DCHECK_LE(alloc_size, self->TlabSize());
   } else if (allocator_type == kAllocatorTypeTLAB) {
     DCHECK(bump_pointer_space_ != nullptr);
-    const size_t new_tlab_size = alloc_size + kDefaultTLABSize;
+    const size_t new_tlab_size =
+        alloc_size + CapAtAllocSamplePoint(kDefaultTLABSize, bytes_until_sample);
     if (UNLIKELY(IsOutOfMemoryOnAllocation(allocator_type, new_tlab_size, grow))) {
       return nullptr;
     }
@@ -4227,14 +4531,15 @@ mirror::Object* Heap::AllocWithNewTLAB(Thread* self,
   } else {
     DCHECK(allocator_type == kAllocatorTypeRegionTLAB);
     DCHECK(region_space_ != nullptr);
-    if (space::RegionSpace::kRegionSize >= alloc_size) {
+    const size_t region_size = region_space_->RegionSize();
+    if (region_size >= alloc_size) {
       // Non-large. Check OOME for a tlab.
-      if (LIKELY(!IsOutOfMemoryOnAllocation(allocator_type,
-                                            space::RegionSpace::kRegionSize,
-                                            grow))) {
-        const size_t new_tlab_size = kUsePartialTlabs
-            ? std::max(alloc_size, kPartialTlabSize)
-            : gc::space::RegionSpace::kRegionSize;
+      if (LIKELY(!IsOutOfMemoryOnAllocation(allocator_type, region_size, grow))) {
+        const size_t refill_size = kUsePartialTlabs
+            ? std::max(alloc_size, std::min(GetTlabRefillSize(self), region_size))
+            : region_size;
+        const size_t new_tlab_size =
+            alloc_size + CapAtAllocSamplePoint(refill_size - alloc_size, bytes_until_sample);
         // Try to allocate a tlab.
         if (!region_space_->AllocNewTlab(self, new_tlab_size)) {
           // Failed to allocate a tlab. Try non-tlab.
@@ -4244,6 +4549,7 @@ mirror::Object* Heap::AllocWithNewTLAB(Thread* self,
                                                        bytes_tl_bulk_allocated);
         }
         *bytes_tl_bulk_allocated = new_tlab_size;
+        RecordTlabRefill(self, new_tlab_size);
         // Fall-through to using the TLAB below.
       } else {
         // Check OOME for a non-tlab allocation.
@@ -4270,6 +4576,10 @@ mirror::Object* Heap::AllocWithNewTLAB(Thread* self,
   // Refilled TLAB, return.
   mirror::Object* ret = self->AllocTlab(alloc_size);
   DCHECK(ret != nullptr);
+  if (bytes_until_sample != std::numeric_limits<size_t>::max()) {
+    // This allocation was counted above.
+    self->TakeUncountedTlabBytes();
+  }
   *bytes_allocated = alloc_size;
   *usable_size = alloc_size;
   return ret;
@@ -62,6 +62,7 @@ namespace gc {
 class AllocationListener;
 class AllocRecordObjectMap;
 class GcPauseListener;
+class NumaTopology;
 class ReferenceProcessor;
 class TaskProcessor;
 class Verification;
@@ -135,11 +136,21 @@ class Heap {
   static constexpr size_t kDefaultLongPauseLogThreshold = MsToNs(5);
   static constexpr size_t kDefaultLongGCLogThreshold = MsToNs(100);
   static constexpr size_t kDefaultTLABSize = 32 * KB;
+  // Bounds of the adaptive region TLAB refill size.
+  static constexpr size_t kMinTlabRefillSize = 4 * KB;
+  static constexpr size_t kMaxTlabRefillSize = 256 * KB;
+  // Bounds how far the pause target may scale the concurrent start head room.
+  static constexpr double kMaxConcurrentStartScale = 16.0;
+  // Bounds how many times max free the GC CPU budget may add to the heap.
+  static constexpr uint64_t kMaxGcCpuFreeMultiplier = 4;
   static constexpr double kDefaultTargetUtilization = 0.5;
   static constexpr double kDefaultHeapGrowthMultiplier = 2.0;
   // Primitive arrays larger than this size are put in the large object space.
   static constexpr size_t kMinLargeObjectThreshold = 3 * kPageSize;
   static constexpr size_t kDefaultLargeObjectThreshold = kMinLargeObjectThreshold;
+  // RosAlloc brackets larger than this only use shared runs, matches
+  // RosAlloc::kMaxThreadLocalBracketSize.
+  static constexpr size_t kDefaultRosAllocThreadLocalBracketSize = 128;
   // Whether or not parallel GC is enabled. If not, then we never create the thread pool.
   static constexpr bool kDefaultEnableParallelGC = false;
 
@@ -155,6 +166,10 @@ class Heap {
 
   // How often we allow heap trimming to happen (nanoseconds).
   static constexpr uint64_t kHeapTrimWait = MsToNs(5000);
+  // How long we wait between the steps of a rate limited heap trim (nanoseconds).
+  static constexpr uint64_t kHeapTrimStepWait = MsToNs(100);
+  // The most bytes released while holding the lock of a space during a heap trim.
+  static constexpr size_t kDefaultHeapTrimBatchSize = 1 * MB;
   // How long we wait after a transition request to perform a collector transition (nanoseconds).
   static constexpr uint64_t kCollectorTransitionWait = MsToNs(5000);
 
@@ -175,6 +190,14 @@ class Heap {
        CollectorType background_collector_type,
        space::LargeObjectSpaceType large_object_space_type,
        size_t large_object_threshold,
+       size_t region_size,
+       size_t region_evacuation_limit,
+       size_t heap_trim_batch_size,
+       size_t heap_trim_rate,
+       size_t rosalloc_thread_local_bracket_size,
+       uint64_t gc_pause_target,
+       double gc_max_cpu_fraction,
+       bool numa_aware_region_space,
        size_t parallel_gc_threads,
        size_t conc_gc_threads,
        bool low_memory_mode,
@@ -568,10 +591,12 @@ class Heap {
   void DoPendingCollectorTransition() REQUIRES(!*gc_complete_lock_, !*pending_task_lock_);
 
   // Deflate monitors, ... and trim the spaces.
-  void Trim(Thread* self) REQUIRES(!*gc_complete_lock_);
+  void Trim(Thread* self) REQUIRES(!*gc_complete_lock_, !*pending_task_lock_);
 
   void RevokeThreadLocalBuffers(Thread* thread);
   void RevokeRosAllocThreadLocalBuffers(Thread* thread);
+  // Revoke the optional RosAlloc thread-local runs the thread has not used lately.
+  void RevokeIdleRosAllocThreadLocalBuffers(Thread* thread);
   void RevokeAllThreadLocalBuffers();
   void AssertThreadLocalBuffersAreRevoked(Thread* thread);
   void AssertAllBumpPointerSpaceThreadLocalBuffersAreRevoked();
@@ -938,6 +963,17 @@ class Heap {
                                    size_t* bytes_tl_bulk_allocated)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Returns how many bytes a region TLAB refill of the thread should reserve, adapting it to the
+  // allocation rate of the thread once per GC cycle.
+  size_t GetTlabRefillSize(Thread* self);
+  void RecordTlabRefill(Thread* self, size_t bytes);
+
+  // Counts an allocation of alloc_size bytes, and the bytes the thread bump-allocated from its
+  // TLAB since the last call, towards the allocation tracker's next sample. Flags the allocation
+  // for recording when it reaches the sample point. Returns the bytes left until the next sample,
+  // or SIZE_MAX when allocations are not sampled.
+  size_t CountAllocationForSampling(Thread* self, size_t alloc_size);
+
   void ThrowOutOfMemoryError(Thread* self, size_t byte_count, AllocatorType allocator_type)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
@@ -1006,6 +1042,19 @@ class Heap {
   void GrowForUtilization(collector::GarbageCollector* collector_ran,
                           uint64_t bytes_allocated_before_gc = 0);
 
+  // Feedback for the GC triggering, see GrowForUtilization.
+  void UpdateAllocationRate(uint64_t bytes_allocated,
+                            uint64_t bytes_allocated_before_gc,
+                            uint64_t bytes_allocated_during_gc);
+  // The longest time the mutators were blocked by the GC that just finished.
+  uint64_t GetObservedGcPause() const;
+  void UpdateConcurrentStartScale(uint64_t observed_pause);
+  // Raises target_size so that GCs taking mean_gc_seconds stay within the GC CPU budget.
+  uint64_t ApplyGcCpuBudget(uint64_t target_size,
+                            uint64_t bytes_allocated,
+                            uint64_t adjusted_max_free,
+                            double mean_gc_seconds) const;
+
   size_t GetPercentFree();
 
   static void VerificationCallback(mirror::Object* obj, void* arg)
@@ -1046,12 +1095,20 @@ class Heap {
         collector_type_ == kCollectorTypeCCBackground;
   }
 
-  // Trim the managed and native spaces by releasing unused memory back to the OS.
-  void TrimSpaces(Thread* self) REQUIRES(!*gc_complete_lock_);
+  // Trim the managed and native spaces by releasing unused memory back to the OS. If the release
+  // rate is limited, another trim step is requested when the budget of this one runs out.
+  void TrimSpaces(Thread* self) REQUIRES(!*gc_complete_lock_, !*pending_task_lock_);
+
+  // Add a heap trim task, a step only continues releasing the pages of the managed spaces.
+  void AddHeapTrimTask(Thread* self, uint64_t delta_time, bool is_step)
+      REQUIRES(!*pending_task_lock_);
 
   // Trim 0 pages at the end of reference tables.
   void TrimIndirectReferenceTables(Thread* self);
 
+  // Revoke the optional RosAlloc thread-local runs of the idle threads with a checkpoint.
+  void TrimRosAllocThreadLocalRuns(Thread* self);
+
   void VisitObjectsInternal(ObjectCallback callback, void* arg)
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!Locks::heap_bitmap_lock_, !*gc_complete_lock_);
@@ -1171,6 +1228,32 @@ class Heap {
   // Minimum allocation size of large object.
   size_t large_object_threshold_;
 
+  // The most bytes a heap trim releases while holding the lock of a space.
+  const size_t heap_trim_batch_size_;
+  // The most bytes per second a heap trim releases, zero means no limit.
+  const size_t heap_trim_rate_;
+
+  // The largest RosAlloc bracket that threads may get thread-local runs for.
+  const size_t rosalloc_thread_local_bracket_size_;
+
+  // The longest pause (nanoseconds) a GC should cause before the next concurrent GC is started
+  // earlier, and the largest share of time to spend in GC before the heap is grown further. Zero
+  // disables them.
+  const uint64_t gc_pause_target_;
+  const double gc_max_cpu_fraction_;
+
+  // State of the GC trigger feedback, only updated by the thread running the GC.
+  uint64_t last_gc_end_time_;
+  uint64_t bytes_allocated_after_last_gc_;
+  // Smoothed bytes per second allocated by the mutators.
+  double allocation_rate_;
+  // Multiplies the head room left when scheduling the next concurrent GC.
+  double concurrent_start_scale_;
+
+  // The NUMA nodes the region space and the heap thread pool are spread over, null unless NUMA
+  // awareness was requested and the machine has more than one node.
+  std::unique_ptr<NumaTopology> numa_topology_;
+
   // Guards access to the state of GC, associated conditional variable is used to signal when a GC
   // completes.
   Mutex* gc_complete_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -1295,10 +1378,6 @@ class Heap {
   // Parallel GC data structures.
   std::unique_ptr<ThreadPool> thread_pool_;
 
-  // Estimated allocation rate (bytes / second). Computed between the time of the last GC cycle
-  // and the start of the current one.
-  uint64_t allocation_rate_;
-
   // For a GC cycle, a bitmap that is set corresponding to the
   std::unique_ptr<accounting::HeapBitmap> live_bitmap_ GUARDED_BY(Locks::heap_bitmap_lock_);
   std::unique_ptr<accounting::HeapBitmap> mark_bitmap_ GUARDED_BY(Locks::heap_bitmap_lock_);
@@ -1411,6 +1490,10 @@ class Heap {
   Histogram<uint64_t> gc_count_rate_histogram_ GUARDED_BY(gc_complete_lock_);
   // The histogram of the number of blocking GC invocations per window duration.
   Histogram<uint64_t> blocking_gc_count_rate_histogram_ GUARDED_BY(gc_complete_lock_);
+  // The number of finished GCs, read without a lock by the TLAB sizing to detect a new cycle.
+  Atomic<uint32_t> gcs_completed_;
+  // The number of region TLAB refills, both expansions and new regions.
+  Atomic<uint64_t> tlab_refills_;
 
   // Allocation tracking support
   Atomic<bool> alloc_tracking_enabled_;
@@ -1439,6 +1522,7 @@ class Heap {
   std::unique_ptr<Verification> verification_;
 
   friend class CollectorTransitionTask;
+  friend class GcFeedbackTest;  // For the GC trigger feedback state.
   friend class collector::GarbageCollector;
   friend class collector::MarkCompact;
   friend class collector::ConcurrentCopying;
@@ -1449,6 +1533,7 @@ class Heap {
   friend class VerifyReferenceCardVisitor;
   friend class VerifyReferenceVisitor;
   friend class VerifyObjectVisitor;
+  ART_FRIEND_TEST(HeapTest, AdaptiveTlabRefillSize);  // For GetTlabRefillSize.
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(Heap);
 };
@@ -18,7 +18,9 @@
 #include "common_runtime_test.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/allocation_record.h"
 #include "handle_scope-inl.h"
+#include "instrumentation.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
 #include "mirror/object_array-inl.h"
@@ -77,6 +79,148 @@ TEST_F(HeapTest, DumpGCPerformanceOnShutdown) {
   Runtime::Current()->SetDumpGCPerformanceOnShutdown(true);
 }
 
+TEST_F(HeapTest, AdaptiveTlabRefillSize) {
+  static constexpr size_t kNumGcs = 16;
+  Heap* heap = Runtime::Current()->GetHeap();
+  Thread* self = Thread::Current();
+  *self->GetTlabSizingState() = Thread::TlabSizingState();
+  const size_t initial_size = heap->GetTlabRefillSize(self);
+  EXPECT_GE(initial_size, Heap::kMinTlabRefillSize);
+  EXPECT_LE(initial_size, Heap::kMaxTlabRefillSize);
+  // The size only adapts once per GC cycle.
+  heap->RecordTlabRefill(self, 64 * MB);
+  EXPECT_EQ(initial_size, heap->GetTlabRefillSize(self));
+
+  // A thread that allocates a lot between GCs gets larger TLABs, up to the maximum.
+  size_t size = initial_size;
+  for (size_t i = 0; i < kNumGcs; ++i) {
+    heap->RecordTlabRefill(self, 64 * MB);
+    heap->CollectGarbage(/* clear_soft_references */ false);
+    const size_t new_size = heap->GetTlabRefillSize(self);
+    EXPECT_GE(new_size, size);
+    EXPECT_LE(new_size, Heap::kMaxTlabRefillSize);
+    size = new_size;
+  }
+  EXPECT_GT(size, Heap::kMaxTlabRefillSize / 2);
+
+  // A thread that stops allocating gets smaller TLABs, down to the minimum.
+  for (size_t i = 0; i < kNumGcs; ++i) {
+    heap->CollectGarbage(/* clear_soft_references */ false);
+    const size_t new_size = heap->GetTlabRefillSize(self);
+    EXPECT_LE(new_size, size);
+    EXPECT_GE(new_size, Heap::kMinTlabRefillSize);
+    size = new_size;
+  }
+  EXPECT_LT(size, 2 * Heap::kMinTlabRefillSize);
+}
+
+TEST_F(HeapTest, SampledAllocationTracking) {
+  static constexpr size_t kSampleIntervalBytes = 64 * KB;
+  static constexpr size_t kNumAllocations = 8192;
+  Heap* heap = Runtime::Current()->GetHeap();
+  AllocRecordObjectMap::SetAllocTrackingEnabled(true, kSampleIntervalBytes);
+  size_t allocated_bytes = 0u;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    if (heap->GetCurrentAllocator() == kAllocatorTypeRegionTLAB) {
+      // Sampling must not slow down every allocation with the instrumented entrypoints.
+      EXPECT_FALSE(Runtime::Current()->GetInstrumentation()->AllocEntrypointsInstrumented());
+    }
+    StackHandleScope<1> hs(soa.Self());
+    Handle<mirror::Class> c(
+        hs.NewHandle(class_linker_->FindSystemClass(soa.Self(), "[Ljava/lang/Object;")));
+    for (size_t i = 0; i < kNumAllocations; ++i) {
+      mirror::ObjectArray<mirror::Object>* array =
+          mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c.Get(), 256);
+      ASSERT_TRUE(array != nullptr);
+      allocated_bytes += array->SizeOf();
+    }
+    MutexLock mu(soa.Self(), *Locks::alloc_tracker_lock_);
+    AllocRecordObjectMap* records = heap->GetAllocationRecords();
+    size_t samples = 0u;
+    size_t estimated_bytes = 0u;
+    for (const auto& pair : records->GetCallSites()) {
+      samples += pair.second.samples;
+      estimated_bytes += pair.second.estimated_bytes;
+    }
+    // Sample intervals are random, so only check the counts are in the expected range.
+    const size_t expected_samples = allocated_bytes / kSampleIntervalBytes;
+    EXPECT_EQ(samples, records->Size());
+    EXPECT_GE(samples, expected_samples / 2u);
+    EXPECT_LE(samples, expected_samples * 2u);
+    EXPECT_GE(estimated_bytes, allocated_bytes / 2u);
+    EXPECT_LE(estimated_bytes, allocated_bytes * 2u);
+  }
+  AllocRecordObjectMap::SetAllocTrackingEnabled(false);
+}
+
+class GcFeedbackTest : public CommonRuntimeTest {
+ protected:
+  static constexpr uint64_t kPauseTarget = MsToNs(10);
+
+  void SetUpRuntimeOptions(RuntimeOptions* options) OVERRIDE {
+    CommonRuntimeTest::SetUpRuntimeOptions(options);
+    options->push_back(std::make_pair("-XX:GcPauseTarget=10", nullptr));
+    options->push_back(std::make_pair("-XX:GcMaxCpuFraction=0.25", nullptr));
+  }
+
+  static double UpdateConcurrentStartScale(Heap* heap, uint64_t observed_pause) {
+    heap->UpdateConcurrentStartScale(observed_pause);
+    return heap->concurrent_start_scale_;
+  }
+
+  static void ResetFeedback(Heap* heap, double allocation_rate) {
+    heap->allocation_rate_ = allocation_rate;
+    heap->concurrent_start_scale_ = 1.0;
+  }
+
+  static uint64_t ApplyGcCpuBudget(Heap* heap,
+                                   uint64_t target_size,
+                                   uint64_t bytes_allocated,
+                                   uint64_t adjusted_max_free,
+                                   double mean_gc_seconds) {
+    return heap->ApplyGcCpuBudget(target_size, bytes_allocated, adjusted_max_free, mean_gc_seconds);
+  }
+};
+
+TEST_F(GcFeedbackTest, PauseTarget) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  ResetFeedback(heap, 0.0);
+  // Each GC that paused the mutators for longer than the target doubles the head room.
+  double expected = 1.0;
+  while (expected < Heap::kMaxConcurrentStartScale) {
+    expected *= 2.0;
+    EXPECT_DOUBLE_EQ(expected, UpdateConcurrentStartScale(heap, kPauseTarget + 1));
+  }
+  EXPECT_DOUBLE_EQ(expected, UpdateConcurrentStartScale(heap, kPauseTarget + 1));
+  // GCs within the target give the head room back, slowly.
+  double scale = Heap::kMaxConcurrentStartScale;
+  for (size_t i = 0; i < 64; ++i) {
+    const double new_scale = UpdateConcurrentStartScale(heap, kPauseTarget);
+    EXPECT_LE(new_scale, scale);
+    EXPECT_GE(new_scale, 1.0);
+    if (i == 0) {
+      EXPECT_GT(new_scale, Heap::kMaxConcurrentStartScale / 2.0);
+    }
+    scale = new_scale;
+  }
+  EXPECT_DOUBLE_EQ(1.0, scale);
+}
+
+TEST_F(GcFeedbackTest, GcCpuBudget) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  // With GCs of 1/8 s and 8 MB/s allocated, the budget of 1/4 needs 3 * 1 MB free between GCs.
+  ResetFeedback(heap, 8.0 * MB);
+  static constexpr double kMeanGcSeconds = 0.125;
+  EXPECT_EQ(19 * MB, ApplyGcCpuBudget(heap, 17 * MB, 16 * MB, 2 * MB, kMeanGcSeconds));
+  // A footprint that already meets the budget is kept.
+  EXPECT_EQ(20 * MB, ApplyGcCpuBudget(heap, 20 * MB, 16 * MB, 2 * MB, kMeanGcSeconds));
+  // The raise is capped at kMaxGcCpuFreeMultiplier times the adjusted max free.
+  ResetFeedback(heap, 80.0 * MB);
+  EXPECT_EQ(16 * MB + 2 * MB * Heap::kMaxGcCpuFreeMultiplier,
+            ApplyGcCpuBudget(heap, 17 * MB, 16 * MB, 2 * MB, kMeanGcSeconds));
+}
+
 class ZygoteHeapTest : public CommonRuntimeTest {
   void SetUpRuntimeOptions(RuntimeOptions* options) {
     CommonRuntimeTest::SetUpRuntimeOptions(options);
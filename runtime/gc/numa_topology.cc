@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "numa_topology.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#include "android-base/stringprintf.h"
+
+#include "base/bit_utils.h"
+#include "base/logging.h"
+#include "globals.h"
+#include "utils.h"
+
+namespace art {
+namespace gc {
+
+using android::base::StringPrintf;
+
+NumaTopology::NumaTopology(std::vector<uint32_t> node_ids,
+                           std::vector<std::vector<uint32_t>> node_cpus,
+                           bool emulated)
+    : node_ids_(std::move(node_ids)),
+      node_cpus_(std::move(node_cpus)),
+      emulated_(emulated) {
+  DCHECK_EQ(node_ids_.size(), node_cpus_.size());
+  DCHECK(!node_cpus_.empty());
+  for (size_t node = 0; node < node_cpus_.size(); ++node) {
+    for (uint32_t cpu : node_cpus_[node]) {
+      if (cpu >= cpu_nodes_.size()) {
+        cpu_nodes_.resize(cpu + 1, 0u);
+      }
+      cpu_nodes_[cpu] = node;
+    }
+  }
+}
+
+static std::vector<uint32_t> AllCpus() {
+  const int64_t num_cpus = std::max<int64_t>(sysconf(_SC_NPROCESSORS_CONF), 1);
+  std::vector<uint32_t> cpus;
+  for (int64_t cpu = 0; cpu < num_cpus; ++cpu) {
+    cpus.push_back(static_cast<uint32_t>(cpu));
+  }
+  return cpus;
+}
+
+std::unique_ptr<NumaTopology> NumaTopology::FromSystem() {
+  return FromSysfs("/sys/devices/system/node");
+}
+
+std::unique_ptr<NumaTopology> NumaTopology::FromSysfs(const std::string& node_dir) {
+  std::vector<uint32_t> node_ids;
+  std::vector<std::vector<uint32_t>> node_cpus;
+  std::string online;
+  std::vector<uint32_t> online_ids;
+  if (ReadFileToString(node_dir + "/online", &online) && ParseList(online, &online_ids)) {
+    for (uint32_t node_id : online_ids) {
+      std::string cpu_list;
+      std::vector<uint32_t> cpus;
+      if (!ReadFileToString(StringPrintf("%s/node%u/cpulist", node_dir.c_str(), node_id),
+                            &cpu_list) ||
+          !ParseList(cpu_list, &cpus)) {
+        node_ids.clear();
+        node_cpus.clear();
+        break;
+      }
+      if (cpus.empty()) {
+        // A memory-only node, no thread ever runs on it.
+        continue;
+      }
+      node_ids.push_back(node_id);
+      node_cpus.push_back(std::move(cpus));
+    }
+  }
+  if (node_cpus.empty()) {
+    node_ids.assign(1u, 0u);
+    node_cpus.assign(1u, AllCpus());
+  }
+  return std::unique_ptr<NumaTopology>(
+      new NumaTopology(std::move(node_ids), std::move(node_cpus), /* emulated */ false));
+}
+
+std::unique_ptr<NumaTopology> NumaTopology::Emulated(size_t num_nodes) {
+  CHECK_GT(num_nodes, 0u);
+  std::vector<uint32_t> node_ids;
+  std::vector<std::vector<uint32_t>> node_cpus(num_nodes);
+  for (size_t node = 0; node < num_nodes; ++node) {
+    node_ids.push_back(node);
+  }
+  for (uint32_t cpu : AllCpus()) {
+    node_cpus[cpu % num_nodes].push_back(cpu);
+  }
+  return std::unique_ptr<NumaTopology>(
+      new NumaTopology(std::move(node_ids), std::move(node_cpus), /* emulated */ true));
+}
+
+bool NumaTopology::ParseList(const std::string& list, std::vector<uint32_t>* out) {
+  std::vector<std::string> ranges;
+  Split(list, ',', &ranges);
+  out->clear();
+  for (std::string range : ranges) {
+    // Sysfs terminates the list with a new line.
+    while (!range.empty() && isspace(range.back())) {
+      range.pop_back();
+    }
+    if (range.empty()) {
+      continue;
+    }
+    unsigned int first;
+    unsigned int last;
+    char trailing;
+    int matched = sscanf(range.c_str(), "%u-%u%c", &first, &last, &trailing);
+    if (matched == 1) {
+      last = first;
+    } else if (matched != 2 || last < first) {
+      return false;
+    }
+    // Also keeps the loop below from wrapping around.
+    if (last > kMaxListValue) {
+      return false;
+    }
+    for (uint32_t i = first; i <= last; ++i) {
+      out->push_back(i);
+    }
+  }
+  return true;
+}
+
+size_t NumaTopology::CurrentNode() const {
+  if (NumNodes() == 1u) {
+    return 0u;
+  }
+  int cpu = sched_getcpu();
+  if (cpu < 0 || static_cast<size_t>(cpu) >= cpu_nodes_.size()) {
+    return 0u;
+  }
+  return cpu_nodes_[cpu];
+}
+
+bool NumaTopology::BindMemory(void* begin, size_t size, size_t node) const {
+  DCHECK_LT(node, NumNodes());
+#if defined(__linux__)
+  const uint32_t node_id = node_ids_[node];
+  if (emulated_ || node_id >= BitSizeOf<unsigned long>()) {  // NOLINT [runtime/int] [4]
+    return false;
+  }
+  unsigned long node_mask = 1UL << node_id;  // NOLINT [runtime/int] [4]
+  // The kernel ignores the last bit of maxnode.
+  if (syscall(__NR_mbind, begin, size, MPOL_PREFERRED, &node_mask,
+              BitSizeOf<unsigned long>() + 1, 0) != 0) {  // NOLINT [runtime/int] [4]
+    PLOG(WARNING) << "mbind of " << begin << " to node " << node_id << " failed";
+    return false;
+  }
+  return true;
+#else
+  UNUSED(begin, size, node);
+  return false;
+#endif
+}
+
+int NumaTopology::GetMemoryNode(const void* addr) const {
+#if defined(__linux__)
+  if (emulated_) {
+    return -1;
+  }
+  void* page = AlignDown(const_cast<void*>(addr), kPageSize);
+  int status = -1;
+  // With no target nodes, move_pages only reports where the page is.
+  if (syscall(__NR_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0 || status < 0) {
+    return -1;
+  }
+  for (size_t node = 0; node < node_ids_.size(); ++node) {
+    if (node_ids_[node] == static_cast<uint32_t>(status)) {
+      return static_cast<int>(node);
+    }
+  }
+  return -1;
+#else
+  UNUSED(addr);
+  return -1;
+#endif
+}
+
+}  // namespace gc
+}  // namespace art
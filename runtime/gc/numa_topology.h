@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_NUMA_TOPOLOGY_H_
+#define ART_RUNTIME_GC_NUMA_TOPOLOGY_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace art {
+namespace gc {
+
+// The NUMA nodes of the machine and their CPUs, read from /sys without libnuma. Nodes are
+// numbered densely from zero in the order of their sysfs ids.
+class NumaTopology {
+ public:
+  // Reads the topology of the machine. Returns a single node topology if /sys does not describe
+  // the nodes.
+  static std::unique_ptr<NumaTopology> FromSystem();
+  // Same as FromSystem() with the node directory of sysfs at node_dir. Nodes without CPUs, such
+  // as memory-only nodes, are left out.
+  static std::unique_ptr<NumaTopology> FromSysfs(const std::string& node_dir);
+
+  // Splits the CPUs of the machine round-robin into num_nodes nodes. Memory is not bound, this
+  // only exercises the node aware paths on machines with a single node.
+  static std::unique_ptr<NumaTopology> Emulated(size_t num_nodes);
+
+  // Parses a sysfs CPU or node list such as "0-3,8,10-11", the list may be empty. Returns false
+  // on malformed input or values above kMaxListValue.
+  static bool ParseList(const std::string& list, std::vector<uint32_t>* out);
+
+  // Larger than any CPU or node id the kernel supports.
+  static constexpr uint32_t kMaxListValue = 64 * 1024;
+
+  size_t NumNodes() const {
+    return node_cpus_.size();
+  }
+
+  bool IsEmulated() const {
+    return emulated_;
+  }
+
+  const std::vector<uint32_t>& GetNodeCpus(size_t node) const {
+    return node_cpus_[node];
+  }
+
+  // Returns the node of the CPU the calling thread currently runs on.
+  size_t CurrentNode() const;
+
+  // Asks the kernel to place the pages of [begin, begin + size) on the node. Returns false if the
+  // request failed or the topology is emulated.
+  bool BindMemory(void* begin, size_t size, size_t node) const;
+
+  // Returns the node the page containing addr is on, or -1 if it is unknown or not populated.
+  int GetMemoryNode(const void* addr) const;
+
+ private:
+  NumaTopology(std::vector<uint32_t> node_ids,
+               std::vector<std::vector<uint32_t>> node_cpus,
+               bool emulated);
+
+  // The sysfs ids of the nodes, which may be sparse.
+  const std::vector<uint32_t> node_ids_;
+  const std::vector<std::vector<uint32_t>> node_cpus_;
+  // Maps a CPU id to its node.
+  std::vector<uint32_t> cpu_nodes_;
+  const bool emulated_;
+
+  DISALLOW_COPY_AND_ASSIGN(NumaTopology);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_NUMA_TOPOLOGY_H_
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "numa_topology.h"
+
+#include <sched.h>
+#include <sys/stat.h>
+
+#include "base/unix_file/fd_file.h"
+#include "common_runtime_test.h"
+#include "gc/heap.h"
+#include "gc/scoped_gc_critical_section.h"
+#include "gc/space/region_space.h"
+#include "os.h"
+#include "thread-inl.h"
+
+namespace art {
+namespace gc {
+
+class NumaTopologyTest : public CommonRuntimeTest {
+ public:
+  // Allocates TLABs from the region space while running on each node in turn and returns the
+  // fraction of them that came from a region outside the node of the allocating thread. Returns
+  // a negative value if fewer than two nodes have a CPU we can run on.
+  double MeasureRemoteTlabRate(const NumaTopology& topology, space::RegionSpace* space) {
+    Thread* self = Thread::Current();
+    const size_t region_size = space->RegionSize();
+    const size_t num_regions = space->Capacity() / region_size;
+    const size_t regions_per_node =
+        RoundUp(num_regions, topology.NumNodes()) / topology.NumNodes();
+    cpu_set_t old_cpu_set;
+    CHECK_EQ(sched_getaffinity(0, sizeof(old_cpu_set), &old_cpu_set), 0);
+    size_t nodes_run = 0;
+    size_t tlabs = 0;
+    size_t remote_tlabs = 0;
+    size_t remote_pages = 0;
+    for (size_t node = 0; node < topology.NumNodes(); ++node) {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      for (uint32_t cpu : topology.GetNodeCpus(node)) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &old_cpu_set)) {
+          CPU_SET(cpu, &cpu_set);
+        }
+      }
+      if (CPU_COUNT(&cpu_set) == 0 || sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        continue;
+      }
+      ++nodes_run;
+      // Leave room for the other nodes, the space keeps half of the regions free.
+      for (size_t i = 0; i < regions_per_node / 4; ++i) {
+        if (!space->AllocNewTlab(self, region_size)) {
+          break;
+        }
+        uint8_t* tlab = self->GetTlabStart();
+        const size_t region_node =
+            (tlab - space->Begin()) / region_size / regions_per_node;
+        ++tlabs;
+        if (region_node != topology.CurrentNode()) {
+          ++remote_tlabs;
+        }
+        // Touch the region so that the kernel places it, then ask where it went.
+        *tlab = 1u;
+        int page_node = topology.GetMemoryNode(tlab);
+        if (page_node >= 0 && static_cast<size_t>(page_node) != topology.CurrentNode()) {
+          ++remote_pages;
+        }
+      }
+      space->RevokeThreadLocalBuffers(self);
+    }
+    CHECK_EQ(sched_setaffinity(0, sizeof(old_cpu_set), &old_cpu_set), 0);
+    if (nodes_run < 2 || tlabs == 0) {
+      return -1.0;
+    }
+    LOG(INFO) << (topology.IsEmulated() ? "Emulated" : "System") << " topology with "
+              << topology.NumNodes() << " nodes: " << remote_tlabs << " of " << tlabs
+              << " TLABs from a remote region, " << remote_pages << " on a remote page";
+    return static_cast<double>(remote_tlabs) / tlabs;
+  }
+
+  double RunRemoteTlabBenchmark(const NumaTopology& topology, bool numa_aware) {
+    static constexpr size_t kRegionSpaceSize = 64 * MB;
+    Thread* self = Thread::Current();
+    Heap* heap = Runtime::Current()->GetHeap();
+    ScopedGCCriticalSection gcs(self, kGcCauseDebugger, kCollectorTypeDebugger);
+    // The TLAB of this thread is about to come from the test space.
+    heap->RevokeThreadLocalBuffers(self);
+    MemMap* mem_map = space::RegionSpace::CreateMemMap("numa test space",
+                                                       kRegionSpaceSize,
+                                                       nullptr);
+    CHECK(mem_map != nullptr);
+    std::unique_ptr<space::RegionSpace> space(
+        space::RegionSpace::Create("numa test space", mem_map));
+    if (numa_aware) {
+      space->SetNumaTopology(&topology);
+    }
+    return MeasureRemoteTlabRate(topology, space.get());
+  }
+};
+
+TEST_F(NumaTopologyTest, ParseList) {
+  std::vector<uint32_t> list;
+  EXPECT_TRUE(NumaTopology::ParseList("0-3,8,10-11\n", &list));
+  EXPECT_EQ(list, std::vector<uint32_t>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_TRUE(NumaTopology::ParseList("5", &list));
+  EXPECT_EQ(list, std::vector<uint32_t>({5}));
+  // The CPU list of a memory-only node is empty.
+  EXPECT_TRUE(NumaTopology::ParseList("\n", &list));
+  EXPECT_TRUE(list.empty());
+  EXPECT_FALSE(NumaTopology::ParseList("3-1", &list));
+  EXPECT_FALSE(NumaTopology::ParseList("0-x", &list));
+  // Values that would make the range loop wrap around are rejected.
+  EXPECT_FALSE(NumaTopology::ParseList("0-4294967295", &list));
+  EXPECT_FALSE(NumaTopology::ParseList("4294967295", &list));
+}
+
+TEST_F(NumaTopologyTest, MemoryOnlyNode) {
+  const std::string node_dir = android_data_ + "/node";
+  ASSERT_EQ(0, mkdir(node_dir.c_str(), 0700));
+  auto write_file = [](const std::string& path, const std::string& content) {
+    std::unique_ptr<File> file(OS::CreateEmptyFile(path.c_str()));
+    ASSERT_TRUE(file != nullptr) << path;
+    ASSERT_TRUE(file->WriteFully(content.data(), content.size()));
+    ASSERT_EQ(0, file->FlushCloseOrErase());
+  };
+  write_file(node_dir + "/online", "0-2\n");
+  for (const char* node : { "/node0", "/node1", "/node2" }) {
+    ASSERT_EQ(0, mkdir((node_dir + node).c_str(), 0700));
+  }
+  write_file(node_dir + "/node0/cpulist", "0-1\n");
+  write_file(node_dir + "/node1/cpulist", "\n");
+  write_file(node_dir + "/node2/cpulist", "2-3\n");
+
+  // Node 1 only has memory and is left out, the other nodes are kept.
+  std::unique_ptr<NumaTopology> topology = NumaTopology::FromSysfs(node_dir);
+  ASSERT_EQ(topology->NumNodes(), 2u);
+  EXPECT_EQ(topology->GetNodeCpus(0), std::vector<uint32_t>({0, 1}));
+  EXPECT_EQ(topology->GetNodeCpus(1), std::vector<uint32_t>({2, 3}));
+
+  ClearDirectory(node_dir.c_str());
+  ASSERT_EQ(0, rmdir(node_dir.c_str()));
+}
+
+TEST_F(NumaTopologyTest, System) {
+  std::unique_ptr<NumaTopology> topology = NumaTopology::FromSystem();
+  ASSERT_GE(topology->NumNodes(), 1u);
+  EXPECT_FALSE(topology->IsEmulated());
+  EXPECT_LT(topology->CurrentNode(), topology->NumNodes());
+}
+
+TEST_F(NumaTopologyTest, Emulated) {
+  std::unique_ptr<NumaTopology> topology = NumaTopology::Emulated(2);
+  ASSERT_EQ(topology->NumNodes(), 2u);
+  EXPECT_TRUE(topology->IsEmulated());
+  EXPECT_LT(topology->CurrentNode(), 2u);
+  for (uint32_t cpu : topology->GetNodeCpus(1)) {
+    EXPECT_EQ(cpu % 2, 1u);
+  }
+  EXPECT_EQ(topology->GetMemoryNode(this), -1);
+}
+
+// Measures how often TLABs come from a remote node, with and without a NUMA aware region space.
+// Uses the topology of the machine when it has several nodes and an emulated one otherwise.
+TEST_F(NumaTopologyTest, RemoteTlabBenchmark) {
+  std::unique_ptr<NumaTopology> topology = NumaTopology::FromSystem();
+  if (topology->NumNodes() < 2) {
+    topology = NumaTopology::Emulated(2);
+  }
+  const double unaware_rate = RunRemoteTlabBenchmark(*topology, /* numa_aware */ false);
+  const double aware_rate = RunRemoteTlabBenchmark(*topology, /* numa_aware */ true);
+  if (unaware_rate < 0.0 || aware_rate < 0.0) {
+    LOG(INFO) << "Not enough usable CPUs to run on two nodes, skipping";
+    return;
+  }
+  LOG(INFO) << "Remote TLAB rate: " << unaware_rate << " unaware, " << aware_rate << " aware";
+  EXPECT_LE(aware_rate, unaware_rate);
+  // The thread can migrate between CPUs of its node but never to another node.
+  EXPECT_EQ(aware_rate, 0.0);
+}
+
+}  // namespace gc
+}  // namespace art
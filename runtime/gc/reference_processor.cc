@@ -18,6 +18,7 @@
 
 #include "base/time_utils.h"
 #include "collector/garbage_collector.h"
+#include "heap.h"
 #include "java_vm_ext.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
@@ -27,6 +28,7 @@
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change-inl.h"
 #include "task_processor.h"
+#include "thread_pool.h"
 #include "utils.h"
 #include "well_known_classes.h"
 
@@ -34,6 +36,57 @@ namespace art {
 namespace gc {
 
 static constexpr bool kAsyncReferenceQueueAdd = false;
+// Whether to check referents using the heap thread pool.
+static constexpr bool kParallelReferenceProcessing = true;
+// Minimum number of references checked by each thread pool task.
+static constexpr size_t kMinReferencesPerTask = 256;
+
+// Checks the referents of a chunk of dequeued references. The white references are compacted to
+// the start of the chunk and enqueued by the GC thread once all of the tasks are done, since
+// ReferenceQueue::EnqueueReference is not thread safe.
+class ReferenceProcessor::ProcessReferencesTask : public Task {
+ public:
+  ProcessReferencesTask(collector::GarbageCollector* collector,
+                        mirror::Reference** refs,
+                        size_t count,
+                        bool clear_referents)
+      : collector_(collector),
+        refs_(refs),
+        count_(count),
+        clear_referents_(clear_referents),
+        num_white_(0) {}
+
+  virtual void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    for (size_t i = 0; i < count_; ++i) {
+      ObjPtr<mirror::Reference> ref = refs_[i];
+      if (clear_referents_) {
+        if (ReferenceQueue::ClearReferentIfWhite(ref, collector_)) {
+          refs_[num_white_++] = ref.Ptr();
+        }
+      } else if (ReferenceQueue::IsWhiteReferent(ref, collector_)) {
+        // The read barrier of a finalizer reference is disabled after its referent is marked.
+        refs_[num_white_++] = ref.Ptr();
+        continue;
+      }
+      ReferenceQueue::DisableReadBarrierForReference(ref);
+    }
+  }
+
+  mirror::Reference** GetWhiteReferences() const {
+    return refs_;
+  }
+
+  size_t GetNumWhiteReferences() const {
+    return num_white_;
+  }
+
+ private:
+  collector::GarbageCollector* const collector_;
+  mirror::Reference** const refs_;
+  const size_t count_;
+  const bool clear_referents_;
+  size_t num_white_;
+};
 
 ReferenceProcessor::ReferenceProcessor()
     : collector_(nullptr),
@@ -163,9 +216,13 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
       StopPreservingReferences(self);
     }
   }
-  // Clear all remaining soft and weak references with white referents.
-  soft_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  weak_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  {
+    // Clear all remaining soft and weak references with white referents.
+    TimingLogger::ScopedTiming t2(concurrent ? "ClearWhiteReferences" :
+        "(Paused)ClearWhiteReferences", timings);
+    ClearWhiteReferences(&soft_reference_queue_, concurrent, collector);
+    ClearWhiteReferences(&weak_reference_queue_, concurrent, collector);
+  }
   {
     TimingLogger::ScopedTiming t2(concurrent ? "EnqueueFinalizerReferences" :
         "(Paused)EnqueueFinalizerReferences", timings);
@@ -173,17 +230,21 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
       StartPreservingReferences(self);
     }
     // Preserve all white objects with finalize methods and schedule them for finalization.
-    finalizer_reference_queue_.EnqueueFinalizerReferences(&cleared_references_, collector);
+    EnqueueFinalizerReferences(concurrent, collector);
     collector->ProcessMarkStack();
     if (concurrent) {
       StopPreservingReferences(self);
     }
   }
-  // Clear all finalizer referent reachable soft and weak references with white referents.
-  soft_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  weak_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  // Clear all phantom references with white referents.
-  phantom_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  {
+    TimingLogger::ScopedTiming t2(concurrent ? "ClearFinalizerReachableReferences" :
+        "(Paused)ClearFinalizerReachableReferences", timings);
+    // Clear all finalizer referent reachable soft and weak references with white referents.
+    ClearWhiteReferences(&soft_reference_queue_, concurrent, collector);
+    ClearWhiteReferences(&weak_reference_queue_, concurrent, collector);
+    // Clear all phantom references with white referents.
+    ClearWhiteReferences(&phantom_reference_queue_, concurrent, collector);
+  }
   // At this point all reference queues other than the cleared references should be empty.
   DCHECK(soft_reference_queue_.IsEmpty());
   DCHECK(weak_reference_queue_.IsEmpty());
@@ -203,6 +264,95 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
   }
 }
 
+bool ReferenceProcessor::FindWhiteReferencesInParallel(ReferenceQueue* queue,
+                                                       bool clear_referents,
+                                                       bool concurrent,
+                                                       collector::GarbageCollector* collector) {
+  Runtime* const runtime = Runtime::Current();
+  Heap* const heap = runtime->GetHeap();
+  ThreadPool* const thread_pool = heap->GetThreadPool();
+  // Use less threads if we are in a background state (non jank perceptible) since we want to leave
+  // more CPU time for the foreground apps.
+  if (!kParallelReferenceProcessing ||
+      thread_pool == nullptr ||
+      queue->IsEmpty() ||
+      !runtime->InJankPerceptibleProcessState()) {
+    return false;
+  }
+  const size_t thread_count =
+      (concurrent ? heap->GetConcGCThreadCount() : heap->GetParallelGCThreadCount()) + 1;
+  if (thread_count <= 1) {
+    return false;
+  }
+  Thread* const self = Thread::Current();
+  DCHECK(pending_references_.empty());
+  queue->DequeuePendingReferences(&pending_references_);
+  const size_t num_refs = pending_references_.size();
+  if (num_refs < kMinParallelReferences) {
+    // Not worth waking up the workers.
+    ProcessReferencesTask task(collector, pending_references_.data(), num_refs, clear_referents);
+    task.Run(self);
+    pending_references_.resize(task.GetNumWhiteReferences());
+    return true;
+  }
+  // Use a few tasks per thread so that a slow chunk does not hold up the others.
+  const size_t chunk_size = std::max(kMinReferencesPerTask, num_refs / (thread_count * 4) + 1);
+  std::vector<std::unique_ptr<ProcessReferencesTask>> tasks;
+  for (size_t begin = 0; begin < num_refs; begin += chunk_size) {
+    tasks.emplace_back(new ProcessReferencesTask(collector,
+                                                 pending_references_.data() + begin,
+                                                 std::min(chunk_size, num_refs - begin),
+                                                 clear_referents));
+    thread_pool->AddTask(self, tasks.back().get());
+  }
+  thread_pool->SetMaxActiveWorkers(thread_count - 1);
+  thread_pool->StartWorkers(self);
+  thread_pool->Wait(self, true, true);
+  thread_pool->StopWorkers(self);
+  // Gather the white references of each chunk at the front of the vector.
+  size_t num_white = 0;
+  for (const std::unique_ptr<ProcessReferencesTask>& task : tasks) {
+    mirror::Reference** white_refs = task->GetWhiteReferences();
+    for (size_t i = 0; i < task->GetNumWhiteReferences(); ++i) {
+      pending_references_[num_white++] = white_refs[i];
+    }
+  }
+  pending_references_.resize(num_white);
+  return true;
+}
+
+void ReferenceProcessor::ClearWhiteReferences(ReferenceQueue* queue,
+                                              bool concurrent,
+                                              collector::GarbageCollector* collector) {
+  if (!FindWhiteReferencesInParallel(queue, /*clear_referents*/ true, concurrent, collector)) {
+    queue->ClearWhiteReferences(&cleared_references_, collector);
+    return;
+  }
+  for (mirror::Reference* ref : pending_references_) {
+    cleared_references_.EnqueueReference(ref);
+  }
+  pending_references_.clear();
+}
+
+void ReferenceProcessor::EnqueueFinalizerReferences(bool concurrent,
+                                                    collector::GarbageCollector* collector) {
+  if (!FindWhiteReferencesInParallel(&finalizer_reference_queue_,
+                                     /*clear_referents*/ false,
+                                     concurrent,
+                                     collector)) {
+    finalizer_reference_queue_.EnqueueFinalizerReferences(&cleared_references_, collector);
+    return;
+  }
+  // Marking stays on the GC thread since MarkObject is not thread safe for every collector. The
+  // mark stack is then processed by ProcessMarkStack, which is parallel where supported.
+  for (mirror::Reference* ref : pending_references_) {
+    ReferenceQueue::EnqueueFinalizerReference(ref->AsFinalizerReference(),
+                                              &cleared_references_,
+                                              collector);
+  }
+  pending_references_.clear();
+}
+
 // Process the "referent" field in a java.lang.ref.Reference.  If the referent has not yet been
 // marked, put it on the appropriate list in the heap for later processing.
 void ReferenceProcessor::DelayReferenceReferent(ObjPtr<mirror::Class> klass,
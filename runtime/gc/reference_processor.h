@@ -17,6 +17,8 @@
 #ifndef ART_RUNTIME_GC_REFERENCE_PROCESSOR_H_
 #define ART_RUNTIME_GC_REFERENCE_PROCESSOR_H_
 
+#include <vector>
+
 #include "base/mutex.h"
 #include "globals.h"
 #include "jni.h"
@@ -76,9 +78,37 @@ class ReferenceProcessor {
   void ClearReferent(ObjPtr<mirror::Reference> ref)
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!Locks::reference_processor_lock_);
+  // Whether the referents of soft and finalizer references are being marked, during which a
+  // marked object may be reachable only through unmarked ones. See GetReferent().
+  bool IsPreservingReferences() const REQUIRES(Locks::reference_processor_lock_) {
+    return preserving_references_;
+  }
 
  private:
+  class ProcessReferencesTask;
+
+  // Queues shorter than this are processed by the GC thread alone.
+  static constexpr size_t kMinParallelReferences = 1024;
+
   bool SlowPathEnabled() REQUIRES_SHARED(Locks::mutator_lock_);
+  // Clear the white referents of the references on queue, using the heap thread pool if the
+  // queue is large enough.
+  void ClearWhiteReferences(ReferenceQueue* queue,
+                            bool concurrent,
+                            collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+  // Preserve the white referents of the finalizer references and enqueue them on the cleared
+  // references, the referent checks are done by the heap thread pool.
+  void EnqueueFinalizerReferences(bool concurrent, collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+  // Dequeue queue into pending_references_ and check the referents with the heap thread pool.
+  // White references are left in pending_references_, or false is returned if the queue should
+  // be processed on the current thread.
+  bool FindWhiteReferencesInParallel(ReferenceQueue* queue,
+                                     bool clear_referents,
+                                     bool concurrent,
+                                     collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
   // Called by ProcessReferences.
   void DisableSlowPath(Thread* self) REQUIRES(Locks::reference_processor_lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
@@ -106,6 +136,10 @@ class ReferenceProcessor {
   ReferenceQueue finalizer_reference_queue_;
   ReferenceQueue phantom_reference_queue_;
   ReferenceQueue cleared_references_;
+  // Scratch space for parallel reference processing, only used by the GC thread.
+  std::vector<mirror::Reference*> pending_references_;
+
+  friend class ReferenceProcessorTest;  // For the queues and FindWhiteReferencesInParallel.
 
   DISALLOW_COPY_AND_ASSIGN(ReferenceProcessor);
 };
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "reference_processor.h"
+
+#include <set>
+#include <vector>
+
+#include "class_linker-inl.h"
+#include "common_runtime_test.h"
+#include "gc/collector/garbage_collector.h"
+#include "gc/heap.h"
+#include "handle_scope-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/object_array-inl.h"
+#include "mirror/reference-inl.h"
+#include "scoped_thread_state_change-inl.h"
+#include "thread_pool.h"
+
+namespace art {
+namespace gc {
+
+// Treats the objects it was told to mark as marked, and every other object as white.
+class MarkedSetCollector : public collector::GarbageCollector {
+ public:
+  explicit MarkedSetCollector(Heap* heap) : GarbageCollector(heap, "marked set collector") {}
+
+  collector::GcType GetGcType() const OVERRIDE {
+    return collector::kGcTypeFull;
+  }
+  CollectorType GetCollectorType() const OVERRIDE {
+    return kCollectorTypeMS;
+  }
+
+  mirror::Object* IsMarked(mirror::Object* obj) OVERRIDE REQUIRES_SHARED(Locks::mutator_lock_) {
+    return marked_.find(obj) != marked_.end() ? obj : nullptr;
+  }
+  bool IsNullOrMarkedHeapReference(mirror::HeapReference<mirror::Object>* obj,
+                                   bool do_atomic_update ATTRIBUTE_UNUSED) OVERRIDE
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    mirror::Object* ref = obj->AsMirrorPtr();
+    return ref == nullptr || IsMarked(ref) != nullptr;
+  }
+  void ProcessMarkStack() OVERRIDE REQUIRES_SHARED(Locks::mutator_lock_) {}
+  mirror::Object* MarkObject(mirror::Object* obj) OVERRIDE REQUIRES_SHARED(Locks::mutator_lock_) {
+    marked_.insert(obj);
+    return obj;
+  }
+  void MarkHeapReference(mirror::HeapReference<mirror::Object>* obj,
+                         bool do_atomic_update ATTRIBUTE_UNUSED) OVERRIDE
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    MarkObject(obj->AsMirrorPtr());
+  }
+  void DelayReferenceReferent(ObjPtr<mirror::Class> klass ATTRIBUTE_UNUSED,
+                              ObjPtr<mirror::Reference> reference ATTRIBUTE_UNUSED) OVERRIDE
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    UNIMPLEMENTED(FATAL);
+  }
+
+ protected:
+  void RunPhases() OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+  void RevokeAllThreadLocalBuffers() OVERRIDE {}
+
+ private:
+  // Only written by the test thread, before the thread pool reads it.
+  std::set<mirror::Object*> marked_;
+};
+
+class ReferenceProcessorTest : public CommonRuntimeTest {
+ protected:
+  // Enough references to be split into chunks for several tasks.
+  static constexpr size_t kNumReferences = 3 * ReferenceProcessor::kMinParallelReferences;
+
+  void SetUpRuntimeOptions(RuntimeOptions* options) OVERRIDE {
+    CommonRuntimeTest::SetUpRuntimeOptions(options);
+    // Make sure the heap thread pool has workers to check the referents with.
+    options->push_back(std::make_pair("-XX:ParallelGCThreads=4", nullptr));
+  }
+
+  // Allocates kNumReferences references of the given class into refs. Every seventh reference
+  // has no referent, the others get a new object as referent.
+  void AllocReferences(Thread* self,
+                       const char* descriptor,
+                       MutableHandle<mirror::ObjectArray<mirror::Object>> refs)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+    StackHandleScope<2> hs(self);
+    Handle<mirror::Class> ref_class(hs.NewHandle(class_linker->FindSystemClass(self, descriptor)));
+    ASSERT_TRUE(ref_class != nullptr);
+    Handle<mirror::Class> object_class(
+        hs.NewHandle(class_linker->FindSystemClass(self, "Ljava/lang/Object;")));
+    ASSERT_TRUE(object_class != nullptr);
+    refs.Assign(mirror::ObjectArray<mirror::Object>::Alloc(
+        self, class_linker->GetClassRoot(ClassLinker::kObjectArrayClass), kNumReferences));
+    ASSERT_TRUE(refs != nullptr);
+    for (size_t i = 0; i < kNumReferences; ++i) {
+      ObjPtr<mirror::Object> ref = ref_class->AllocObject(self);
+      ASSERT_TRUE(ref != nullptr);
+      refs->Set<false>(i, ref);
+      if (i % 7 != 0) {
+        ObjPtr<mirror::Object> referent = object_class->AllocObject(self);
+        ASSERT_TRUE(referent != nullptr);
+        refs->Get(i)->AsReference()->SetReferent<false>(referent);
+      }
+    }
+  }
+
+  // Marks the referents of every third reference, enqueues all of the references on queue and
+  // returns the references with white referents. Records the referents in referents.
+  std::set<mirror::Reference*> MarkAndEnqueue(mirror::ObjectArray<mirror::Object>* refs,
+                                              MarkedSetCollector* collector,
+                                              ReferenceQueue* queue,
+                                              std::vector<mirror::Object*>* referents)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    std::set<mirror::Reference*> white_refs;
+    for (size_t i = 0; i < kNumReferences; ++i) {
+      mirror::Reference* ref = refs->Get(i)->AsReference();
+      mirror::Object* referent = ref->GetReferent();
+      referents->push_back(referent);
+      if (referent != nullptr) {
+        if (i % 3 == 0) {
+          collector->MarkObject(referent);
+        } else {
+          white_refs.insert(ref);
+        }
+      }
+      queue->EnqueueReference(ref);
+    }
+    return white_refs;
+  }
+
+  // Whether FindWhiteReferencesInParallel may use the heap thread pool.
+  static bool CanProcessInParallel() {
+    Heap* heap = Runtime::Current()->GetHeap();
+    return heap->GetThreadPool() != nullptr &&
+        heap->GetParallelGCThreadCount() > 0u &&
+        Runtime::Current()->InJankPerceptibleProcessState();
+  }
+
+  static ReferenceQueue* GetWeakReferenceQueue(ReferenceProcessor* processor) {
+    return &processor->weak_reference_queue_;
+  }
+  static ReferenceQueue* GetFinalizerReferenceQueue(ReferenceProcessor* processor) {
+    return &processor->finalizer_reference_queue_;
+  }
+  static ReferenceQueue* GetClearedReferences(ReferenceProcessor* processor) {
+    return &processor->cleared_references_;
+  }
+
+  static void ClearWhiteReferences(ReferenceProcessor* processor,
+                                   ReferenceQueue* queue,
+                                   MarkedSetCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    processor->ClearWhiteReferences(queue, /* concurrent */ false, collector);
+  }
+
+  static bool FindWhiteReferencesInParallel(ReferenceProcessor* processor,
+                                            ReferenceQueue* queue,
+                                            MarkedSetCollector* collector,
+                                            /* out */ std::vector<mirror::Reference*>* white_refs)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    if (!processor->FindWhiteReferencesInParallel(
+            queue, /* clear_referents */ false, /* concurrent */ false, collector)) {
+      return false;
+    }
+    white_refs->swap(processor->pending_references_);
+    return true;
+  }
+};
+
+TEST_F(ReferenceProcessorTest, ClearWhiteReferencesInParallel) {
+  ASSERT_TRUE(CanProcessInParallel());
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<1> hs(self);
+  MutableHandle<mirror::ObjectArray<mirror::Object>> refs(
+      hs.NewHandle<mirror::ObjectArray<mirror::Object>>(nullptr));
+  AllocReferences(self, "Ljava/lang/ref/WeakReference;", refs);
+  ASSERT_TRUE(refs != nullptr);
+
+  // Nothing is allocated from here on, so the objects stay where they are.
+  ReferenceProcessor processor;
+  MarkedSetCollector collector(Runtime::Current()->GetHeap());
+  std::vector<mirror::Object*> referents;
+  const std::set<mirror::Reference*> white_refs =
+      MarkAndEnqueue(refs.Get(), &collector, GetWeakReferenceQueue(&processor), &referents);
+  ClearWhiteReferences(&processor, GetWeakReferenceQueue(&processor), &collector);
+  EXPECT_TRUE(GetWeakReferenceQueue(&processor)->IsEmpty());
+
+  // Exactly the references with white referents are enqueued, each of them once.
+  ReferenceQueue* cleared = GetClearedReferences(&processor);
+  EXPECT_EQ(white_refs.size(), cleared->GetLength());
+  std::set<mirror::Reference*> cleared_refs;
+  while (!cleared->IsEmpty()) {
+    cleared_refs.insert(cleared->DequeuePendingReference().Ptr());
+  }
+  EXPECT_EQ(white_refs, cleared_refs);
+  // Their referents are cleared, and the other references keep theirs.
+  for (size_t i = 0; i < kNumReferences; ++i) {
+    mirror::Reference* ref = refs->Get(i)->AsReference();
+    if (white_refs.find(ref) != white_refs.end()) {
+      EXPECT_TRUE(ref->GetReferent() == nullptr) << i;
+    } else {
+      EXPECT_EQ(referents[i], ref->GetReferent()) << i;
+    }
+  }
+}
+
+TEST_F(ReferenceProcessorTest, FindWhiteFinalizerReferencesInParallel) {
+  ASSERT_TRUE(CanProcessInParallel());
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<1> hs(self);
+  MutableHandle<mirror::ObjectArray<mirror::Object>> refs(
+      hs.NewHandle<mirror::ObjectArray<mirror::Object>>(nullptr));
+  AllocReferences(self, "Ljava/lang/ref/FinalizerReference;", refs);
+  ASSERT_TRUE(refs != nullptr);
+
+  ReferenceProcessor processor;
+  MarkedSetCollector collector(Runtime::Current()->GetHeap());
+  std::vector<mirror::Object*> referents;
+  const std::set<mirror::Reference*> white_refs =
+      MarkAndEnqueue(refs.Get(), &collector, GetFinalizerReferenceQueue(&processor), &referents);
+  std::vector<mirror::Reference*> found;
+  ASSERT_TRUE(FindWhiteReferencesInParallel(
+      &processor, GetFinalizerReferenceQueue(&processor), &collector, &found));
+  EXPECT_TRUE(GetFinalizerReferenceQueue(&processor)->IsEmpty());
+
+  // The white references of every chunk are gathered, each of them once.
+  EXPECT_EQ(white_refs.size(), found.size());
+  EXPECT_EQ(white_refs, std::set<mirror::Reference*>(found.begin(), found.end()));
+  // The referents of finalizer references are left for the GC thread to mark.
+  for (size_t i = 0; i < kNumReferences; ++i) {
+    EXPECT_EQ(referents[i], refs->Get(i)->AsReference()->GetReferent()) << i;
+  }
+}
+
+}  // namespace gc
+}  // namespace art
@@ -70,6 +70,12 @@ ObjPtr<mirror::Reference> ReferenceQueue::DequeuePendingReference() {
   return ref;
 }
 
+void ReferenceQueue::DequeuePendingReferences(std::vector<mirror::Reference*>* refs) {
+  while (!IsEmpty()) {
+    refs->push_back(DequeuePendingReference().Ptr());
+  }
+}
+
 // This must be called whenever DequeuePendingReference is called.
 void ReferenceQueue::DisableReadBarrierForReference(ObjPtr<mirror::Reference> ref) {
   Heap* heap = Runtime::Current()->GetHeap();
@@ -128,20 +134,33 @@ size_t ReferenceQueue::GetLength() const {
   return count;
 }
 
+bool ReferenceQueue::IsWhiteReferent(ObjPtr<mirror::Reference> ref,
+                                     collector::GarbageCollector* collector) {
+  mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
+  // do_atomic_update is false because this happens during the reference processing phase where
+  // Reference.clear() would block.
+  return !collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update*/false);
+}
+
+bool ReferenceQueue::ClearReferentIfWhite(ObjPtr<mirror::Reference> ref,
+                                          collector::GarbageCollector* collector) {
+  if (!IsWhiteReferent(ref, collector)) {
+    return false;
+  }
+  // Referent is white, clear it.
+  if (Runtime::Current()->IsActiveTransaction()) {
+    ref->ClearReferent<true>();
+  } else {
+    ref->ClearReferent<false>();
+  }
+  return true;
+}
+
 void ReferenceQueue::ClearWhiteReferences(ReferenceQueue* cleared_references,
                                           collector::GarbageCollector* collector) {
   while (!IsEmpty()) {
     ObjPtr<mirror::Reference> ref = DequeuePendingReference();
-    mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
-    // do_atomic_update is false because this happens during the reference processing phase where
-    // Reference.clear() would block.
-    if (!collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update*/false)) {
-      // Referent is white, clear it.
-      if (Runtime::Current()->IsActiveTransaction()) {
-        ref->ClearReferent<true>();
-      } else {
-        ref->ClearReferent<false>();
-      }
+    if (ClearReferentIfWhite(ref, collector)) {
       cleared_references->EnqueueReference(ref);
     }
     // Delay disabling the read barrier until here so that the ClearReferent call above in
@@ -150,28 +169,33 @@ void ReferenceQueue::ClearWhiteReferences(ReferenceQueue* cleared_references,
   }
 }
 
+void ReferenceQueue::EnqueueFinalizerReference(ObjPtr<mirror::FinalizerReference> ref,
+                                               ReferenceQueue* cleared_references,
+                                               collector::GarbageCollector* collector) {
+  if (IsWhiteReferent(ref->AsReference(), collector)) {
+    mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
+    ObjPtr<mirror::Object> forward_address = collector->MarkObject(referent_addr->AsMirrorPtr());
+    // Move the updated referent to the zombie field.
+    if (Runtime::Current()->IsActiveTransaction()) {
+      ref->SetZombie<true>(forward_address);
+      ref->ClearReferent<true>();
+    } else {
+      ref->SetZombie<false>(forward_address);
+      ref->ClearReferent<false>();
+    }
+    cleared_references->EnqueueReference(ref);
+  }
+  // Delay disabling the read barrier until here so that the ClearReferent call above in
+  // transaction mode will trigger the read barrier.
+  DisableReadBarrierForReference(ref->AsReference());
+}
+
 void ReferenceQueue::EnqueueFinalizerReferences(ReferenceQueue* cleared_references,
                                                 collector::GarbageCollector* collector) {
   while (!IsEmpty()) {
-    ObjPtr<mirror::FinalizerReference> ref = DequeuePendingReference()->AsFinalizerReference();
-    mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
-    // do_atomic_update is false because this happens during the reference processing phase where
-    // Reference.clear() would block.
-    if (!collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update*/false)) {
-      ObjPtr<mirror::Object> forward_address = collector->MarkObject(referent_addr->AsMirrorPtr());
-      // Move the updated referent to the zombie field.
-      if (Runtime::Current()->IsActiveTransaction()) {
-        ref->SetZombie<true>(forward_address);
-        ref->ClearReferent<true>();
-      } else {
-        ref->SetZombie<false>(forward_address);
-        ref->ClearReferent<false>();
-      }
-      cleared_references->EnqueueReference(ref);
-    }
-    // Delay disabling the read barrier until here so that the ClearReferent call above in
-    // transaction mode will trigger the read barrier.
-    DisableReadBarrierForReference(ref->AsReference());
+    EnqueueFinalizerReference(DequeuePendingReference()->AsFinalizerReference(),
+                              cleared_references,
+                              collector);
   }
 }
 
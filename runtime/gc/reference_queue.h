@@ -33,6 +33,7 @@
 
 namespace art {
 namespace mirror {
+class FinalizerReference;
 class Reference;
 }  // namespace mirror
 
@@ -66,10 +67,33 @@ class ReferenceQueue {
   // Call DisableReadBarrierForReference for the reference that's returned from this function.
   ObjPtr<mirror::Reference> DequeuePendingReference() REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Dequeue all of the references, appending them to refs. Call DisableReadBarrierForReference
+  // for each of them.
+  void DequeuePendingReferences(std::vector<mirror::Reference*>* refs)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // If applicable, disable the read barrier for the reference after its referent is handled (see
   // ConcurrentCopying::ProcessMarkStackRef.) This must be called for a reference that's dequeued
   // from pending queue (DequeuePendingReference).
-  void DisableReadBarrierForReference(ObjPtr<mirror::Reference> ref)
+  static void DisableReadBarrierForReference(ObjPtr<mirror::Reference> ref)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Returns true if the referent of a dequeued reference is non-null and unmarked.
+  static bool IsWhiteReferent(ObjPtr<mirror::Reference> ref,
+                              collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Clear the referent of a dequeued reference if it is white, returns true if it was cleared.
+  // Safe to call from multiple threads for distinct references.
+  static bool ClearReferentIfWhite(ObjPtr<mirror::Reference> ref,
+                                   collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Handle a dequeued finalizer reference: a white referent is marked, moved to the zombie field
+  // and the reference is enqueued on cleared_references.
+  static void EnqueueFinalizerReference(ObjPtr<mirror::FinalizerReference> ref,
+                                        ReferenceQueue* cleared_references,
+                                        collector::GarbageCollector* collector)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Enqueues finalizer references with white referents.  White referents are blackened, moved to
@@ -61,6 +61,36 @@ TEST_F(ReferenceQueueTest, EnqueueDequeue) {
   ASSERT_EQ(refs, dequeued);
 }
 
+TEST_F(ReferenceQueueTest, DequeuePendingReferences) {
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<20> hs(self);
+  Mutex lock("Reference queue lock");
+  ReferenceQueue queue(&lock);
+  auto ref_class = hs.NewHandle(
+      Runtime::Current()->GetClassLinker()->FindClass(self, "Ljava/lang/ref/WeakReference;",
+                                                      ScopedNullHandle<mirror::ClassLoader>()));
+  ASSERT_TRUE(ref_class != nullptr);
+  std::set<mirror::Reference*> refs;
+  for (size_t i = 0; i < 3; ++i) {
+    auto ref(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+    ASSERT_TRUE(ref != nullptr);
+    queue.EnqueueReference(ref.Get());
+    refs.insert(ref.Get());
+  }
+  ASSERT_EQ(queue.GetLength(), 3U);
+
+  std::vector<mirror::Reference*> dequeued;
+  queue.DequeuePendingReferences(&dequeued);
+  ASSERT_TRUE(queue.IsEmpty());
+  ASSERT_EQ(dequeued.size(), 3U);
+  ASSERT_EQ(refs, std::set<mirror::Reference*>(dequeued.begin(), dequeued.end()));
+  for (mirror::Reference* ref : dequeued) {
+    // Dequeued references are unprocessed again and can be re-enqueued.
+    ASSERT_TRUE(ref->IsUnprocessed());
+  }
+}
+
 TEST_F(ReferenceQueueTest, Dump) {
   Thread* self = Thread::Current();
   ScopedObjectAccess soa(self);
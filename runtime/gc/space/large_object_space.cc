@@ -20,6 +20,7 @@
 
 #include "gc/accounting/heap_bitmap-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "base/bit_utils.h"
 #include "base/logging.h"
 #include "base/memory_tool.h"
 #include "base/mutex-inl.h"
@@ -36,7 +37,9 @@ namespace space {
 
 class MemoryToolLargeObjectMapSpace FINAL : public LargeObjectMapSpace {
  public:
-  explicit MemoryToolLargeObjectMapSpace(const std::string& name) : LargeObjectMapSpace(name) {
+  // Reused maps would hide use after free of large objects, so don't cache them.
+  explicit MemoryToolLargeObjectMapSpace(const std::string& name)
+      : LargeObjectMapSpace(name, /* map_cache_capacity */ 0) {
   }
 
   ~MemoryToolLargeObjectMapSpace() OVERRIDE {
@@ -117,27 +120,78 @@ void LargeObjectSpace::CopyLiveToMarked() {
   mark_bitmap_->CopyFrom(live_bitmap_.get());
 }
 
-LargeObjectMapSpace::LargeObjectMapSpace(const std::string& name)
+LargeObjectMapSpace::LargeObjectMapSpace(const std::string& name, size_t map_cache_capacity)
     : LargeObjectSpace(name, nullptr, nullptr),
-      lock_("large object map space lock", kAllocSpaceLock) {}
+      lock_("large object map space lock", kAllocSpaceLock),
+      map_cache_bytes_(0),
+      num_reserved_maps_(0),
+      map_cache_capacity_(map_cache_capacity) {}
+
+LargeObjectMapSpace::~LargeObjectMapSpace() {
+  MutexLock mu(Thread::Current(), lock_);
+  for (auto& pair : map_cache_) {
+    delete pair.second;
+  }
+}
 
 LargeObjectMapSpace* LargeObjectMapSpace::Create(const std::string& name) {
   if (Runtime::Current()->IsRunningOnMemoryTool()) {
     return new MemoryToolLargeObjectMapSpace(name);
   } else {
-    return new LargeObjectMapSpace(name);
+    return new LargeObjectMapSpace(name, kDefaultMapCacheCapacity);
+  }
+}
+
+MemMap* LargeObjectMapSpace::TakeCachedMap(size_t num_bytes) {
+  const size_t map_size = RoundUp(num_bytes, kPageSize);
+  auto it = map_cache_.lower_bound(map_size);
+  // Don't let a small object hold on to a much larger map, at most 1/8 of the map is wasted.
+  if (it == map_cache_.end() || it->first - map_size > it->first / 8) {
+    return nullptr;
+  }
+  MemMap* mem_map = it->second;
+  map_cache_.erase(it);
+  DCHECK_GE(map_cache_bytes_, mem_map->BaseSize());
+  map_cache_bytes_ -= mem_map->BaseSize();
+  return mem_map;
+}
+
+bool LargeObjectMapSpace::ReserveCachedMap(size_t map_size) {
+  if (map_cache_.size() + num_reserved_maps_ >= kMaxCachedMaps ||
+      map_cache_bytes_ + map_size > map_cache_capacity_) {
+    return false;
   }
+  map_cache_bytes_ += map_size;
+  ++num_reserved_maps_;
+  return true;
+}
+
+void LargeObjectMapSpace::CacheMap(MemMap* mem_map) {
+  DCHECK_GT(num_reserved_maps_, 0u);
+  --num_reserved_maps_;
+  map_cache_.emplace(mem_map->BaseSize(), mem_map);
 }
 
 mirror::Object* LargeObjectMapSpace::Alloc(Thread* self, size_t num_bytes,
                                            size_t* bytes_allocated, size_t* usable_size,
                                            size_t* bytes_tl_bulk_allocated) {
-  std::string error_msg;
-  MemMap* mem_map = MemMap::MapAnonymous("large object space allocation", nullptr, num_bytes,
-                                         PROT_READ | PROT_WRITE, true, false, &error_msg);
-  if (UNLIKELY(mem_map == nullptr)) {
-    LOG(WARNING) << "Large object allocation failed: " << error_msg;
-    return nullptr;
+  MemMap* mem_map = nullptr;
+  if (map_cache_capacity_ != 0) {
+    MutexLock mu(self, lock_);
+    mem_map = TakeCachedMap(num_bytes);
+  }
+  if (mem_map != nullptr) {
+    if (kIsDebugBuild) {
+      CHECK(mem_map->Protect(PROT_READ | PROT_WRITE));
+    }
+  } else {
+    std::string error_msg;
+    mem_map = MemMap::MapAnonymous("large object space allocation", nullptr, num_bytes,
+                                   PROT_READ | PROT_WRITE, true, false, &error_msg);
+    if (UNLIKELY(mem_map == nullptr)) {
+      LOG(WARNING) << "Large object allocation failed: " << error_msg;
+      return nullptr;
+    }
   }
   mirror::Object* const obj = reinterpret_cast<mirror::Object*>(mem_map->Begin());
   MutexLock mu(self, lock_);
@@ -178,21 +232,37 @@ void LargeObjectMapSpace::SetAllLargeObjectsAsZygoteObjects(Thread* self) {
 }
 
 size_t LargeObjectMapSpace::Free(Thread* self, mirror::Object* ptr) {
+  MemMap* mem_map;
+  bool cache_map;
+  {
+    MutexLock mu(self, lock_);
+    auto it = large_objects_.find(ptr);
+    if (UNLIKELY(it == large_objects_.end())) {
+      ScopedObjectAccess soa(self);
+      Runtime::Current()->GetHeap()->DumpSpaces(LOG_STREAM(FATAL_WITHOUT_ABORT));
+      LOG(FATAL) << "Attempted to free large object " << ptr << " which was not live";
+    }
+    mem_map = it->second.mem_map;
+    DCHECK_GE(num_bytes_allocated_, mem_map->BaseSize());
+    num_bytes_allocated_ -= mem_map->BaseSize();
+    --num_objects_allocated_;
+    large_objects_.erase(it);
+    cache_map = ReserveCachedMap(mem_map->BaseSize());
+  }
+  const size_t allocation_size = mem_map->BaseSize();
+  // The map is no longer reachable from the space, release or unmap it without holding lock_.
+  if (!cache_map) {
+    delete mem_map;
+    return allocation_size;
+  }
+  // A reused map must read as zero.
+  mem_map->MadviseDontNeedAndZero();
+  if (kIsDebugBuild) {
+    // Catch accesses to the freed object.
+    CHECK(mem_map->Protect(PROT_NONE));
+  }
   MutexLock mu(self, lock_);
-  auto it = large_objects_.find(ptr);
-  if (UNLIKELY(it == large_objects_.end())) {
-    ScopedObjectAccess soa(self);
-    Runtime::Current()->GetHeap()->DumpSpaces(LOG_STREAM(FATAL_WITHOUT_ABORT));
-    LOG(FATAL) << "Attempted to free large object " << ptr << " which was not live";
-  }
-  MemMap* mem_map = it->second.mem_map;
-  const size_t map_size = mem_map->BaseSize();
-  DCHECK_GE(num_bytes_allocated_, map_size);
-  size_t allocation_size = map_size;
-  num_bytes_allocated_ -= allocation_size;
-  --num_objects_allocated_;
-  delete mem_map;
-  large_objects_.erase(it);
+  CacheMap(mem_map);
   return allocation_size;
 }
 
@@ -353,7 +423,9 @@ FreeListSpace* FreeListSpace::Create(const std::string& name, uint8_t* requested
 FreeListSpace::FreeListSpace(const std::string& name, MemMap* mem_map, uint8_t* begin, uint8_t* end)
     : LargeObjectSpace(name, begin, end),
       mem_map_(mem_map),
-      lock_("free list space lock", kAllocSpaceLock) {
+      lock_("free list space lock", kAllocSpaceLock),
+      non_empty_free_bins_(0) {
+  static_assert(kNumFreeBins <= BitSizeOf<uint64_t>(), "Too many free bins");
   const size_t space_capacity = end - begin;
   free_end_ = space_capacity;
   CHECK_ALIGNED(space_capacity, kAlignment);
@@ -390,22 +462,73 @@ void FreeListSpace::Walk(DlMallocSpace::WalkCallback callback, void* arg) {
 
 void FreeListSpace::RemoveFreePrev(AllocationInfo* info) {
   CHECK_GT(info->GetPrevFree(), 0U);
-  auto it = free_blocks_.lower_bound(info);
-  CHECK(it != free_blocks_.end());
+  const size_t bin = GetFreeBinIndex(info->GetPrevFree());
+  FreeBlocks& free_blocks = free_blocks_[bin];
+  auto it = free_blocks.lower_bound(info);
+  CHECK(it != free_blocks.end());
   CHECK_EQ(*it, info);
-  free_blocks_.erase(it);
+  free_blocks.erase(it);
+  if (free_blocks.empty()) {
+    non_empty_free_bins_ &= ~(UINT64_C(1) << bin);
+  }
+}
+
+void FreeListSpace::InsertFreePrev(AllocationInfo* info) {
+  DCHECK_GT(info->GetPrevFree(), 0U);
+  const size_t bin = GetFreeBinIndex(info->GetPrevFree());
+  free_blocks_[bin].insert(info);
+  non_empty_free_bins_ |= UINT64_C(1) << bin;
+}
+
+AllocationInfo* FreeListSpace::TakeFreePrev(size_t num_bytes) {
+  DCHECK_ALIGNED(num_bytes, kAlignment);
+  const size_t bin = GetFreeBinIndex(std::max<size_t>(num_bytes / kAlignment, 1u));
+  const uint64_t fitting_bins = non_empty_free_bins_ & (~UINT64_C(0) << bin);
+  if (fitting_bins == 0) {
+    return nullptr;
+  }
+  const size_t found_bin = CTZ(fitting_bins);
+  FreeBlocks* free_blocks = &free_blocks_[found_bin];
+  FreeBlocks::iterator it;
+  if (found_bin == kLargeFreeBin) {
+    // The large bin has blocks of different sizes, find the smallest that fits.
+    AllocationInfo temp_info;
+    temp_info.SetPrevFreeBytes(num_bytes);
+    temp_info.SetByteSize(0, false);
+    it = free_blocks->lower_bound(&temp_info);
+    if (it == free_blocks->end()) {
+      return nullptr;
+    }
+  } else {
+    // All the blocks of the bin fit, take the lowest one.
+    it = free_blocks->begin();
+  }
+  AllocationInfo* info = *it;
+  free_blocks->erase(it);
+  if (free_blocks->empty()) {
+    non_empty_free_bins_ &= ~(UINT64_C(1) << found_bin);
+  }
+  return info;
 }
 
 size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
-  MutexLock mu(self, lock_);
   DCHECK(Contains(obj)) << reinterpret_cast<void*>(Begin()) << " " << obj << " "
                         << reinterpret_cast<void*>(End());
   DCHECK_ALIGNED(obj, kAlignment);
   AllocationInfo* info = GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(obj));
+  // The size of an allocated block only changes when it is freed, and the block can't be reused
+  // until it is marked free under the lock below. Release its pages before taking the lock so
+  // that freeing a large object does not stall the allocating threads.
   DCHECK(!info->IsFree());
   const size_t allocation_size = info->ByteSize();
   DCHECK_GT(allocation_size, 0U);
   DCHECK_ALIGNED(allocation_size, kAlignment);
+  madvise(obj, allocation_size, MADV_DONTNEED);
+  if (kIsDebugBuild) {
+    // Can't disallow reads since we use them to find next chunks during coalescing.
+    mprotect(obj, allocation_size, PROT_READ);
+  }
+  MutexLock mu(self, lock_);
   info->SetByteSize(allocation_size, true);  // Mark as free.
   // Look at the next chunk.
   AllocationInfo* next_info = info->GetNextInfo();
@@ -440,18 +563,13 @@ size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
       new_free_info = next_info;
     }
     new_free_info->SetPrevFreeBytes(new_free_size);
-    free_blocks_.insert(new_free_info);
+    InsertFreePrev(new_free_info);
     info->SetByteSize(new_free_size, true);
     DCHECK_EQ(info->GetNextInfo(), new_free_info);
   }
   --num_objects_allocated_;
   DCHECK_LE(allocation_size, num_bytes_allocated_);
   num_bytes_allocated_ -= allocation_size;
-  madvise(obj, allocation_size, MADV_DONTNEED);
-  if (kIsDebugBuild) {
-    // Can't disallow reads since we use them to find next chunks during coalescing.
-    mprotect(obj, allocation_size, PROT_READ);
-  }
   return allocation_size;
 }
 
@@ -470,15 +588,10 @@ mirror::Object* FreeListSpace::Alloc(Thread* self, size_t num_bytes, size_t* byt
                                      size_t* usable_size, size_t* bytes_tl_bulk_allocated) {
   MutexLock mu(self, lock_);
   const size_t allocation_size = RoundUp(num_bytes, kAlignment);
-  AllocationInfo temp_info;
-  temp_info.SetPrevFreeBytes(allocation_size);
-  temp_info.SetByteSize(0, false);
   AllocationInfo* new_info;
   // Find the smallest chunk at least num_bytes in size.
-  auto it = free_blocks_.lower_bound(&temp_info);
-  if (it != free_blocks_.end()) {
-    AllocationInfo* info = *it;
-    free_blocks_.erase(it);
+  AllocationInfo* info = TakeFreePrev(allocation_size);
+  if (info != nullptr) {
     // Fit our object in the previous allocation info free space.
     new_info = info->GetPrevFreeInfo();
     // Remove the newly allocated block from the info and update the prev_free_.
@@ -488,7 +601,7 @@ mirror::Object* FreeListSpace::Alloc(Thread* self, size_t num_bytes, size_t* byt
       new_free->SetPrevFreeBytes(0);
       new_free->SetByteSize(info->GetPrevFreeBytes(), true);
       // If there is remaining space, insert back into the free set.
-      free_blocks_.insert(info);
+      InsertFreePrev(info);
     }
   } else {
     // Try to steal some memory from the free space at the end of the space.
@@ -127,9 +127,16 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   DISALLOW_COPY_AND_ASSIGN(LargeObjectSpace);
 };
 
-// A discontinuous large object space implemented by individual mmap/munmap calls.
+// A discontinuous large object space implemented by individual mmap/munmap calls. Recently freed
+// maps are kept, with their pages released, and reused for allocations of about the same size.
 class LargeObjectMapSpace : public LargeObjectSpace {
  public:
+  // Upper bound on the total size of the cached maps. The cached maps only hold address space,
+  // their pages are released when the object is freed.
+  static constexpr size_t kDefaultMapCacheCapacity = 8 * MB;
+  // Maximum number of cached maps.
+  static constexpr size_t kMaxCachedMaps = 32;
+
   // Creates a large object space. Allocations into the large object space use memory maps instead
   // of malloc.
   static LargeObjectMapSpace* Create(const std::string& name);
@@ -150,8 +157,16 @@ class LargeObjectMapSpace : public LargeObjectSpace {
     MemMap* mem_map;
     bool is_zygote;
   };
-  explicit LargeObjectMapSpace(const std::string& name);
-  virtual ~LargeObjectMapSpace() {}
+  LargeObjectMapSpace(const std::string& name, size_t map_cache_capacity);
+  virtual ~LargeObjectMapSpace();
+
+  // Returns a cached map of at least num_bytes if there is one that does not waste too much.
+  MemMap* TakeCachedMap(size_t num_bytes) REQUIRES(lock_);
+  // Reserves room in the cache for a map of map_size bytes. Returns false if the cache is full, in
+  // which case the map should be unmapped.
+  bool ReserveCachedMap(size_t map_size) REQUIRES(lock_);
+  // Caches a map that room was reserved for, once its pages are released.
+  void CacheMap(MemMap* mem_map) REQUIRES(lock_);
 
   bool IsZygoteLargeObject(Thread* self, mirror::Object* obj) const OVERRIDE REQUIRES(!lock_);
   void SetAllLargeObjectsAsZygoteObjects(Thread* self) OVERRIDE REQUIRES(!lock_);
@@ -160,6 +175,13 @@ class LargeObjectMapSpace : public LargeObjectSpace {
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   AllocationTrackingSafeMap<mirror::Object*, LargeObject, kAllocatorTagLOSMaps> large_objects_
       GUARDED_BY(lock_);
+  // Freed maps by size.
+  AllocationTrackingMultiMap<size_t, MemMap*, kAllocatorTagLOSMaps> map_cache_ GUARDED_BY(lock_);
+  // Bytes of the cached maps and of the maps that room was reserved for.
+  size_t map_cache_bytes_ GUARDED_BY(lock_);
+  // Number of maps that room was reserved for and that are not cached yet.
+  size_t num_reserved_maps_ GUARDED_BY(lock_);
+  const size_t map_cache_capacity_;
 };
 
 // A continuous large object space with a free-list to handle holes.
@@ -197,6 +219,11 @@ class FreeListSpace FINAL : public LargeObjectSpace {
   }
   // Removes header from the free blocks set by finding the corresponding iterator and erasing it.
   void RemoveFreePrev(AllocationInfo* info) REQUIRES(lock_);
+  // Adds the free block before info to the free blocks.
+  void InsertFreePrev(AllocationInfo* info) REQUIRES(lock_);
+  // Finds the smallest free block of at least num_bytes, removes it from the free blocks and
+  // returns the allocation info that follows it. Returns null if there is no such block.
+  AllocationInfo* TakeFreePrev(size_t num_bytes) REQUIRES(lock_);
   bool IsZygoteLargeObject(Thread* self, mirror::Object* obj) const OVERRIDE;
   void SetAllLargeObjectsAsZygoteObjects(Thread* self) OVERRIDE REQUIRES(!lock_);
 
@@ -207,6 +234,16 @@ class FreeListSpace FINAL : public LargeObjectSpace {
   typedef std::set<AllocationInfo*, SortByPrevFree,
                    TrackingAllocator<AllocationInfo*, kAllocatorTagLOSFreeList>> FreeBlocks;
 
+  // Free blocks are binned by their size in pages. Every bin but the last holds blocks of one
+  // size so that the common small allocations find a block without searching, the last bin holds
+  // all the blocks of kNumFreeBins pages or more.
+  static constexpr size_t kNumFreeBins = 64;
+  static constexpr size_t kLargeFreeBin = kNumFreeBins - 1;
+  static size_t GetFreeBinIndex(size_t num_pages) {
+    DCHECK_GT(num_pages, 0u);
+    return std::min(num_pages - 1, kLargeFreeBin);
+  }
+
   // There is not footer for any allocations at the end of the space, so we keep track of how much
   // free space there is at the end manually.
   std::unique_ptr<MemMap> mem_map_;
@@ -217,7 +254,9 @@ class FreeListSpace FINAL : public LargeObjectSpace {
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   // Free bytes at the end of the space.
   size_t free_end_ GUARDED_BY(lock_);
-  FreeBlocks free_blocks_ GUARDED_BY(lock_);
+  FreeBlocks free_blocks_[kNumFreeBins] GUARDED_BY(lock_);
+  // Bit i is set if free_blocks_[i] is not empty.
+  uint64_t non_empty_free_bins_ GUARDED_BY(lock_);
 };
 
 }  // namespace space
@@ -29,6 +29,9 @@ class LargeObjectSpaceTest : public SpaceTest<CommonRuntimeTest> {
   static constexpr size_t kNumThreads = 10;
   static constexpr size_t kNumIterations = 1000;
   void RaceTest();
+
+  static constexpr size_t kNumChurnIterations = 2000;
+  void ChurnBenchmark();
 };
 
 
@@ -166,6 +169,166 @@ void LargeObjectSpaceTest::RaceTest() {
   }
 }
 
+// Allocates and frees buffers of a few common sizes, keeping a handful of them live, the way
+// code churning through I/O buffers or bitmaps does.
+class AllocChurnTask : public Task {
+ public:
+  AllocChurnTask(size_t iterations, LargeObjectSpace* los, Atomic<size_t>* failures)
+      : iterations_(iterations), los_(los), failures_(failures) {}
+
+  void Run(Thread* self) {
+    static constexpr size_t kSizes[] = { 12 * KB, 16 * KB, 32 * KB, 64 * KB, 16 * KB, 12 * KB };
+    static constexpr size_t kNumLive = 8;
+    mirror::Object* live[kNumLive] = {};
+    for (size_t i = 0; i < iterations_; ++i) {
+      mirror::Object*& slot = live[i % kNumLive];
+      if (slot != nullptr) {
+        los_->Free(self, slot);
+      }
+      size_t alloc_size, bytes_tl_bulk_allocated;
+      slot = los_->Alloc(self, kSizes[i % arraysize(kSizes)], &alloc_size, nullptr,
+                         &bytes_tl_bulk_allocated);
+      if (slot == nullptr) {
+        failures_->FetchAndAddSequentiallyConsistent(1);
+      }
+    }
+    for (mirror::Object* obj : live) {
+      if (obj != nullptr) {
+        los_->Free(self, obj);
+      }
+    }
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+ private:
+  size_t iterations_;
+  LargeObjectSpace* los_;
+  Atomic<size_t>* failures_;
+};
+
+void LargeObjectSpaceTest::ChurnBenchmark() {
+  for (size_t los_type = 0; los_type < 2; ++los_type) {
+    LargeObjectSpace* los = nullptr;
+    if (los_type == 0) {
+      los = space::LargeObjectMapSpace::Create("large object space");
+    } else {
+      los = space::FreeListSpace::Create("large object space", nullptr, 128 * MB);
+    }
+
+    Thread* self = Thread::Current();
+    Atomic<size_t> failures(0);
+    ThreadPool thread_pool("Large object space churn thread pool", kNumThreads);
+    for (size_t i = 0; i < kNumThreads; ++i) {
+      thread_pool.AddTask(self, new AllocChurnTask(kNumChurnIterations, los, &failures));
+    }
+    const uint64_t start_time = NanoTime();
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, true, false);
+    const uint64_t duration = NanoTime() - start_time;
+
+    EXPECT_EQ(0u, failures.LoadSequentiallyConsistent());
+    EXPECT_EQ(0u, los->GetBytesAllocated());
+    EXPECT_EQ(0u, los->GetObjectsAllocated());
+    LOG(INFO) << (los_type == 0 ? "LargeObjectMapSpace" : "FreeListSpace") << ": "
+              << kNumThreads * kNumChurnIterations << " allocations and frees on " << kNumThreads
+              << " threads took " << PrettyDuration(duration) << " ("
+              << duration / (kNumThreads * kNumChurnIterations) << "ns per allocation)";
+    delete los;
+  }
+}
+
+TEST_F(LargeObjectSpaceTest, MapCacheReuse) {
+  if (Runtime::Current()->IsRunningOnMemoryTool()) {
+    // The memory tool variant does not cache freed maps.
+    return;
+  }
+  Thread* const self = Thread::Current();
+  std::unique_ptr<LargeObjectSpace> los(
+      space::LargeObjectMapSpace::Create("large object space"));
+  size_t bytes_allocated, bytes_tl_bulk_allocated;
+  mirror::Object* obj =
+      los->Alloc(self, 64 * KB, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+  ASSERT_TRUE(obj != nullptr);
+  memset(obj, 0xAB, 64 * KB);
+  los->Free(self, obj);
+
+  // An allocation too small for the cached map gets a new map.
+  mirror::Object* small_obj =
+      los->Alloc(self, 16 * KB, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+  ASSERT_TRUE(small_obj != nullptr);
+  EXPECT_NE(obj, small_obj);
+  EXPECT_EQ(16 * KB, bytes_allocated);
+
+  // An allocation within 1/8 of the cached map reuses it, and it reads as zero.
+  mirror::Object* reused_obj =
+      los->Alloc(self, 60 * KB, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+  ASSERT_TRUE(reused_obj != nullptr);
+  EXPECT_EQ(obj, reused_obj);
+  EXPECT_EQ(64 * KB, bytes_allocated);
+  EXPECT_EQ(64 * KB, los->AllocationSize(reused_obj, nullptr));
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(reused_obj);
+  for (size_t i = 0; i < 64 * KB; ++i) {
+    ASSERT_EQ(0u, bytes[i]) << i;
+  }
+  los->Free(self, small_obj);
+  los->Free(self, reused_obj);
+  EXPECT_EQ(0U, los->GetBytesAllocated());
+  EXPECT_EQ(0U, los->GetObjectsAllocated());
+}
+
+TEST_F(LargeObjectSpaceTest, FreeListBestFit) {
+  Thread* const self = Thread::Current();
+  std::unique_ptr<LargeObjectSpace> los(
+      space::FreeListSpace::Create("large object space", nullptr, 128 * MB));
+  // Free blocks of 4, 8, 100 and 70 pages, separated by live objects so that they do not
+  // coalesce. 4 and 8 pages have bins of their own, 70 and 100 share the last bin.
+  static constexpr size_t kBlockPages[] = { 4, 8, 100, 70 };
+  mirror::Object* blocks[arraysize(kBlockPages)];
+  mirror::Object* separators[arraysize(kBlockPages)];
+  size_t bytes_allocated, bytes_tl_bulk_allocated;
+  for (size_t i = 0; i < arraysize(kBlockPages); ++i) {
+    blocks[i] = los->Alloc(
+        self, kBlockPages[i] * kPageSize, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+    separators[i] =
+        los->Alloc(self, kPageSize, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+    ASSERT_TRUE(blocks[i] != nullptr);
+    ASSERT_TRUE(separators[i] != nullptr);
+  }
+  for (mirror::Object* obj : blocks) {
+    los->Free(self, obj);
+  }
+
+  auto alloc_pages = [&](size_t num_pages) {
+    return los->Alloc(
+        self, num_pages * kPageSize, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+  };
+  // Each allocation takes the smallest free block that fits, from the start of the block.
+  mirror::Object* obj3 = alloc_pages(3);
+  EXPECT_EQ(blocks[0], obj3);
+  mirror::Object* obj8 = alloc_pages(8);
+  EXPECT_EQ(blocks[1], obj8);
+  mirror::Object* obj66 = alloc_pages(66);
+  EXPECT_EQ(blocks[3], obj66);
+  mirror::Object* obj90 = alloc_pages(90);
+  EXPECT_EQ(blocks[2], obj90);
+  // The page left of the 4 page block is smaller than the 4 pages left of the 70 page block.
+  mirror::Object* obj1 = alloc_pages(1);
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(blocks[0]) + 3 * kPageSize,
+            reinterpret_cast<uint8_t*>(obj1));
+
+  for (mirror::Object* obj : { obj3, obj8, obj66, obj90, obj1 }) {
+    los->Free(self, obj);
+  }
+  for (mirror::Object* obj : separators) {
+    los->Free(self, obj);
+  }
+  EXPECT_EQ(0U, los->GetBytesAllocated());
+  EXPECT_EQ(0U, los->GetObjectsAllocated());
+}
+
 TEST_F(LargeObjectSpaceTest, LargeObjectTest) {
   LargeObjectTest();
 }
@@ -174,6 +337,10 @@ TEST_F(LargeObjectSpaceTest, RaceTest) {
   RaceTest();
 }
 
+TEST_F(LargeObjectSpaceTest, ChurnBenchmark) {
+  ChurnBenchmark();
+}
+
 }  // namespace space
 }  // namespace gc
 }  // namespace art
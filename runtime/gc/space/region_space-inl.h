@@ -46,7 +46,7 @@ inline mirror::Object* RegionSpace::AllocNonvirtual(size_t num_bytes, size_t* by
                                                     size_t* bytes_tl_bulk_allocated) {
   DCHECK_ALIGNED(num_bytes, kAlignment);
   mirror::Object* obj;
-  if (LIKELY(num_bytes <= kRegionSize)) {
+  if (LIKELY(num_bytes <= region_size_)) {
     // Non-large object.
     if (!kForEvac) {
       obj = current_region_->Alloc(num_bytes, bytes_allocated, usable_size,
@@ -76,29 +76,25 @@ inline mirror::Object* RegionSpace::AllocNonvirtual(size_t num_bytes, size_t* by
       if ((num_non_free_regions_ + 1) * 2 > num_regions_) {
         return nullptr;
       }
-      for (size_t i = 0; i < num_regions_; ++i) {
-        Region* r = &regions_[i];
-        if (r->IsFree()) {
-          r->Unfree(this, time_);
-          r->SetNewlyAllocated();
-          ++num_non_free_regions_;
-          obj = r->Alloc(num_bytes, bytes_allocated, usable_size, bytes_tl_bulk_allocated);
-          CHECK(obj != nullptr);
-          current_region_ = r;
-          return obj;
-        }
+      Region* r = FindFreeRegionLocked();
+      if (r != nullptr) {
+        r->Unfree(this, time_);
+        r->SetNewlyAllocated();
+        ++num_non_free_regions_;
+        obj = r->Alloc(num_bytes, bytes_allocated, usable_size, bytes_tl_bulk_allocated);
+        CHECK(obj != nullptr);
+        current_region_ = r;
+        return obj;
       }
     } else {
-      for (size_t i = 0; i < num_regions_; ++i) {
-        Region* r = &regions_[i];
-        if (r->IsFree()) {
-          r->Unfree(this, time_);
-          ++num_non_free_regions_;
-          obj = r->Alloc(num_bytes, bytes_allocated, usable_size, bytes_tl_bulk_allocated);
-          CHECK(obj != nullptr);
-          evac_region_ = r;
-          return obj;
-        }
+      Region* r = FindFreeRegionLocked();
+      if (r != nullptr) {
+        r->Unfree(this, time_);
+        ++num_non_free_regions_;
+        obj = r->Alloc(num_bytes, bytes_allocated, usable_size, bytes_tl_bulk_allocated);
+        CHECK(obj != nullptr);
+        evac_region_ = r;
+        return obj;
       }
     }
   } else {
@@ -141,12 +137,12 @@ inline mirror::Object* RegionSpace::Region::Alloc(size_t num_bytes, size_t* byte
 inline size_t RegionSpace::AllocationSizeNonvirtual(mirror::Object* obj, size_t* usable_size) {
   size_t num_bytes = obj->SizeOf();
   if (usable_size != nullptr) {
-    if (LIKELY(num_bytes <= kRegionSize)) {
+    if (LIKELY(num_bytes <= region_size_)) {
       DCHECK(RefToRegion(obj)->IsAllocated());
       *usable_size = RoundUp(num_bytes, kAlignment);
     } else {
       DCHECK(RefToRegion(obj)->IsLarge());
-      *usable_size = RoundUp(num_bytes, kRegionSize);
+      *usable_size = RoundUp(num_bytes, region_size_);
     }
   }
   return num_bytes;
@@ -281,11 +277,11 @@ mirror::Object* RegionSpace::AllocLarge(size_t num_bytes, size_t* bytes_allocate
                                         size_t* usable_size,
                                         size_t* bytes_tl_bulk_allocated) {
   DCHECK_ALIGNED(num_bytes, kAlignment);
-  DCHECK_GT(num_bytes, kRegionSize);
-  size_t num_regs = RoundUp(num_bytes, kRegionSize) / kRegionSize;
+  DCHECK_GT(num_bytes, region_size_);
+  size_t num_regs = RoundUp(num_bytes, region_size_) / region_size_;
   DCHECK_GT(num_regs, 0U);
-  DCHECK_LT((num_regs - 1) * kRegionSize, num_bytes);
-  DCHECK_LE(num_bytes, num_regs * kRegionSize);
+  DCHECK_LT((num_regs - 1) * region_size_, num_bytes);
+  DCHECK_LE(num_bytes, num_regs * region_size_);
   MutexLock mu(Thread::Current(), region_lock_);
   if (!kForEvac) {
     // Retain sufficient free regions for full evacuation.
@@ -324,7 +320,7 @@ mirror::Object* RegionSpace::AllocLarge(size_t num_bytes, size_t* bytes_allocate
       }
       *bytes_allocated = num_bytes;
       if (usable_size != nullptr) {
-        *usable_size = num_regs * kRegionSize;
+        *usable_size = num_regs * region_size_;
       }
       *bytes_tl_bulk_allocated = num_bytes;
       return reinterpret_cast<mirror::Object*>(first_reg->Begin());
@@ -338,7 +334,7 @@ mirror::Object* RegionSpace::AllocLarge(size_t num_bytes, size_t* bytes_allocate
 
 inline size_t RegionSpace::Region::BytesAllocated() const {
   if (IsLarge()) {
-    DCHECK_LT(begin_ + kRegionSize, Top());
+    DCHECK_LT(end_, Top());
     return static_cast<size_t>(Top() - begin_);
   } else if (IsLargeTail()) {
     DCHECK_EQ(begin_, Top());
@@ -352,7 +348,7 @@ inline size_t RegionSpace::Region::BytesAllocated() const {
     } else {
       bytes = static_cast<size_t>(Top() - begin_);
     }
-    DCHECK_LE(bytes, kRegionSize);
+    DCHECK_LE(bytes, static_cast<size_t>(end_ - begin_));
     return bytes;
   }
 }
@@ -14,8 +14,13 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "bump_pointer_space.h"
 #include "bump_pointer_space-inl.h"
+#include "gc/numa_topology.h"
 #include "mirror/object-inl.h"
 #include "mirror/class-inl.h"
 #include "thread_list.h"
@@ -28,17 +33,19 @@ namespace space {
 // value of the region size, evaculate the region.
 static constexpr uint kEvaculateLivePercentThreshold = 75U;
 
-MemMap* RegionSpace::CreateMemMap(const std::string& name, size_t capacity,
-                                  uint8_t* requested_begin) {
-  CHECK_ALIGNED(capacity, kRegionSize);
+MemMap* RegionSpace::CreateMemMap(const std::string& name,
+                                  size_t capacity,
+                                  uint8_t* requested_begin,
+                                  size_t region_size) {
+  CHECK_ALIGNED_PARAM(capacity, region_size);
   std::string error_msg;
-  // Ask for the capacity of an additional kRegionSize so that we can align the map by kRegionSize
+  // Ask for the capacity of an additional region so that we can align the map by the region size
   // even if we get unaligned base address. This is necessary for the ReadBarrierTable to work.
   std::unique_ptr<MemMap> mem_map;
   while (true) {
     mem_map.reset(MemMap::MapAnonymous(name.c_str(),
                                        requested_begin,
-                                       capacity + kRegionSize,
+                                       capacity + region_size,
                                        PROT_READ | PROT_WRITE,
                                        true,
                                        false,
@@ -55,50 +62,65 @@ MemMap* RegionSpace::CreateMemMap(const std::string& name, size_t capacity,
     MemMap::DumpMaps(LOG_STREAM(ERROR));
     return nullptr;
   }
-  CHECK_EQ(mem_map->Size(), capacity + kRegionSize);
+  CHECK_EQ(mem_map->Size(), capacity + region_size);
   CHECK_EQ(mem_map->Begin(), mem_map->BaseBegin());
   CHECK_EQ(mem_map->Size(), mem_map->BaseSize());
-  if (IsAlignedParam(mem_map->Begin(), kRegionSize)) {
-    // Got an aligned map. Since we requested a map that's kRegionSize larger. Shrink by
-    // kRegionSize at the end.
+  if (IsAlignedParam(mem_map->Begin(), region_size)) {
+    // Got an aligned map. Since we requested a map that's a region larger. Shrink by
+    // a region at the end.
     mem_map->SetSize(capacity);
   } else {
     // Got an unaligned map. Align the both ends.
-    mem_map->AlignBy(kRegionSize);
+    mem_map->AlignBy(region_size);
   }
-  CHECK_ALIGNED(mem_map->Begin(), kRegionSize);
-  CHECK_ALIGNED(mem_map->End(), kRegionSize);
+  CHECK_ALIGNED_PARAM(mem_map->Begin(), region_size);
+  CHECK_ALIGNED_PARAM(mem_map->End(), region_size);
   CHECK_EQ(mem_map->Size(), capacity);
   return mem_map.release();
 }
 
-RegionSpace* RegionSpace::Create(const std::string& name, MemMap* mem_map) {
-  return new RegionSpace(name, mem_map);
+RegionSpace* RegionSpace::Create(const std::string& name, MemMap* mem_map, size_t region_size) {
+  return new RegionSpace(name, mem_map, region_size);
 }
 
-RegionSpace::RegionSpace(const std::string& name, MemMap* mem_map)
+RegionSpace::RegionSpace(const std::string& name, MemMap* mem_map, size_t region_size)
     : ContinuousMemMapAllocSpace(name, mem_map, mem_map->Begin(), mem_map->End(), mem_map->End(),
                                  kGcRetentionPolicyAlwaysCollect),
-      region_lock_("Region lock", kRegionSpaceRegionLock), time_(1U) {
+      region_lock_("Region lock", kRegionSpaceRegionLock),
+      region_size_(region_size),
+      region_size_shift_(WhichPowerOf2(region_size)),
+      time_(1U),
+      evacuation_limit_(0U),
+      tlab_waste_bytes_(0U),
+      numa_topology_(nullptr),
+      regions_per_numa_node_(0U) {
+  CHECK(IsPowerOfTwo(region_size_)) << region_size_;
+  CHECK_ALIGNED_PARAM(region_size_, kPageSize);
+  if (kUseTableLookupReadBarrier) {
+    // The read barrier table has one entry per default sized region.
+    CHECK_EQ(region_size_, accounting::ReadBarrierTable::kRegionSize);
+  }
   size_t mem_map_size = mem_map->Size();
-  CHECK_ALIGNED(mem_map_size, kRegionSize);
-  CHECK_ALIGNED(mem_map->Begin(), kRegionSize);
-  num_regions_ = mem_map_size / kRegionSize;
+  CHECK_ALIGNED_PARAM(mem_map_size, region_size_);
+  CHECK_ALIGNED_PARAM(mem_map->Begin(), region_size_);
+  num_regions_ = mem_map_size / region_size_;
   num_non_free_regions_ = 0U;
   DCHECK_GT(num_regions_, 0U);
   non_free_region_index_limit_ = 0U;
   regions_.reset(new Region[num_regions_]);
   uint8_t* region_addr = mem_map->Begin();
-  for (size_t i = 0; i < num_regions_; ++i, region_addr += kRegionSize) {
-    regions_[i].Init(i, region_addr, region_addr + kRegionSize);
+  for (size_t i = 0; i < num_regions_; ++i, region_addr += region_size_) {
+    regions_[i].Init(i, region_addr, region_addr + region_size_);
   }
+  evacuate_region_.reset(new bool[num_regions_]);
+  evacuation_candidates_.reserve(num_regions_);
   mark_bitmap_.reset(
       accounting::ContinuousSpaceBitmap::Create("region space live bitmap", Begin(), Capacity()));
   if (kIsDebugBuild) {
     CHECK_EQ(regions_[0].Begin(), Begin());
     for (size_t i = 0; i < num_regions_; ++i) {
       CHECK(regions_[i].IsFree());
-      CHECK_EQ(static_cast<size_t>(regions_[i].End() - regions_[i].Begin()), kRegionSize);
+      CHECK_EQ(static_cast<size_t>(regions_[i].End() - regions_[i].Begin()), region_size_);
       if (i + 1 < num_regions_) {
         CHECK_EQ(regions_[i].End(), regions_[i + 1].Begin());
       }
@@ -122,7 +144,7 @@ size_t RegionSpace::FromSpaceSize() {
       ++num_regions;
     }
   }
-  return num_regions * kRegionSize;
+  return num_regions * region_size_;
 }
 
 size_t RegionSpace::UnevacFromSpaceSize() {
@@ -134,7 +156,7 @@ size_t RegionSpace::UnevacFromSpaceSize() {
       ++num_regions;
     }
   }
-  return num_regions * kRegionSize;
+  return num_regions * region_size_;
 }
 
 size_t RegionSpace::ToSpaceSize() {
@@ -146,7 +168,7 @@ size_t RegionSpace::ToSpaceSize() {
       ++num_regions;
     }
   }
-  return num_regions * kRegionSize;
+  return num_regions * region_size_;
 }
 
 inline bool RegionSpace::Region::ShouldBeEvacuated() {
@@ -164,7 +186,7 @@ inline bool RegionSpace::Region::ShouldBeEvacuated() {
       DCHECK(!IsLargeTail());
       DCHECK_NE(live_bytes_, static_cast<size_t>(-1));
       DCHECK_LE(live_bytes_, BytesAllocated());
-      const size_t bytes_allocated = RoundUp(BytesAllocated(), kRegionSize);
+      const size_t bytes_allocated = RoundUp(BytesAllocated(), static_cast<size_t>(end_ - begin_));
       DCHECK_LE(live_bytes_, bytes_allocated);
       if (IsAllocated()) {
         // Side node: live_percent == 0 does not necessarily mean
@@ -182,6 +204,79 @@ inline bool RegionSpace::Region::ShouldBeEvacuated() {
   return result;
 }
 
+void RegionSpace::RankEvacuationCandidates() {
+  MutexLock mu(Thread::Current(), region_lock_);
+  evacuation_candidates_.clear();
+  const size_t iter_limit = std::min(num_regions_, non_free_region_index_limit_);
+  for (size_t i = 0; i < iter_limit; ++i) {
+    Region* r = &regions_[i];
+    if (IsEvacuationCandidate(r)) {
+      evacuation_candidates_.push_back(r);
+    }
+  }
+  // Evacuate the sparsest regions first. Since every region is the same size, fewer live bytes
+  // means more bytes reclaimed per byte copied. A dead large object costs nothing to evacuate.
+  std::sort(evacuation_candidates_.begin(),
+            evacuation_candidates_.end(),
+            [](const Region* a, const Region* b) {
+              if (a->LiveBytes() != b->LiveBytes()) {
+                return a->LiveBytes() < b->LiveBytes();
+              }
+              return a->Idx() < b->Idx();
+            });
+}
+
+void RegionSpace::SelectRegionsToEvacuate(size_t iter_limit,
+                                          bool force_evacuate_all,
+                                          EvacuationStats* stats) {
+  size_t num_expected_large_tails = 0;
+  for (size_t i = 0; i < iter_limit; ++i) {
+    Region* r = &regions_[i];
+    evacuate_region_[i] = false;
+    if (r->IsFree()) {
+      continue;
+    }
+    if (num_expected_large_tails != 0U) {
+      // Large tails follow their head, which is decided below.
+      DCHECK(r->IsLargeTail());
+      --num_expected_large_tails;
+      continue;
+    }
+    if (r->IsLarge()) {
+      num_expected_large_tails = RoundUp(r->BytesAllocated(), region_size_) / region_size_ - 1;
+    }
+    if (force_evacuate_all || r->IsNewlyAllocated()) {
+      // The live bytes of these are not known, always evacuate them.
+      evacuate_region_[i] = true;
+      if (r->IsNewlyAllocated()) {
+        ++stats->newly_allocated_regions;
+      }
+    }
+  }
+  DCHECK_EQ(num_expected_large_tails, 0U);
+  // Take the candidates ranked by RankEvacuationCandidates() before the pause. Regions only get
+  // live bytes during a collection, so the ranking is still valid. A region freed since then is
+  // skipped, and one reallocated since then is newly allocated and was handled above.
+  uint64_t copied_bytes = 0;
+  for (Region* r : evacuation_candidates_) {
+    if (force_evacuate_all || !IsEvacuationCandidate(r)) {
+      continue;
+    }
+    const size_t live_bytes = r->LiveBytes();
+    if (evacuation_limit_ != 0U && copied_bytes + live_bytes > evacuation_limit_) {
+      ++stats->capped_regions;
+      continue;
+    }
+    copied_bytes += live_bytes;
+    evacuate_region_[r->Idx()] = true;
+    stats->expected_reclaimed_bytes +=
+        RoundUp(r->BytesAllocated(), region_size_) - live_bytes;
+  }
+  // Do not reuse a stale ranking in the next collection.
+  evacuation_candidates_.clear();
+  stats->expected_copied_bytes = copied_bytes;
+}
+
 // Determine which regions to evacuate and mark them as
 // from-space. Mark the rest as unevacuated from-space.
 void RegionSpace::SetFromSpace(accounting::ReadBarrierTable* rb_table, bool force_evacuate_all) {
@@ -197,6 +292,8 @@ void RegionSpace::SetFromSpace(accounting::ReadBarrierTable* rb_table, bool forc
   const size_t iter_limit = kUseTableLookupReadBarrier
       ? num_regions_
       : std::min(num_regions_, non_free_region_index_limit_);
+  EvacuationStats stats;
+  SelectRegionsToEvacuate(iter_limit, force_evacuate_all, &stats);
   for (size_t i = 0; i < iter_limit; ++i) {
     Region* r = &regions_[i];
     RegionState state = r->State();
@@ -207,18 +304,20 @@ void RegionSpace::SetFromSpace(accounting::ReadBarrierTable* rb_table, bool forc
         DCHECK((state == RegionState::kRegionStateAllocated ||
                 state == RegionState::kRegionStateLarge) &&
                type == RegionType::kRegionTypeToSpace);
-        bool should_evacuate = force_evacuate_all || r->ShouldBeEvacuated();
+        bool should_evacuate = evacuate_region_[i];
         if (should_evacuate) {
           r->SetAsFromSpace();
           DCHECK(r->IsInFromSpace());
+          ++stats.evacuated_regions;
         } else {
           r->SetAsUnevacFromSpace();
           DCHECK(r->IsInUnevacFromSpace());
+          ++stats.unevacuated_regions;
         }
         if (UNLIKELY(state == RegionState::kRegionStateLarge &&
                      type == RegionType::kRegionTypeToSpace)) {
           prev_large_evacuated = should_evacuate;
-          num_expected_large_tails = RoundUp(r->BytesAllocated(), kRegionSize) / kRegionSize - 1;
+          num_expected_large_tails = RoundUp(r->BytesAllocated(), region_size_) / region_size_ - 1;
           DCHECK_GT(num_expected_large_tails, 0U);
         }
       } else {
@@ -227,9 +326,11 @@ void RegionSpace::SetFromSpace(accounting::ReadBarrierTable* rb_table, bool forc
         if (prev_large_evacuated) {
           r->SetAsFromSpace();
           DCHECK(r->IsInFromSpace());
+          ++stats.evacuated_regions;
         } else {
           r->SetAsUnevacFromSpace();
           DCHECK(r->IsInUnevacFromSpace());
+          ++stats.unevacuated_regions;
         }
         --num_expected_large_tails;
       }
@@ -244,6 +345,60 @@ void RegionSpace::SetFromSpace(accounting::ReadBarrierTable* rb_table, bool forc
   DCHECK_EQ(num_expected_large_tails, 0U);
   current_region_ = &full_region_;
   evac_region_ = &full_region_;
+  last_evacuation_stats_ = stats;
+  cumulative_evacuation_stats_.evacuated_regions += stats.evacuated_regions;
+  cumulative_evacuation_stats_.unevacuated_regions += stats.unevacuated_regions;
+  cumulative_evacuation_stats_.newly_allocated_regions += stats.newly_allocated_regions;
+  cumulative_evacuation_stats_.capped_regions += stats.capped_regions;
+  cumulative_evacuation_stats_.expected_copied_bytes += stats.expected_copied_bytes;
+  cumulative_evacuation_stats_.expected_reclaimed_bytes += stats.expected_reclaimed_bytes;
+}
+
+void RegionSpace::DumpEvacuationStats(std::ostream& os) {
+  MutexLock mu(Thread::Current(), region_lock_);
+  const EvacuationStats& stats = cumulative_evacuation_stats_;
+  os << "Region size: " << PrettySize(region_size_) << "\n"
+     << "Evacuation limit: "
+     << (evacuation_limit_ == 0U ? "none" : PrettySize(evacuation_limit_)) << "\n"
+     << "Cumulative regions evacuated: " << stats.evacuated_regions
+     << " (newly allocated " << stats.newly_allocated_regions << ")"
+     << " unevacuated: " << stats.unevacuated_regions
+     << " capped: " << stats.capped_regions << "\n"
+     << "Cumulative expected evacuation copied: " << PrettySize(stats.expected_copied_bytes)
+     << " reclaimed: " << PrettySize(stats.expected_reclaimed_bytes) << "\n";
+}
+
+void RegionSpace::SetNumaTopology(const NumaTopology* topology) {
+  MutexLock mu(Thread::Current(), region_lock_);
+  DCHECK_EQ(num_non_free_regions_, 0U);
+  const size_t num_nodes = topology->NumNodes();
+  regions_per_numa_node_ = RoundUp(num_regions_, num_nodes) / num_nodes;
+  for (size_t node = 0; node < num_nodes; ++node) {
+    const size_t begin = node * regions_per_numa_node_;
+    const size_t end = std::min(begin + regions_per_numa_node_, num_regions_);
+    if (begin < end) {
+      topology->BindMemory(regions_[begin].Begin(), (end - begin) * region_size_, node);
+    }
+  }
+  numa_topology_ = topology;
+}
+
+RegionSpace::Region* RegionSpace::FindFreeRegionLocked() {
+  size_t start = 0;
+  if (numa_topology_ != nullptr) {
+    start = std::min(numa_topology_->CurrentNode() * regions_per_numa_node_, num_regions_ - 1);
+  }
+  for (size_t n = 0; n < num_regions_; ++n) {
+    size_t i = start + n;
+    if (i >= num_regions_) {
+      i -= num_regions_;
+    }
+    Region* r = &regions_[i];
+    if (r->IsFree()) {
+      return r;
+    }
+  }
+  return nullptr;
 }
 
 void RegionSpace::ClearFromSpace(uint64_t* cleared_bytes, uint64_t* cleared_objects) {
@@ -251,88 +406,107 @@ void RegionSpace::ClearFromSpace(uint64_t* cleared_bytes, uint64_t* cleared_obje
   DCHECK(cleared_objects != nullptr);
   *cleared_bytes = 0;
   *cleared_objects = 0;
-  MutexLock mu(Thread::Current(), region_lock_);
-  VerifyNonFreeRegionLimit();
+  Thread* const self = Thread::Current();
+  // The regions to free, and the blocks of adjacent regions whose pages they cover.
+  std::vector<Region*> regions_to_clear;
+  std::vector<std::pair<uint8_t*, uint8_t*>> clear_blocks;
   size_t new_non_free_region_index_limit = 0;
-
-  // Combine zeroing and releasing pages to reduce how often madvise is called. This helps
-  // reduce contention on the mmap semaphore. b/62194020
-  // clear_region adds a region to the current block. If the region is not adjacent, the
-  // clear block is zeroed, released, and a new block begins.
-  uint8_t* clear_block_begin = nullptr;
-  uint8_t* clear_block_end = nullptr;
-  auto clear_region = [&clear_block_begin, &clear_block_end](Region* r) {
-    r->Clear(/*zero_and_release_pages*/false);
-    if (clear_block_end != r->Begin()) {
-      ZeroAndReleasePages(clear_block_begin, clear_block_end - clear_block_begin);
-      clear_block_begin = r->Begin();
-    }
-    clear_block_end = r->End();
-  };
-  for (size_t i = 0; i < std::min(num_regions_, non_free_region_index_limit_); ++i) {
-    Region* r = &regions_[i];
-    if (r->IsInFromSpace()) {
-      *cleared_bytes += r->BytesAllocated();
-      *cleared_objects += r->ObjectsAllocated();
-      --num_non_free_regions_;
-      clear_region(r);
-    } else if (r->IsInUnevacFromSpace()) {
-      if (r->LiveBytes() == 0) {
-        // Special case for 0 live bytes, this means all of the objects in the region are dead and
-        // we can clear it. This is important for large objects since we must not visit dead ones in
-        // RegionSpace::Walk because they may contain dangling references to invalid objects.
-        // It is also better to clear these regions now instead of at the end of the next GC to
-        // save RAM. If we don't clear the regions here, they will be cleared next GC by the normal
-        // live percent evacuation logic.
-        size_t free_regions = 1;
-        // Also release RAM for large tails.
-        while (i + free_regions < num_regions_ && regions_[i + free_regions].IsLargeTail()) {
-          DCHECK(r->IsLarge());
-          clear_region(&regions_[i + free_regions]);
-          ++free_regions;
-        }
+  {
+    MutexLock mu(self, region_lock_);
+    VerifyNonFreeRegionLimit();
+    // Combine zeroing and releasing pages to reduce how often madvise is called. This helps
+    // reduce contention on the mmap semaphore. b/62194020
+    // clear_region adds a region to the current block. If the region is not adjacent, a new block
+    // begins.
+    auto clear_region = [&regions_to_clear, &clear_blocks](Region* r) {
+      regions_to_clear.push_back(r);
+      if (clear_blocks.empty() || clear_blocks.back().second != r->Begin()) {
+        clear_blocks.emplace_back(r->Begin(), r->End());
+      } else {
+        clear_blocks.back().second = r->End();
+      }
+    };
+    for (size_t i = 0; i < std::min(num_regions_, non_free_region_index_limit_); ++i) {
+      Region* r = &regions_[i];
+      if (r->IsInFromSpace()) {
         *cleared_bytes += r->BytesAllocated();
         *cleared_objects += r->ObjectsAllocated();
-        num_non_free_regions_ -= free_regions;
         clear_region(r);
-        GetLiveBitmap()->ClearRange(
-            reinterpret_cast<mirror::Object*>(r->Begin()),
-            reinterpret_cast<mirror::Object*>(r->Begin() + free_regions * kRegionSize));
         continue;
-      }
-      size_t full_count = 0;
-      while (r->IsInUnevacFromSpace()) {
-        Region* const cur = &regions_[i + full_count];
-        if (i + full_count >= num_regions_ ||
-            cur->LiveBytes() != static_cast<size_t>(cur->Top() - cur->Begin())) {
-          break;
+      } else if (r->IsInUnevacFromSpace()) {
+        if (r->LiveBytes() == 0) {
+          // Special case for 0 live bytes, this means all of the objects in the region are dead
+          // and we can clear it. This is important for large objects since we must not visit dead
+          // ones in RegionSpace::Walk because they may contain dangling references to invalid
+          // objects. It is also better to clear these regions now instead of at the end of the
+          // next GC to save RAM. If we don't clear the regions here, they will be cleared next GC
+          // by the normal live percent evacuation logic.
+          *cleared_bytes += r->BytesAllocated();
+          *cleared_objects += r->ObjectsAllocated();
+          clear_region(r);
+          size_t free_regions = 1;
+          // Also release RAM for large tails.
+          while (i + free_regions < num_regions_ && regions_[i + free_regions].IsLargeTail()) {
+            DCHECK(r->IsLarge());
+            clear_region(&regions_[i + free_regions]);
+            ++free_regions;
+          }
+          GetLiveBitmap()->ClearRange(
+              reinterpret_cast<mirror::Object*>(r->Begin()),
+              reinterpret_cast<mirror::Object*>(r->Begin() + free_regions * region_size_));
+          // Skip over the large tails, which are only freed once the pages are released.
+          i += free_regions - 1;
+          continue;
         }
-        DCHECK(cur->IsInUnevacFromSpace());
-        if (full_count != 0) {
-          cur->SetUnevacFromSpaceAsToSpace();
+        size_t full_count = 0;
+        while (r->IsInUnevacFromSpace()) {
+          Region* const cur = &regions_[i + full_count];
+          if (i + full_count >= num_regions_ ||
+              cur->LiveBytes() != static_cast<size_t>(cur->Top() - cur->Begin())) {
+            break;
+          }
+          DCHECK(cur->IsInUnevacFromSpace());
+          if (full_count != 0) {
+            cur->SetUnevacFromSpaceAsToSpace();
+          }
+          ++full_count;
+        }
+        // Note that r is the full_count == 0 iteration since it is not handled by the loop.
+        r->SetUnevacFromSpaceAsToSpace();
+        if (full_count >= 1) {
+          GetLiveBitmap()->ClearRange(
+              reinterpret_cast<mirror::Object*>(r->Begin()),
+              reinterpret_cast<mirror::Object*>(r->Begin() + full_count * region_size_));
+          // Skip over extra regions we cleared.
+          // Subtract one for the for loop.
+          i += full_count - 1;
         }
-        ++full_count;
       }
-      // Note that r is the full_count == 0 iteration since it is not handled by the loop.
-      r->SetUnevacFromSpaceAsToSpace();
-      if (full_count >= 1) {
-        GetLiveBitmap()->ClearRange(
-            reinterpret_cast<mirror::Object*>(r->Begin()),
-            reinterpret_cast<mirror::Object*>(r->Begin() + full_count * kRegionSize));
-        // Skip over extra regions we cleared.
-        // Subtract one for the for loop.
-        i += full_count - 1;
+      // Note r != last_checked_region if r->IsInUnevacFromSpace() was true above.
+      Region* last_checked_region = &regions_[i];
+      if (!last_checked_region->IsFree()) {
+        new_non_free_region_index_limit = std::max(new_non_free_region_index_limit,
+                                                   last_checked_region->Idx() + 1);
       }
     }
-    // Note r != last_checked_region if r->IsInUnevacFromSpace() was true above.
-    Region* last_checked_region = &regions_[i];
-    if (!last_checked_region->IsFree()) {
-      new_non_free_region_index_limit = std::max(new_non_free_region_index_limit,
-                                                 last_checked_region->Idx() + 1);
+  }
+  // Release the pages without the region lock, so that allocating threads do not wait for the
+  // madvise calls. The regions are only freed afterwards, so nothing allocates in them meanwhile.
+  for (const std::pair<uint8_t*, uint8_t*>& block : clear_blocks) {
+    ZeroAndReleasePages(block.first, block.second - block.first);
+  }
+  MutexLock mu(self, region_lock_);
+  for (Region* r : regions_to_clear) {
+    r->Clear(/*zero_and_release_pages*/false);
+  }
+  num_non_free_regions_ -= regions_to_clear.size();
+  // Regions allocated while the lock was dropped may lie above the new limit.
+  for (size_t i = non_free_region_index_limit_; i > new_non_free_region_index_limit; --i) {
+    if (!regions_[i - 1].IsFree()) {
+      new_non_free_region_index_limit = i;
+      break;
     }
   }
-  // Clear pages for the last block since clearing happens when a new block opens.
-  ZeroAndReleasePages(clear_block_begin, clear_block_end - clear_block_begin);
   // Update non_free_region_index_limit_.
   SetNonFreeRegionLimit(new_non_free_region_index_limit);
   evac_region_ = nullptr;
@@ -371,7 +545,7 @@ void RegionSpace::LogFragmentationAllocFailure(std::ostream& os,
       }
     }
     max_contiguous_allocation = std::max(max_contiguous_allocation,
-                                         max_contiguous_free_regions * kRegionSize);
+                                         max_contiguous_free_regions * region_size_);
   }
   os << "; failed due to fragmentation (largest possible contiguous allocation "
      <<  max_contiguous_allocation << " bytes)";
@@ -399,12 +573,13 @@ void RegionSpace::Dump(std::ostream& os) const {
 
 void RegionSpace::FreeLarge(mirror::Object* large_obj, size_t bytes_allocated) {
   DCHECK(Contains(large_obj));
-  DCHECK_ALIGNED(large_obj, kRegionSize);
+  DCHECK_ALIGNED_PARAM(large_obj, region_size_);
   MutexLock mu(Thread::Current(), region_lock_);
   uint8_t* begin_addr = reinterpret_cast<uint8_t*>(large_obj);
-  uint8_t* end_addr = AlignUp(reinterpret_cast<uint8_t*>(large_obj) + bytes_allocated, kRegionSize);
+  uint8_t* end_addr =
+      AlignUp(reinterpret_cast<uint8_t*>(large_obj) + bytes_allocated, region_size_);
   CHECK_LT(begin_addr, end_addr);
-  for (uint8_t* addr = begin_addr; addr < end_addr; addr += kRegionSize) {
+  for (uint8_t* addr = begin_addr; addr < end_addr; addr += region_size_) {
     Region* reg = RefToRegionLocked(reinterpret_cast<mirror::Object*>(addr));
     if (addr == begin_addr) {
       DCHECK(reg->IsLarge());
@@ -451,20 +626,18 @@ bool RegionSpace::AllocNewTlab(Thread* self, size_t min_bytes) {
   if ((num_non_free_regions_ + 1) * 2 > num_regions_) {
     return false;
   }
-  for (size_t i = 0; i < num_regions_; ++i) {
-    Region* r = &regions_[i];
-    if (r->IsFree()) {
-      r->Unfree(this, time_);
-      ++num_non_free_regions_;
-      r->SetNewlyAllocated();
-      r->SetTop(r->End());
-      r->is_a_tlab_ = true;
-      r->thread_ = self;
-      self->SetTlab(r->Begin(), r->Begin() + min_bytes, r->End());
-      return true;
-    }
+  Region* r = FindFreeRegionLocked();
+  if (r == nullptr) {
+    return false;
   }
-  return false;
+  r->Unfree(this, time_);
+  ++num_non_free_regions_;
+  r->SetNewlyAllocated();
+  r->SetTop(r->End());
+  r->is_a_tlab_ = true;
+  r->thread_ = self;
+  self->SetTlab(r->Begin(), r->Begin() + min_bytes, r->End());
+  return true;
 }
 
 size_t RegionSpace::RevokeThreadLocalBuffers(Thread* thread) {
@@ -477,12 +650,13 @@ void RegionSpace::RevokeThreadLocalBuffersLocked(Thread* thread) {
   uint8_t* tlab_start = thread->GetTlabStart();
   DCHECK_EQ(thread->HasTlab(), tlab_start != nullptr);
   if (tlab_start != nullptr) {
-    DCHECK_ALIGNED(tlab_start, kRegionSize);
+    DCHECK_ALIGNED_PARAM(tlab_start, region_size_);
     Region* r = RefToRegionLocked(reinterpret_cast<mirror::Object*>(tlab_start));
     DCHECK(r->IsAllocated());
-    DCHECK_LE(thread->GetThreadLocalBytesAllocated(), kRegionSize);
+    DCHECK_LE(thread->GetThreadLocalBytesAllocated(), region_size_);
     r->RecordThreadLocalAllocations(thread->GetThreadLocalObjectsAllocated(),
                                     thread->GetThreadLocalBytesAllocated());
+    tlab_waste_bytes_ += thread->TlabSize();
     r->is_a_tlab_ = false;
     r->thread_ = nullptr;
   }
@@ -24,6 +24,9 @@
 
 namespace art {
 namespace gc {
+
+class NumaTopology;
+
 namespace space {
 
 // A space that consists of equal-sized regions.
@@ -38,8 +41,13 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
   // Create a region space mem map with the requested sizes. The requested base address is not
   // guaranteed to be granted, if it is required, the caller should call Begin on the returned
   // space to confirm the request was granted.
-  static MemMap* CreateMemMap(const std::string& name, size_t capacity, uint8_t* requested_begin);
-  static RegionSpace* Create(const std::string& name, MemMap* mem_map);
+  static MemMap* CreateMemMap(const std::string& name,
+                              size_t capacity,
+                              uint8_t* requested_begin,
+                              size_t region_size = kDefaultRegionSize);
+  static RegionSpace* Create(const std::string& name,
+                             MemMap* mem_map,
+                             size_t region_size = kDefaultRegionSize);
 
   // Allocate num_bytes, returns null if the space is full.
   mirror::Object* Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated,
@@ -166,8 +174,70 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
 
   // Object alignment within the space.
   static constexpr size_t kAlignment = kObjectAlignment;
-  // The region size.
-  static constexpr size_t kRegionSize = 256 * KB;
+  // The default region size. The region size may be changed with -XX:RegionSize to any page
+  // aligned power of two.
+  static constexpr size_t kDefaultRegionSize = 256 * KB;
+  // The smallest region size, a region must be able to hold a TLAB.
+  static constexpr size_t kMinRegionSize = 32 * KB;
+
+  size_t RegionSize() const {
+    return region_size_;
+  }
+
+  // Statistics of the evacuation decisions made by SetFromSpace().
+  struct EvacuationStats {
+    // Regions (including large tails) evacuated and kept in place.
+    size_t evacuated_regions = 0;
+    size_t unevacuated_regions = 0;
+    // Evacuated regions that were allocated since the previous collection.
+    size_t newly_allocated_regions = 0;
+    // Sparse regions left in place because evacuating them would exceed the evacuation limit.
+    size_t capped_regions = 0;
+    // Live bytes of the evacuated regions that are not newly allocated, as of the previous
+    // collection.
+    uint64_t expected_copied_bytes = 0;
+    // Bytes freed by evacuating those regions, net of the copies.
+    uint64_t expected_reclaimed_bytes = 0;
+  };
+
+  // Limit the live bytes copied out of regions that are not newly allocated in each collection,
+  // zero means no limit. Newly allocated regions are always evacuated since their live bytes are
+  // not known.
+  void SetEvacuationLimit(size_t bytes) REQUIRES(!region_lock_) {
+    MutexLock mu(Thread::Current(), region_lock_);
+    evacuation_limit_ = bytes;
+  }
+
+  EvacuationStats GetLastEvacuationStats() REQUIRES(!region_lock_) {
+    MutexLock mu(Thread::Current(), region_lock_);
+    return last_evacuation_stats_;
+  }
+
+  void DumpEvacuationStats(std::ostream& os) REQUIRES(!region_lock_);
+
+  // Splits the regions into one contiguous range per node of the topology and binds the memory of
+  // each range to its node. TLAB and evacuation regions are then looked for first in the range of
+  // the node the allocating thread runs on. The topology must outlive the space.
+  void SetNumaTopology(const NumaTopology* topology) REQUIRES(!region_lock_);
+
+  // Returns the node whose range holds ref, zero if the space is not NUMA aware.
+  size_t GetNumaNode(mirror::Object* ref) {
+    if (numa_topology_ == nullptr) {
+      return 0u;
+    }
+    return RefToRegionUnlocked(ref)->Idx() / regions_per_numa_node_;
+  }
+
+  // Bytes left unused in TLABs when they were revoked.
+  uint64_t GetTlabWasteBytes() REQUIRES(!region_lock_) {
+    MutexLock mu(Thread::Current(), region_lock_);
+    return tlab_waste_bytes_;
+  }
+
+  void ResetTlabWasteBytes() REQUIRES(!region_lock_) {
+    MutexLock mu(Thread::Current(), region_lock_);
+    tlab_waste_bytes_ = 0U;
+  }
 
   bool IsInFromSpace(mirror::Object* ref) {
     if (HasAddress(ref)) {
@@ -209,6 +279,9 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
     return RegionType::kRegionTypeNone;
   }
 
+  // Rank the regions that SetFromSpace() may evacuate by their live bytes. Called before the flip
+  // pause so that the pause does not sort the regions.
+  void RankEvacuationCandidates() REQUIRES(!region_lock_);
   void SetFromSpace(accounting::ReadBarrierTable* rb_table, bool force_evacuate_all)
       REQUIRES(!region_lock_);
 
@@ -241,7 +314,7 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
   }
 
  private:
-  RegionSpace(const std::string& name, MemMap* mem_map);
+  RegionSpace(const std::string& name, MemMap* mem_map, size_t region_size);
 
   template<bool kToSpaceOnly>
   void WalkInternal(ObjectCallback* callback, void* arg) NO_THREAD_SAFETY_ANALYSIS;
@@ -269,7 +342,6 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
       is_a_tlab_ = false;
       thread_ = nullptr;
       DCHECK_LT(begin, end);
-      DCHECK_EQ(static_cast<size_t>(end - begin), kRegionSize);
     }
 
     RegionState State() const {
@@ -350,7 +422,7 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
     bool IsLarge() const {
       bool is_large = state_ == RegionState::kRegionStateLarge;
       if (is_large) {
-        DCHECK_LT(begin_ + kRegionSize, Top());
+        DCHECK_LT(end_, Top());
       }
       return is_large;
     }
@@ -423,7 +495,7 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
 
     size_t ObjectsAllocated() const {
       if (IsLarge()) {
-        DCHECK_LT(begin_ + kRegionSize, Top());
+        DCHECK_LT(end_, Top());
         DCHECK_EQ(objects_allocated_.LoadRelaxed(), 0U);
         return 1;
       } else if (IsLargeTail()) {
@@ -503,7 +575,7 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
   Region* RefToRegionLocked(mirror::Object* ref) REQUIRES(region_lock_) {
     DCHECK(HasAddress(ref));
     uintptr_t offset = reinterpret_cast<uintptr_t>(ref) - reinterpret_cast<uintptr_t>(Begin());
-    size_t reg_idx = offset / kRegionSize;
+    size_t reg_idx = offset >> region_size_shift_;
     DCHECK_LT(reg_idx, num_regions_);
     Region* reg = &regions_[reg_idx];
     DCHECK_EQ(reg->Idx(), reg_idx);
@@ -514,6 +586,9 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
   mirror::Object* GetNextObject(mirror::Object* obj)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Returns a free region, searching from the NUMA node of the calling thread, or null.
+  Region* FindFreeRegionLocked() REQUIRES(region_lock_);
+
   void AdjustNonFreeRegionLimit(size_t new_non_free_region_index) REQUIRES(region_lock_) {
     DCHECK_LT(new_non_free_region_index, num_regions_);
     non_free_region_index_limit_ = std::max(non_free_region_index_limit_,
@@ -527,6 +602,15 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
     VerifyNonFreeRegionLimit();
   }
 
+  // Whether r is evacuated when the copy budget allows, ranked by its live bytes.
+  bool IsEvacuationCandidate(Region* r) REQUIRES(region_lock_) {
+    return (r->IsAllocated() || r->IsLarge()) && !r->IsNewlyAllocated() && r->ShouldBeEvacuated();
+  }
+
+  // Decide which regions SetFromSpace() evacuates, in evacuate_region_.
+  void SelectRegionsToEvacuate(size_t iter_limit, bool force_evacuate_all, EvacuationStats* stats)
+      REQUIRES(region_lock_);
+
   void VerifyNonFreeRegionLimit() REQUIRES(region_lock_) {
     if (kIsDebugBuild && non_free_region_index_limit_ < num_regions_) {
       for (size_t i = non_free_region_index_limit_; i < num_regions_; ++i) {
@@ -537,6 +621,8 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
 
   Mutex region_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
 
+  const size_t region_size_;       // The size of each region, a power of two.
+  const size_t region_size_shift_;  // log2(region_size_).
   uint32_t time_;                  // The time as the number of collections since the startup.
   size_t num_regions_;             // The number of regions in this space.
   size_t num_non_free_regions_;    // The number of non-free regions in this space.
@@ -550,6 +636,20 @@ class RegionSpace FINAL : public ContinuousMemMapAllocSpace {
   Region* evac_region_;            // The region that's being evacuated to currently.
   Region full_region_;             // The dummy/sentinel region that looks full.
 
+  // Evacuation policy and its scratch state, ranked before the flip pause and consumed by
+  // SetFromSpace().
+  size_t evacuation_limit_ GUARDED_BY(region_lock_);
+  std::unique_ptr<bool[]> evacuate_region_ GUARDED_BY(region_lock_);
+  std::vector<Region*> evacuation_candidates_ GUARDED_BY(region_lock_);
+  EvacuationStats last_evacuation_stats_ GUARDED_BY(region_lock_);
+  EvacuationStats cumulative_evacuation_stats_ GUARDED_BY(region_lock_);
+
+  uint64_t tlab_waste_bytes_ GUARDED_BY(region_lock_);
+
+  // Set once before the space is used for allocation, null unless the space is NUMA aware.
+  const NumaTopology* numa_topology_;
+  size_t regions_per_numa_node_;
+
   // Mark bitmap used by the GC.
   std::unique_ptr<accounting::ContinuousSpaceBitmap> mark_bitmap_;
 
@@ -55,13 +55,15 @@ RosAllocSpace::RosAllocSpace(MemMap* mem_map, size_t initial_size, const std::st
 RosAllocSpace* RosAllocSpace::CreateFromMemMap(MemMap* mem_map, const std::string& name,
                                                size_t starting_size, size_t initial_size,
                                                size_t growth_limit, size_t capacity,
-                                               bool low_memory_mode, bool can_move_objects) {
+                                               bool low_memory_mode, bool can_move_objects,
+                                               size_t max_thread_local_bracket_size) {
   DCHECK(mem_map != nullptr);
 
   bool running_on_memory_tool = Runtime::Current()->IsRunningOnMemoryTool();
 
   allocator::RosAlloc* rosalloc = CreateRosAlloc(mem_map->Begin(), starting_size, initial_size,
-                                                 capacity, low_memory_mode, running_on_memory_tool);
+                                                 capacity, low_memory_mode, running_on_memory_tool,
+                                                 max_thread_local_bracket_size);
   if (rosalloc == nullptr) {
     LOG(ERROR) << "Failed to initialize rosalloc for alloc space (" << name << ")";
     return nullptr;
@@ -93,7 +95,8 @@ RosAllocSpace::~RosAllocSpace() {
 
 RosAllocSpace* RosAllocSpace::Create(const std::string& name, size_t initial_size,
                                      size_t growth_limit, size_t capacity, uint8_t* requested_begin,
-                                     bool low_memory_mode, bool can_move_objects) {
+                                     bool low_memory_mode, bool can_move_objects,
+                                     size_t max_thread_local_bracket_size) {
   uint64_t start_time = 0;
   if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
     start_time = NanoTime();
@@ -119,7 +122,7 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name, size_t initial_siz
 
   RosAllocSpace* space = CreateFromMemMap(mem_map, name, starting_size, initial_size,
                                           growth_limit, capacity, low_memory_mode,
-                                          can_move_objects);
+                                          can_move_objects, max_thread_local_bracket_size);
   // We start out with only the initial size possibly containing objects.
   if (VLOG_IS_ON(heap) || VLOG_IS_ON(startup)) {
     LOG(INFO) << "RosAllocSpace::Create exiting (" << PrettyDuration(NanoTime() - start_time)
@@ -131,7 +134,8 @@ RosAllocSpace* RosAllocSpace::Create(const std::string& name, size_t initial_siz
 allocator::RosAlloc* RosAllocSpace::CreateRosAlloc(void* begin, size_t morecore_start,
                                                    size_t initial_size,
                                                    size_t maximum_size, bool low_memory_mode,
-                                                   bool running_on_memory_tool) {
+                                                   bool running_on_memory_tool,
+                                                   size_t max_thread_local_bracket_size) {
   // clear errno to allow PLOG on error
   errno = 0;
   // create rosalloc using our backing storage starting at begin and
@@ -145,6 +149,7 @@ allocator::RosAlloc* RosAllocSpace::CreateRosAlloc(void* begin, size_t morecore_
       running_on_memory_tool);
   if (rosalloc != nullptr) {
     rosalloc->SetFootprintLimit(initial_size);
+    rosalloc->SetMaxThreadLocalBracketSize(max_thread_local_bracket_size);
   } else {
     PLOG(ERROR) << "RosAlloc::Create failed";
   }
@@ -241,7 +246,7 @@ size_t RosAllocSpace::FreeList(Thread* self, size_t num_ptrs, mirror::Object** p
   return bytes_freed;
 }
 
-size_t RosAllocSpace::Trim() {
+size_t RosAllocSpace::Trim(TrimBudget* budget) {
   VLOG(heap) << "RosAllocSpace::Trim() ";
   {
     Thread* const self = Thread::Current();
@@ -253,7 +258,7 @@ size_t RosAllocSpace::Trim() {
   }
   // Attempt to release pages if it does not release all empty pages.
   if (!rosalloc_->DoesReleaseAllPages()) {
-    return rosalloc_->ReleasePages();
+    return rosalloc_->ReleasePages(budget);
   }
   return 0;
 }
@@ -339,6 +344,10 @@ size_t RosAllocSpace::RevokeThreadLocalBuffers(Thread* thread) {
   return rosalloc_->RevokeThreadLocalRuns(thread);
 }
 
+size_t RosAllocSpace::RevokeIdleThreadLocalBuffers(Thread* thread) {
+  return rosalloc_->RevokeIdleThreadLocalRuns(thread);
+}
+
 size_t RosAllocSpace::RevokeAllThreadLocalBuffers() {
   return rosalloc_->RevokeAllThreadLocalRuns();
 }
@@ -361,10 +370,12 @@ void RosAllocSpace::Clear() {
   live_bitmap_->Clear();
   mark_bitmap_->Clear();
   SetEnd(begin_ + starting_size_);
+  const size_t max_thread_local_bracket_size = rosalloc_->GetMaxThreadLocalBracketSize();
   delete rosalloc_;
   rosalloc_ = CreateRosAlloc(mem_map_->Begin(), starting_size_, initial_size_,
                              NonGrowthLimitCapacity(), low_memory_mode_,
-                             Runtime::Current()->IsRunningOnMemoryTool());
+                             Runtime::Current()->IsRunningOnMemoryTool(),
+                             max_thread_local_bracket_size);
   SetFootprintLimit(footprint_limit);
 }
 
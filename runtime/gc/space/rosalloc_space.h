@@ -38,13 +38,19 @@ class RosAllocSpace : public MallocSpace {
   // base address is not guaranteed to be granted, if it is required,
   // the caller should call Begin on the returned space to confirm the
   // request was granted.
+  // The spaces split off by CreateZygoteSpace() and Clear() keep
+  // max_thread_local_bracket_size, see RosAlloc::SetMaxThreadLocalBracketSize().
   static RosAllocSpace* Create(const std::string& name, size_t initial_size, size_t growth_limit,
                                size_t capacity, uint8_t* requested_begin, bool low_memory_mode,
-                               bool can_move_objects);
+                               bool can_move_objects,
+                               size_t max_thread_local_bracket_size =
+                                   allocator::RosAlloc::kMaxThreadLocalBracketSize);
   static RosAllocSpace* CreateFromMemMap(MemMap* mem_map, const std::string& name,
                                          size_t starting_size, size_t initial_size,
                                          size_t growth_limit, size_t capacity,
-                                         bool low_memory_mode, bool can_move_objects);
+                                         bool low_memory_mode, bool can_move_objects,
+                                         size_t max_thread_local_bracket_size =
+                                             allocator::RosAlloc::kMaxThreadLocalBracketSize);
 
   mirror::Object* AllocWithGrowth(Thread* self, size_t num_bytes, size_t* bytes_allocated,
                                   size_t* usable_size, size_t* bytes_tl_bulk_allocated)
@@ -103,7 +109,11 @@ class RosAllocSpace : public MallocSpace {
     return rosalloc_;
   }
 
-  size_t Trim() OVERRIDE;
+  size_t Trim() OVERRIDE {
+    return Trim(nullptr);
+  }
+  // Trim, releasing the empty pages within the budget if there is one.
+  size_t Trim(TrimBudget* budget);
   void Walk(WalkCallback callback, void* arg) OVERRIDE REQUIRES(!lock_);
   size_t GetFootprint() OVERRIDE;
   size_t GetFootprintLimit() OVERRIDE;
@@ -119,6 +129,8 @@ class RosAllocSpace : public MallocSpace {
   uint64_t GetObjectsAllocated() OVERRIDE;
 
   size_t RevokeThreadLocalBuffers(Thread* thread);
+  // Revoke the optional thread-local runs the thread has not used lately.
+  size_t RevokeIdleThreadLocalBuffers(Thread* thread);
   size_t RevokeAllThreadLocalBuffers();
   void AssertThreadLocalBuffersAreRevoked(Thread* thread);
   void AssertAllThreadLocalBuffersAreRevoked();
@@ -157,14 +169,17 @@ class RosAllocSpace : public MallocSpace {
   mirror::Object* AllocCommon(Thread* self, size_t num_bytes, size_t* bytes_allocated,
                               size_t* usable_size, size_t* bytes_tl_bulk_allocated);
 
+  // The new allocator uses thread-local runs for the same brackets as this space's.
   void* CreateAllocator(void* base, size_t morecore_start, size_t initial_size,
                         size_t maximum_size, bool low_memory_mode) OVERRIDE {
     return CreateRosAlloc(base, morecore_start, initial_size, maximum_size, low_memory_mode,
-                          RUNNING_ON_MEMORY_TOOL != 0);
+                          RUNNING_ON_MEMORY_TOOL != 0,
+                          rosalloc_->GetMaxThreadLocalBracketSize());
   }
   static allocator::RosAlloc* CreateRosAlloc(void* base, size_t morecore_start, size_t initial_size,
                                              size_t maximum_size, bool low_memory_mode,
-                                             bool running_on_memory_tool);
+                                             bool running_on_memory_tool,
+                                             size_t max_thread_local_bracket_size);
 
   void InspectAllRosAlloc(void (*callback)(void *start, void *end, size_t num_bytes, void* callback_arg),
                           void* arg, bool do_null_callback_at_end)
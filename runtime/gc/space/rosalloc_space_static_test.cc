@@ -16,6 +16,8 @@
 
 #include "space_test.h"
 
+#include "gc/trim_budget.h"
+
 namespace art {
 namespace gc {
 namespace space {
@@ -28,6 +30,79 @@ MallocSpace* CreateRosAllocSpace(const std::string& name, size_t initial_size, s
 
 TEST_SPACE_CREATE_FN_STATIC(RosAllocSpace, CreateRosAllocSpace)
 
+TEST_F(RosAllocSpaceStaticTest, IncrementalTrim) {
+  static constexpr size_t kNumObjects = 64;
+  static constexpr size_t kObjectSize = 64 * KB;
+  MallocSpace* space = RosAllocSpace::Create("test", 8 * MB, 8 * MB, 8 * MB, nullptr,
+                                             /* low_memory_mode */ false, false);
+  ASSERT_TRUE(space != nullptr);
+  AddSpace(space);
+  Thread* self = Thread::Current();
+  {
+    ScopedObjectAccess soa(self);
+    std::vector<mirror::Object*> objects;
+    for (size_t i = 0; i < kNumObjects; ++i) {
+      size_t bytes_allocated = 0;
+      size_t bytes_tl_bulk_allocated;
+      mirror::Object* obj = Alloc(space, self, kObjectSize, &bytes_allocated, nullptr,
+                                  &bytes_tl_bulk_allocated);
+      ASSERT_TRUE(obj != nullptr);
+      objects.push_back(obj);
+    }
+    // Leave holes that are not coalesced and are below the release size threshold.
+    for (size_t i = 0; i < kNumObjects; i += 2) {
+      space->Free(self, objects[i]);
+    }
+  }
+  // Each step stops once its budget is used up and the next one resumes where it stopped.
+  size_t steps = 0;
+  size_t reclaimed_bytes = 0;
+  while (true) {
+    TrimBudget budget(16 * KB, 128 * KB);
+    reclaimed_bytes += down_cast<RosAllocSpace*>(space)->Trim(&budget);
+    ++steps;
+    if (!budget.IsExhausted()) {
+      break;
+    }
+    ASSERT_LE(budget.GetReleasedBytes(), 128 * KB + 16 * KB);
+  }
+  EXPECT_GT(steps, 1u);
+  EXPECT_GE(reclaimed_bytes, kNumObjects / 2 * (kObjectSize - kPageSize));
+  // Everything was released, an unlimited trim has nothing left to do.
+  EXPECT_EQ(down_cast<RosAllocSpace*>(space)->Trim(), 0u);
+}
+
+TEST_F(RosAllocSpaceStaticTest, ZygoteSpaceKeepsThreadLocalBracketSize) {
+  MallocSpace* space = RosAllocSpace::Create("test", 4 * MB, 16 * MB, 16 * MB, nullptr,
+                                             /* low_memory_mode */ false, false,
+                                             /* max_thread_local_bracket_size */ 1 * KB);
+  ASSERT_TRUE(space != nullptr);
+  EXPECT_EQ(1 * KB, space->AsRosAllocSpace()->GetRosAlloc()->GetMaxThreadLocalBracketSize());
+  AddSpace(space);
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  // Make sure that the zygote space isn't directly at the start of the space.
+  size_t dummy;
+  EXPECT_TRUE(space->Alloc(self, 1 * MB, &dummy, nullptr, &dummy) != nullptr);
+
+  gc::Heap* heap = Runtime::Current()->GetHeap();
+  space::Space* old_space = space;
+  {
+    ScopedThreadSuspension sts(self, kSuspended);
+    ScopedSuspendAll ssa("Add zygote space");
+    heap->RemoveSpace(old_space);
+  }
+  heap->RevokeAllThreadLocalBuffers();
+  space::ZygoteSpace* zygote_space = space->CreateZygoteSpace("alloc space",
+                                                              heap->IsLowMemoryMode(),
+                                                              &space);
+  delete old_space;
+  AddSpace(zygote_space, false);
+  AddSpace(space, false);
+  // The new alloc space uses the same thread-local brackets.
+  ASSERT_TRUE(space->IsRosAllocSpace());
+  EXPECT_EQ(1 * KB, space->AsRosAllocSpace()->GetRosAlloc()->GetMaxThreadLocalBracketSize());
+}
 
 }  // namespace space
 }  // namespace gc
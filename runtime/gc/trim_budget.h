@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_TRIM_BUDGET_H_
+#define ART_RUNTIME_GC_TRIM_BUDGET_H_
+
+#include <limits>
+
+#include "base/macros.h"
+
+namespace art {
+namespace gc {
+
+// Bounds the work of one step of an incremental heap trim. Pages are released in batches of at
+// most BatchBytes() so that the lock of a space is not held across a long madvise, and the step
+// ends once max_bytes have been released. The heap limits the release rate by spacing the steps.
+class TrimBudget {
+ public:
+  // Zero means no limit.
+  TrimBudget(size_t batch_bytes, size_t max_bytes)
+      : batch_bytes_(batch_bytes), max_bytes_(max_bytes), released_bytes_(0) {}
+
+  size_t BatchBytes() const {
+    return batch_bytes_ != 0 ? batch_bytes_ : std::numeric_limits<size_t>::max();
+  }
+
+  void AddReleasedBytes(size_t bytes) {
+    released_bytes_ += bytes;
+  }
+
+  size_t GetReleasedBytes() const {
+    return released_bytes_;
+  }
+
+  // True if the step is over, the caller should stop and resume in the next step.
+  bool IsExhausted() const {
+    return max_bytes_ != 0 && released_bytes_ >= max_bytes_;
+  }
+
+ private:
+  const size_t batch_bytes_;
+  const size_t max_bytes_;
+  // Bytes passed to madvise so far, including pages that were already released.
+  size_t released_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(TrimBudget);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_TRIM_BUDGET_H_
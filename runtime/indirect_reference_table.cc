@@ -27,6 +27,7 @@
 #include "thread.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 namespace art {
@@ -62,29 +63,44 @@ void IndirectReferenceTable::AbortIfNoCheckJNI(const std::string& msg) {
 IndirectReferenceTable::IndirectReferenceTable(size_t max_count,
                                                IndirectRefKind desired_kind,
                                                ResizableCapacity resizable,
-                                               std::string* error_msg)
+                                               std::string* error_msg,
+                                               uint32_t stripe,
+                                               size_t stripe_bits)
     : segment_state_(kIRTFirstSegment),
       kind_(desired_kind),
-      max_entries_(max_count),
-      current_num_holes_(0),
+      stripe_(stripe),
+      stripe_bits_(stripe_bits),
       resizable_(resizable) {
   CHECK(error_msg != nullptr);
   CHECK_NE(desired_kind, kHandleScopeOrInvalid);
-
-  const size_t table_bytes = max_count * sizeof(IrtEntry);
-  table_mem_map_.reset(MemMap::MapAnonymous("indirect ref table", nullptr, table_bytes,
-                                            PROT_READ | PROT_WRITE, false, false, error_msg));
-  if (table_mem_map_.get() == nullptr && error_msg->empty()) {
+  CHECK_GT(max_count, 0u);
+  CHECK_LT(stripe, 1u << stripe_bits);
+
+  std::fill_n(chunks_, kMaxChunks, nullptr);
+  // Later chunks double the capacity, which keeps the index to chunk mapping a bit scan.
+  first_chunk_size_ = (resizable == ResizableCapacity::kYes) ? RoundUpToPowerOfTwo(max_count)
+                                                             : max_count;
+  first_chunk_shift_ = (resizable == ResizableCapacity::kYes) ? WhichPowerOf2(first_chunk_size_)
+                                                              : 0u;
+  max_entries_ = 0u;
+  const size_t table_bytes = first_chunk_size_ * sizeof(IrtEntry);
+  std::unique_ptr<MemMap> first_chunk(MemMap::MapAnonymous("indirect ref table",
+                                                           nullptr,
+                                                           table_bytes,
+                                                           PROT_READ | PROT_WRITE,
+                                                           false,
+                                                           false,
+                                                           error_msg));
+  if (first_chunk == nullptr && error_msg->empty()) {
     *error_msg = "Unable to map memory for indirect ref table";
   }
 
-  if (table_mem_map_.get() != nullptr) {
-    table_ = reinterpret_cast<IrtEntry*>(table_mem_map_->Begin());
-  } else {
-    table_ = nullptr;
+  if (first_chunk != nullptr) {
+    chunks_[0] = reinterpret_cast<IrtEntry*>(first_chunk->Begin());
+    chunk_mem_maps_.push_back(std::move(first_chunk));
+    max_entries_ = first_chunk_size_;
   }
   segment_state_ = kIRTFirstSegment;
-  last_known_previous_state_ = kIRTFirstSegment;
 }
 
 IndirectReferenceTable::~IndirectReferenceTable() {
@@ -119,91 +135,51 @@ void IndirectReferenceTable::ConstexprChecks() {
 }
 
 bool IndirectReferenceTable::IsValid() const {
-  return table_mem_map_.get() != nullptr;
+  return !chunk_mem_maps_.empty();
 }
 
 // Holes:
 //
 // To keep the IRT compact, we want to fill "holes" created by non-stack-discipline Add & Remove
-// operation sequences. For simplicity and lower memory overhead, we do not use a free list or
-// similar. Instead, we scan for holes, with the expectation that we will find holes fast as they
-// are usually near the end of the table (see the header, TODO: verify this assumption). To avoid
-// scans when there are no holes, the number of known holes should be tracked.
+// operation sequences. Remove pushes the index of every hole it creates onto free_list_, and Add
+// pops the most recent one, so neither has to scan the table.
 //
 // A previous implementation stored the top index and the number of holes as the segment state.
 // This constraints the maximum number of references to 16-bit. We want to relax this, as it
 // is easy to require more references (e.g., to list all classes in large applications). Thus,
 // the implicitly stack-stored state, the IRTSegmentState, is only the top index.
 //
-// Thus, hole count is a local property of the current segment, and needs to be recovered when
-// (or after) a frame is pushed or popped. To keep JNI transitions simple (and inlineable), we
-// cannot do work when the segment changes. Thus, Add and Remove need to ensure the current
-// hole count is correct.
+// To keep JNI transitions simple (and inlineable), we cannot do work when the segment changes,
+// so the free list is not updated when a segment is pushed or popped. Instead, Add validates the
+// index it pops, which covers the following (some non-trivial) cases:
 //
-// To be able to detect segment changes, we require an additional local field that can describe
-// the known segment. This is last_known_previous_state_. The requirement will become clear with
-// the following (some non-trivial) cases that have to be supported:
-//
-// 1) Segment with holes (current_num_holes_ > 0), push new segment, add/remove reference
-// 2) Segment with holes (current_num_holes_ > 0), pop segment, add/remove reference
-// 3) Segment with holes (current_num_holes_ > 0), push new segment, pop segment, add/remove
-//    reference
+// 1) Segment with holes, push new segment, add/remove reference
+// 2) Segment with holes, pop segment, add/remove reference
+// 3) Segment with holes, push new segment, pop segment, add/remove reference
 // 4) Empty segment, push new segment, create a hole, pop a segment, add/remove a reference
 // 5) Base segment, push new segment, create a hole, pop a segment, push new segment, add/remove
 //    reference
 //
-// Storing the last known *previous* state (bottom index) allows conservatively detecting all the
-// segment changes above. The condition is simply that the last known state is greater than or
-// equal to the current previous state, and smaller than the current state (top index). The
-// condition is conservative as it adds O(1) overhead to operations on an empty segment.
-
-static size_t CountNullEntries(const IrtEntry* table, size_t from, size_t to) {
-  size_t count = 0;
-  for (size_t index = from; index != to; ++index) {
-    if (table[index].GetReference()->IsNull()) {
-      count++;
-    }
-  }
-  return count;
-}
-
-void IndirectReferenceTable::RecoverHoles(IRTSegmentState prev_state) {
-  if (last_known_previous_state_.top_index >= segment_state_.top_index ||
-      last_known_previous_state_.top_index < prev_state.top_index) {
-    const size_t top_index = segment_state_.top_index;
-    size_t count = CountNullEntries(table_, prev_state.top_index, top_index);
-
-    if (kDebugIRT) {
-      LOG(INFO) << "+++ Recovered holes: "
-                << " Current prev=" << prev_state.top_index
-                << " Current top_index=" << top_index
-                << " Old num_holes=" << current_num_holes_
-                << " New num_holes=" << count;
-    }
-
-    current_num_holes_ = count;
-    last_known_previous_state_ = prev_state;
-  } else if (kDebugIRT) {
-    LOG(INFO) << "No need to recover holes";
-  }
-}
-
-ALWAYS_INLINE
-static inline void CheckHoleCount(IrtEntry* table,
-                                  size_t exp_num_holes,
-                                  IRTSegmentState prev_state,
-                                  IRTSegmentState cur_state) {
-  if (kIsDebugBuild) {
-    size_t count = CountNullEntries(table, prev_state.top_index, cur_state.top_index);
-    CHECK_EQ(exp_num_holes, count) << "prevState=" << prev_state.top_index
-                                   << " topIndex=" << cur_state.top_index;
+// An index at or above the top index belongs to a popped segment (2, 4, 5), or was consumed when
+// the top-most entry was removed, and is dropped. So is an index whose entry is in use again. An
+// index below the bottom index is a hole of an outer segment (1) and stays on the list for when
+// that segment is the current one again, we append instead. Any other index is a hole of the
+// current segment (3).
+//
+// Dropping stale indexes lazily means that the free list can hold more indexes than there are
+// holes. Remove prunes it once it is much longer than the table, which keeps both operations
+// O(1) amortized.
+
+bool IndirectReferenceTable::AddChunk(std::string* error_msg) {
+  const size_t num_chunks = chunk_mem_maps_.size();
+  DCHECK_GT(num_chunks, 0u);
+  if (num_chunks == kMaxChunks) {
+    *error_msg = "Too many chunks";
+    return false;
   }
-}
-
-bool IndirectReferenceTable::Resize(size_t new_size, std::string* error_msg) {
-  CHECK_GT(new_size, max_entries_);
-
-  const size_t table_bytes = new_size * sizeof(IrtEntry);
+  // The new chunk holds as many entries as all the previous ones together.
+  DCHECK_EQ(max_entries_, first_chunk_size_ << (num_chunks - 1));
+  const size_t table_bytes = max_entries_ * sizeof(IrtEntry);
   std::unique_ptr<MemMap> new_map(MemMap::MapAnonymous("indirect ref table",
                                                        nullptr,
                                                        table_bytes,
@@ -215,29 +191,85 @@ bool IndirectReferenceTable::Resize(size_t new_size, std::string* error_msg) {
     return false;
   }
 
-  memcpy(new_map->Begin(), table_mem_map_->Begin(), table_mem_map_->Size());
-  table_mem_map_ = std::move(new_map);
-  table_ = reinterpret_cast<IrtEntry*>(table_mem_map_->Begin());
-  max_entries_ = new_size;
+  chunks_[num_chunks] = reinterpret_cast<IrtEntry*>(new_map->Begin());
+  chunk_mem_maps_.push_back(std::move(new_map));
+  max_entries_ *= 2;
+  return true;
+}
 
+bool IndirectReferenceTable::EnsureFreeCapacity(size_t free_capacity, std::string* error_msg) {
+  const size_t top_index = segment_state_.top_index;
+  while (free_capacity > max_entries_ - top_index) {
+    if (resizable_ == ResizableCapacity::kNo) {
+      *error_msg = "Table is not resizable";
+      return false;
+    }
+    if (!AddChunk(error_msg)) {
+      return false;
+    }
+  }
   return true;
 }
 
+bool IndirectReferenceTable::TakeHole(uint32_t bottom_index, uint32_t* index) {
+  const uint32_t top_index = segment_state_.top_index;
+  while (!free_list_.empty()) {
+    const uint32_t candidate = free_list_.back();
+    if (candidate < bottom_index) {
+      // A hole of an outer segment.
+      return false;
+    }
+    free_list_.pop_back();
+    if (candidate < top_index && GetEntry(candidate)->GetReference()->IsNull()) {
+      *index = candidate;
+      return true;
+    }
+    if (kDebugIRT) {
+      LOG(INFO) << "+++ dropped stale hole " << candidate;
+    }
+  }
+  return false;
+}
+
+void IndirectReferenceTable::PruneFreeList() {
+  const uint32_t top_index = segment_state_.top_index;
+  auto is_stale = [this, top_index](uint32_t index) REQUIRES_SHARED(Locks::mutator_lock_) {
+    return index >= top_index || !GetEntry(index)->GetReference()->IsNull();
+  };
+  free_list_.erase(std::remove_if(free_list_.begin(), free_list_.end(), is_stale),
+                   free_list_.end());
+  // Ascending, so that Add pops the holes of the innermost segment first.
+  std::sort(free_list_.begin(), free_list_.end());
+  free_list_.erase(std::unique(free_list_.begin(), free_list_.end()), free_list_.end());
+  if (kDebugIRT) {
+    LOG(INFO) << "+++ pruned free list to " << free_list_.size() << " holes";
+  }
+}
+
 IndirectRef IndirectReferenceTable::Add(IRTSegmentState previous_state,
                                         ObjPtr<mirror::Object> obj) {
   if (kDebugIRT) {
     LOG(INFO) << "+++ Add: previous_state=" << previous_state.top_index
               << " top_index=" << segment_state_.top_index
-              << " last_known_prev_top_index=" << last_known_previous_state_.top_index
-              << " holes=" << current_num_holes_;
+              << " free_list_size=" << free_list_.size();
   }
 
-  size_t top_index = segment_state_.top_index;
-
   CHECK(obj != nullptr);
   VerifyObject(obj);
-  DCHECK(table_ != nullptr);
+  DCHECK(IsValid());
+
+  // If there's a hole in the current segment, fill it; otherwise, add to the end of the list.
+  uint32_t index;
+  if (TakeHole(previous_state.top_index, &index)) {
+    GetEntry(index)->Add(obj);
+    IndirectRef result = ToIndirectRef(index);
+    if (kDebugIRT) {
+      LOG(INFO) << "+++ filled hole at " << index << " top=" << segment_state_.top_index;
+    }
+    return result;
+  }
 
+  const uint32_t top_index = segment_state_.top_index;
   if (top_index == max_entries_) {
     if (resizable_ == ResizableCapacity::kNo) {
       LOG(FATAL) << "JNI ERROR (app bug): " << kind_ << " table overflow "
@@ -246,9 +278,9 @@ IndirectRef IndirectReferenceTable::Add(IRTSegmentState previous_state,
       UNREACHABLE();
     }
 
-    // Try to double space.
+    // Try to double space. Existing entries are not moved.
     std::string error_msg;
-    if (!Resize(max_entries_ * 2, &error_msg)) {
+    if (!AddChunk(&error_msg)) {
       LOG(FATAL) << "JNI ERROR (app bug): " << kind_ << " table overflow "
                  << "(max=" << max_entries_ << ")" << std::endl
                  << MutatorLockedDumpable<IndirectReferenceTable>(*this)
@@ -257,36 +289,12 @@ IndirectRef IndirectReferenceTable::Add(IRTSegmentState previous_state,
     }
   }
 
-  RecoverHoles(previous_state);
-  CheckHoleCount(table_, current_num_holes_, previous_state, segment_state_);
-
-  // We know there's enough room in the table.  Now we just need to find
-  // the right spot.  If there's a hole, find it and fill it; otherwise,
-  // add to the end of the list.
-  IndirectRef result;
-  size_t index;
-  if (current_num_holes_ > 0) {
-    DCHECK_GT(top_index, 1U);
-    // Find the first hole; likely to be near the end of the list.
-    IrtEntry* p_scan = &table_[top_index - 1];
-    DCHECK(!p_scan->GetReference()->IsNull());
-    --p_scan;
-    while (!p_scan->GetReference()->IsNull()) {
-      DCHECK_GE(p_scan, table_ + previous_state.top_index);
-      --p_scan;
-    }
-    index = p_scan - table_;
-    current_num_holes_--;
-  } else {
-    // Add to the end.
-    index = top_index++;
-    segment_state_.top_index = top_index;
-  }
-  table_[index].Add(obj);
-  result = ToIndirectRef(index);
+  index = top_index;
+  segment_state_.top_index = top_index + 1;
+  GetEntry(index)->Add(obj);
+  IndirectRef result = ToIndirectRef(index);
   if (kDebugIRT) {
-    LOG(INFO) << "+++ added at " << ExtractIndex(result) << " top=" << segment_state_.top_index
-              << " holes=" << current_num_holes_;
+    LOG(INFO) << "+++ added at " << index << " top=" << segment_state_.top_index;
   }
 
   DCHECK(result != nullptr);
@@ -295,7 +303,7 @@ IndirectRef IndirectReferenceTable::Add(IRTSegmentState previous_state,
 
 void IndirectReferenceTable::AssertEmpty() {
   for (size_t i = 0; i < Capacity(); ++i) {
-    if (!table_[i].GetReference()->IsNull()) {
+    if (!GetEntry(i)->GetReference()->IsNull()) {
       LOG(FATAL) << "Internal Error: non-empty local reference table\n"
                  << MutatorLockedDumpable<IndirectReferenceTable>(*this);
       UNREACHABLE();
@@ -315,14 +323,13 @@ bool IndirectReferenceTable::Remove(IRTSegmentState previous_state, IndirectRef
   if (kDebugIRT) {
     LOG(INFO) << "+++ Remove: previous_state=" << previous_state.top_index
               << " top_index=" << segment_state_.top_index
-              << " last_known_prev_top_index=" << last_known_previous_state_.top_index
-              << " holes=" << current_num_holes_;
+              << " free_list_size=" << free_list_.size();
   }
 
   const uint32_t top_index = segment_state_.top_index;
   const uint32_t bottom_index = previous_state.top_index;
 
-  DCHECK(table_ != nullptr);
+  DCHECK(IsValid());
 
   if (GetIndirectRefKind(iref) == kHandleScopeOrInvalid) {
     auto* self = Thread::Current();
@@ -353,47 +360,31 @@ bool IndirectReferenceTable::Remove(IRTSegmentState previous_state, IndirectRef
     return false;
   }
 
-  RecoverHoles(previous_state);
-  CheckHoleCount(table_, current_num_holes_, previous_state, segment_state_);
-
   if (idx == top_index - 1) {
-    // Top-most entry.  Scan up and consume holes.
+    // Top-most entry.  Scan up and consume holes. Their indexes stay on the free list and are
+    // dropped by the next Add that pops them.
 
     if (!CheckEntry("remove", iref, idx)) {
       return false;
     }
 
-    *table_[idx].GetReference() = GcRoot<mirror::Object>(nullptr);
-    if (current_num_holes_ != 0) {
-      uint32_t collapse_top_index = top_index;
-      while (--collapse_top_index > bottom_index && current_num_holes_ != 0) {
-        if (kDebugIRT) {
-          ScopedObjectAccess soa(Thread::Current());
-          LOG(INFO) << "+++ checking for hole at " << collapse_top_index - 1
-                    << " (previous_state=" << bottom_index << ") val="
-                    << table_[collapse_top_index - 1].GetReference()->Read<kWithoutReadBarrier>();
-        }
-        if (!table_[collapse_top_index - 1].GetReference()->IsNull()) {
-          break;
-        }
-        if (kDebugIRT) {
-          LOG(INFO) << "+++ ate hole at " << (collapse_top_index - 1);
-        }
-        current_num_holes_--;
-      }
-      segment_state_.top_index = collapse_top_index;
-
-      CheckHoleCount(table_, current_num_holes_, previous_state, segment_state_);
-    } else {
-      segment_state_.top_index = top_index - 1;
+    *GetEntry(idx)->GetReference() = GcRoot<mirror::Object>(nullptr);
+    uint32_t collapse_top_index = idx;
+    while (collapse_top_index > bottom_index &&
+           GetEntry(collapse_top_index - 1)->GetReference()->IsNull()) {
       if (kDebugIRT) {
-        LOG(INFO) << "+++ ate last entry " << top_index - 1;
+        LOG(INFO) << "+++ ate hole at " << (collapse_top_index - 1);
       }
+      --collapse_top_index;
+    }
+    segment_state_.top_index = collapse_top_index;
+    if (kDebugIRT) {
+      LOG(INFO) << "+++ ate last entry " << idx << ", top=" << collapse_top_index;
     }
   } else {
     // Not the top-most entry.  This creates a hole.  We null out the entry to prevent somebody
-    // from deleting it twice and screwing up the hole count.
-    if (table_[idx].GetReference()->IsNull()) {
+    // from deleting it twice and putting it on the free list twice.
+    if (GetEntry(idx)->GetReference()->IsNull()) {
       LOG(INFO) << "--- WEIRD: removing null entry " << idx;
       return false;
     }
@@ -401,11 +392,14 @@ bool IndirectReferenceTable::Remove(IRTSegmentState previous_state, IndirectRef
       return false;
     }
 
-    *table_[idx].GetReference() = GcRoot<mirror::Object>(nullptr);
-    current_num_holes_++;
-    CheckHoleCount(table_, current_num_holes_, previous_state, segment_state_);
+    *GetEntry(idx)->GetReference() = GcRoot<mirror::Object>(nullptr);
+    free_list_.push_back(idx);
+    // There cannot be more holes than entries, the rest are stale indexes.
+    if (free_list_.size() > 2u * static_cast<size_t>(top_index)) {
+      PruneFreeList();
+    }
     if (kDebugIRT) {
-      LOG(INFO) << "+++ left hole at " << idx << ", holes=" << current_num_holes_;
+      LOG(INFO) << "+++ left hole at " << idx << ", free_list_size=" << free_list_.size();
     }
   }
 
@@ -415,9 +409,22 @@ bool IndirectReferenceTable::Remove(IRTSegmentState previous_state, IndirectRef
 void IndirectReferenceTable::Trim() {
   ScopedTrace trace(__PRETTY_FUNCTION__);
   const size_t top_index = Capacity();
-  auto* release_start = AlignUp(reinterpret_cast<uint8_t*>(&table_[top_index]), kPageSize);
-  uint8_t* release_end = table_mem_map_->End();
-  madvise(release_start, release_end - release_start, MADV_DONTNEED);
+  // Chunks are kept mapped, they would be needed again when the table grows back.
+  size_t chunk_begin = 0u;
+  for (size_t i = 0; i != chunk_mem_maps_.size(); ++i) {
+    MemMap* map = chunk_mem_maps_[i].get();
+    const size_t chunk_size = map->Size() / sizeof(IrtEntry);
+    if (top_index < chunk_begin + chunk_size) {
+      const size_t first_free = std::max(top_index, chunk_begin) - chunk_begin;
+      uint8_t* release_start =
+          AlignUp(reinterpret_cast<uint8_t*>(&chunks_[i][first_free]), kPageSize);
+      uint8_t* release_end = map->End();
+      if (release_start < release_end) {
+        madvise(release_start, release_end - release_start, MADV_DONTNEED);
+      }
+    }
+    chunk_begin += chunk_size;
+  }
 }
 
 void IndirectReferenceTable::VisitRoots(RootVisitor* visitor, const RootInfo& root_info) {
@@ -434,9 +441,9 @@ void IndirectReferenceTable::Dump(std::ostream& os) const {
   os << kind_ << " table dump:\n";
   ReferenceTable::Table entries;
   for (size_t i = 0; i < Capacity(); ++i) {
-    ObjPtr<mirror::Object> obj = table_[i].GetReference()->Read<kWithoutReadBarrier>();
+    ObjPtr<mirror::Object> obj = GetEntry(i)->GetReference()->Read<kWithoutReadBarrier>();
     if (obj != nullptr) {
-      obj = table_[i].GetReference()->Read();
+      obj = GetEntry(i)->GetReference()->Read();
       entries.push_back(GcRoot<mirror::Object>(obj));
     }
   }
@@ -21,7 +21,9 @@
 
 #include <iosfwd>
 #include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "base/bit_utils.h"
 #include "base/logging.h"
@@ -106,9 +108,9 @@ const char* GetIndirectRefKindString(const IndirectRefKind& kind);
 // removing a recently-added entry (usually the most-recently-added entry).  For JNI local
 // references, the common operations are adding a new entry and removing an entire table segment.
 //
-// If we delete entries from the middle of the list, we will be left with "holes".  We track the
-// number of holes so that, when adding new elements, we can quickly decide to do a trivial append
-// or go slot-hunting.
+// If we delete entries from the middle of the list, we will be left with "holes". The indexes of
+// the holes go on a free list, so that adding a new element either takes the most recent hole of
+// the current segment or appends, both in O(1).
 //
 // When the top-most entry is removed, any holes immediately below it are also removed. Thus,
 // deletion of an entry may reduce "top_index" by more than one.
@@ -119,11 +121,14 @@ const char* GetIndirectRefKindString(const IndirectRefKind& kind);
 // serves as the new bottom. When we pop a frame off, the value from the stack becomes the new top
 // index, and the value stored in the previous frame becomes the new bottom.
 //
-// Holes are being locally cached for the segment. Otherwise we'd have to pass bottom index and
-// number of holes, which restricts us to 16 bits for the top index. The value is cached within the
-// table. To avoid code in generated JNI transitions, which implicitly form segments, the code for
-// adding and removing references needs to detect the change of a segment. Helper fields are used
-// for this detection.
+// Generated JNI transitions, which implicitly form segments, pop a segment by restoring the top
+// index without telling the table, so the free list may hold indexes of an outer segment, of a
+// popped segment or of slots that have been reused since. Entries are only taken when they are in
+// the current segment and still null, see the .cc file.
+//
+// The storage grows by whole chunks that are never moved: the first chunk holds the initial
+// capacity and every further chunk as many entries as all previous ones together, so an index
+// maps to its chunk with a single bit scan and growing the table never copies it.
 //
 // Common alternative implementation: make IndirectRef a pointer to the actual reference slot.
 // Instead of getting a table and doing a lookup, the lookup can be done instantly. Operations like
@@ -133,9 +138,6 @@ const char* GetIndirectRefKindString(const IndirectRefKind& kind);
 // detect stale references aren't possible (though we may be able to get similar benefits with other
 // approaches).
 //
-// TODO: consider a "lastDeleteIndex" for quick hole-filling when an add immediately follows a
-// delete; must invalidate after segment pop might be worth only using it for JNI globals.
-//
 // TODO: may want completely different add/remove algorithms for global and local refs to improve
 // performance.  A large circular buffer might reduce the amortized cost of adding global
 // references.
@@ -182,9 +184,12 @@ static_assert(sizeof(IrtEntry) == (1 + kIRTPrevCount) * sizeof(uint32_t),
               "Unexpected sizeof(IrtEntry)");
 static_assert(IsPowerOfTwo(sizeof(IrtEntry)), "Unexpected sizeof(IrtEntry)");
 
+class IndirectReferenceTable;
+
 class IrtIterator {
  public:
-  IrtIterator(IrtEntry* table, size_t i, size_t capacity) REQUIRES_SHARED(Locks::mutator_lock_)
+  IrtIterator(const IndirectReferenceTable* table, size_t i, size_t capacity)
+      REQUIRES_SHARED(Locks::mutator_lock_)
       : table_(table), i_(i), capacity_(capacity) {
   }
 
@@ -193,17 +198,15 @@ class IrtIterator {
     return *this;
   }
 
-  GcRoot<mirror::Object>* operator*() REQUIRES_SHARED(Locks::mutator_lock_) {
-    // This does not have a read barrier as this is used to visit roots.
-    return table_[i_].GetReference();
-  }
+  // This does not have a read barrier as this is used to visit roots.
+  inline GcRoot<mirror::Object>* operator*() REQUIRES_SHARED(Locks::mutator_lock_);
 
   bool equals(const IrtIterator& rhs) const {
     return (i_ == rhs.i_ && table_ == rhs.table_);
   }
 
  private:
-  IrtEntry* const table_;
+  const IndirectReferenceTable* const table_;
   size_t i_;
   const size_t capacity_;
 };
@@ -228,10 +231,16 @@ class IndirectReferenceTable {
   // construction has failed and the IndirectReferenceTable will be in an
   // invalid state. Use IsValid to check whether the object is in an invalid
   // state.
+  //
+  // A table can be one of 1 << stripe_bits stripes that together form one logical table. The
+  // stripe is encoded in the low bits of the index of the references it hands out, see
+  // ExtractStripe.
   IndirectReferenceTable(size_t max_count,
                          IndirectRefKind kind,
                          ResizableCapacity resizable,
-                         std::string* error_msg);
+                         std::string* error_msg,
+                         uint32_t stripe = 0u,
+                         size_t stripe_bits = 0u);
 
   ~IndirectReferenceTable();
 
@@ -266,6 +275,11 @@ class IndirectReferenceTable {
   // Updates an existing indirect reference to point to a new object.
   void Update(IndirectRef iref, ObjPtr<mirror::Object> obj) REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Make sure that at least free_capacity entries can be added to the current segment without
+  // growing the table. Returns false and sets error_msg if the table cannot grow that much.
+  bool EnsureFreeCapacity(size_t free_capacity, std::string* error_msg)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Remove an existing entry.
   //
   // If the entry is not between the current top index and the bottom index
@@ -287,11 +301,11 @@ class IndirectReferenceTable {
 
   // Note IrtIterator does not have a read barrier as it's used to visit roots.
   IrtIterator begin() {
-    return IrtIterator(table_, 0, Capacity());
+    return IrtIterator(this, 0, Capacity());
   }
 
   IrtIterator end() {
-    return IrtIterator(table_, Capacity(), Capacity());
+    return IrtIterator(this, Capacity(), Capacity());
   }
 
   void VisitRoots(RootVisitor* visitor, const RootInfo& root_info)
@@ -318,7 +332,27 @@ class IndirectReferenceTable {
     return DecodeIndirectRefKind(reinterpret_cast<uintptr_t>(iref));
   }
 
+  // Returns the stripe of the table that handed out the indirect reference.
+  ALWAYS_INLINE static uint32_t ExtractStripe(IndirectRef iref, size_t stripe_bits) {
+    return DecodeIndex(reinterpret_cast<uintptr_t>(iref)) & ((1u << stripe_bits) - 1u);
+  }
+
+  // Returns the entry with the given index, which must be below the allocated capacity.
+  ALWAYS_INLINE IrtEntry* GetEntry(uint32_t index) const {
+    DCHECK_LT(index, max_entries_);
+    if (LIKELY(index < first_chunk_size_)) {
+      return &chunks_[0][index];
+    }
+    // Only resizable tables have more chunks, and their first chunk size is a power of two. Chunk
+    // k > 0 holds the indexes [first_chunk_size_ << (k - 1), first_chunk_size_ << k).
+    const size_t msb = static_cast<size_t>(MostSignificantBit(index));
+    return &chunks_[msb - first_chunk_shift_ + 1][index - (1u << msb)];
+  }
+
  private:
+  // Enough chunks for any index an indirect reference can encode.
+  static constexpr size_t kMaxChunks = 32;
+
   static constexpr size_t kSerialBits = MinimumBitsToStore(kIRTPrevCount);
   static constexpr uint32_t kShiftedSerialMask = (1u << kSerialBits) - 1;
 
@@ -352,26 +386,33 @@ class IndirectReferenceTable {
 
   constexpr uintptr_t EncodeIndirectRef(uint32_t table_index, uint32_t serial) const {
     DCHECK_LT(table_index, max_entries_);
-    return EncodeIndex(table_index) | EncodeSerial(serial) | EncodeIndirectRefKind(kind_);
+    return EncodeIndex((table_index << stripe_bits_) | stripe_) |
+        EncodeSerial(serial) |
+        EncodeIndirectRefKind(kind_);
   }
 
   static void ConstexprChecks();
 
   // Extract the table index from an indirect reference.
-  ALWAYS_INLINE static uint32_t ExtractIndex(IndirectRef iref) {
-    return DecodeIndex(reinterpret_cast<uintptr_t>(iref));
+  ALWAYS_INLINE uint32_t ExtractIndex(IndirectRef iref) const {
+    return DecodeIndex(reinterpret_cast<uintptr_t>(iref)) >> stripe_bits_;
   }
 
   IndirectRef ToIndirectRef(uint32_t table_index) const {
     DCHECK_LT(table_index, max_entries_);
-    uint32_t serial = table_[table_index].GetSerial();
+    uint32_t serial = GetEntry(table_index)->GetSerial();
     return reinterpret_cast<IndirectRef>(EncodeIndirectRef(table_index, serial));
   }
 
-  // Resize the backing table. Currently must be larger than the current size.
-  bool Resize(size_t new_size, std::string* error_msg);
+  // Doubles the capacity with a new chunk. The existing entries stay where they are.
+  bool AddChunk(std::string* error_msg);
 
-  void RecoverHoles(IRTSegmentState from);
+  // Takes a hole of the current segment [bottom_index, top) from the free list. Returns false if
+  // there is none and the caller has to append.
+  bool TakeHole(uint32_t bottom_index, uint32_t* index) REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Drops the free list entries that are no longer holes, and sorts the others.
+  void PruneFreeList() REQUIRES_SHARED(Locks::mutator_lock_);
 
   // Abort if check_jni is not enabled. Otherwise, just log as an error.
   static void AbortIfNoCheckJNI(const std::string& msg);
@@ -383,28 +424,35 @@ class IndirectReferenceTable {
   /// semi-public - read/write by jni down calls.
   IRTSegmentState segment_state_;
 
-  // Mem map where we store the indirect refs.
-  std::unique_ptr<MemMap> table_mem_map_;
-  // bottom of the stack. Do not directly access the object references
-  // in this as they are roots. Use Get() that has a read barrier.
-  IrtEntry* table_;
+  // Mem maps where we store the indirect refs, one per chunk.
+  std::vector<std::unique_ptr<MemMap>> chunk_mem_maps_;
+  // The entries of each chunk. Do not directly access the object references
+  // in these as they are roots. Use Get() that has a read barrier.
+  IrtEntry* chunks_[kMaxChunks];
+  size_t first_chunk_size_;
+  size_t first_chunk_shift_;
   // bit mask, ORed into all irefs.
   const IndirectRefKind kind_;
+  // The stripe of this table, stored below the table index in all irefs.
+  const uint32_t stripe_;
+  const size_t stripe_bits_;
 
-  // max #of entries allowed (modulo resizing).
+  // max #of entries allowed (modulo resizing), the total size of the chunks.
   size_t max_entries_;
 
-  // Some values to retain old behavior with holes. Description of the algorithm is in the .cc
+  // Indexes of removed entries, most recent last. Description of the algorithm is in the .cc
   // file.
-  // TODO: Consider other data structures for compact tables, e.g., free lists.
-  size_t current_num_holes_;
-  IRTSegmentState last_known_previous_state_;
+  std::vector<uint32_t> free_list_;
 
   // Whether the table's capacity may be resized. As there are no locks used, it is the caller's
   // responsibility to ensure thread-safety.
   ResizableCapacity resizable_;
 };
 
+inline GcRoot<mirror::Object>* IrtIterator::operator*() {
+  return table_->GetEntry(i_)->GetReference();
+}
+
 }  // namespace art
 
 #endif  // ART_RUNTIME_INDIRECT_REFERENCE_TABLE_H_
@@ -267,9 +267,9 @@ TEST_F(IndirectReferenceTableTest, BasicTest) {
 TEST_F(IndirectReferenceTableTest, Holes) {
   // Test the explicitly named cases from the IRT implementation:
   //
-  // 1) Segment with holes (current_num_holes_ > 0), push new segment, add/remove reference
-  // 2) Segment with holes (current_num_holes_ > 0), pop segment, add/remove reference
-  // 3) Segment with holes (current_num_holes_ > 0), push new segment, pop segment, add/remove
+  // 1) Segment with holes, push new segment, add/remove reference
+  // 2) Segment with holes, pop segment, add/remove reference
+  // 3) Segment with holes, push new segment, pop segment, add/remove
   //    reference
   // 4) Empty segment, push new segment, create a hole, pop a segment, add/remove a reference
   // 5) Base segment, push new segment, create a hole, pop a segment, push new segment, add/remove
@@ -294,7 +294,7 @@ TEST_F(IndirectReferenceTableTest, Holes) {
 
   std::string error_msg;
 
-  // 1) Segment with holes (current_num_holes_ > 0), push new segment, add/remove reference.
+  // 1) Segment with holes, push new segment, add/remove reference.
   {
     IndirectReferenceTable irt(kTableMax,
                                kGlobal,
@@ -325,7 +325,7 @@ TEST_F(IndirectReferenceTableTest, Holes) {
     UNUSED(iref0, iref1, iref2, iref3);
   }
 
-  // 2) Segment with holes (current_num_holes_ > 0), pop segment, add/remove reference
+  // 2) Segment with holes, pop segment, add/remove reference
   {
     IndirectReferenceTable irt(kTableMax,
                                kGlobal,
@@ -360,7 +360,7 @@ TEST_F(IndirectReferenceTableTest, Holes) {
     UNUSED(iref0, iref1, iref2, iref3, iref4);
   }
 
-  // 3) Segment with holes (current_num_holes_ > 0), push new segment, pop segment, add/remove
+  // 3) Segment with holes, push new segment, pop segment, add/remove
   //    reference.
   {
     IndirectReferenceTable irt(kTableMax,
@@ -510,4 +510,114 @@ TEST_F(IndirectReferenceTableTest, Resize) {
   EXPECT_EQ(irt.Capacity(), kTableMax + 1);
 }
 
+TEST_F(IndirectReferenceTableTest, GrowAndReuseHoles) {
+  ScopedObjectAccess soa(Thread::Current());
+  static const size_t kTableInitial = 10;
+  static const size_t kNumRefs = 8 * kTableInitial + 3;
+
+  mirror::Class* c = class_linker_->FindSystemClass(soa.Self(), "Ljava/lang/Object;");
+  StackHandleScope<2> hs(soa.Self());
+  ASSERT_TRUE(c != nullptr);
+  Handle<mirror::Object> obj0 = hs.NewHandle(c->AllocObject(soa.Self()));
+  ASSERT_TRUE(obj0 != nullptr);
+  Handle<mirror::Object> obj1 = hs.NewHandle(c->AllocObject(soa.Self()));
+  ASSERT_TRUE(obj1 != nullptr);
+
+  std::string error_msg;
+  IndirectReferenceTable irt(kTableInitial,
+                             kLocal,
+                             IndirectReferenceTable::ResizableCapacity::kYes,
+                             &error_msg);
+  ASSERT_TRUE(irt.IsValid()) << error_msg;
+  const IRTSegmentState cookie = kIRTFirstSegment;
+
+  // Grow over several chunks, the references added before growing must stay valid.
+  std::vector<IndirectRef> refs;
+  for (size_t i = 0; i != kNumRefs; ++i) {
+    refs.push_back(irt.Add(cookie, (i % 2 == 0) ? obj0.Get() : obj1.Get()));
+  }
+  EXPECT_EQ(irt.Capacity(), kNumRefs);
+  for (size_t i = 0; i != kNumRefs; ++i) {
+    EXPECT_OBJ_PTR_EQ((i % 2 == 0) ? obj0.Get() : obj1.Get(), irt.Get(refs[i]));
+  }
+
+  // Punch holes into every chunk and fill them again without growing the table.
+  for (size_t i = 0; i < kNumRefs - 1; i += 2) {
+    EXPECT_TRUE(irt.Remove(cookie, refs[i]));
+  }
+  EXPECT_EQ(irt.Capacity(), kNumRefs);
+  for (size_t i = 0; i < kNumRefs - 1; i += 2) {
+    refs[i] = irt.Add(cookie, obj1.Get());
+  }
+  EXPECT_EQ(irt.Capacity(), kNumRefs);
+  for (size_t i = 0; i != kNumRefs - 1; ++i) {
+    EXPECT_OBJ_PTR_EQ(obj1.Get(), irt.Get(refs[i]));
+  }
+  CheckDump(&irt, kNumRefs, 2);
+
+  // Room for the requested references is made up front.
+  ASSERT_TRUE(irt.EnsureFreeCapacity(4 * kNumRefs, &error_msg)) << error_msg;
+  for (size_t i = 0; i != 4 * kNumRefs; ++i) {
+    irt.Add(cookie, obj0.Get());
+  }
+  EXPECT_EQ(irt.Capacity(), 5 * kNumRefs);
+}
+
+TEST_F(IndirectReferenceTableTest, Stripes) {
+  ScopedObjectAccess soa(Thread::Current());
+  static const size_t kTableMax = 8;
+  static const size_t kStripeBits = 2;
+
+  mirror::Class* c = class_linker_->FindSystemClass(soa.Self(), "Ljava/lang/Object;");
+  StackHandleScope<2> hs(soa.Self());
+  ASSERT_TRUE(c != nullptr);
+  Handle<mirror::Object> obj0 = hs.NewHandle(c->AllocObject(soa.Self()));
+  ASSERT_TRUE(obj0 != nullptr);
+  Handle<mirror::Object> obj1 = hs.NewHandle(c->AllocObject(soa.Self()));
+  ASSERT_TRUE(obj1 != nullptr);
+
+  std::string error_msg;
+  IndirectReferenceTable stripe0(kTableMax,
+                                 kGlobal,
+                                 IndirectReferenceTable::ResizableCapacity::kYes,
+                                 &error_msg,
+                                 0u,
+                                 kStripeBits);
+  ASSERT_TRUE(stripe0.IsValid()) << error_msg;
+  IndirectReferenceTable stripe3(kTableMax,
+                                 kGlobal,
+                                 IndirectReferenceTable::ResizableCapacity::kYes,
+                                 &error_msg,
+                                 3u,
+                                 kStripeBits);
+  ASSERT_TRUE(stripe3.IsValid()) << error_msg;
+  const IRTSegmentState cookie = kIRTFirstSegment;
+
+  // The same index in different stripes gives different references.
+  IndirectRef iref0 = stripe0.Add(cookie, obj0.Get());
+  IndirectRef iref3 = stripe3.Add(cookie, obj1.Get());
+  EXPECT_NE(iref0, iref3);
+  EXPECT_EQ(IndirectReferenceTable::ExtractStripe(iref0, kStripeBits), 0u);
+  EXPECT_EQ(IndirectReferenceTable::ExtractStripe(iref3, kStripeBits), 3u);
+  EXPECT_EQ(IndirectReferenceTable::GetIndirectRefKind(iref3), kGlobal);
+  EXPECT_OBJ_PTR_EQ(obj0.Get(), stripe0.Get(iref0));
+  EXPECT_OBJ_PTR_EQ(obj1.Get(), stripe3.Get(iref3));
+
+  // The stripe survives growing the table.
+  std::vector<IndirectRef> refs;
+  for (size_t i = 0; i != 2 * kTableMax; ++i) {
+    refs.push_back(stripe3.Add(cookie, obj0.Get()));
+  }
+  for (IndirectRef ref : refs) {
+    EXPECT_EQ(IndirectReferenceTable::ExtractStripe(ref, kStripeBits), 3u);
+    EXPECT_OBJ_PTR_EQ(obj0.Get(), stripe3.Get(ref));
+  }
+  for (IndirectRef ref : refs) {
+    EXPECT_TRUE(stripe3.Remove(cookie, ref));
+  }
+  EXPECT_TRUE(stripe3.Remove(cookie, iref3));
+  EXPECT_EQ(stripe3.Capacity(), 0u);
+  EXPECT_TRUE(stripe0.Remove(cookie, iref0));
+}
+
 }  // namespace art
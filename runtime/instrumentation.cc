@@ -16,6 +16,7 @@
 
 #include "instrumentation.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "arch/context.h"
@@ -81,6 +82,7 @@ Instrumentation::Instrumentation()
       have_branch_listeners_(false),
       have_invoke_virtual_or_interface_listeners_(false),
       deoptimized_methods_lock_("deoptimized methods lock", kDeoptimizedMethodsLock),
+      num_deoptimized_methods_(0),
       deoptimization_enabled_(false),
       interpreter_handler_table_(kMainHandlerTable),
       quick_alloc_entry_points_instrumentation_counter_(0),
@@ -409,80 +411,180 @@ static bool HasEvent(Instrumentation::InstrumentationEvent expected, uint32_t ev
   return (events & expected) != 0;
 }
 
+void InstrumentationListeners::Publish(std::vector<Entry>&& entries) {
+  Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
+  if (entries.empty()) {
+    current_.StoreRelease(nullptr);
+    return;
+  }
+  std::unique_ptr<Array> array(new Array());
+  array->ignored_access_flags = ~0u;
+  array->filtered_access_flags = 0u;
+  for (const Entry& entry : entries) {
+    array->ignored_access_flags &= entry.ignored_access_flags;
+    array->filtered_access_flags |= entry.ignored_access_flags;
+  }
+  array->entries = std::move(entries);
+  current_.StoreRelease(array.get());
+  arrays_.push_back(std::move(array));
+}
+
+void InstrumentationListeners::Add(InstrumentationListener* listener,
+                                   uint32_t ignored_access_flags) {
+  std::vector<Entry> entries;
+  const Array* array = Get();
+  if (array != nullptr) {
+    for (const Entry& entry : array->entries) {
+      if (entry.listener == listener) {
+        return;
+      }
+    }
+    entries = array->entries;
+  }
+  entries.push_back(Entry { listener, ignored_access_flags });
+  Publish(std::move(entries));
+}
+
+void InstrumentationListeners::Remove(InstrumentationListener* listener) {
+  const Array* array = Get();
+  if (array == nullptr) {
+    return;
+  }
+  std::vector<Entry> entries;
+  for (const Entry& entry : array->entries) {
+    if (entry.listener != listener) {
+      entries.push_back(entry);
+    }
+  }
+  if (entries.size() == array->entries.size()) {
+    return;
+  }
+  // Threads suspended in a listener may still be iterating an older array, make sure they do
+  // not call the removed listener, which may be deleted as soon as we return.
+  for (const std::unique_ptr<Array>& old_array : arrays_) {
+    for (Entry& entry : old_array->entries) {
+      if (entry.listener == listener) {
+        entry.listener = nullptr;
+      }
+    }
+  }
+  Publish(std::move(entries));
+}
+
+void InstrumentationListeners::FreeRetiredArrays() {
+  Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
+  const Array* current = Get();
+  arrays_.erase(std::remove_if(arrays_.begin(),
+                               arrays_.end(),
+                               [current](const std::unique_ptr<Array>& array) {
+                                 return array.get() != current;
+                               }),
+                arrays_.end());
+}
+
+void Instrumentation::FreeRetiredListenerArrays() {
+  Thread* self = Thread::Current();
+  Locks::mutator_lock_->AssertExclusiveHeld(self);
+  {
+    // All other threads are suspended, so the depths cannot change under us.
+    MutexLock mu(self, *Locks::thread_list_lock_);
+    for (Thread* thread : Runtime::Current()->GetThreadList()->GetList()) {
+      if (thread->GetInstrumentationDispatchDepth() != 0u) {
+        return;
+      }
+    }
+  }
+  method_entry_listeners_.FreeRetiredArrays();
+  method_exit_listeners_.FreeRetiredArrays();
+  method_unwind_listeners_.FreeRetiredArrays();
+  branch_listeners_.FreeRetiredArrays();
+  invoke_virtual_or_interface_listeners_.FreeRetiredArrays();
+  dex_pc_listeners_.FreeRetiredArrays();
+  field_read_listeners_.FreeRetiredArrays();
+  field_write_listeners_.FreeRetiredArrays();
+  exception_caught_listeners_.FreeRetiredArrays();
+}
+
 static void PotentiallyAddListenerTo(Instrumentation::InstrumentationEvent event,
                                      uint32_t events,
-                                     std::list<InstrumentationListener*>& list,
+                                     InstrumentationListeners& listeners,
                                      InstrumentationListener* listener,
+                                     uint32_t ignored_access_flags,
                                      bool* has_listener)
     REQUIRES(Locks::mutator_lock_, !Locks::thread_list_lock_, !Locks::classlinker_classes_lock_) {
   Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
   if (!HasEvent(event, events)) {
     return;
   }
-  // If there is a free slot in the list, we insert the listener in that slot.
-  // Otherwise we add it to the end of the list.
-  auto it = std::find(list.begin(), list.end(), nullptr);
-  if (it != list.end()) {
-    *it = listener;
-  } else {
-    list.push_back(listener);
-  }
+  listeners.Add(listener, ignored_access_flags);
   *has_listener = true;
 }
 
-void Instrumentation::AddListener(InstrumentationListener* listener, uint32_t events) {
+void Instrumentation::AddListener(InstrumentationListener* listener,
+                                  uint32_t events,
+                                  uint32_t ignored_access_flags) {
   Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
   PotentiallyAddListenerTo(kMethodEntered,
                            events,
                            method_entry_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_method_entry_listeners_);
   PotentiallyAddListenerTo(kMethodExited,
                            events,
                            method_exit_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_method_exit_listeners_);
   PotentiallyAddListenerTo(kMethodUnwind,
                            events,
                            method_unwind_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_method_unwind_listeners_);
   PotentiallyAddListenerTo(kBranch,
                            events,
                            branch_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_branch_listeners_);
   PotentiallyAddListenerTo(kInvokeVirtualOrInterface,
                            events,
                            invoke_virtual_or_interface_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_invoke_virtual_or_interface_listeners_);
   PotentiallyAddListenerTo(kDexPcMoved,
                            events,
                            dex_pc_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_dex_pc_listeners_);
   PotentiallyAddListenerTo(kFieldRead,
                            events,
                            field_read_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_field_read_listeners_);
   PotentiallyAddListenerTo(kFieldWritten,
                            events,
                            field_write_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_field_write_listeners_);
   PotentiallyAddListenerTo(kExceptionCaught,
                            events,
                            exception_caught_listeners_,
                            listener,
+                           ignored_access_flags,
                            &have_exception_caught_listeners_);
   UpdateInterpreterHandlerTable();
+  FreeRetiredListenerArrays();
 }
 
 static void PotentiallyRemoveListenerFrom(Instrumentation::InstrumentationEvent event,
                                           uint32_t events,
-                                          std::list<InstrumentationListener*>& list,
+                                          InstrumentationListeners& listeners,
                                           InstrumentationListener* listener,
                                           bool* has_listener)
     REQUIRES(Locks::mutator_lock_, !Locks::thread_list_lock_, !Locks::classlinker_classes_lock_) {
@@ -490,21 +592,8 @@ static void PotentiallyRemoveListenerFrom(Instrumentation::InstrumentationEvent
   if (!HasEvent(event, events)) {
     return;
   }
-  auto it = std::find(list.begin(), list.end(), listener);
-  if (it != list.end()) {
-    // Just update the entry, do not remove from the list. Removing entries in the list
-    // is unsafe when mutators are iterating over it.
-    *it = nullptr;
-  }
-
-  // Check if the list contains any non-null listener, and update 'has_listener'.
-  for (InstrumentationListener* l : list) {
-    if (l != nullptr) {
-      *has_listener = true;
-      return;
-    }
-  }
-  *has_listener = false;
+  listeners.Remove(listener);
+  *has_listener = !listeners.IsEmpty();
 }
 
 void Instrumentation::RemoveListener(InstrumentationListener* listener, uint32_t events) {
@@ -555,6 +644,7 @@ void Instrumentation::RemoveListener(InstrumentationListener* listener, uint32_t
                                 listener,
                                 &have_exception_caught_listeners_);
   UpdateInterpreterHandlerTable();
+  FreeRetiredListenerArrays();
 }
 
 Instrumentation::InstrumentationLevel Instrumentation::GetCurrentInstrumentationLevel() const {
@@ -743,6 +833,7 @@ bool Instrumentation::AddDeoptimizedMethod(ArtMethod* method) {
   }
   // Not found. Add it.
   deoptimized_methods_.insert(method);
+  num_deoptimized_methods_.StoreRelaxed(deoptimized_methods_.size());
   return true;
 }
 
@@ -764,6 +855,7 @@ bool Instrumentation::RemoveDeoptimizedMethod(ArtMethod* method) {
     return false;
   }
   deoptimized_methods_.erase(it);
+  num_deoptimized_methods_.StoreRelaxed(deoptimized_methods_.size());
   return true;
 }
 
@@ -834,6 +926,10 @@ void Instrumentation::Undeoptimize(ArtMethod* method) {
 
 bool Instrumentation::IsDeoptimized(ArtMethod* method) {
   DCHECK(method != nullptr);
+  // Methods are only deoptimized with the mutator lock exclusively held, which we exclude.
+  if (num_deoptimized_methods_.LoadRelaxed() == 0) {
+    return false;
+  }
   ReaderMutexLock mu(Thread::Current(), deoptimized_methods_lock_);
   return IsDeoptimizedMethod(method);
 }
@@ -916,61 +1012,119 @@ const void* Instrumentation::GetQuickCodeFor(ArtMethod* method, PointerSize poin
   return class_linker->GetQuickOatCodeFor(method);
 }
 
+// Marks the thread as using a listener array until the end of the scope, so that the array is
+// not freed if a listener suspends the thread. See Instrumentation::FreeRetiredListenerArrays().
+class ScopedListenerDispatch {
+ public:
+  explicit ScopedListenerDispatch(Thread* self) : self_(self) {
+    self_->IncrementInstrumentationDispatchDepth();
+  }
+
+  ~ScopedListenerDispatch() {
+    self_->DecrementInstrumentationDispatchDepth();
+  }
+
+ private:
+  Thread* const self_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedListenerDispatch);
+};
+
+// Calls fn on each listener interested in an event of the method, which may be null for events
+// not tied to a method. Methods filtered out by every listener return before looking at the
+// entries, and the access flags are only read if some listener filters on them.
+template <typename Fn>
+static ALWAYS_INLINE void DispatchEvent(Thread* thread,
+                                        const InstrumentationListeners& listeners,
+                                        ArtMethod* method,
+                                        const Fn& fn)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  DCHECK_EQ(thread, Thread::Current());
+  const InstrumentationListeners::Array* array = listeners.Get();
+  if (array == nullptr) {
+    return;
+  }
+  // Arrays are only freed with all threads suspended, and there is no suspend point between
+  // loading the array and marking the thread.
+  ScopedListenerDispatch sld(thread);
+  uint32_t access_flags = 0u;
+  if (UNLIKELY(array->filtered_access_flags != 0u) && method != nullptr) {
+    access_flags = method->GetAccessFlags();
+    if ((access_flags & array->ignored_access_flags) != 0) {
+      return;
+    }
+  }
+  if (LIKELY(array->entries.size() == 1u)) {
+    // The filter of the array is the filter of its only listener.
+    InstrumentationListener* listener = array->entries[0].listener;
+    if (listener != nullptr) {
+      fn(listener);
+    }
+    return;
+  }
+  for (const InstrumentationListeners::Entry& entry : array->entries) {
+    if (entry.listener != nullptr && (access_flags & entry.ignored_access_flags) == 0) {
+      fn(entry.listener);
+    }
+  }
+}
+
 void Instrumentation::MethodEnterEventImpl(Thread* thread, mirror::Object* this_object,
                                            ArtMethod* method,
                                            uint32_t dex_pc) const {
-  if (HasMethodEntryListeners()) {
-    for (InstrumentationListener* listener : method_entry_listeners_) {
-      if (listener != nullptr) {
-        listener->MethodEntered(thread, this_object, method, dex_pc);
-      }
-    }
-  }
+  DispatchEvent(thread,
+                method_entry_listeners_,
+                method,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->MethodEntered(thread, this_object, method, dex_pc);
+  });
 }
 
 void Instrumentation::MethodExitEventImpl(Thread* thread, mirror::Object* this_object,
                                           ArtMethod* method,
                                           uint32_t dex_pc, const JValue& return_value) const {
-  if (HasMethodExitListeners()) {
-    for (InstrumentationListener* listener : method_exit_listeners_) {
-      if (listener != nullptr) {
-        listener->MethodExited(thread, this_object, method, dex_pc, return_value);
-      }
-    }
-  }
+  DispatchEvent(thread,
+                method_exit_listeners_,
+                method,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->MethodExited(thread, this_object, method, dex_pc, return_value);
+  });
 }
 
 void Instrumentation::MethodUnwindEvent(Thread* thread, mirror::Object* this_object,
                                         ArtMethod* method,
                                         uint32_t dex_pc) const {
   if (HasMethodUnwindListeners()) {
-    for (InstrumentationListener* listener : method_unwind_listeners_) {
-      if (listener != nullptr) {
-        listener->MethodUnwind(thread, this_object, method, dex_pc);
-      }
-    }
+    DispatchEvent(thread,
+                  method_unwind_listeners_,
+                  method,
+                  [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+      listener->MethodUnwind(thread, this_object, method, dex_pc);
+    });
   }
 }
 
 void Instrumentation::DexPcMovedEventImpl(Thread* thread, mirror::Object* this_object,
                                           ArtMethod* method,
                                           uint32_t dex_pc) const {
-  for (InstrumentationListener* listener : dex_pc_listeners_) {
-    if (listener != nullptr) {
-      listener->DexPcMoved(thread, this_object, method, dex_pc);
-    }
-  }
+  DispatchEvent(thread,
+                dex_pc_listeners_,
+                method,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->DexPcMoved(thread, this_object, method, dex_pc);
+  });
 }
 
 void Instrumentation::BranchImpl(Thread* thread,
                                  ArtMethod* method,
                                  uint32_t dex_pc,
                                  int32_t offset) const {
-  for (InstrumentationListener* listener : branch_listeners_) {
-    if (listener != nullptr) {
-      listener->Branch(thread, method, dex_pc, offset);
-    }
-  }
+  DispatchEvent(thread,
+                branch_listeners_,
+                method,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->Branch(thread, method, dex_pc, offset);
+  });
 }
 
 void Instrumentation::InvokeVirtualOrInterfaceImpl(Thread* thread,
@@ -981,31 +1135,34 @@ void Instrumentation::InvokeVirtualOrInterfaceImpl(Thread* thread,
   // We cannot have thread suspension since that would cause the this_object parameter to
   // potentially become a dangling pointer. An alternative could be to put it in a handle instead.
   ScopedAssertNoThreadSuspension ants(__FUNCTION__);
-  for (InstrumentationListener* listener : invoke_virtual_or_interface_listeners_) {
-    if (listener != nullptr) {
-      listener->InvokeVirtualOrInterface(thread, this_object, caller, dex_pc, callee);
-    }
-  }
+  DispatchEvent(thread,
+                invoke_virtual_or_interface_listeners_,
+                caller,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->InvokeVirtualOrInterface(thread, this_object, caller, dex_pc, callee);
+  });
 }
 
 void Instrumentation::FieldReadEventImpl(Thread* thread, mirror::Object* this_object,
                                          ArtMethod* method, uint32_t dex_pc,
                                          ArtField* field) const {
-  for (InstrumentationListener* listener : field_read_listeners_) {
-    if (listener != nullptr) {
-      listener->FieldRead(thread, this_object, method, dex_pc, field);
-    }
-  }
+  DispatchEvent(thread,
+                field_read_listeners_,
+                method,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->FieldRead(thread, this_object, method, dex_pc, field);
+  });
 }
 
 void Instrumentation::FieldWriteEventImpl(Thread* thread, mirror::Object* this_object,
                                          ArtMethod* method, uint32_t dex_pc,
                                          ArtField* field, const JValue& field_value) const {
-  for (InstrumentationListener* listener : field_write_listeners_) {
-    if (listener != nullptr) {
-      listener->FieldWritten(thread, this_object, method, dex_pc, field, field_value);
-    }
-  }
+  DispatchEvent(thread,
+                field_write_listeners_,
+                method,
+                [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+    listener->FieldWritten(thread, this_object, method, dex_pc, field, field_value);
+  });
 }
 
 void Instrumentation::ExceptionCaughtEvent(Thread* thread,
@@ -1016,11 +1173,12 @@ void Instrumentation::ExceptionCaughtEvent(Thread* thread,
   if (HasExceptionCaughtListeners()) {
     DCHECK_EQ(thread->GetException(), h_exception.Get());
     thread->ClearException();
-    for (InstrumentationListener* listener : exception_caught_listeners_) {
-      if (listener != nullptr) {
-        listener->ExceptionCaught(thread, h_exception.Get());
-      }
-    }
+    DispatchEvent(thread,
+                  exception_caught_listeners_,
+                  /* method */ nullptr,
+                  [&](InstrumentationListener* listener) REQUIRES_SHARED(Locks::mutator_lock_) {
+      listener->ExceptionCaught(thread, h_exception.Get());
+    });
     thread->SetException(h_exception.Get());
   }
 }
@@ -19,9 +19,12 @@
 
 #include <stdint.h>
 #include <list>
+#include <memory>
 #include <unordered_set>
+#include <vector>
 
 #include "arch/instruction_set.h"
+#include "atomic.h"
 #include "base/enums.h"
 #include "base/macros.h"
 #include "base/mutex.h"
@@ -112,6 +115,61 @@ struct InstrumentationListener {
       REQUIRES_SHARED(Locks::mutator_lock_) = 0;
 };
 
+// The listeners of one instrumentation event. Events are dispatched from an array of listeners
+// which is replaced rather than grown or shrunk when a listener is added or removed, so that the
+// common case of a single listener is a load, a flag test and one call.
+//
+// The arrays are only replaced with the mutator_lock_ exclusively held. A dispatching thread can
+// however be suspended by a listener and resume iterating an array that has since been replaced,
+// so old arrays are kept alive and a removed listener is cleared in every array it appears in.
+// Retired arrays are freed once no thread is dispatching an event, see
+// Instrumentation::FreeRetiredListenerArrays().
+class InstrumentationListeners {
+ public:
+  struct Entry {
+    InstrumentationListener* listener;
+    // The listener is not told about events of methods with any of these access flags.
+    uint32_t ignored_access_flags;
+  };
+
+  struct Array {
+    std::vector<Entry> entries;
+    // The flags every listener of the array ignores, checked before looking at the entries.
+    uint32_t ignored_access_flags;
+    // The flags any listener of the array ignores, zero if no listener filters events.
+    uint32_t filtered_access_flags;
+  };
+
+  InstrumentationListeners() : current_(nullptr) {}
+
+  // Returns the array to dispatch from, null if there are no listeners.
+  const Array* Get() const {
+    return current_.LoadAcquire();
+  }
+
+  bool IsEmpty() const {
+    return Get() == nullptr;
+  }
+
+  void Add(InstrumentationListener* listener, uint32_t ignored_access_flags)
+      REQUIRES(Locks::mutator_lock_);
+  void Remove(InstrumentationListener* listener) REQUIRES(Locks::mutator_lock_);
+
+  // Frees the arrays that were replaced. No thread may be dispatching from them.
+  void FreeRetiredArrays() REQUIRES(Locks::mutator_lock_);
+
+ private:
+  void Publish(std::vector<Entry>&& entries) REQUIRES(Locks::mutator_lock_);
+
+  Atomic<Array*> current_;
+  // The current array and the retired ones that were not freed yet.
+  std::vector<std::unique_ptr<Array>> arrays_ GUARDED_BY(Locks::mutator_lock_);
+
+  friend class InstrumentationTest;  // For arrays_.
+
+  DISALLOW_COPY_AND_ASSIGN(InstrumentationListeners);
+};
+
 // Instrumentation is a catch-all for when extra information is required from the runtime. The
 // typical use for instrumentation is for profiling and debugging. Instrumentation may add stubs
 // to method entry and exit, it may also force execution to be switched to the interpreter and
@@ -141,8 +199,13 @@ class Instrumentation {
   // Add a listener to be notified of the masked together sent of instrumentation events. This
   // suspend the runtime to install stubs. You are expected to hold the mutator lock as a proxy
   // for saying you should have suspended all threads (installing stubs while threads are running
-  // will break).
-  void AddListener(InstrumentationListener* listener, uint32_t events)
+  // will break). Events of methods with any of the ignored access flags are not reported to the
+  // listener, and are not dispatched at all if no other listener wants them. The filter does not
+  // change which methods get instrumentation stubs: the stubs of ignored methods still call into
+  // the runtime, and only the listener calls are skipped.
+  void AddListener(InstrumentationListener* listener,
+                   uint32_t events,
+                   uint32_t ignored_access_flags = 0u)
       REQUIRES(Locks::mutator_lock_, !Locks::thread_list_lock_, !Locks::classlinker_classes_lock_);
 
   // Removes a listener possibly removing instrumentation stubs.
@@ -461,6 +524,12 @@ class Instrumentation {
     interpreter_handler_table_ = IsActive() ? kAlternativeHandlerTable : kMainHandlerTable;
   }
 
+  // Frees the listener arrays replaced by AddListener() and RemoveListener() if no thread is
+  // dispatching an event. Threads suspended by a listener keep the old arrays alive until a later
+  // call finds them all out of their listeners.
+  void FreeRetiredListenerArrays()
+      REQUIRES(Locks::mutator_lock_, !Locks::thread_list_lock_);
+
   // No thread safety analysis to get around SetQuickAllocEntryPointsInstrumented requiring
   // exclusive access to mutator lock which you can't get if the runtime isn't started.
   void SetEntrypointsInstrumented(bool instrumented) NO_THREAD_SAFETY_ANALYSIS;
@@ -561,30 +630,23 @@ class Instrumentation {
   InstrumentationLevelTable requested_instrumentation_levels_ GUARDED_BY(Locks::mutator_lock_);
 
   // The event listeners, written to with the mutator_lock_ exclusively held.
-  // Mutators must be able to iterate over these lists concurrently, that is, with listeners being
-  // added or removed while iterating. The modifying thread holds exclusive lock,
-  // so other threads cannot iterate (i.e. read the data of the list) at the same time but they
-  // do keep iterators that need to remain valid. This is the reason these listeners are std::list
-  // and not for example std::vector: the existing storage for a std::list does not move.
-  // Note that mutators cannot make a copy of these lists before iterating, as the instrumentation
-  // listeners can also be deleted concurrently.
-  // As a result, these lists are never trimmed. That's acceptable given the low number of
-  // listeners we have.
-  std::list<InstrumentationListener*> method_entry_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> method_exit_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> method_unwind_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> branch_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> invoke_virtual_or_interface_listeners_
-      GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> dex_pc_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> field_read_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> field_write_listeners_ GUARDED_BY(Locks::mutator_lock_);
-  std::list<InstrumentationListener*> exception_caught_listeners_ GUARDED_BY(Locks::mutator_lock_);
+  InstrumentationListeners method_entry_listeners_;
+  InstrumentationListeners method_exit_listeners_;
+  InstrumentationListeners method_unwind_listeners_;
+  InstrumentationListeners branch_listeners_;
+  InstrumentationListeners invoke_virtual_or_interface_listeners_;
+  InstrumentationListeners dex_pc_listeners_;
+  InstrumentationListeners field_read_listeners_;
+  InstrumentationListeners field_write_listeners_;
+  InstrumentationListeners exception_caught_listeners_;
 
   // The set of methods being deoptimized (by the debugger) which must be executed with interpreter
   // only.
   mutable ReaderWriterMutex deoptimized_methods_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   std::unordered_set<ArtMethod*> deoptimized_methods_ GUARDED_BY(deoptimized_methods_lock_);
+  // The size of deoptimized_methods_, so that IsDeoptimized() does not need the lock when no
+  // method is deoptimized, the common case of the instrumentation stubs.
+  AtomicInteger num_deoptimized_methods_;
   bool deoptimization_enabled_;
 
   // Current interpreter handler table. This is updated each time the thread state flags are
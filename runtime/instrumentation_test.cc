@@ -165,6 +165,10 @@ class InstrumentationTest : public CommonRuntimeTest {
     return Runtime::Current()->GetInstrumentation()->GetCurrentInstrumentationLevel();
   }
 
+  size_t GetNumMethodEntryListenerArrays() REQUIRES_SHARED(Locks::mutator_lock_) {
+    return Runtime::Current()->GetInstrumentation()->method_entry_listeners_.arrays_.size();
+  }
+
   size_t GetInstrumentationUserCount() {
     ScopedObjectAccess soa(Thread::Current());
     return Runtime::Current()->GetInstrumentation()->requested_instrumentation_levels_.size();
@@ -451,6 +455,106 @@ TEST_F(InstrumentationTest, InvokeVirtualOrInterfaceEvent) {
   TestEvent(instrumentation::Instrumentation::kInvokeVirtualOrInterface);
 }
 
+// Events of methods with an access flag the listener ignores are not reported to it.
+TEST_F(InstrumentationTest, IgnoredAccessFlags) {
+  ScopedObjectAccess soa(Thread::Current());
+  instrumentation::Instrumentation* instr = Runtime::Current()->GetInstrumentation();
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  mirror::Class* klass = class_linker->FindSystemClass(soa.Self(), "Ljava/lang/Thread;");
+  ASSERT_TRUE(klass != nullptr);
+  ArtMethod* native_method = klass->FindDeclaredDirectMethod("currentThread",
+                                                             "()Ljava/lang/Thread;",
+                                                             kRuntimePointerSize);
+  ASSERT_TRUE(native_method != nullptr);
+  ASSERT_TRUE(native_method->IsNative());
+  ArtMethod* java_method = klass->FindDeclaredDirectMethod("<init>", "()V", kRuntimePointerSize);
+  ASSERT_TRUE(java_method != nullptr);
+  ASSERT_FALSE(java_method->IsNative());
+
+  TestInstrumentationListener native_listener;
+  TestInstrumentationListener listener;
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Add instrumentation listeners");
+    instr->AddListener(&native_listener, instrumentation::Instrumentation::kMethodEntered,
+                       /* ignored_access_flags */ kAccNative);
+  }
+  EXPECT_TRUE(instr->HasMethodEntryListeners());
+  instr->MethodEnterEvent(soa.Self(), nullptr, native_method, 0);
+  EXPECT_FALSE(native_listener.received_method_enter_event);
+  instr->MethodEnterEvent(soa.Self(), nullptr, java_method, 0);
+  EXPECT_TRUE(native_listener.received_method_enter_event);
+
+  // A listener without filter still gets the events the other one ignores.
+  native_listener.Reset();
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Add instrumentation listeners");
+    instr->AddListener(&listener, instrumentation::Instrumentation::kMethodEntered);
+  }
+  instr->MethodEnterEvent(soa.Self(), nullptr, native_method, 0);
+  EXPECT_FALSE(native_listener.received_method_enter_event);
+  EXPECT_TRUE(listener.received_method_enter_event);
+
+  listener.Reset();
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Remove instrumentation listeners");
+    instr->RemoveListener(&native_listener, instrumentation::Instrumentation::kMethodEntered);
+  }
+  EXPECT_TRUE(instr->HasMethodEntryListeners());
+  instr->MethodEnterEvent(soa.Self(), nullptr, java_method, 0);
+  EXPECT_FALSE(native_listener.received_method_enter_event);
+  EXPECT_TRUE(listener.received_method_enter_event);
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Remove instrumentation listeners");
+    instr->RemoveListener(&listener, instrumentation::Instrumentation::kMethodEntered);
+  }
+  EXPECT_FALSE(instr->HasMethodEntryListeners());
+}
+
+// Replaced listener arrays are kept while a thread may be dispatching from them, and freed by the
+// next change of the listeners once no thread is.
+TEST_F(InstrumentationTest, FreeRetiredListenerArrays) {
+  ScopedObjectAccess soa(Thread::Current());
+  instrumentation::Instrumentation* instr = Runtime::Current()->GetInstrumentation();
+  TestInstrumentationListener listener1;
+  TestInstrumentationListener listener2;
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Add instrumentation listeners");
+    instr->AddListener(&listener1, instrumentation::Instrumentation::kMethodEntered);
+  }
+  EXPECT_EQ(1u, GetNumMethodEntryListenerArrays());
+
+  // Pretend the thread was suspended by a listener while dispatching an event.
+  soa.Self()->IncrementInstrumentationDispatchDepth();
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Add instrumentation listeners");
+    instr->AddListener(&listener2, instrumentation::Instrumentation::kMethodEntered);
+  }
+  EXPECT_EQ(2u, GetNumMethodEntryListenerArrays());
+  soa.Self()->DecrementInstrumentationDispatchDepth();
+
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Remove instrumentation listeners");
+    instr->RemoveListener(&listener2, instrumentation::Instrumentation::kMethodEntered);
+  }
+  EXPECT_EQ(1u, GetNumMethodEntryListenerArrays());
+  instr->MethodEnterEvent(soa.Self(), nullptr, nullptr, 0);
+  EXPECT_TRUE(listener1.received_method_enter_event);
+  EXPECT_FALSE(listener2.received_method_enter_event);
+  {
+    ScopedThreadSuspension sts(soa.Self(), kSuspended);
+    ScopedSuspendAll ssa("Remove instrumentation listeners");
+    instr->RemoveListener(&listener1, instrumentation::Instrumentation::kMethodEntered);
+  }
+  EXPECT_EQ(0u, GetNumMethodEntryListenerArrays());
+}
+
 TEST_F(InstrumentationTest, DeoptimizeDirectMethod) {
   ScopedObjectAccess soa(Thread::Current());
   jobject class_loader = LoadDex("Instrumentation");
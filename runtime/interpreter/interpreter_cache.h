@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_INTERPRETER_INTERPRETER_CACHE_H_
+#define ART_RUNTIME_INTERPRETER_INTERPRETER_CACHE_H_
+
+#include <array>
+#include <stdint.h>
+
+#include "base/bit_utils.h"
+#include "base/macros.h"
+
+namespace art {
+
+class Thread;
+
+// Small per-thread direct-mapped cache of resolved fields and methods for the interpreter. It is
+// keyed by the address of the dex instruction, which is unique for as long as the dex file is
+// loaded, so a hit skips the dex cache and the class linker entirely. The meaning of the value
+// depends on the instruction: the ArtField* of field instructions and the resolved ArtMethod* of
+// invokes.
+//
+// Only the owning thread reads and writes its cache, so no synchronization is needed. Anything
+// that can free or replace the cached fields and methods, class unloading and class redefinition,
+// must clear the caches of all threads with Thread::ClearAllInterpreterCaches() which runs a
+// checkpoint. A suspended thread has its cache cleared by the thread running the checkpoint.
+//
+// The mterp assembly probes the cache directly, see THREAD_INTERPRETER_CACHE_OFFSET and
+// INTERPRETER_CACHE_SIZE_LOG2 in asm_support.h.
+class InterpreterCache {
+ public:
+  // The number of entries, a power of two. Small enough to stay in L1 with the rest of the
+  // interpreter state.
+  static constexpr size_t kSize = 256;
+
+  struct Entry {
+    const void* key;
+    size_t value;
+  };
+
+  InterpreterCache() {
+    Clear();
+  }
+
+  // Returns true and sets *value if the key is in the cache.
+  ALWAYS_INLINE bool Get(const void* key, /* out */ size_t* value) const {
+    const Entry& entry = data_[IndexOf(key)];
+    if (LIKELY(entry.key == key)) {
+      *value = entry.value;
+      return true;
+    }
+    return false;
+  }
+
+  // Replaces whatever entry the key maps to.
+  ALWAYS_INLINE void Set(const void* key, size_t value) {
+    data_[IndexOf(key)] = Entry{key, value};
+  }
+
+  void Clear() {
+    data_.fill(Entry{nullptr, 0u});
+  }
+
+  // Dex instructions are 2-byte aligned and the shortest field and invoke instructions are four
+  // bytes long, so the low two bits carry little information.
+  static size_t IndexOf(const void* key) {
+    static_assert(IsPowerOfTwo(kSize), "Size must be a power of two");
+    return (reinterpret_cast<uintptr_t>(key) >> 2) & (kSize - 1);
+  }
+
+ private:
+  std::array<Entry, kSize> data_;
+
+  DISALLOW_COPY_AND_ASSIGN(InterpreterCache);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_INTERPRETER_INTERPRETER_CACHE_H_
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "interpreter_cache.h"
+
+#include "common_runtime_test.h"
+#include "scoped_thread_state_change-inl.h"
+#include "thread-inl.h"
+#include "thread_list.h"
+
+namespace art {
+
+class InterpreterCacheTest : public CommonRuntimeTest {};
+
+TEST_F(InterpreterCacheTest, GetSet) {
+  std::unique_ptr<InterpreterCache> cache(new InterpreterCache());
+  uint16_t insns[2 * InterpreterCache::kSize];
+  size_t value = 0u;
+  EXPECT_FALSE(cache->Get(&insns[0], &value));
+  cache->Set(&insns[0], 42u);
+  EXPECT_TRUE(cache->Get(&insns[0], &value));
+  EXPECT_EQ(value, 42u);
+  // Field and invoke instructions are at least four bytes apart, which maps them to different
+  // entries unless they are a multiple of kSize * 4 bytes apart.
+  cache->Set(&insns[2], 43u);
+  EXPECT_TRUE(cache->Get(&insns[0], &value));
+  EXPECT_EQ(value, 42u);
+  EXPECT_EQ(InterpreterCache::IndexOf(&insns[0]),
+            InterpreterCache::IndexOf(&insns[2 * InterpreterCache::kSize]));
+  cache->Set(&insns[2 * InterpreterCache::kSize], 44u);
+  EXPECT_FALSE(cache->Get(&insns[0], &value));
+  cache->Clear();
+  EXPECT_FALSE(cache->Get(&insns[2], &value));
+}
+
+TEST_F(InterpreterCacheTest, ClearAll) {
+  Thread* self = Thread::Current();
+  uint16_t insn = 0u;
+  size_t value = 0u;
+  self->GetInterpreterCache()->Set(&insn, 1u);
+  {
+    // Runs the checkpoint on this thread right away.
+    ScopedObjectAccess soa(self);
+    Thread::ClearAllInterpreterCaches();
+  }
+  EXPECT_FALSE(self->GetInterpreterCache()->Get(&insn, &value));
+  self->GetInterpreterCache()->Set(&insn, 1u);
+  {
+    ScopedSuspendAll ssa(__FUNCTION__);
+    Thread::ClearAllInterpreterCaches();
+  }
+  EXPECT_FALSE(self->GetInterpreterCache()->Get(&insn, &value));
+}
+
+}  // namespace art
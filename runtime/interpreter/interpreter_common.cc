@@ -46,9 +46,8 @@ bool DoFieldGet(Thread* self, ShadowFrame& shadow_frame, const Instruction* inst
                 uint16_t inst_data) {
   const bool is_static = (find_type == StaticObjectRead) || (find_type == StaticPrimitiveRead);
   const uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
-  ArtField* f =
-      FindFieldFromCode<find_type, do_access_check>(field_idx, shadow_frame.GetMethod(), self,
-                                                    Primitive::ComponentSize(field_type));
+  ArtField* f = FindFieldFromCodeCached<find_type, do_access_check>(
+      field_idx, shadow_frame, inst, self, Primitive::ComponentSize(field_type));
   if (UNLIKELY(f == nullptr)) {
     CHECK(self->IsExceptionPending());
     return false;
@@ -242,9 +241,8 @@ bool DoFieldPut(Thread* self, const ShadowFrame& shadow_frame, const Instruction
   const bool do_assignability_check = do_access_check;
   bool is_static = (find_type == StaticObjectWrite) || (find_type == StaticPrimitiveWrite);
   uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
-  ArtField* f =
-      FindFieldFromCode<find_type, do_access_check>(field_idx, shadow_frame.GetMethod(), self,
-                                                    Primitive::ComponentSize(field_type));
+  ArtField* f = FindFieldFromCodeCached<find_type, do_access_check>(
+      field_idx, shadow_frame, inst, self, Primitive::ComponentSize(field_type));
   if (UNLIKELY(f == nullptr)) {
     CHECK(self->IsExceptionPending());
     return false;
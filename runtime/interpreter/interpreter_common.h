@@ -40,6 +40,7 @@
 #include "dex_instruction-inl.h"
 #include "entrypoints/entrypoint_utils-inl.h"
 #include "handle_scope-inl.h"
+#include "interpreter_cache.h"
 #include "jit/jit.h"
 #include "mirror/call_site.h"
 #include "mirror/class-inl.h"
@@ -105,6 +106,81 @@ void AbortTransactionV(Thread* self, const char* fmt, va_list args)
 void RecordArrayElementsInTransaction(ObjPtr<mirror::Array> array, int32_t count)
     REQUIRES_SHARED(Locks::mutator_lock_);
 
+// Returns the field accessed by the field instruction, from the interpreter cache of the thread
+// if it was resolved before. Only fields which need no further checks are cached: non-volatile
+// ones, so that mterp can access them with plain loads, and static ones once their class is
+// initialized. Returns null with a pending exception if the field cannot be resolved.
+template<FindFieldType find_type, bool do_access_check>
+ALWAYS_INLINE static inline ArtField* FindFieldFromCodeCached(uint32_t field_idx,
+                                                              const ShadowFrame& shadow_frame,
+                                                              const Instruction* inst,
+                                                              Thread* self,
+                                                              size_t expected_size)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  constexpr bool is_static = (find_type == StaticObjectRead) ||
+                             (find_type == StaticPrimitiveRead) ||
+                             (find_type == StaticObjectWrite) ||
+                             (find_type == StaticPrimitiveWrite);
+  InterpreterCache* cache = self->GetInterpreterCache();
+  size_t cached;
+  if (!do_access_check && cache->Get(inst, &cached)) {
+    return reinterpret_cast<ArtField*>(cached);
+  }
+  ArtField* field = FindFieldFromCode<find_type, do_access_check>(
+      field_idx, shadow_frame.GetMethod(), self, expected_size);
+  if (!do_access_check &&
+      field != nullptr &&
+      !field->IsVolatile() &&
+      (!is_static ||
+       (field->GetDeclaringClass()->IsInitialized() &&
+        // A transaction can undo the initialization.
+        !Runtime::Current()->IsActiveTransaction()))) {
+    cache->Set(inst, reinterpret_cast<size_t>(field));
+  }
+  return field;
+}
+
+// Returns the method called by the invoke instruction. The resolved method of static, direct and
+// virtual invokes is kept in the interpreter cache of the thread, so that a hit only does the null
+// check and the virtual dispatch. Returns null with a pending exception on failure.
+template<InvokeType type, bool do_access_check>
+ALWAYS_INLINE static inline ArtMethod* FindMethodFromCodeCached(uint32_t method_idx,
+                                                                ObjPtr<mirror::Object>* this_object,
+                                                                ArtMethod* referrer,
+                                                                const Instruction* inst,
+                                                                Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  constexpr bool kCacheable =
+      !do_access_check && (type == kStatic || type == kDirect || type == kVirtual);
+  if (!kCacheable) {
+    return FindMethodFromCode<type, do_access_check>(method_idx, this_object, referrer, self);
+  }
+  InterpreterCache* cache = self->GetInterpreterCache();
+  size_t cached;
+  // A null receiver takes the slow path which throws the right exception.
+  if (cache->Get(inst, &cached) && (type == kStatic || *this_object != nullptr)) {
+    ArtMethod* resolved_method = reinterpret_cast<ArtMethod*>(cached);
+    if (type == kVirtual) {
+      return (*this_object)->GetClass()->GetVTableEntry(resolved_method->GetMethodIndex(),
+                                                        kRuntimePointerSize);
+    }
+    return resolved_method;
+  }
+  ArtMethod* called_method =
+      FindMethodFromCode<type, do_access_check>(method_idx, this_object, referrer, self);
+  if (called_method != nullptr) {
+    // Virtual invokes cache the resolved method rather than the target of the dispatch. It is
+    // still in the dex cache unless another thread evicted it in the meantime.
+    ArtMethod* resolved_method = (type == kVirtual)
+        ? Runtime::Current()->GetClassLinker()->GetResolvedMethod(method_idx, referrer)
+        : called_method;
+    if (resolved_method != nullptr) {
+      cache->Set(inst, reinterpret_cast<size_t>(resolved_method));
+    }
+  }
+  return called_method;
+}
+
 // Invokes the given method. This is part of the invocation support and is used by DoInvoke,
 // DoFastInvoke and DoInvokeVirtualQuick functions.
 // Returns true on success, otherwise throws an exception and returns false.
@@ -112,24 +188,24 @@ template<bool is_range, bool do_assignability_check>
 bool DoCall(ArtMethod* called_method, Thread* self, ShadowFrame& shadow_frame,
             const Instruction* inst, uint16_t inst_data, JValue* result);
 
-// Handles streamlined non-range invoke static, direct and virtual instructions originating in
-// mterp. Access checks and instrumentation other than jit profiling are not supported, but does
-// support interpreter intrinsics if applicable.
+// Handles streamlined invoke static, direct and virtual instructions originating in mterp.
+// Access checks and instrumentation other than jit profiling are not supported, but does support
+// interpreter intrinsics if applicable.
 // Returns true on success, otherwise throws an exception and returns false.
-template<InvokeType type>
+template<InvokeType type, bool is_range = false>
 static inline bool DoFastInvoke(Thread* self,
                                 ShadowFrame& shadow_frame,
                                 const Instruction* inst,
                                 uint16_t inst_data,
                                 JValue* result) {
-  const uint32_t method_idx = inst->VRegB_35c();
-  const uint32_t vregC = inst->VRegC_35c();
+  const uint32_t method_idx = (is_range) ? inst->VRegB_3rc() : inst->VRegB_35c();
+  const uint32_t vregC = (is_range) ? inst->VRegC_3rc() : inst->VRegC_35c();
   ObjPtr<mirror::Object> receiver = (type == kStatic)
       ? nullptr
       : shadow_frame.GetVRegReference(vregC);
   ArtMethod* sf_method = shadow_frame.GetMethod();
-  ArtMethod* const called_method = FindMethodFromCode<type, false>(
-      method_idx, &receiver, sf_method, self);
+  ArtMethod* const called_method = FindMethodFromCodeCached<type, false>(
+      method_idx, &receiver, sf_method, inst, self);
   // The shadow frame should already be pushed, so we don't need to update it.
   if (UNLIKELY(called_method == nullptr)) {
     CHECK(self->IsExceptionPending());
@@ -153,7 +229,7 @@ static inline bool DoFastInvoke(Thread* self,
         return !self->IsExceptionPending();
       }
     }
-    return DoCall<false, false>(called_method, self, shadow_frame, inst, inst_data, result);
+    return DoCall<is_range, false>(called_method, self, shadow_frame, inst, inst_data, result);
   }
 }
 
@@ -169,8 +245,8 @@ static inline bool DoInvoke(Thread* self,
   const uint32_t vregC = (is_range) ? inst->VRegC_3rc() : inst->VRegC_35c();
   ObjPtr<mirror::Object> receiver = (type == kStatic) ? nullptr : shadow_frame.GetVRegReference(vregC);
   ArtMethod* sf_method = shadow_frame.GetMethod();
-  ArtMethod* const called_method = FindMethodFromCode<type, do_access_check>(
-      method_idx, &receiver, sf_method, self);
+  ArtMethod* const called_method = FindMethodFromCodeCached<type, do_access_check>(
+      method_idx, &receiver, sf_method, inst, self);
   // The shadow frame should already be pushed, so we don't need to update it.
   if (UNLIKELY(called_method == nullptr)) {
     CHECK(self->IsExceptionPending());
@@ -562,16 +638,19 @@ EXPLICIT_DO_INVOKE_ALL_TEMPLATE_DECL(kInterface)   // invoke-interface/range.
 #undef EXPLICIT_DO_INVOKE_TEMPLATE_DECL
 
 // Explicitly instantiate all DoFastInvoke functions.
-#define EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(_type)                     \
-  template REQUIRES_SHARED(Locks::mutator_lock_)                         \
-  bool DoFastInvoke<_type>(Thread* self,                                 \
-                           ShadowFrame& shadow_frame,                    \
-                           const Instruction* inst, uint16_t inst_data,  \
-                           JValue* result)
-
-EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kStatic);     // invoke-static
-EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kDirect);     // invoke-direct
-EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kVirtual);    // invoke-virtual
+#define EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(_type, _is_range)                     \
+  template REQUIRES_SHARED(Locks::mutator_lock_)                                    \
+  bool DoFastInvoke<_type, _is_range>(Thread* self,                                 \
+                                      ShadowFrame& shadow_frame,                    \
+                                      const Instruction* inst, uint16_t inst_data,  \
+                                      JValue* result)
+
+EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kStatic, false);     // invoke-static
+EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kStatic, true);      // invoke-static/range
+EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kDirect, false);     // invoke-direct
+EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kDirect, true);      // invoke-direct/range
+EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kVirtual, false);    // invoke-virtual
+EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL(kVirtual, true);     // invoke-virtual/range
 #undef EXPLICIT_DO_FAST_INVOKE_TEMPLATE_DECL
 
 // Explicitly instantiate all DoInvokeVirtualQuick functions.
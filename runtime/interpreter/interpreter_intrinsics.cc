@@ -16,13 +16,35 @@
 
 #include "interpreter/interpreter_intrinsics.h"
 
+#include "atomic.h"
+#include "base/casts.h"
 #include "compiler/intrinsics_enum.h"
 #include "dex_instruction.h"
 #include "interpreter/interpreter_common.h"
+#include "read_barrier-inl.h"
 
 namespace art {
 namespace interpreter {
 
+// Enough for the longest intrinsic signature, Unsafe.compareAndSwapLong(Object, long, long, long)
+// with its receiver, which can only be called with a range invoke.
+static constexpr size_t kMaxIntrinsicArgRegs = 8;
+
+// Gets the argument registers of a non-range or a range invoke.
+static ALWAYS_INLINE void GetIntrinsicArgs(const Instruction* inst,
+                                           uint16_t inst_data,
+                                           uint32_t (&arg)[kMaxIntrinsicArgRegs]) {
+  static_assert(kMaxIntrinsicArgRegs >= Instruction::kMaxVarArgRegs, "Too few argument registers");
+  if (Instruction::FormatOf(inst->Opcode(inst_data)) == Instruction::k3rc) {
+    const uint32_t first = inst->VRegC_3rc();
+    const uint32_t count = std::min<uint32_t>(inst->VRegA_3rc(inst_data), kMaxIntrinsicArgRegs);
+    for (uint32_t i = 0; i < count; ++i) {
+      arg[i] = first + i;
+    }
+  } else {
+    inst->GetVarArgs(arg, inst_data);
+  }
+}
 
 #define BINARY_INTRINSIC(name, op, get1, get2, set)                 \
 static ALWAYS_INLINE bool name(ShadowFrame* shadow_frame,           \
@@ -30,8 +52,8 @@ static ALWAYS_INLINE bool name(ShadowFrame* shadow_frame,           \
                                uint16_t inst_data,                  \
                                JValue* result_register)             \
     REQUIRES_SHARED(Locks::mutator_lock_) {                         \
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};                   \
-  inst->GetVarArgs(arg, inst_data);                                 \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                          \
+  GetIntrinsicArgs(inst, inst_data, arg);                           \
   result_register->set(op(shadow_frame->get1, shadow_frame->get2)); \
   return true;                                                      \
 }
@@ -45,18 +67,76 @@ static ALWAYS_INLINE bool name(ShadowFrame* shadow_frame,           \
 #define BINARY_JI_INTRINSIC(name, op, set) \
     BINARY_INTRINSIC(name, op, GetVRegLong(arg[0]), GetVReg(arg[2]), set)
 
+#define BINARY_FF_INTRINSIC(name, op, set) \
+    BINARY_INTRINSIC(name, op, GetVRegFloat(arg[0]), GetVRegFloat(arg[1]), set)
+
+#define BINARY_DD_INTRINSIC(name, op, set) \
+    BINARY_INTRINSIC(name, op, GetVRegDouble(arg[0]), GetVRegDouble(arg[2]), set)
+
 #define UNARY_INTRINSIC(name, op, get, set)                  \
 static ALWAYS_INLINE bool name(ShadowFrame* shadow_frame,    \
                                const Instruction* inst,      \
                                uint16_t inst_data,           \
                                JValue* result_register)      \
     REQUIRES_SHARED(Locks::mutator_lock_) {                  \
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};            \
-  inst->GetVarArgs(arg, inst_data);                          \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                   \
+  GetIntrinsicArgs(inst, inst_data, arg);                    \
   result_register->set(op(shadow_frame->get(arg[0])));       \
   return true;                                               \
 }
 
+// Math.min and Math.max of floating point values: NaN if either is NaN, and -0.0 is less than 0.0.
+template <typename T>
+static ALWAYS_INLINE T JavaMin(T a, T b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return std::numeric_limits<T>::quiet_NaN();
+  }
+  if (a == b) {
+    return std::signbit(a) ? a : b;
+  }
+  return (a < b) ? a : b;
+}
+
+template <typename T>
+static ALWAYS_INLINE T JavaMax(T a, T b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return std::numeric_limits<T>::quiet_NaN();
+  }
+  if (a == b) {
+    return std::signbit(a) ? b : a;
+  }
+  return (a > b) ? a : b;
+}
+
+// Math.round: the closest integer with ties rounded up, zero for NaN and saturated to the range of
+// the result.
+template <typename TInt, typename TFloat>
+static ALWAYS_INLINE TInt JavaRound(TFloat value) {
+  if (std::isnan(value)) {
+    return 0;
+  }
+  TFloat floor = std::floor(value);
+  if (value - floor >= static_cast<TFloat>(0.5)) {
+    floor += static_cast<TFloat>(1.0);
+  }
+  if (floor >= static_cast<TFloat>(std::numeric_limits<TInt>::max())) {
+    return std::numeric_limits<TInt>::max();
+  }
+  if (floor <= static_cast<TFloat>(std::numeric_limits<TInt>::min())) {
+    return std::numeric_limits<TInt>::min();
+  }
+  return static_cast<TInt>(floor);
+}
+
+// Float.floatToIntBits and Double.doubleToLongBits: the raw bits with all NaNs collapsed into the
+// canonical one.
+static ALWAYS_INLINE int32_t FloatToIntBits(float value) {
+  return std::isnan(value) ? 0x7fc00000 : bit_cast<int32_t, float>(value);
+}
+
+static ALWAYS_INLINE int64_t DoubleToLongBits(double value) {
+  return std::isnan(value) ? INT64_C(0x7ff8000000000000) : bit_cast<int64_t, double>(value);
+}
 
 // java.lang.Integer.reverse(I)I
 UNARY_INTRINSIC(MterpIntegerReverse, ReverseBits32, GetVReg, SetI);
@@ -151,6 +231,57 @@ UNARY_INTRINSIC(MterpMathAbsFloat, 0x7fffffff&, GetVReg, SetI);
 // java.lang.Math.abs(D)D
 UNARY_INTRINSIC(MterpMathAbsDouble, INT64_C(0x7fffffffffffffff)&, GetVRegLong, SetJ);
 
+// java.lang.Math.min(FF)F
+BINARY_FF_INTRINSIC(MterpMathMinFloatFloat, JavaMin, SetF);
+
+// java.lang.Math.min(DD)D
+BINARY_DD_INTRINSIC(MterpMathMinDoubleDouble, JavaMin, SetD);
+
+// java.lang.Math.max(FF)F
+BINARY_FF_INTRINSIC(MterpMathMaxFloatFloat, JavaMax, SetF);
+
+// java.lang.Math.max(DD)D
+BINARY_DD_INTRINSIC(MterpMathMaxDoubleDouble, JavaMax, SetD);
+
+// java.lang.Math.rint(D)D
+UNARY_INTRINSIC(MterpMathRint, std::rint, GetVRegDouble, SetD);
+
+// java.lang.Math.round(D)J
+UNARY_INTRINSIC(MterpMathRoundDouble, (JavaRound<int64_t, double>), GetVRegDouble, SetJ);
+
+// java.lang.Math.round(F)I
+UNARY_INTRINSIC(MterpMathRoundFloat, (JavaRound<int32_t, float>), GetVRegFloat, SetI);
+
+// java.lang.Float.floatToRawIntBits(F)I
+UNARY_INTRINSIC(MterpFloatFloatToRawIntBits, (bit_cast<int32_t, float>), GetVRegFloat, SetI);
+
+// java.lang.Float.floatToIntBits(F)I
+UNARY_INTRINSIC(MterpFloatFloatToIntBits, FloatToIntBits, GetVRegFloat, SetI);
+
+// java.lang.Float.intBitsToFloat(I)F
+UNARY_INTRINSIC(MterpFloatIntBitsToFloat, (bit_cast<float, int32_t>), GetVReg, SetF);
+
+// java.lang.Float.isNaN(F)Z
+UNARY_INTRINSIC(MterpFloatIsNaN, std::isnan, GetVRegFloat, SetZ);
+
+// java.lang.Float.isInfinite(F)Z
+UNARY_INTRINSIC(MterpFloatIsInfinite, std::isinf, GetVRegFloat, SetZ);
+
+// java.lang.Double.doubleToRawLongBits(D)J
+UNARY_INTRINSIC(MterpDoubleDoubleToRawLongBits, (bit_cast<int64_t, double>), GetVRegDouble, SetJ);
+
+// java.lang.Double.doubleToLongBits(D)J
+UNARY_INTRINSIC(MterpDoubleDoubleToLongBits, DoubleToLongBits, GetVRegDouble, SetJ);
+
+// java.lang.Double.longBitsToDouble(J)D
+UNARY_INTRINSIC(MterpDoubleLongBitsToDouble, (bit_cast<double, int64_t>), GetVRegLong, SetD);
+
+// java.lang.Double.isNaN(D)Z
+UNARY_INTRINSIC(MterpDoubleIsNaN, std::isnan, GetVRegDouble, SetZ);
+
+// java.lang.Double.isInfinite(D)Z
+UNARY_INTRINSIC(MterpDoubleIsInfinite, std::isinf, GetVRegDouble, SetZ);
+
 // java.lang.Math.sqrt(D)D
 UNARY_INTRINSIC(MterpMathSqrt, std::sqrt, GetVRegDouble, SetD);
 
@@ -184,8 +315,8 @@ static ALWAYS_INLINE bool MterpStringCharAt(ShadowFrame* shadow_frame,
                                             uint16_t inst_data,
                                             JValue* result_register)
     REQUIRES_SHARED(Locks::mutator_lock_) {
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};
-  inst->GetVarArgs(arg, inst_data);
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
   mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString();
   int length = str->GetLength();
   int index = shadow_frame->GetVReg(arg[1]);
@@ -208,8 +339,8 @@ static ALWAYS_INLINE bool MterpStringCompareTo(ShadowFrame* shadow_frame,
                                                uint16_t inst_data,
                                                JValue* result_register)
     REQUIRES_SHARED(Locks::mutator_lock_) {
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};
-  inst->GetVarArgs(arg, inst_data);
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
   mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString();
   mirror::Object* arg1 = shadow_frame->GetVRegReference(arg[1]);
   if (arg1 == nullptr) {
@@ -225,8 +356,8 @@ static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame, \
                                       uint16_t inst_data,        \
                                       JValue* result_register)   \
     REQUIRES_SHARED(Locks::mutator_lock_) {                      \
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};                \
-  inst->GetVarArgs(arg, inst_data);                              \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                       \
+  GetIntrinsicArgs(inst, inst_data, arg);                        \
   mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString(); \
   int ch = shadow_frame->GetVReg(arg[1]);                        \
   if (ch >= 0x10000) {                                           \
@@ -249,8 +380,8 @@ static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame, \
                                       uint16_t inst_data,        \
                                       JValue* result_register)   \
     REQUIRES_SHARED(Locks::mutator_lock_) {                      \
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};                \
-  inst->GetVarArgs(arg, inst_data);                              \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                       \
+  GetIntrinsicArgs(inst, inst_data, arg);                        \
   mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString(); \
   result_register->operation;                                    \
   return true;                                                   \
@@ -269,8 +400,8 @@ static ALWAYS_INLINE bool MterpStringGetCharsNoCheck(ShadowFrame* shadow_frame,
                                                      JValue* result_register ATTRIBUTE_UNUSED)
     REQUIRES_SHARED(Locks::mutator_lock_) {
   // Start, end & index already checked by caller - won't throw.  Destination is uncompressed.
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};
-  inst->GetVarArgs(arg, inst_data);
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
   mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString();
   int32_t start = shadow_frame->GetVReg(arg[1]);
   int32_t end = shadow_frame->GetVReg(arg[2]);
@@ -296,8 +427,8 @@ static ALWAYS_INLINE bool MterpStringEquals(ShadowFrame* shadow_frame,
                                             uint16_t inst_data,
                                             JValue* result_register)
     REQUIRES_SHARED(Locks::mutator_lock_) {
-  uint32_t arg[Instruction::kMaxVarArgRegs] = {};
-  inst->GetVarArgs(arg, inst_data);
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
   mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString();
   mirror::Object* obj = shadow_frame->GetVRegReference(arg[1]);
   bool res = false;  // Assume not equal.
@@ -323,6 +454,337 @@ static ALWAYS_INLINE bool MterpStringEquals(ShadowFrame* shadow_frame,
   return true;
 }
 
+// Returns the index of the first occurrence of needle in haystack at or after start, or -1.
+template <typename THaystack, typename TNeedle>
+static int32_t IndexOfString(const THaystack* haystack,
+                             int32_t haystack_length,
+                             const TNeedle* needle,
+                             int32_t needle_length,
+                             int32_t start) {
+  for (int32_t i = start; i <= haystack_length - needle_length; ++i) {
+    int32_t j = 0;
+    while (j < needle_length && haystack[i + j] == needle[j]) {
+      ++j;
+    }
+    if (j == needle_length) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// String.indexOf(String, int) with the clamping of the start index of the Java code.
+static int32_t StringIndexOfString(mirror::String* str, mirror::String* needle, int32_t start)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  const int32_t length = str->GetLength();
+  const int32_t needle_length = needle->GetLength();
+  start = std::max(start, 0);
+  if (start >= length) {
+    return (needle_length == 0) ? length : -1;
+  }
+  if (str->IsCompressed()) {
+    return needle->IsCompressed()
+        ? IndexOfString(str->GetValueCompressed(), length,
+                        needle->GetValueCompressed(), needle_length, start)
+        : IndexOfString(str->GetValueCompressed(), length,
+                        needle->GetValue(), needle_length, start);
+  }
+  return needle->IsCompressed()
+      ? IndexOfString(str->GetValue(), length, needle->GetValueCompressed(), needle_length, start)
+      : IndexOfString(str->GetValue(), length, needle->GetValue(), needle_length, start);
+}
+
+#define STRING_STRING_INDEXOF_INTRINSIC(name, starting_pos)                 \
+static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame,            \
+                                      const Instruction* inst,              \
+                                      uint16_t inst_data,                   \
+                                      JValue* result_register)              \
+    REQUIRES_SHARED(Locks::mutator_lock_) {                                 \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                                  \
+  GetIntrinsicArgs(inst, inst_data, arg);                                   \
+  mirror::String* str = shadow_frame->GetVRegReference(arg[0])->AsString(); \
+  mirror::Object* needle_obj = shadow_frame->GetVRegReference(arg[1]);      \
+  if (needle_obj == nullptr) {                                              \
+    /* Punt and let non-intrinsic version deal with the throw. */           \
+    return false;                                                           \
+  }                                                                         \
+  mirror::String* needle = needle_obj->AsString();                          \
+  result_register->SetI(StringIndexOfString(str, needle, starting_pos));    \
+  return true;                                                              \
+}
+
+// java.lang.String.indexOf(Ljava/lang/String;)I
+STRING_STRING_INDEXOF_INTRINSIC(StringStringIndexOf, 0);
+
+// java.lang.String.indexOf(Ljava/lang/String;I)I
+STRING_STRING_INDEXOF_INTRINSIC(StringStringIndexOfAfter, shadow_frame->GetVReg(arg[2]));
+
+// Returns true if the copy of count elements from src_pos to dst_pos stays within both arrays,
+// false if System.arraycopy would throw. The copy is left to the native method in a transaction,
+// which has to record the old values.
+static ALWAYS_INLINE bool CanArrayCopy(mirror::Object* src,
+                                       int32_t src_pos,
+                                       mirror::Object* dst,
+                                       int32_t dst_pos,
+                                       int32_t count)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  if (src == nullptr || dst == nullptr || !src->IsArrayInstance() || !dst->IsArrayInstance() ||
+      Runtime::Current()->IsActiveTransaction()) {
+    return false;
+  }
+  return src_pos >= 0 && dst_pos >= 0 && count >= 0 &&
+         src_pos <= src->AsArray()->GetLength() - count &&
+         dst_pos <= dst->AsArray()->GetLength() - count;
+}
+
+// java.lang.System.arraycopy([CI[CII)V
+static ALWAYS_INLINE bool MterpSystemArrayCopyChar(ShadowFrame* shadow_frame,
+                                                   const Instruction* inst,
+                                                   uint16_t inst_data,
+                                                   JValue* result_register ATTRIBUTE_UNUSED)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
+  mirror::Object* src = shadow_frame->GetVRegReference(arg[0]);
+  int32_t src_pos = shadow_frame->GetVReg(arg[1]);
+  mirror::Object* dst = shadow_frame->GetVRegReference(arg[2]);
+  int32_t dst_pos = shadow_frame->GetVReg(arg[3]);
+  int32_t count = shadow_frame->GetVReg(arg[4]);
+  if (!CanArrayCopy(src, src_pos, dst, dst_pos, count)) {
+    return false;  // Punt and let non-intrinsic version deal with the throw.
+  }
+  dst->AsCharArray()->Memmove(dst_pos, src->AsCharArray(), src_pos, count);
+  return true;
+}
+
+// java.lang.System.arraycopy(Ljava/lang/Object;ILjava/lang/Object;II)V
+static ALWAYS_INLINE bool MterpSystemArrayCopy(ShadowFrame* shadow_frame,
+                                               const Instruction* inst,
+                                               uint16_t inst_data,
+                                               JValue* result_register ATTRIBUTE_UNUSED)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
+  mirror::Object* src = shadow_frame->GetVRegReference(arg[0]);
+  int32_t src_pos = shadow_frame->GetVReg(arg[1]);
+  mirror::Object* dst = shadow_frame->GetVRegReference(arg[2]);
+  int32_t dst_pos = shadow_frame->GetVReg(arg[3]);
+  int32_t count = shadow_frame->GetVReg(arg[4]);
+  if (!CanArrayCopy(src, src_pos, dst, dst_pos, count)) {
+    return false;  // Punt and let non-intrinsic version deal with the throw.
+  }
+  // Only handle arrays of the same type, mixed object arrays need per element checks.
+  ObjPtr<mirror::Class> component_type = dst->GetClass()->GetComponentType();
+  if (component_type != src->GetClass()->GetComponentType()) {
+    return false;
+  }
+  mirror::Array* src_array = src->AsArray();
+  mirror::Array* dst_array = dst->AsArray();
+  switch (component_type->GetPrimitiveType()) {
+    case Primitive::kPrimBoolean:
+    case Primitive::kPrimByte:
+      dst_array->AsByteSizedArray()->Memmove(
+          dst_pos, src_array->AsByteSizedArray(), src_pos, count);
+      return true;
+    case Primitive::kPrimChar:
+    case Primitive::kPrimShort:
+      dst_array->AsShortSizedArray()->Memmove(
+          dst_pos, src_array->AsShortSizedArray(), src_pos, count);
+      return true;
+    case Primitive::kPrimInt:
+      dst_array->AsIntArray()->Memmove(dst_pos, src_array->AsIntArray(), src_pos, count);
+      return true;
+    case Primitive::kPrimFloat:
+      dst_array->AsFloatArray()->Memmove(dst_pos, src_array->AsFloatArray(), src_pos, count);
+      return true;
+    case Primitive::kPrimLong:
+      dst_array->AsLongArray()->Memmove(dst_pos, src_array->AsLongArray(), src_pos, count);
+      return true;
+    case Primitive::kPrimDouble:
+      dst_array->AsDoubleArray()->Memmove(dst_pos, src_array->AsDoubleArray(), src_pos, count);
+      return true;
+    case Primitive::kPrimNot:
+      dst_array->AsObjectArray<mirror::Object>()->AssignableMemmove(
+          dst_pos, src_array->AsObjectArray<mirror::Object>(), src_pos, count);
+      return true;
+    case Primitive::kPrimVoid:
+      LOG(FATAL) << "Unreachable, cannot have arrays of type void";
+      UNREACHABLE();
+  }
+  return false;
+}
+
+// java.lang.Thread.currentThread()Ljava/lang/Thread;
+static ALWAYS_INLINE bool MterpThreadCurrentThread(ShadowFrame* shadow_frame ATTRIBUTE_UNUSED,
+                                                   const Instruction* inst ATTRIBUTE_UNUSED,
+                                                   uint16_t inst_data ATTRIBUTE_UNUSED,
+                                                   JValue* result_register)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  result_register->SetL(Thread::Current()->GetPeer());
+  return true;
+}
+
+// The sun.misc.Unsafe intrinsics below take the Unsafe instance in arg[0], the object in arg[1]
+// and the field offset in arg[2] and arg[3]. Like the native methods, the writes are not
+// transactional, so they punt if a transaction is active.
+
+#define UNSAFE_GET_INTRINSIC(name, get, set)                     \
+static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame, \
+                                      const Instruction* inst,   \
+                                      uint16_t inst_data,        \
+                                      JValue* result_register)   \
+    REQUIRES_SHARED(Locks::mutator_lock_) {                      \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                       \
+  GetIntrinsicArgs(inst, inst_data, arg);                        \
+  mirror::Object* obj = shadow_frame->GetVRegReference(arg[1]);  \
+  if (obj == nullptr) {                                          \
+    return false;                                                \
+  }                                                              \
+  MemberOffset offset(shadow_frame->GetVRegLong(arg[2]));        \
+  result_register->set(obj->get(offset));                        \
+  return true;                                                   \
+}
+
+// sun.misc.Unsafe.getInt(Ljava/lang/Object;J)I
+UNSAFE_GET_INTRINSIC(UnsafeGet, GetField32, SetI)
+
+// sun.misc.Unsafe.getIntVolatile(Ljava/lang/Object;J)I
+UNSAFE_GET_INTRINSIC(UnsafeGetVolatile, GetField32Volatile, SetI)
+
+// sun.misc.Unsafe.getLong(Ljava/lang/Object;J)J
+UNSAFE_GET_INTRINSIC(UnsafeGetLong, GetField64, SetJ)
+
+// sun.misc.Unsafe.getLongVolatile(Ljava/lang/Object;J)J
+UNSAFE_GET_INTRINSIC(UnsafeGetLongVolatile, GetField64Volatile, SetJ)
+
+// sun.misc.Unsafe.getObject(Ljava/lang/Object;J)Ljava/lang/Object;
+UNSAFE_GET_INTRINSIC(UnsafeGetObject, GetFieldObject<mirror::Object>, SetL)
+
+// sun.misc.Unsafe.getObjectVolatile(Ljava/lang/Object;J)Ljava/lang/Object;
+UNSAFE_GET_INTRINSIC(UnsafeGetObjectVolatile, GetFieldObjectVolatile<mirror::Object>, SetL)
+
+#define UNSAFE_PUT_INTRINSIC(name, get_value, ordered, set)                     \
+static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame,                \
+                                      const Instruction* inst,                  \
+                                      uint16_t inst_data,                       \
+                                      JValue* result_register ATTRIBUTE_UNUSED) \
+    REQUIRES_SHARED(Locks::mutator_lock_) {                                     \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                                      \
+  GetIntrinsicArgs(inst, inst_data, arg);                                       \
+  mirror::Object* obj = shadow_frame->GetVRegReference(arg[1]);                 \
+  if (obj == nullptr || Runtime::Current()->IsActiveTransaction()) {            \
+    return false;                                                               \
+  }                                                                             \
+  MemberOffset offset(shadow_frame->GetVRegLong(arg[2]));                       \
+  if (ordered) {                                                                \
+    QuasiAtomic::ThreadFenceRelease();                                          \
+  }                                                                             \
+  obj->set<false>(offset, shadow_frame->get_value(arg[4]));                     \
+  return true;                                                                  \
+}
+
+// sun.misc.Unsafe.putInt(Ljava/lang/Object;JI)V
+UNSAFE_PUT_INTRINSIC(UnsafePut, GetVReg, false, SetField32)
+
+// sun.misc.Unsafe.putOrderedInt(Ljava/lang/Object;JI)V
+UNSAFE_PUT_INTRINSIC(UnsafePutOrdered, GetVReg, true, SetField32)
+
+// sun.misc.Unsafe.putIntVolatile(Ljava/lang/Object;JI)V
+UNSAFE_PUT_INTRINSIC(UnsafePutVolatile, GetVReg, false, SetField32Volatile)
+
+// sun.misc.Unsafe.putLong(Ljava/lang/Object;JJ)V
+UNSAFE_PUT_INTRINSIC(UnsafePutLong, GetVRegLong, false, SetField64)
+
+// sun.misc.Unsafe.putOrderedLong(Ljava/lang/Object;JJ)V
+UNSAFE_PUT_INTRINSIC(UnsafePutLongOrdered, GetVRegLong, true, SetField64)
+
+// sun.misc.Unsafe.putLongVolatile(Ljava/lang/Object;JJ)V
+UNSAFE_PUT_INTRINSIC(UnsafePutLongVolatile, GetVRegLong, false, SetField64Volatile)
+
+// sun.misc.Unsafe.putObject(Ljava/lang/Object;JLjava/lang/Object;)V
+UNSAFE_PUT_INTRINSIC(UnsafePutObject, GetVRegReference, false, SetFieldObject)
+
+// sun.misc.Unsafe.putOrderedObject(Ljava/lang/Object;JLjava/lang/Object;)V
+UNSAFE_PUT_INTRINSIC(UnsafePutObjectOrdered, GetVRegReference, true, SetFieldObject)
+
+// sun.misc.Unsafe.putObjectVolatile(Ljava/lang/Object;JLjava/lang/Object;)V
+UNSAFE_PUT_INTRINSIC(UnsafePutObjectVolatile, GetVRegReference, false, SetFieldObjectVolatile)
+
+#define UNSAFE_CAS_INTRINSIC(name, get_value, new_value_reg, cas)              \
+static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame,               \
+                                      const Instruction* inst,                 \
+                                      uint16_t inst_data,                      \
+                                      JValue* result_register)                 \
+    REQUIRES_SHARED(Locks::mutator_lock_) {                                    \
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};                                     \
+  GetIntrinsicArgs(inst, inst_data, arg);                                      \
+  mirror::Object* obj = shadow_frame->GetVRegReference(arg[1]);                \
+  if (obj == nullptr || Runtime::Current()->IsActiveTransaction()) {           \
+    return false;                                                              \
+  }                                                                            \
+  MemberOffset offset(shadow_frame->GetVRegLong(arg[2]));                      \
+  bool success = obj->cas<false>(offset,                                       \
+                                 shadow_frame->get_value(arg[4]),              \
+                                 shadow_frame->get_value(arg[new_value_reg])); \
+  result_register->SetZ(success);                                              \
+  return true;                                                                 \
+}
+
+// sun.misc.Unsafe.compareAndSwapInt(Ljava/lang/Object;JII)Z
+UNSAFE_CAS_INTRINSIC(UnsafeCASInt, GetVReg, 5, CasFieldStrongSequentiallyConsistent32)
+
+// sun.misc.Unsafe.compareAndSwapLong(Ljava/lang/Object;JJJ)Z
+UNSAFE_CAS_INTRINSIC(UnsafeCASLong, GetVRegLong, 6, CasFieldStrongSequentiallyConsistent64)
+
+// sun.misc.Unsafe.compareAndSwapObject(Ljava/lang/Object;JLjava/lang/Object;Ljava/lang/Object;)Z
+static ALWAYS_INLINE bool MterpUnsafeCASObject(ShadowFrame* shadow_frame,
+                                               const Instruction* inst,
+                                               uint16_t inst_data,
+                                               JValue* result_register)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  uint32_t arg[kMaxIntrinsicArgRegs] = {};
+  GetIntrinsicArgs(inst, inst_data, arg);
+  mirror::Object* obj = shadow_frame->GetVRegReference(arg[1]);
+  if (obj == nullptr || Runtime::Current()->IsActiveTransaction()) {
+    return false;
+  }
+  MemberOffset offset(shadow_frame->GetVRegLong(arg[2]));
+  if (kUseReadBarrier) {
+    // Need to make sure the reference stored in the field is a to-space one before attempting the
+    // CAS or the CAS could fail incorrectly.
+    mirror::HeapReference<mirror::Object>* field_addr =
+        reinterpret_cast<mirror::HeapReference<mirror::Object>*>(
+            reinterpret_cast<uint8_t*>(obj) + offset.SizeValue());
+    ReadBarrier::Barrier<mirror::Object, kWithReadBarrier, /* kAlwaysUpdateField */ true>(
+        obj, offset, field_addr);
+  }
+  bool success = obj->CasFieldStrongSequentiallyConsistentObject<false>(
+      offset,
+      shadow_frame->GetVRegReference(arg[4]),
+      shadow_frame->GetVRegReference(arg[5]));
+  result_register->SetZ(success);
+  return true;
+}
+
+#define FENCE_INTRINSIC(name, fence)                                              \
+static ALWAYS_INLINE bool Mterp##name(ShadowFrame* shadow_frame ATTRIBUTE_UNUSED, \
+                                      const Instruction* inst ATTRIBUTE_UNUSED,   \
+                                      uint16_t inst_data ATTRIBUTE_UNUSED,        \
+                                      JValue* result_register ATTRIBUTE_UNUSED)   \
+    REQUIRES_SHARED(Locks::mutator_lock_) {                                       \
+  QuasiAtomic::fence();                                                           \
+  return true;                                                                    \
+}
+
+// sun.misc.Unsafe.loadFence()V
+FENCE_INTRINSIC(UnsafeLoadFence, ThreadFenceAcquire)
+
+// sun.misc.Unsafe.storeFence()V
+FENCE_INTRINSIC(UnsafeStoreFence, ThreadFenceRelease)
+
+// sun.misc.Unsafe.fullFence()V
+FENCE_INTRINSIC(UnsafeFullFence, ThreadFenceSequentiallyConsistent)
+
 // Macro to help keep track of what's left to implement.
 #define UNIMPLEMENTED_CASE(name)    \
     case Intrinsics::k##name:       \
@@ -343,16 +805,16 @@ bool MterpHandleIntrinsic(ShadowFrame* shadow_frame,
   Intrinsics intrinsic = static_cast<Intrinsics>(called_method->GetIntrinsic());
   bool res = false;  // Assume failure
   switch (intrinsic) {
-    UNIMPLEMENTED_CASE(DoubleDoubleToRawLongBits /* (D)J */)
-    UNIMPLEMENTED_CASE(DoubleDoubleToLongBits /* (D)J */)
-    UNIMPLEMENTED_CASE(DoubleIsInfinite /* (D)Z */)
-    UNIMPLEMENTED_CASE(DoubleIsNaN /* (D)Z */)
-    UNIMPLEMENTED_CASE(DoubleLongBitsToDouble /* (J)D */)
-    UNIMPLEMENTED_CASE(FloatFloatToRawIntBits /* (F)I */)
-    UNIMPLEMENTED_CASE(FloatFloatToIntBits /* (F)I */)
-    UNIMPLEMENTED_CASE(FloatIsInfinite /* (F)Z */)
-    UNIMPLEMENTED_CASE(FloatIsNaN /* (F)Z */)
-    UNIMPLEMENTED_CASE(FloatIntBitsToFloat /* (I)F */)
+    INTRINSIC_CASE(DoubleDoubleToRawLongBits)
+    INTRINSIC_CASE(DoubleDoubleToLongBits)
+    INTRINSIC_CASE(DoubleIsInfinite)
+    INTRINSIC_CASE(DoubleIsNaN)
+    INTRINSIC_CASE(DoubleLongBitsToDouble)
+    INTRINSIC_CASE(FloatFloatToRawIntBits)
+    INTRINSIC_CASE(FloatFloatToIntBits)
+    INTRINSIC_CASE(FloatIsInfinite)
+    INTRINSIC_CASE(FloatIsNaN)
+    INTRINSIC_CASE(FloatIntBitsToFloat)
     INTRINSIC_CASE(IntegerReverse)
     INTRINSIC_CASE(IntegerReverseBytes)
     INTRINSIC_CASE(IntegerBitCount)
@@ -380,12 +842,12 @@ bool MterpHandleIntrinsic(ShadowFrame* shadow_frame,
     INTRINSIC_CASE(MathAbsFloat)
     INTRINSIC_CASE(MathAbsLong)
     INTRINSIC_CASE(MathAbsInt)
-    UNIMPLEMENTED_CASE(MathMinDoubleDouble /* (DD)D */)
-    UNIMPLEMENTED_CASE(MathMinFloatFloat /* (FF)F */)
+    INTRINSIC_CASE(MathMinDoubleDouble)
+    INTRINSIC_CASE(MathMinFloatFloat)
     INTRINSIC_CASE(MathMinLongLong)
     INTRINSIC_CASE(MathMinIntInt)
-    UNIMPLEMENTED_CASE(MathMaxDoubleDouble /* (DD)D */)
-    UNIMPLEMENTED_CASE(MathMaxFloatFloat /* (FF)F */)
+    INTRINSIC_CASE(MathMaxDoubleDouble)
+    INTRINSIC_CASE(MathMaxFloatFloat)
     INTRINSIC_CASE(MathMaxLongLong)
     INTRINSIC_CASE(MathMaxIntInt)
     INTRINSIC_CASE(MathCos)
@@ -408,12 +870,12 @@ bool MterpHandleIntrinsic(ShadowFrame* shadow_frame,
     INTRINSIC_CASE(MathSqrt)
     INTRINSIC_CASE(MathCeil)
     INTRINSIC_CASE(MathFloor)
-    UNIMPLEMENTED_CASE(MathRint /* (D)D */)
-    UNIMPLEMENTED_CASE(MathRoundDouble /* (D)J */)
-    UNIMPLEMENTED_CASE(MathRoundFloat /* (F)I */)
-    UNIMPLEMENTED_CASE(SystemArrayCopyChar /* ([CI[CII)V */)
-    UNIMPLEMENTED_CASE(SystemArrayCopy /* (Ljava/lang/Object;ILjava/lang/Object;II)V */)
-    UNIMPLEMENTED_CASE(ThreadCurrentThread /* ()Ljava/lang/Thread; */)
+    INTRINSIC_CASE(MathRint)
+    INTRINSIC_CASE(MathRoundDouble)
+    INTRINSIC_CASE(MathRoundFloat)
+    INTRINSIC_CASE(SystemArrayCopyChar)
+    INTRINSIC_CASE(SystemArrayCopy)
+    INTRINSIC_CASE(ThreadCurrentThread)
     UNIMPLEMENTED_CASE(MemoryPeekByte /* (J)B */)
     UNIMPLEMENTED_CASE(MemoryPeekIntNative /* (J)I */)
     UNIMPLEMENTED_CASE(MemoryPeekLongNative /* (J)J */)
@@ -428,8 +890,8 @@ bool MterpHandleIntrinsic(ShadowFrame* shadow_frame,
     INTRINSIC_CASE(StringGetCharsNoCheck)
     INTRINSIC_CASE(StringIndexOf)
     INTRINSIC_CASE(StringIndexOfAfter)
-    UNIMPLEMENTED_CASE(StringStringIndexOf /* (Ljava/lang/String;)I */)
-    UNIMPLEMENTED_CASE(StringStringIndexOfAfter /* (Ljava/lang/String;I)I */)
+    INTRINSIC_CASE(StringStringIndexOf)
+    INTRINSIC_CASE(StringStringIndexOfAfter)
     INTRINSIC_CASE(StringIsEmpty)
     INTRINSIC_CASE(StringLength)
     UNIMPLEMENTED_CASE(StringNewStringFromBytes /* ([BIII)Ljava/lang/String; */)
@@ -441,32 +903,32 @@ bool MterpHandleIntrinsic(ShadowFrame* shadow_frame,
     UNIMPLEMENTED_CASE(StringBuilderAppend /* (Ljava/lang/String;)Ljava/lang/StringBuilder; */)
     UNIMPLEMENTED_CASE(StringBuilderLength /* ()I */)
     UNIMPLEMENTED_CASE(StringBuilderToString /* ()Ljava/lang/String; */)
-    UNIMPLEMENTED_CASE(UnsafeCASInt /* (Ljava/lang/Object;JII)Z */)
-    UNIMPLEMENTED_CASE(UnsafeCASLong /* (Ljava/lang/Object;JJJ)Z */)
-    UNIMPLEMENTED_CASE(UnsafeCASObject /* (Ljava/lang/Object;JLjava/lang/Object;Ljava/lang/Object;)Z */)
-    UNIMPLEMENTED_CASE(UnsafeGet /* (Ljava/lang/Object;J)I */)
-    UNIMPLEMENTED_CASE(UnsafeGetVolatile /* (Ljava/lang/Object;J)I */)
-    UNIMPLEMENTED_CASE(UnsafeGetObject /* (Ljava/lang/Object;J)Ljava/lang/Object; */)
-    UNIMPLEMENTED_CASE(UnsafeGetObjectVolatile /* (Ljava/lang/Object;J)Ljava/lang/Object; */)
-    UNIMPLEMENTED_CASE(UnsafeGetLong /* (Ljava/lang/Object;J)J */)
-    UNIMPLEMENTED_CASE(UnsafeGetLongVolatile /* (Ljava/lang/Object;J)J */)
-    UNIMPLEMENTED_CASE(UnsafePut /* (Ljava/lang/Object;JI)V */)
-    UNIMPLEMENTED_CASE(UnsafePutOrdered /* (Ljava/lang/Object;JI)V */)
-    UNIMPLEMENTED_CASE(UnsafePutVolatile /* (Ljava/lang/Object;JI)V */)
-    UNIMPLEMENTED_CASE(UnsafePutObject /* (Ljava/lang/Object;JLjava/lang/Object;)V */)
-    UNIMPLEMENTED_CASE(UnsafePutObjectOrdered /* (Ljava/lang/Object;JLjava/lang/Object;)V */)
-    UNIMPLEMENTED_CASE(UnsafePutObjectVolatile /* (Ljava/lang/Object;JLjava/lang/Object;)V */)
-    UNIMPLEMENTED_CASE(UnsafePutLong /* (Ljava/lang/Object;JJ)V */)
-    UNIMPLEMENTED_CASE(UnsafePutLongOrdered /* (Ljava/lang/Object;JJ)V */)
-    UNIMPLEMENTED_CASE(UnsafePutLongVolatile /* (Ljava/lang/Object;JJ)V */)
+    INTRINSIC_CASE(UnsafeCASInt)
+    INTRINSIC_CASE(UnsafeCASLong)
+    INTRINSIC_CASE(UnsafeCASObject)
+    INTRINSIC_CASE(UnsafeGet)
+    INTRINSIC_CASE(UnsafeGetVolatile)
+    INTRINSIC_CASE(UnsafeGetObject)
+    INTRINSIC_CASE(UnsafeGetObjectVolatile)
+    INTRINSIC_CASE(UnsafeGetLong)
+    INTRINSIC_CASE(UnsafeGetLongVolatile)
+    INTRINSIC_CASE(UnsafePut)
+    INTRINSIC_CASE(UnsafePutOrdered)
+    INTRINSIC_CASE(UnsafePutVolatile)
+    INTRINSIC_CASE(UnsafePutObject)
+    INTRINSIC_CASE(UnsafePutObjectOrdered)
+    INTRINSIC_CASE(UnsafePutObjectVolatile)
+    INTRINSIC_CASE(UnsafePutLong)
+    INTRINSIC_CASE(UnsafePutLongOrdered)
+    INTRINSIC_CASE(UnsafePutLongVolatile)
     UNIMPLEMENTED_CASE(UnsafeGetAndAddInt /* (Ljava/lang/Object;JI)I */)
     UNIMPLEMENTED_CASE(UnsafeGetAndAddLong /* (Ljava/lang/Object;JJ)J */)
     UNIMPLEMENTED_CASE(UnsafeGetAndSetInt /* (Ljava/lang/Object;JI)I */)
     UNIMPLEMENTED_CASE(UnsafeGetAndSetLong /* (Ljava/lang/Object;JJ)J */)
     UNIMPLEMENTED_CASE(UnsafeGetAndSetObject /* (Ljava/lang/Object;JLjava/lang/Object;)Ljava/lang/Object; */)
-    UNIMPLEMENTED_CASE(UnsafeLoadFence /* ()V */)
-    UNIMPLEMENTED_CASE(UnsafeStoreFence /* ()V */)
-    UNIMPLEMENTED_CASE(UnsafeFullFence /* ()V */)
+    INTRINSIC_CASE(UnsafeLoadFence)
+    INTRINSIC_CASE(UnsafeStoreFence)
+    INTRINSIC_CASE(UnsafeFullFence)
     UNIMPLEMENTED_CASE(ReferenceGetReferent /* ()Ljava/lang/Object; */)
     UNIMPLEMENTED_CASE(IntegerValueOf /* (I)Ljava/lang/Integer; */)
     case Intrinsics::kNone:
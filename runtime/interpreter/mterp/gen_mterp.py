@@ -35,6 +35,9 @@ default_op_dir = None
 default_alt_stub = None
 opcode_locations = {}
 alt_opcode_locations = {}
+opcode_flags = {}
+fuse_macros = {}            # macro -> fused macro
+fused_opcodes = {}          # first opcode -> second opcode
 asm_stub_text = []
 fallback_stub_text = []
 label_prefix = ".L"         # use ".L" to hide labels from gdb
@@ -221,6 +224,44 @@ def opEntry(tokens):
                 % (tokens[1], opcode_locations[tokens[1]], tokens[2])
     opcode_locations[tokens[1]] = tokens[2]
 
+#
+# Parse arch config file --
+# Name the macro that dispatches to the next instruction, and the variant of
+# it that takes the opcode and label of the expected next handler as two
+# extra trailing arguments.
+#
+def fuseMacro(tokens):
+    if len(tokens) != 3:
+        raise DataParseError("fuse-macro requires exactly two arguments")
+    if in_op_start != 0:
+        raise DataParseError("fuse-macro must precede opStart")
+    fuse_macros[tokens[1]] = tokens[2]
+
+#
+# Parse arch config file --
+# Let the handler of the first opcode jump straight to the handler of the
+# second when that is the next instruction.
+#
+def fuseEntry(tokens):
+    if len(tokens) != 3:
+        raise DataParseError("fuse requires exactly two arguments")
+    if in_op_start != 1:
+        raise DataParseError("fuse statements must be between opStart/opEnd")
+    if not fuse_macros:
+        raise DataParseError("fuse requires a preceding fuse-macro")
+    for op in tokens[1:]:
+        if op not in opcodes:
+            raise DataParseError("unknown opcode %s" % op)
+    flags = opcode_flags[tokens[1]]
+    if "kContinue" not in flags or \
+            "kBranch" in flags or "kSwitch" in flags or "kReturn" in flags:
+        raise DataParseError("%s does not fall through to the next opcode"
+                % tokens[1])
+    if fused_opcodes.has_key(tokens[1]):
+        raise DataParseError("%s is already fused with %s"
+                % (tokens[1], fused_opcodes[tokens[1]]))
+    fused_opcodes[tokens[1]] = tokens[2]
+
 #
 # Parse arch config file --
 # End of opcode list; emit instruction blocks.
@@ -254,12 +295,15 @@ def genaltop(tokens):
 def getOpcodeList():
     opcodes = []
     opcode_fp = open(interp_defs_file)
-    opcode_re = re.compile(r"^\s*V\((....), (\w+),.*", re.DOTALL)
+    opcode_re = re.compile(r"^\s*V\((....), (\w+), \"[^\"]*\", \w+, \w+, ([^,]+),.*",
+                           re.DOTALL)
     for line in opcode_fp:
         match = opcode_re.match(line)
         if not match:
             continue
-        opcodes.append("op_" + match.group(2).lower())
+        op = "op_" + match.group(2).lower()
+        opcodes.append(op)
+        opcode_flags[op] = [flag.strip() for flag in match.group(3).split("|")]
     opcode_fp.close()
 
     if len(opcodes) != kNumPackedOpcodes:
@@ -376,11 +420,18 @@ def loadAndEmitAsm(location, opindex, sister_list):
     source = "%s/%s.S" % (location, op)
     dict = getGlobalSubDict()
     dict.update({ "opcode":op, "opnum":opindex })
+    if fused_opcodes.has_key(op):
+        # A list, so that the count is shared with the included files.
+        dict["fused_with"] = fused_opcodes[op]
+        dict["fused_count"] = [0]
     if verbose:
         print " emit %s --> asm" % source
 
     emitAsmHeader(asm_fp, dict, label_prefix)
     appendSourceFile(source, dict, asm_fp, sister_list)
+    if dict.has_key("fused_with") and dict["fused_count"][0] == 0:
+        raise DataParseError("%s has no %s to fuse with %s" % (source,
+                " or ".join(sorted(fuse_macros)), dict["fused_with"]))
 
 #
 # Emit fallback fragment
@@ -485,6 +536,7 @@ def appendSourceFile(source, dict, outfp, sister_list):
                 raise
         else:
             subline = line
+        subline = fuseLine(subline, dict)
 
         # write output to appropriate file
         if in_sister:
@@ -494,6 +546,32 @@ def appendSourceFile(source, dict, outfp, sister_list):
     outfp.write("\n")
     infp.close()
 
+#
+# Replace the dispatch to the next instruction on the line with its fused
+# variant if the opcode being emitted is fused with its successor, e.g.
+#   GOTO_NEXT  ->  GOTO_NEXT_FUSED 0x0a, .L_op_move_result
+#
+fuse_line_re = re.compile(r"^(\s*)(\w+)\b([^#/\n]*?)(\s*)((#|//|/\*).*)?$")
+def fuseLine(line, dict):
+    if dict == None or not dict.has_key("fused_with"):
+        return line
+    match = fuse_line_re.match(line.rstrip("\n"))
+    if not match or not fuse_macros.has_key(match.group(2)):
+        return line
+    second = dict["fused_with"]
+    args = match.group(3).strip()
+    if args:
+        args += ", "
+    args += "0x%02x, %s_%s" % (opcodes.index(second), label_prefix, second)
+    dict["fused_count"][0] += 1
+    code = "%s%s %s" % (match.group(1), fuse_macros[match.group(2)], args)
+    comment = match.group(5)
+    if not comment:
+        return code + "\n"
+    # keep the comment in its column if there is room
+    padding = max(1, match.start(5) - len(code))
+    return "%s%s%s\n" % (code, " " * padding, comment)
+
 #
 # Emit a C-style section header comment.
 #
@@ -593,6 +671,10 @@ try:
                 altEntry(tokens)
             elif tokens[0] == "op":
                 opEntry(tokens)
+            elif tokens[0] == "fuse-macro":
+                fuseMacro(tokens)
+            elif tokens[0] == "fuse":
+                fuseEntry(tokens)
             elif tokens[0] == "handler-style":
                 setHandlerStyle(tokens)
             elif tokens[0] == "alt-ops":
@@ -17,6 +17,8 @@
 /*
  * Mterp entry point and support functions.
  */
+#include <bitset>
+
 #include "interpreter/interpreter_common.h"
 #include "interpreter/interpreter_intrinsics.h"
 #include "entrypoints/entrypoint_utils-inl.h"
@@ -47,9 +49,65 @@ void CheckMterpAsmConstants() {
 void InitMterpTls(Thread* self) {
   self->SetMterpDefaultIBase(artMterpAsmInstructionStart);
   self->SetMterpAltIBase(artMterpAsmAltInstructionStart);
-  self->SetMterpCurrentIBase((kTraceExecutionEnabled || kTestExportPC) ?
-                             artMterpAsmAltInstructionStart :
-                             artMterpAsmInstructionStart);
+  const bool use_alt = kTraceExecutionEnabled || kTestExportPC || kProfileInstructionPairs;
+  self->SetMterpCurrentIBase(use_alt ? artMterpAsmAltInstructionStart :
+                                       artMterpAsmInstructionStart);
+}
+
+// Counts of the instruction pairs, indexed by first opcode * kNumPackedOpcodes + second opcode.
+static Atomic<uint32_t>* GetInstructionPairCounts() {
+  static Atomic<uint32_t>* counts =
+      new Atomic<uint32_t>[kNumPackedOpcodes * kNumPackedOpcodes]();
+  return counts;
+}
+
+// Only instructions that continue to the next one can be fused with it.
+static bool CanFuseWithNext(Instruction::Code opcode) {
+  const int flags = Instruction::FlagsOf(opcode);
+  return (flags & Instruction::kContinue) != 0 &&
+         (flags & (Instruction::kBranch | Instruction::kSwitch | Instruction::kReturn)) == 0;
+}
+
+// The name of the handler template of the opcode, e.g. "op_move_result_object".
+static std::string HandlerName(Instruction::Code opcode) {
+  std::string name = std::string("op_") + Instruction::Name(opcode);
+  std::replace(name.begin(), name.end(), '-', '_');
+  std::replace(name.begin(), name.end(), '/', '_');
+  return name;
+}
+
+void DumpInstructionPairProfile(std::ostream& os) {
+  static constexpr size_t kMaxPairs = 32;
+  if (!kProfileInstructionPairs) {
+    return;
+  }
+  Atomic<uint32_t>* counts = GetInstructionPairCounts();
+  std::vector<std::pair<uint32_t, size_t>> pairs;
+  uint64_t total = 0;
+  for (size_t i = 0; i < kNumPackedOpcodes * kNumPackedOpcodes; ++i) {
+    uint32_t count = counts[i].LoadRelaxed();
+    total += count;
+    if (count != 0u) {
+      pairs.emplace_back(count, i);
+    }
+  }
+  std::sort(pairs.begin(), pairs.end(), std::greater<std::pair<uint32_t, size_t>>());
+  // A handler can only be fused with one successor, keep the most frequent.
+  std::bitset<kNumPackedOpcodes> fused;
+  size_t num_pairs = 0;
+  os << "Mterp instruction pairs, " << total << " executed:\n";
+  for (size_t i = 0; i < pairs.size() && num_pairs < kMaxPairs; ++i) {
+    size_t first = pairs[i].second / kNumPackedOpcodes;
+    size_t second = pairs[i].second % kNumPackedOpcodes;
+    if (fused.test(first)) {
+      continue;
+    }
+    fused.set(first);
+    ++num_pairs;
+    os << "    # " << pairs[i].first << " (" << (pairs[i].first * 100.0 / total) << "%)\n"
+       << "    fuse " << HandlerName(static_cast<Instruction::Code>(first))
+       << " " << HandlerName(static_cast<Instruction::Code>(second)) << "\n";
+  }
 }
 
 /*
@@ -213,7 +271,7 @@ extern "C" size_t MterpInvokeVirtualRange(Thread* self,
     REQUIRES_SHARED(Locks::mutator_lock_) {
   JValue* result_register = shadow_frame->GetResultRegister();
   const Instruction* inst = Instruction::At(dex_pc_ptr);
-  return DoInvoke<kVirtual, true, false>(
+  return DoFastInvoke<kVirtual, /* is_range */ true>(
       self, *shadow_frame, inst, inst_data, result_register);
 }
 
@@ -246,7 +304,7 @@ extern "C" size_t MterpInvokeDirectRange(Thread* self,
     REQUIRES_SHARED(Locks::mutator_lock_) {
   JValue* result_register = shadow_frame->GetResultRegister();
   const Instruction* inst = Instruction::At(dex_pc_ptr);
-  return DoInvoke<kDirect, true, false>(
+  return DoFastInvoke<kDirect, /* is_range */ true>(
       self, *shadow_frame, inst, inst_data, result_register);
 }
 
@@ -257,7 +315,7 @@ extern "C" size_t MterpInvokeStaticRange(Thread* self,
     REQUIRES_SHARED(Locks::mutator_lock_) {
   JValue* result_register = shadow_frame->GetResultRegister();
   const Instruction* inst = Instruction::At(dex_pc_ptr);
-  return DoInvoke<kStatic, true, false>(
+  return DoFastInvoke<kStatic, /* is_range */ true>(
       self, *shadow_frame, inst, inst_data, result_register);
 }
 
@@ -297,6 +355,24 @@ extern "C" size_t MterpInvokeVirtualQuickRange(Thread* self,
     REQUIRES_SHARED(Locks::mutator_lock_) {
   JValue* result_register = shadow_frame->GetResultRegister();
   const Instruction* inst = Instruction::At(dex_pc_ptr);
+  const uint32_t vregC = inst->VRegC_3rc();
+  const uint32_t vtable_idx = inst->VRegB_3rc();
+  ObjPtr<mirror::Object> const receiver = shadow_frame->GetVRegReference(vregC);
+  if (receiver != nullptr) {
+    ArtMethod* const called_method = receiver->GetClass()->GetEmbeddedVTableEntry(
+        vtable_idx, kRuntimePointerSize);
+    if ((called_method != nullptr) && called_method->IsIntrinsic()) {
+      if (MterpHandleIntrinsic(shadow_frame, called_method, inst, inst_data, result_register)) {
+        jit::Jit* jit = Runtime::Current()->GetJit();
+        if (jit != nullptr) {
+          jit->InvokeVirtualOrInterface(
+              receiver, shadow_frame->GetMethod(), shadow_frame->GetDexPC(), called_method);
+          jit->AddSamples(self, shadow_frame->GetMethod(), 1, /*with_backedges*/false);
+        }
+        return !self->IsExceptionPending();
+      }
+    }
+  }
   return DoInvokeVirtualQuick<true>(
       self, *shadow_frame, inst, inst_data, result_register);
 }
@@ -515,6 +591,13 @@ extern "C" void MterpCheckBefore(Thread* self, ShadowFrame* shadow_frame, uint16
     uint32_t dex_pc = dex_pc_ptr - shadow_frame->GetCodeItem()->insns_;
     TraceExecution(*shadow_frame, inst, dex_pc);
   }
+  if (kProfileInstructionPairs) {
+    Instruction::Code opcode = inst->Opcode(inst_data);
+    if (CanFuseWithNext(opcode)) {
+      Instruction::Code next = inst->Next()->Opcode();
+      GetInstructionPairCounts()[opcode * kNumPackedOpcodes + next].FetchAndAddRelaxed(1u);
+    }
+  }
   if (kTestExportPC) {
     // Save invalid dex pc to force segfault if improperly used.
     shadow_frame->SetDexPCPtr(reinterpret_cast<uint16_t*>(kExportPCPoison));
@@ -687,6 +770,104 @@ extern "C" ssize_t artSetObjInstanceFromMterp(uint32_t field_idx,
   return -1;  // failure
 }
 
+// Slow path of the iget handlers with a fast path. Resolves the field through the interpreter
+// cache of the thread, so that the handler finds it there the next time the instruction runs.
+template <typename return_type, Primitive::Type primitive_type>
+ALWAYS_INLINE return_type MterpGetInstance(uint32_t field_idx,
+                                           mirror::Object* obj,
+                                           ShadowFrame* shadow_frame,
+                                           Thread* self,
+                                           return_type (ArtField::*func)(ObjPtr<mirror::Object>))
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return_type res = 0;  // On exception, the result will be ignored.
+  // The handler exported the dex pc.
+  const Instruction* inst = Instruction::At(shadow_frame->GetDexPCPtr());
+  StackHandleScope<1> hs(self);
+  HandleWrapper<mirror::Object> h(hs.NewHandleWrapper(&obj));
+  ArtField* f = FindFieldFromCodeCached<InstancePrimitiveRead, false>(
+      field_idx, *shadow_frame, inst, self, Primitive::ComponentSize(primitive_type));
+  if (LIKELY(f != nullptr)) {
+    if (UNLIKELY(h == nullptr)) {
+      ThrowNullPointerExceptionForFieldAccess(f, /* is_read */ true);
+    } else {
+      res = (f->*func)(h.Get());
+    }
+  }
+  return res;
+}
+
+extern "C" int32_t MterpGetBooleanInstance(uint32_t field_idx,
+                                           mirror::Object* obj,
+                                           ShadowFrame* shadow_frame,
+                                           Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return MterpGetInstance<uint8_t, Primitive::kPrimBoolean>(field_idx,
+                                                            obj,
+                                                            shadow_frame,
+                                                            self,
+                                                            &ArtField::GetBoolean);
+}
+
+extern "C" int32_t MterpGetByteInstance(uint32_t field_idx,
+                                        mirror::Object* obj,
+                                        ShadowFrame* shadow_frame,
+                                        Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return MterpGetInstance<int8_t, Primitive::kPrimByte>(field_idx,
+                                                        obj,
+                                                        shadow_frame,
+                                                        self,
+                                                        &ArtField::GetByte);
+}
+
+extern "C" uint32_t MterpGetCharInstance(uint32_t field_idx,
+                                         mirror::Object* obj,
+                                         ShadowFrame* shadow_frame,
+                                         Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return MterpGetInstance<uint16_t, Primitive::kPrimChar>(field_idx,
+                                                          obj,
+                                                          shadow_frame,
+                                                          self,
+                                                          &ArtField::GetChar);
+}
+
+extern "C" int32_t MterpGetShortInstance(uint32_t field_idx,
+                                         mirror::Object* obj,
+                                         ShadowFrame* shadow_frame,
+                                         Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return MterpGetInstance<int16_t, Primitive::kPrimShort>(field_idx,
+                                                          obj,
+                                                          shadow_frame,
+                                                          self,
+                                                          &ArtField::GetShort);
+}
+
+extern "C" int32_t MterpGet32Instance(uint32_t field_idx,
+                                      mirror::Object* obj,
+                                      ShadowFrame* shadow_frame,
+                                      Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return MterpGetInstance<int32_t, Primitive::kPrimInt>(field_idx,
+                                                        obj,
+                                                        shadow_frame,
+                                                        self,
+                                                        &ArtField::GetInt);
+}
+
+extern "C" int64_t MterpGet64Instance(uint32_t field_idx,
+                                      mirror::Object* obj,
+                                      ShadowFrame* shadow_frame,
+                                      Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  return MterpGetInstance<int64_t, Primitive::kPrimLong>(field_idx,
+                                                         obj,
+                                                         shadow_frame,
+                                                         self,
+                                                         &ArtField::GetLong);
+}
+
 template <typename return_type, Primitive::Type primitive_type>
 ALWAYS_INLINE return_type MterpGetStatic(uint32_t field_idx,
                                          ArtMethod* referrer,
@@ -17,6 +17,8 @@
 #ifndef ART_RUNTIME_INTERPRETER_MTERP_MTERP_H_
 #define ART_RUNTIME_INTERPRETER_MTERP_MTERP_H_
 
+#include <iosfwd>
+
 /*
  * Mterp assembly handler bases
  */
@@ -31,6 +33,10 @@ namespace interpreter {
 void InitMterpTls(Thread* self);
 void CheckMterpAsmConstants();
 
+// Prints the most frequent pairs of a non-branching instruction and its successor as "fuse" lines
+// of the config_* files, see README.txt. Requires kProfileInstructionPairs.
+void DumpInstructionPairProfile(std::ostream& os);
+
 // The return type should be 'bool' but our assembly stubs expect 'bool'
 // to be zero-extended to the whole register and that's broken on x86-64
 // as a 'bool' is returned in 'al' and the rest of 'rax' is garbage.
@@ -43,6 +49,10 @@ extern "C" size_t MterpShouldSwitchInterpreters();
 constexpr uintptr_t kExportPCPoison = 0xdead00ff;
 // Set true to enable poison testing of ExportPC.  Uses Alt interpreter.
 constexpr bool kTestExportPC = false;
+// Set true to count the instruction pairs executed by mterp, dumped on SIGQUIT. Uses Alt
+// interpreter. Fused handlers skip the Alt handler of their successor, so regenerate the fuse list
+// of the config_* files from an mterp built without one.
+constexpr bool kProfileInstructionPairs = false;
 
 }  // namespace interpreter
 }  // namespace art
@@ -35,6 +35,10 @@ void InitMterpTls(Thread* self) {
   self->SetMterpAltIBase(nullptr);
 }
 
+void DumpInstructionPairProfile(std::ostream& os ATTRIBUTE_UNUSED) {
+  // Dummy version when mterp not implemented.
+}
+
 /*
  * The platform-specific implementation must provide this.
  */
@@ -21,13 +21,16 @@
 #include "android-base/stringprintf.h"
 
 #include "art_method-inl.h"
-#include "base/dumpable.h"
+#include "base/dumpable-inl.h"
 #include "base/mutex.h"
 #include "base/stl_util.h"
 #include "base/systrace.h"
 #include "check_jni.h"
 #include "dex_file-inl.h"
 #include "fault_handler.h"
+#include "gc/collector/concurrent_copying.h"
+#include "gc/heap.h"
+#include "gc/reference_processor.h"
 #include "indirect_reference_table-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/class_loader.h"
@@ -49,7 +52,7 @@ namespace art {
 using android::base::StringAppendF;
 using android::base::StringAppendV;
 
-static constexpr size_t kGlobalsMax = 51200;  // Arbitrary sanity check. (Must fit in 16 bits.)
+static constexpr size_t kGlobalsMax = 51200;  // Arbitrary sanity check, over all stripes.
 
 static constexpr size_t kWeakGlobalsMax = 51200;  // Arbitrary sanity check. (Must fit in 16 bits.)
 
@@ -415,6 +418,30 @@ const JNIInvokeInterface gJniInvokeInterface = {
   JII::AttachCurrentThreadAsDaemon
 };
 
+// A stripe of the global reference table. A thread adds its global references to the stripe of
+// its thread id, so threads that create and delete global references at the same time mostly take
+// different locks, and the holes on the free list of a stripe are mostly the ones its threads
+// left. Deleting and updating a reference goes to the stripe encoded in it, decoding takes no lock.
+struct JavaVMExt::GlobalsStripe {
+  GlobalsStripe(uint32_t stripe, std::string* error_msg)
+      : lock("JNI global reference table lock", kJniGlobalsLock),
+        table(kGlobalsMax / kGlobalsStripes,
+              kGlobal,
+              IndirectReferenceTable::ResizableCapacity::kYes,
+              error_msg,
+              stripe,
+              kGlobalsStripeBits),
+        num_refs(0u) {}
+
+  Mutex lock;
+  // Growing the table adds a chunk and does not move the existing entries, so that it is safe
+  // with the unlocked decodes of other threads.
+  IndirectReferenceTable table;
+  // The number of live references. Only written with the lock held, read without it to apply
+  // kGlobalsMax to all stripes together.
+  Atomic<size_t> num_refs;
+};
+
 JavaVMExt::JavaVMExt(Runtime* runtime,
                      const RuntimeArgumentMap& runtime_options,
                      std::string* error_msg)
@@ -426,7 +453,6 @@ JavaVMExt::JavaVMExt(Runtime* runtime,
       tracing_enabled_(runtime_options.Exists(RuntimeArgumentMap::JniTrace)
                        || VLOG_IS_ON(third_party_jni)),
       trace_(runtime_options.GetOrDefault(RuntimeArgumentMap::JniTrace)),
-      globals_(kGlobalsMax, kGlobal, IndirectReferenceTable::ResizableCapacity::kNo, error_msg),
       libraries_(new Libraries),
       unchecked_functions_(&gJniInvokeInterface),
       weak_globals_(kWeakGlobalsMax,
@@ -438,6 +464,9 @@ JavaVMExt::JavaVMExt(Runtime* runtime,
                                   (CHECK(Locks::jni_weak_globals_lock_ != nullptr),
                                    *Locks::jni_weak_globals_lock_)),
       env_hooks_() {
+  for (size_t i = 0; i != kGlobalsStripes; ++i) {
+    globals_[i].reset(new GlobalsStripe(i, error_msg));
+  }
   functions = unchecked_functions_;
   SetCheckJniEnabled(runtime_options.Exists(RuntimeArgumentMap::CheckJni));
 }
@@ -452,10 +481,15 @@ std::unique_ptr<JavaVMExt> JavaVMExt::Create(Runtime* runtime,
                                              const RuntimeArgumentMap& runtime_options,
                                              std::string* error_msg) NO_THREAD_SAFETY_ANALYSIS {
   std::unique_ptr<JavaVMExt> java_vm(new JavaVMExt(runtime, runtime_options, error_msg));
-  if (java_vm && java_vm->globals_.IsValid() && java_vm->weak_globals_.IsValid()) {
-    return java_vm;
+  if (java_vm == nullptr || !java_vm->weak_globals_.IsValid()) {
+    return nullptr;
   }
-  return nullptr;
+  for (const std::unique_ptr<GlobalsStripe>& stripe : java_vm->globals_) {
+    if (!stripe->table.IsValid()) {
+      return nullptr;
+    }
+  }
+  return java_vm;
 }
 
 jint JavaVMExt::HandleGetEnv(/*out*/void** env, jint version) {
@@ -552,13 +586,31 @@ bool JavaVMExt::ShouldTrace(ArtMethod* method) {
   return true;
 }
 
+size_t JavaVMExt::CountGlobals() const {
+  size_t count = 0u;
+  for (const std::unique_ptr<GlobalsStripe>& stripe : globals_) {
+    count += stripe->num_refs.LoadRelaxed();
+  }
+  return count;
+}
+
 jobject JavaVMExt::AddGlobalRef(Thread* self, ObjPtr<mirror::Object> obj) {
   // Check for null after decoding the object to handle cleared weak globals.
   if (obj == nullptr) {
     return nullptr;
   }
-  WriterMutexLock mu(self, *Locks::jni_globals_lock_);
-  IndirectRef ref = globals_.Add(kIRTFirstSegment, obj);
+  GlobalsStripe* stripe = globals_[self->GetThreadId() & (kGlobalsStripes - 1u)].get();
+  MutexLock mu(self, stripe->lock);
+  const size_t num_refs = stripe->num_refs.LoadRelaxed();
+  // Only count the other stripes once this one holds more than its share.
+  if (UNLIKELY(num_refs >= kGlobalsMax / kGlobalsStripes) && CountGlobals() >= kGlobalsMax) {
+    LOG(FATAL) << "JNI ERROR (app bug): global reference table overflow "
+               << "(max=" << kGlobalsMax << ")\n"
+               << MutatorLockedDumpable<IndirectReferenceTable>(stripe->table);
+    UNREACHABLE();
+  }
+  IndirectRef ref = stripe->table.Add(kIRTFirstSegment, obj);
+  stripe->num_refs.StoreRelaxed(num_refs + 1u);
   return reinterpret_cast<jobject>(ref);
 }
 
@@ -584,10 +636,14 @@ void JavaVMExt::DeleteGlobalRef(Thread* self, jobject obj) {
   if (obj == nullptr) {
     return;
   }
-  WriterMutexLock mu(self, *Locks::jni_globals_lock_);
-  if (!globals_.Remove(kIRTFirstSegment, obj)) {
+  GlobalsStripe* stripe = GetGlobalsStripe(obj);
+  MutexLock mu(self, stripe->lock);
+  if (!stripe->table.Remove(kIRTFirstSegment, obj)) {
     LOG(WARNING) << "JNI WARNING: DeleteGlobalRef(" << obj << ") "
                  << "failed to find entry";
+  } else if (IndirectReferenceTable::GetIndirectRefKind(obj) == kGlobal) {
+    // Remove also succeeds for references in a handle scope, without removing anything.
+    stripe->num_refs.StoreRelaxed(stripe->num_refs.LoadRelaxed() - 1u);
   }
 }
 
@@ -622,10 +678,12 @@ void JavaVMExt::DumpForSigQuit(std::ostream& os) {
     os << " (with forcecopy)";
   }
   Thread* self = Thread::Current();
-  {
-    ReaderMutexLock mu(self, *Locks::jni_globals_lock_);
-    os << "; globals=" << globals_.Capacity();
+  size_t globals_capacity = 0u;
+  for (const std::unique_ptr<GlobalsStripe>& stripe : globals_) {
+    MutexLock mu(self, stripe->lock);
+    globals_capacity += stripe->table.Capacity();
   }
+  os << "; globals=" << globals_capacity;
   {
     MutexLock mu(self, *Locks::jni_weak_globals_lock_);
     if (weak_globals_.Capacity() > 0) {
@@ -666,12 +724,13 @@ void JavaVMExt::BroadcastForNewWeakGlobals() {
 }
 
 ObjPtr<mirror::Object> JavaVMExt::DecodeGlobal(IndirectRef ref) {
-  return globals_.SynchronizedGet(ref);
+  return GetGlobalsStripe(ref)->table.SynchronizedGet(ref);
 }
 
 void JavaVMExt::UpdateGlobal(Thread* self, IndirectRef ref, ObjPtr<mirror::Object> result) {
-  WriterMutexLock mu(self, *Locks::jni_globals_lock_);
-  globals_.Update(ref, result);
+  GlobalsStripe* stripe = GetGlobalsStripe(ref);
+  MutexLock mu(self, stripe->lock);
+  stripe->table.Update(ref, result);
 }
 
 inline bool JavaVMExt::MayAccessWeakGlobals(Thread* self) const {
@@ -696,10 +755,44 @@ ObjPtr<mirror::Object> JavaVMExt::DecodeWeakGlobal(Thread* self, IndirectRef ref
   if (LIKELY(MayAccessWeakGlobalsUnlocked(self))) {
     return weak_globals_.SynchronizedGet(ref);
   }
+  if (kUseReadBarrier) {
+    ObjPtr<mirror::Object> marked = DecodeMarkedWeakGlobal(self, ref);
+    if (marked != nullptr) {
+      return marked;
+    }
+  }
   MutexLock mu(self, *Locks::jni_weak_globals_lock_);
   return DecodeWeakGlobalLocked(self, ref);
 }
 
+ObjPtr<mirror::Object> JavaVMExt::DecodeMarkedWeakGlobal(Thread* self, IndirectRef ref) {
+  DCHECK(kUseReadBarrier);
+  // Under CC, weak ref access is disabled while the collector processes references, and a decode
+  // with a read barrier could push the referent onto the mark stack and interfere with the
+  // termination of marking. Without a read barrier we only get the from-space reference, but if
+  // the collector already marked it the object stays alive and it returns the to-space reference.
+  // Sweeping only clears entries of unmarked objects.
+  gc::Heap* heap = Runtime::Current()->GetHeap();
+  gc::collector::ConcurrentCopying* collector = heap->ConcurrentCopyingCollector();
+  if (collector == nullptr) {
+    return nullptr;
+  }
+  // While references are preserved, an object may be marked only because it is reachable from a
+  // finalizer referent, and handing it out could let the mutator store it into an object that
+  // gets swept, see ReferenceProcessor::GetReferent(). Weak globals have no reference state to
+  // tell such objects apart, so they wait. Holding the lock keeps the collector from starting to
+  // preserve references before we are done.
+  MutexLock mu(self, *Locks::reference_processor_lock_);
+  if (heap->GetReferenceProcessor()->IsPreservingReferences()) {
+    return nullptr;
+  }
+  ObjPtr<mirror::Object> obj = weak_globals_.SynchronizedGet<kWithoutReadBarrier>(ref);
+  if (obj == nullptr) {
+    return nullptr;
+  }
+  return collector->IsMarked(obj.Ptr());
+}
+
 ObjPtr<mirror::Object> JavaVMExt::DecodeWeakGlobalLocked(Thread* self, IndirectRef ref) {
   if (kDebugLocking) {
     Locks::jni_weak_globals_lock_->AssertHeld(self);
@@ -749,9 +842,9 @@ void JavaVMExt::UpdateWeakGlobal(Thread* self, IndirectRef ref, ObjPtr<mirror::O
 
 void JavaVMExt::DumpReferenceTables(std::ostream& os) {
   Thread* self = Thread::Current();
-  {
-    ReaderMutexLock mu(self, *Locks::jni_globals_lock_);
-    globals_.Dump(os);
+  for (const std::unique_ptr<GlobalsStripe>& stripe : globals_) {
+    MutexLock mu(self, stripe->lock);
+    stripe->table.Dump(os);
   }
   {
     MutexLock mu(self, *Locks::jni_weak_globals_lock_);
@@ -992,14 +1085,19 @@ void JavaVMExt::SweepJniWeakGlobals(IsMarkedVisitor* visitor) {
 }
 
 void JavaVMExt::TrimGlobals() {
-  WriterMutexLock mu(Thread::Current(), *Locks::jni_globals_lock_);
-  globals_.Trim();
+  Thread* self = Thread::Current();
+  for (const std::unique_ptr<GlobalsStripe>& stripe : globals_) {
+    MutexLock mu(self, stripe->lock);
+    stripe->table.Trim();
+  }
 }
 
 void JavaVMExt::VisitRoots(RootVisitor* visitor) {
   Thread* self = Thread::Current();
-  ReaderMutexLock mu(self, *Locks::jni_globals_lock_);
-  globals_.VisitRoots(visitor, RootInfo(kRootJNIGlobal));
+  for (const std::unique_ptr<GlobalsStripe>& stripe : globals_) {
+    MutexLock mu(self, stripe->lock);
+    stripe->table.VisitRoots(visitor, RootInfo(kRootJNIGlobal));
+  }
   // The weak_globals table is visited by the GC itself (because it mutates the table).
 }
 
@@ -116,18 +116,15 @@ class JavaVMExt : public JavaVM {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   void DumpForSigQuit(std::ostream& os)
-      REQUIRES(!Locks::jni_libraries_lock_,
-               !Locks::jni_globals_lock_,
-               !Locks::jni_weak_globals_lock_);
+      REQUIRES(!Locks::jni_libraries_lock_, !Locks::jni_weak_globals_lock_);
 
   void DumpReferenceTables(std::ostream& os)
       REQUIRES_SHARED(Locks::mutator_lock_)
-      REQUIRES(!Locks::jni_globals_lock_, !Locks::jni_weak_globals_lock_);
+      REQUIRES(!Locks::jni_weak_globals_lock_);
 
   bool SetCheckJniEnabled(bool enabled);
 
-  void VisitRoots(RootVisitor* visitor) REQUIRES_SHARED(Locks::mutator_lock_)
-      REQUIRES(!Locks::jni_globals_lock_);
+  void VisitRoots(RootVisitor* visitor) REQUIRES_SHARED(Locks::mutator_lock_);
 
   void DisallowNewWeakGlobals()
       REQUIRES_SHARED(Locks::mutator_lock_)
@@ -139,14 +136,13 @@ class JavaVMExt : public JavaVM {
       REQUIRES(!Locks::jni_weak_globals_lock_);
 
   jobject AddGlobalRef(Thread* self, ObjPtr<mirror::Object> obj)
-      REQUIRES_SHARED(Locks::mutator_lock_)
-      REQUIRES(!Locks::jni_globals_lock_);
+      REQUIRES_SHARED(Locks::mutator_lock_);
 
   jweak AddWeakGlobalRef(Thread* self, ObjPtr<mirror::Object> obj)
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!Locks::jni_weak_globals_lock_);
 
-  void DeleteGlobalRef(Thread* self, jobject obj) REQUIRES(!Locks::jni_globals_lock_);
+  void DeleteGlobalRef(Thread* self, jobject obj);
 
   void DeleteWeakGlobalRef(Thread* self, jweak obj) REQUIRES(!Locks::jni_weak_globals_lock_);
 
@@ -158,12 +154,11 @@ class JavaVMExt : public JavaVM {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
   void UpdateGlobal(Thread* self, IndirectRef ref, ObjPtr<mirror::Object> result)
-      REQUIRES_SHARED(Locks::mutator_lock_)
-      REQUIRES(!Locks::jni_globals_lock_);
+      REQUIRES_SHARED(Locks::mutator_lock_);
 
   ObjPtr<mirror::Object> DecodeWeakGlobal(Thread* self, IndirectRef ref)
       REQUIRES_SHARED(Locks::mutator_lock_)
-      REQUIRES(!Locks::jni_weak_globals_lock_);
+      REQUIRES(!Locks::jni_weak_globals_lock_, !Locks::reference_processor_lock_);
 
   ObjPtr<mirror::Object> DecodeWeakGlobalLocked(Thread* self, IndirectRef ref)
       REQUIRES_SHARED(Locks::mutator_lock_)
@@ -188,8 +183,7 @@ class JavaVMExt : public JavaVM {
     return unchecked_functions_;
   }
 
-  void TrimGlobals() REQUIRES_SHARED(Locks::mutator_lock_)
-      REQUIRES(!Locks::jni_globals_lock_);
+  void TrimGlobals() REQUIRES_SHARED(Locks::mutator_lock_);
 
   jint HandleGetEnv(/*out*/void** env, jint version);
 
@@ -208,6 +202,26 @@ class JavaVMExt : public JavaVM {
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(Locks::jni_weak_globals_lock_);
 
+  // Returns the object of a weak global while the CC collector has weak ref access disabled, if
+  // the collector has already marked it and is not preserving references. Returns null if the
+  // caller has to wait.
+  ObjPtr<mirror::Object> DecodeMarkedWeakGlobal(Thread* self, IndirectRef ref)
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!Locks::reference_processor_lock_);
+
+  // The global references are spread over kGlobalsStripes tables, see GlobalsStripe.
+  static constexpr size_t kGlobalsStripeBits = 3u;
+  static constexpr size_t kGlobalsStripes = 1u << kGlobalsStripeBits;
+  struct GlobalsStripe;
+
+  GlobalsStripe* GetGlobalsStripe(IndirectRef ref) const {
+    return globals_[IndirectReferenceTable::ExtractStripe(ref, kGlobalsStripeBits)].get();
+  }
+
+  // Returns the number of global references over all stripes. Not exact while other threads add
+  // or delete global references.
+  size_t CountGlobals() const;
+
   Runtime* const runtime_;
 
   // Used for testing. By default, we'll LOG(FATAL) the reason.
@@ -222,8 +236,9 @@ class JavaVMExt : public JavaVM {
   // Extra diagnostics.
   const std::string trace_;
 
-  // Not guarded by globals_lock since we sometimes use SynchronizedGet in Thread::DecodeJObject.
-  IndirectReferenceTable globals_;
+  // Not guarded by the stripe locks since we sometimes use SynchronizedGet in
+  // Thread::DecodeJObject.
+  std::unique_ptr<GlobalsStripe> globals_[kGlobalsStripes];
 
   // No lock annotation since UnloadNativeLibraries is called on libraries_ but locks the
   // jni_libraries_lock_ internally.
@@ -615,7 +615,7 @@ void Jit::AddSamples(Thread* self, ArtMethod* method, uint16_t count, bool with_
     return;
   }
 
-  if (method->IsClassInitializer() || method->IsNative() || !method->IsCompilable()) {
+  if (method->IsClassInitializer() || !method->IsCompilable()) {
     // We do not want to compile such methods.
     return;
   }
@@ -632,7 +632,10 @@ void Jit::AddSamples(Thread* self, ArtMethod* method, uint16_t count, bool with_
   }
   int32_t new_count = starting_count + count;   // int32 here to avoid wrap-around;
   if (starting_count < warm_method_threshold_) {
+    // Native methods are only sampled by the GenericJNI trampoline and get a JNI stub, which
+    // needs no ProfilingInfo.
     if ((new_count >= warm_method_threshold_) &&
+        !method->IsNative() &&
         (method->GetProfilingInfo(kRuntimePointerSize) == nullptr)) {
       bool success = ProfilingInfo::Create(self, method, /* retry_allocation */ false);
       if (success) {
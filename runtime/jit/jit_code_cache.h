@@ -19,6 +19,8 @@
 
 #include "instrumentation.h"
 
+#include <set>
+
 #include "atomic.h"
 #include "base/arena_containers.h"
 #include "base/histogram-inl.h"
@@ -166,6 +168,11 @@ class JitCodeCache {
       REQUIRES(!lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Return the code of a JIT-compiled JNI stub of the native 'method', or null if there is none.
+  const void* GetJniStubCode(ArtMethod* method)
+      REQUIRES(!lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   OatQuickMethodHeader* LookupOsrMethodHeader(ArtMethod* method)
       REQUIRES(!lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
@@ -347,6 +354,8 @@ class JitCodeCache {
   SafeMap<const void*, ArtMethod*> method_code_map_ GUARDED_BY(lock_);
   // Holds osr compiled code associated to the ArtMethod.
   SafeMap<ArtMethod*, const void*> osr_code_map_ GUARDED_BY(lock_);
+  // Native methods whose JNI stub is being compiled, they have no ProfilingInfo to record it.
+  std::set<ArtMethod*> jni_stubs_being_compiled_ GUARDED_BY(lock_);
   // ProfilingInfo objects we have allocated.
   std::vector<ProfilingInfo*> profiling_infos_ GUARDED_BY(lock_);
 
@@ -1320,6 +1320,8 @@ jvmtiError Redefiner::Run() {
     redef.UpdateClass(klass, data.GetNewDexCache(), data.GetOriginalDexFile());
   }
   RestoreObsoleteMethodMapsIfUnneeded(holder);
+  // The interpreter caches may hold the old fields and methods of the redefined classes.
+  art::Thread::ClearAllInterpreterCaches();
   // TODO We should check for if any of the redefined methods are intrinsic methods here and, if any
   // are, force a full-world deoptimization before finishing redefinition. If we don't do this then
   // methods that have been jitted prior to the current redefinition being applied might continue
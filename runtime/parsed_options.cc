@@ -21,6 +21,7 @@
 #include "base/stringpiece.h"
 #include "debugger.h"
 #include "gc/heap.h"
+#include "gc/space/region_space.h"
 #include "monitor.h"
 #include "runtime.h"
 #include "ti/agent.h"
@@ -227,6 +228,29 @@ std::unique_ptr<RuntimeParser> ParsedOptions::MakeParser(bool ignore_unrecognize
       .Define("-XX:LargeObjectThreshold=_")
           .WithType<Memory<1>>()
           .IntoKey(M::LargeObjectThreshold)
+      .Define("-XX:RegionSize=_")
+          .WithType<Memory<1>>()
+          .IntoKey(M::RegionSize)
+      .Define("-XX:RegionEvacuationLimit=_")
+          .WithType<Memory<1>>()
+          .IntoKey(M::RegionEvacuationLimit)
+      .Define("-XX:HeapTrimBatchSize=_")
+          .WithType<Memory<1>>()
+          .IntoKey(M::HeapTrimBatchSize)
+      .Define("-XX:HeapTrimRate=_")
+          .WithType<unsigned int>()
+          .IntoKey(M::HeapTrimRate)
+      .Define("-XX:RosAllocThreadLocalBracketSize=_")
+          .WithType<Memory<1>>()
+          .IntoKey(M::RosAllocThreadLocalBracketSize)
+      .Define("-XX:GcPauseTarget=_")  // in ms
+          .WithType<MillisecondsToNanoseconds>()  // store as ns
+          .IntoKey(M::GcPauseTarget)
+      .Define("-XX:GcMaxCpuFraction=_")
+          .WithType<double>().WithRange(0.0, 0.9)
+          .IntoKey(M::GcMaxCpuFraction)
+      .Define("-XX:+NumaAwareRegionSpace")
+          .IntoKey(M::NumaAwareRegionSpace)
       .Define("-XX:BackgroundGC=_")
           .WithType<BackgroundGcOption>()
           .IntoKey(M::BackgroundGc)
@@ -490,6 +514,21 @@ bool ParsedOptions::DoParse(const RuntimeOptions& options,
     Exit(0);
   }
 
+  const size_t region_size = args.GetOrDefault(M::RegionSize);
+  if (!IsPowerOfTwo(region_size) ||
+      !IsAligned<kPageSize>(region_size) ||
+      region_size < gc::space::RegionSpace::kMinRegionSize) {
+    Usage("-XX:RegionSize=%zu must be a page aligned power of two of at least %zu bytes\n",
+          region_size,
+          gc::space::RegionSpace::kMinRegionSize);
+    return false;
+  }
+  if (kUseTableLookupReadBarrier && region_size != gc::space::RegionSpace::kDefaultRegionSize) {
+    // The read barrier table is sized for the default region size.
+    Usage("-XX:RegionSize cannot be changed with the table lookup read barrier\n");
+    return false;
+  }
+
   // Set a default boot class path if we didn't get an explicit one via command line.
   if (getenv("BOOTCLASSPATH") != nullptr) {
     args.SetIfMissing(M::BootClassPath, std::string(getenv("BOOTCLASSPATH")));
@@ -700,6 +739,14 @@ void ParsedOptions::Usage(const char* fmt, ...) {
   UsageMessage(stream, "  -XX:BackgroundGC=none\n");
   UsageMessage(stream, "  -XX:LargeObjectSpace={disabled,map,freelist}\n");
   UsageMessage(stream, "  -XX:LargeObjectThreshold=N\n");
+  UsageMessage(stream, "  -XX:RegionSize=N\n");
+  UsageMessage(stream, "  -XX:RegionEvacuationLimit=N\n");
+  UsageMessage(stream, "  -XX:HeapTrimBatchSize=N\n");
+  UsageMessage(stream, "  -XX:HeapTrimRate=integervalue\n");
+  UsageMessage(stream, "  -XX:RosAllocThreadLocalBracketSize=N\n");
+  UsageMessage(stream, "  -XX:GcPauseTarget=integervalue\n");
+  UsageMessage(stream, "  -XX:GcMaxCpuFraction=doublevalue\n");
+  UsageMessage(stream, "  -XX:+NumaAwareRegionSpace\n");
   UsageMessage(stream, "  -XX:DumpNativeStackOnSigQuit=booleanvalue\n");
   UsageMessage(stream, "  -Xmethod-trace\n");
   UsageMessage(stream, "  -Xmethod-trace-file:filename");
@@ -127,6 +127,27 @@ TEST_F(ParsedOptionsTest, ParsedOptionsGc) {
   EXPECT_EQ(gc::kCollectorTypeMC, xgc.collector_type_);
 }
 
+TEST_F(ParsedOptionsTest, ParsedOptionsRegionSize) {
+  using Opt = RuntimeArgumentMap;
+  {
+    RuntimeOptions options;
+    options.push_back(std::make_pair("-XX:RegionSize=256K", nullptr));
+    RuntimeArgumentMap map;
+    ASSERT_TRUE(ParsedOptions::Parse(options, false, &map));
+    EXPECT_EQ(256 * KB, map.GetOrDefault(Opt::RegionSize));
+  }
+  // Not a power of two, not page aligned, or too small for a TLAB.
+  static const char* const kInvalidRegionSizes[] = {
+      "-XX:RegionSize=384K", "-XX:RegionSize=1000", "-XX:RegionSize=4K",
+  };
+  for (const char* option : kInvalidRegionSizes) {
+    RuntimeOptions options;
+    options.push_back(std::make_pair(option, nullptr));
+    RuntimeArgumentMap map;
+    EXPECT_FALSE(ParsedOptions::Parse(options, false, &map)) << option;
+  }
+}
+
 TEST_F(ParsedOptionsTest, ParsedOptionsInstructionSet) {
   using Opt = RuntimeArgumentMap;
 
@@ -83,6 +83,7 @@
 #include "instrumentation.h"
 #include "intern_table.h"
 #include "interpreter/interpreter.h"
+#include "interpreter/mterp/mterp.h"
 #include "java_vm_ext.h"
 #include "jit/jit.h"
 #include "jit/jit_code_cache.h"
@@ -1103,6 +1104,14 @@ bool Runtime::Init(RuntimeArgumentMap&& runtime_options_in) {
                                        : runtime_options.GetOrDefault(Opt::BackgroundGc),
                        runtime_options.GetOrDefault(Opt::LargeObjectSpace),
                        runtime_options.GetOrDefault(Opt::LargeObjectThreshold),
+                       runtime_options.GetOrDefault(Opt::RegionSize),
+                       runtime_options.GetOrDefault(Opt::RegionEvacuationLimit),
+                       runtime_options.GetOrDefault(Opt::HeapTrimBatchSize),
+                       runtime_options.GetOrDefault(Opt::HeapTrimRate) * MB,
+                       runtime_options.GetOrDefault(Opt::RosAllocThreadLocalBracketSize),
+                       runtime_options.GetOrDefault(Opt::GcPauseTarget),
+                       runtime_options.GetOrDefault(Opt::GcMaxCpuFraction),
+                       runtime_options.Exists(Opt::NumaAwareRegionSpace),
                        runtime_options.GetOrDefault(Opt::ParallelGCThreads),
                        runtime_options.GetOrDefault(Opt::ConcGCThreads),
                        runtime_options.Exists(Opt::LowMemoryMode),
@@ -1596,6 +1605,9 @@ void Runtime::DumpForSigQuit(std::ostream& os) {
     os << "Running non JIT\n";
   }
   DumpDeoptimizations(os);
+  if (interpreter::kProfileInstructionPairs) {
+    interpreter::DumpInstructionPairProfile(os);
+  }
   TrackedAllocators::Dump(os);
   os << "\n";
 
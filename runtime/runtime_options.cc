@@ -19,6 +19,7 @@
 #include <memory>
 
 #include "gc/heap.h"
+#include "gc/space/region_space.h"
 #include "monitor.h"
 #include "runtime.h"
 #include "thread_list.h"
@@ -778,12 +778,9 @@ QuickMethodFrameInfo StackVisitor::GetCurrentQuickFrameInfo() const {
     return runtime->GetCalleeSaveMethodFrameInfo(Runtime::kSaveRefsAndArgs);
   }
 
-  // The only remaining case is if the method is native and uses the generic JNI stub.
+  // The only remaining case is if the method is native and uses the generic JNI stub. The
+  // entrypoint may since have been replaced by a JIT-compiled JNI stub, so it is not checked.
   DCHECK(method->IsNative());
-  ClassLinker* class_linker = runtime->GetClassLinker();
-  const void* entry_point = runtime->GetInstrumentation()->GetQuickCodeFor(method,
-                                                                           kRuntimePointerSize);
-  DCHECK(class_linker->IsQuickGenericJniStub(entry_point)) << method->PrettyMethod();
   // Generic JNI frame.
   uint32_t handle_refs = GetNumberOfReferenceArgsWithoutReceiver(method) + 1;
   size_t scope_size = HandleScope::SizeOf(handle_refs);
@@ -798,6 +795,30 @@ QuickMethodFrameInfo StackVisitor::GetCurrentQuickFrameInfo() const {
   return QuickMethodFrameInfo(frame_size, callee_info.CoreSpillMask(), callee_info.FpSpillMask());
 }
 
+// Returns the header of the compiled JNI stub of a native method at the top of a fragment that
+// was not entered through the GenericJNI trampoline.
+static const OatQuickMethodHeader* GetNativeMethodHeader(ArtMethod* method)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  Runtime* runtime = Runtime::Current();
+  ClassLinker* class_linker = runtime->GetClassLinker();
+  const void* entry_point = method->GetEntryPointFromQuickCompiledCode();
+  CHECK(entry_point != nullptr) << method->PrettyMethod();
+  if (!class_linker->IsQuickGenericJniStub(entry_point) &&
+      !class_linker->IsQuickResolutionStub(entry_point) &&
+      entry_point != GetQuickInstrumentationEntryPoint()) {
+    return OatQuickMethodHeader::FromEntryPoint(entry_point);
+  }
+  const void* code = method->GetOatMethodQuickCode(class_linker->GetImagePointerSize());
+  if (code != nullptr) {
+    return OatQuickMethodHeader::FromEntryPoint(code);
+  }
+  // The entrypoint no longer points to the JIT-compiled JNI stub that is running.
+  CHECK(runtime->GetJit() != nullptr) << method->PrettyMethod();
+  code = runtime->GetJit()->GetCodeCache()->GetJniStubCode(method);
+  CHECK(code != nullptr) << method->PrettyMethod();
+  return OatQuickMethodHeader::FromCodePointer(code);
+}
+
 template <StackVisitor::CountTransitions kCount>
 void StackVisitor::WalkStack(bool include_transitions) {
   if (check_suspended_) {
@@ -819,8 +840,21 @@ void StackVisitor::WalkStack(bool include_transitions) {
       // Can't be both a shadow and a quick fragment.
       DCHECK(current_fragment->GetTopShadowFrame() == nullptr);
       ArtMethod* method = *cur_quick_frame_;
+      bool header_retrieved = false;
+      if (method != nullptr && method->IsNative()) {
+        // There is no pc for the first frame, so ArtMethod::GetOatQuickMethodHeader() cannot tell
+        // a GenericJNI frame from a JIT-compiled JNI stub frame, the entrypoint may have changed
+        // since the frame was entered. The GenericJNI trampoline tags the top quick frame.
+        cur_oat_quick_method_header_ = current_fragment->GetTopQuickFrameTag()
+            ? nullptr
+            : GetNativeMethodHeader(method);
+        header_retrieved = true;
+      }
       while (method != nullptr) {
-        cur_oat_quick_method_header_ = method->GetOatQuickMethodHeader(cur_quick_frame_pc_);
+        if (!header_retrieved) {
+          cur_oat_quick_method_header_ = method->GetOatQuickMethodHeader(cur_quick_frame_pc_);
+        }
+        header_retrieved = false;  // Force header retrieval in next iteration.
         SanityCheckFrame();
 
         if ((walk_kind_ == StackWalkKind::kIncludeInlinedFrames)
@@ -21,6 +21,7 @@
 #include <string>
 
 #include "arch/instruction_set.h"
+#include "base/bit_utils.h"
 #include "base/macros.h"
 #include "base/mutex.h"
 #include "dex_file.h"
@@ -519,7 +520,7 @@ class JavaFrameRootInfo FINAL : public RootInfo {
 class PACKED(4) ManagedStack {
  public:
   ManagedStack()
-      : top_quick_frame_(nullptr), link_(nullptr), top_shadow_frame_(nullptr) {}
+      : tagged_top_quick_frame_(0u), link_(nullptr), top_shadow_frame_(nullptr) {}
 
   void PushManagedStackFragment(ManagedStack* fragment) {
     // Copy this top fragment into given fragment.
@@ -541,20 +542,34 @@ class PACKED(4) ManagedStack {
   }
 
   ArtMethod** GetTopQuickFrame() const {
-    return top_quick_frame_;
+    return reinterpret_cast<ArtMethod**>(tagged_top_quick_frame_ & ~static_cast<uintptr_t>(1u));
+  }
+
+  // The GenericJNI trampoline tags the top quick frame with the low bit, the frame then has no
+  // OatQuickMethodHeader even if the entrypoint of the native method has since been replaced by
+  // a JIT-compiled JNI stub.
+  bool GetTopQuickFrameTag() const {
+    return (tagged_top_quick_frame_ & 1u) != 0u;
   }
 
   void SetTopQuickFrame(ArtMethod** top) {
     DCHECK(top_shadow_frame_ == nullptr);
-    top_quick_frame_ = top;
+    DCHECK_ALIGNED(top, 4u);
+    tagged_top_quick_frame_ = reinterpret_cast<uintptr_t>(top);
+  }
+
+  void SetTopQuickFrameTagged(ArtMethod** top) {
+    DCHECK(top_shadow_frame_ == nullptr);
+    DCHECK_ALIGNED(top, 4u);
+    tagged_top_quick_frame_ = reinterpret_cast<uintptr_t>(top) | 1u;
   }
 
   static size_t TopQuickFrameOffset() {
-    return OFFSETOF_MEMBER(ManagedStack, top_quick_frame_);
+    return OFFSETOF_MEMBER(ManagedStack, tagged_top_quick_frame_);
   }
 
   ShadowFrame* PushShadowFrame(ShadowFrame* new_top_frame) {
-    DCHECK(top_quick_frame_ == nullptr);
+    DCHECK_EQ(tagged_top_quick_frame_, 0u);
     ShadowFrame* old_frame = top_shadow_frame_;
     top_shadow_frame_ = new_top_frame;
     new_top_frame->SetLink(old_frame);
@@ -562,7 +577,7 @@ class PACKED(4) ManagedStack {
   }
 
   ShadowFrame* PopShadowFrame() {
-    DCHECK(top_quick_frame_ == nullptr);
+    DCHECK_EQ(tagged_top_quick_frame_, 0u);
     CHECK(top_shadow_frame_ != nullptr);
     ShadowFrame* frame = top_shadow_frame_;
     top_shadow_frame_ = frame->GetLink();
@@ -574,7 +589,7 @@ class PACKED(4) ManagedStack {
   }
 
   void SetTopShadowFrame(ShadowFrame* top) {
-    DCHECK(top_quick_frame_ == nullptr);
+    DCHECK_EQ(tagged_top_quick_frame_, 0u);
     top_shadow_frame_ = top;
   }
 
@@ -587,7 +602,8 @@ class PACKED(4) ManagedStack {
   bool ShadowFramesContain(StackReference<mirror::Object>* shadow_frame_entry) const;
 
  private:
-  ArtMethod** top_quick_frame_;
+  // The top quick frame, with the GenericJNI tag in the low bit.
+  uintptr_t tagged_top_quick_frame_;
   ManagedStack* link_;
   ShadowFrame* top_shadow_frame_;
 };
@@ -27,6 +27,16 @@ namespace art {
 constexpr size_t DexRegisterLocationCatalog::kNoLocationEntryIndex;
 constexpr uint32_t StackMap::kNoDexRegisterMap;
 constexpr uint32_t StackMap::kNoInlineInfo;
+constexpr size_t StackMapLookupCache::kMinStackMaps;
+constexpr size_t StackMapLookupCache::kSize;
+
+Atomic<uint64_t> StackMapLookupCache::entries_[StackMapLookupCache::kSize];
+
+void StackMapLookupCache::Clear() {
+  for (Atomic<uint64_t>& entry : entries_) {
+    entry.StoreRelaxed(0u);
+  }
+}
 
 std::ostream& operator<<(std::ostream& stream, const DexRegisterLocation::Kind& kind) {
   using Kind = DexRegisterLocation::Kind;
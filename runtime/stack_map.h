@@ -18,6 +18,7 @@
 #define ART_RUNTIME_STACK_MAP_H_
 
 #include "arch/code_offset.h"
+#include "atomic.h"
 #include "base/bit_vector.h"
 #include "base/bit_utils.h"
 #include "bit_memory_region.h"
@@ -1337,6 +1338,67 @@ struct CodeInfoEncoding {
   uint32_t cache_non_header_size = kInvalidSize;
 };
 
+// Global direct-mapped cache from a (CodeInfo, native pc offset) pair to the index of its stack
+// map. Stack walks of exception-heavy code, Thread.getStackTrace, sampling profilers and GC root
+// visiting look up the same return addresses again and again, and without the cache each lookup
+// is a linear scan over all stack maps of the method.
+//
+// The CodeInfo of AOT code lives in read-only oat memory, so the cache cannot hang off the
+// OatQuickMethodHeader. Instead every entry packs a tag derived from the key with the stack map
+// index in one word, which threads read and write with relaxed atomics and no lock. A hit is only
+// a hint: the caller checks that the stack map at the index has the native pc offset it looks
+// for, so collisions, races and entries left behind by freed JIT code fall back to the scan and
+// nothing ever needs to be invalidated.
+class StackMapLookupCache {
+ public:
+  // Set to false to measure stack walks without the cache.
+  static constexpr bool kEnabled = true;
+  // Methods with fewer stack maps are scanned faster than the cache is probed.
+  static constexpr size_t kMinStackMaps = 8;
+  // The number of entries, a power of two.
+  static constexpr size_t kSizeLog2 = 12;
+  static constexpr size_t kSize = 1u << kSizeLog2;
+
+  // Returns true and sets *index if the cache has a candidate index for the key.
+  ALWAYS_INLINE static bool Lookup(const void* code_info,
+                                   uint32_t native_pc_offset,
+                                   /* out */ size_t* index) {
+    const uint64_t hash = Hash(code_info, native_pc_offset);
+    const uint64_t entry = entries_[hash >> (64 - kSizeLog2)].LoadRelaxed();
+    if ((entry & kIndexMask) != 0u && (entry & ~kIndexMask) == (hash & ~kIndexMask)) {
+      *index = (entry & kIndexMask) - 1u;
+      return true;
+    }
+    return false;
+  }
+
+  ALWAYS_INLINE static void Insert(const void* code_info,
+                                   uint32_t native_pc_offset,
+                                   size_t index) {
+    if (index + 1u > kIndexMask) {
+      return;
+    }
+    const uint64_t hash = Hash(code_info, native_pc_offset);
+    entries_[hash >> (64 - kSizeLog2)].StoreRelaxed((hash & ~kIndexMask) | (index + 1u));
+  }
+
+  // Empties the cache, only needed by tests.
+  static void Clear();
+
+ private:
+  // The low bits of an entry hold the stack map index plus one, so that zero means empty.
+  static constexpr uint64_t kIndexMask = (UINT64_C(1) << 24) - 1u;
+
+  static uint64_t Hash(const void* code_info, uint32_t native_pc_offset) {
+    static constexpr uint64_t kGoldenRatio = UINT64_C(0x9e3779b97f4a7c15);
+    const uint64_t key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(code_info)) ^
+        (static_cast<uint64_t>(native_pc_offset) * kGoldenRatio);
+    return key * kGoldenRatio;
+  }
+
+  static Atomic<uint64_t> entries_[kSize];
+};
+
 /**
  * Wrapper around all compiler information collected for a method.
  * The information is of the form:
@@ -1536,10 +1598,25 @@ class CodeInfo {
     // TODO: Safepoint stack maps are sorted by native_pc_offset but catch stack
     //       maps are not. If we knew that the method does not have try/catch,
     //       we could do binary search.
-    for (size_t i = 0, e = GetNumberOfStackMaps(encoding); i < e; ++i) {
+    const size_t e = GetNumberOfStackMaps(encoding);
+    const bool use_cache = StackMapLookupCache::kEnabled && e >= StackMapLookupCache::kMinStackMaps;
+    size_t cached_index;
+    if (use_cache &&
+        StackMapLookupCache::Lookup(region_.begin(), native_pc_offset, &cached_index) &&
+        cached_index < e) {
+      StackMap stack_map = GetStackMapAt(cached_index, encoding);
+      if (stack_map.GetNativePcOffset(encoding.stack_map.encoding, kRuntimeISA) ==
+          native_pc_offset) {
+        return stack_map;
+      }
+    }
+    for (size_t i = 0; i < e; ++i) {
       StackMap stack_map = GetStackMapAt(i, encoding);
       if (stack_map.GetNativePcOffset(encoding.stack_map.encoding, kRuntimeISA) ==
           native_pc_offset) {
+        if (use_cache) {
+          StackMapLookupCache::Insert(region_.begin(), native_pc_offset, i);
+        }
         return stack_map;
       }
     }
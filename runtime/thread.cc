@@ -37,6 +37,7 @@
 #include "arch/context.h"
 #include "art_field-inl.h"
 #include "art_method-inl.h"
+#include "barrier.h"
 #include "base/bit_utils.h"
 #include "base/memory_tool.h"
 #include "base/mutex.h"
@@ -1965,7 +1966,9 @@ Thread::Thread(bool daemon)
       wait_monitor_(nullptr),
       interrupted_(false),
       custom_tls_(nullptr),
-      can_call_into_java_(true) {
+      can_call_into_java_(true),
+      instrumentation_dispatch_depth_(0u),
+      trace_sample_buffer_(nullptr) {
   wait_mutex_ = new Mutex("a thread wait mutex");
   wait_cond_ = new ConditionVariable("a thread wait condition variable", *wait_mutex_);
   tlsPtr_.instrumentation_stack = new std::deque<instrumentation::InstrumentationStackFrame>;
@@ -1979,15 +1982,60 @@ Thread::Thread(bool daemon)
   std::fill(tlsPtr_.rosalloc_runs,
             tlsPtr_.rosalloc_runs + kNumRosAllocThreadLocalSizeBracketsInThread,
             gc::allocator::RosAlloc::GetDedicatedFullRun());
+  std::fill(rosalloc_bracket_allocations_,
+            rosalloc_bracket_allocations_ + kNumRosAllocThreadLocalSizeBracketsInThread,
+            0u);
   tlsPtr_.checkpoint_function = nullptr;
   for (uint32_t i = 0; i < kMaxSuspendBarriers; ++i) {
     tlsPtr_.active_suspend_barriers[i] = nullptr;
   }
   tlsPtr_.flip_function = nullptr;
   tlsPtr_.thread_local_mark_stack = nullptr;
+  tlsPtr_.interpreter_cache = &interpreter_cache_;
   tls32_.is_transitioning_to_runnable = false;
 }
 
+class ClearInterpreterCacheClosure : public Closure {
+ public:
+  explicit ClearInterpreterCacheClosure(Barrier* barrier) : barrier_(barrier) {}
+
+  virtual void Run(Thread* thread) OVERRIDE {
+    // The thread is either running this itself or suspended.
+    thread->GetInterpreterCache()->Clear();
+    barrier_->Pass(Thread::Current());
+  }
+
+ private:
+  Barrier* const barrier_;
+};
+
+void Thread::ClearAllInterpreterCaches() {
+  Thread* self = Thread::Current();
+  ThreadList* thread_list = Runtime::Current()->GetThreadList();
+  if (Locks::mutator_lock_->IsExclusiveHeld(self)) {
+    // All other threads are suspended and can't run a checkpoint.
+    MutexLock mu(self, *Locks::thread_list_lock_);
+    for (Thread* thread : thread_list->GetList()) {
+      thread->GetInterpreterCache()->Clear();
+    }
+  } else {
+    // Wait for every thread to clear its cache, the caller frees the fields and methods next.
+    Barrier barrier(0);
+    ClearInterpreterCacheClosure closure(&barrier);
+    const size_t barrier_count = thread_list->RunCheckpoint(&closure);
+    if (barrier_count == 0) {
+      return;
+    }
+    if (self->GetState() == kRunnable) {
+      ScopedThreadSuspension sts(self, kWaitingForCheckPointsToRun);
+      barrier.Increment(self, barrier_count);
+    } else {
+      ScopedThreadStateChange tsc(self, kWaitingForCheckPointsToRun);
+      barrier.Increment(self, barrier_count);
+    }
+  }
+}
+
 bool Thread::IsStillStarting() const {
   // You might think you can check whether the state is kStarting, but for much of thread startup,
   // the thread is in kNative; it might also be in kVmWait.
@@ -3477,6 +3525,9 @@ void Thread::SetTlab(uint8_t* start, uint8_t* end, uint8_t* limit) {
   tlsPtr_.thread_local_end = end;
   tlsPtr_.thread_local_limit = limit;
   tlsPtr_.thread_local_objects = 0;
+  // Bytes allocated from a revoked TLAB since the last allocation slow path are not counted
+  // towards the next allocation sample.
+  alloc_sample_state_.counted_tlab_pos = start;
 }
 
 bool Thread::HasTlab() const {
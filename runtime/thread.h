@@ -20,6 +20,7 @@
 #include <bitset>
 #include <deque>
 #include <iosfwd>
+#include <limits>
 #include <list>
 #include <memory>
 #include <setjmp.h>
@@ -37,6 +38,7 @@
 #include "globals.h"
 #include "handle_scope.h"
 #include "instrumentation.h"
+#include "interpreter/interpreter_cache.h"
 #include "jvalue.h"
 #include "object_callbacks.h"
 #include "offsets.h"
@@ -93,6 +95,7 @@ class SingleStepControl;
 class StackedShadowFrameRecord;
 class Thread;
 class ThreadList;
+struct TraceSampleBuffer;
 
 // Thread priorities. These must match the Thread.MIN_PRIORITY,
 // Thread.NORM_PRIORITY, and Thread.MAX_PRIORITY constants.
@@ -115,8 +118,8 @@ enum class StackedShadowFrameType {
   kDeoptimizationShadowFrame,
 };
 
-// This should match RosAlloc::kNumThreadLocalSizeBrackets.
-static constexpr size_t kNumRosAllocThreadLocalSizeBracketsInThread = 16;
+// This should match RosAlloc::kMaxNumThreadLocalSizeBrackets.
+static constexpr size_t kNumRosAllocThreadLocalSizeBracketsInThread = 41;
 
 // Thread's stack layout for implicit stack overflow checks:
 //
@@ -434,6 +437,10 @@ class Thread {
     tlsPtr_.managed_stack.SetTopQuickFrame(top_method);
   }
 
+  void SetTopOfStackTagged(ArtMethod** top_method) {
+    tlsPtr_.managed_stack.SetTopQuickFrameTagged(top_method);
+  }
+
   void SetTopOfShadowStack(ShadowFrame* top) {
     tlsPtr_.managed_stack.SetTopShadowFrame(top);
   }
@@ -725,6 +732,12 @@ class Thread {
                                                                 thread_local_alloc_stack_end));
   }
 
+  template<PointerSize pointer_size>
+  static ThreadOffset<pointer_size> InterpreterCacheOffset() {
+    return ThreadOffsetFromTlsPtr<pointer_size>(OFFSETOF_MEMBER(tls_ptr_sized_values,
+                                                                interpreter_cache));
+  }
+
   // Size of stack less any space reserved for stack overflow
   size_t GetStackSize() const {
     return tlsPtr_.stack_size - (tlsPtr_.stack_end - tlsPtr_.stack_begin);
@@ -895,6 +908,21 @@ class Thread {
     --tls32_.disable_thread_flip_count;
   }
 
+  // The number of instrumentation events the thread is dispatching to listeners, see
+  // Instrumentation::FreeRetiredListenerArrays().
+  uint32_t GetInstrumentationDispatchDepth() const {
+    return instrumentation_dispatch_depth_;
+  }
+
+  void IncrementInstrumentationDispatchDepth() {
+    ++instrumentation_dispatch_depth_;
+  }
+
+  void DecrementInstrumentationDispatchDepth() {
+    DCHECK_GT(instrumentation_dispatch_depth_, 0u);
+    --instrumentation_dispatch_depth_;
+  }
+
   // Returns true if the thread is allowed to call into java.
   bool CanCallIntoJava() const {
     return can_call_into_java_;
@@ -1005,6 +1033,16 @@ class Thread {
     tls64_.trace_clock_base = clock_base;
   }
 
+  // The samples of this thread not yet written to the trace when sampling to a stream. The Trace
+  // owns the buffer.
+  TraceSampleBuffer* GetTraceSampleBuffer() const {
+    return trace_sample_buffer_;
+  }
+
+  void SetTraceSampleBuffer(TraceSampleBuffer* buffer) {
+    trace_sample_buffer_ = buffer;
+  }
+
   BaseMutex* GetHeldMutex(LockLevel level) const {
     return tlsPtr_.held_mutexes[level];
   }
@@ -1050,6 +1088,56 @@ class Thread {
     DCHECK_LE(tlsPtr_.thread_local_end, tlsPtr_.thread_local_limit);
   }
 
+  // State of the adaptive region TLAB sizing, only touched by the thread itself in the heap's
+  // TLAB refill slow path.
+  struct TlabSizingState {
+    // Bytes reserved by a refill, zero until the first refill.
+    size_t refill_size = 0;
+    // Bytes reserved by refills since the refill size was last adapted.
+    size_t bytes_since_resize = 0;
+    // The heap's count of finished GCs when the refill size was last adapted.
+    uint32_t gcs_completed = 0;
+  };
+
+  TlabSizingState* GetTlabSizingState() {
+    return &tlab_sizing_state_;
+  }
+
+  // State of the allocation tracker's sampling, only touched by the thread itself in allocation
+  // slow paths, and by SetTlab().
+  struct AllocSampleState {
+    // Bytes left to allocate before the next sampled allocation.
+    size_t bytes_until_sample = 0;
+    // TLAB position up to which bump-pointer allocations have been counted.
+    uint8_t* counted_tlab_pos = nullptr;
+    // State of the generator for the randomized sample intervals, zero until the first draw.
+    uint64_t random_state = 0;
+    // Set by an allocation slow path when the allocation in progress is to be recorded.
+    bool sample_pending = false;
+  };
+
+  AllocSampleState* GetAllocSampleState() {
+    return &alloc_sample_state_;
+  }
+
+  // Returns the bytes bump-allocated from the TLAB since the last call or since the TLAB was set.
+  size_t TakeUncountedTlabBytes() {
+    DCHECK_LE(alloc_sample_state_.counted_tlab_pos, tlsPtr_.thread_local_pos);
+    size_t bytes = tlsPtr_.thread_local_pos - alloc_sample_state_.counted_tlab_pos;
+    alloc_sample_state_.counted_tlab_pos = tlsPtr_.thread_local_pos;
+    return bytes;
+  }
+
+  InterpreterCache* GetInterpreterCache() {
+    return &interpreter_cache_;
+  }
+
+  // Clears the interpreter caches of all threads. Must be called before the fields and methods of
+  // unloaded or redefined classes can be freed or reused. Runs a checkpoint and waits for it, or
+  // clears the caches directly if the caller has suspended all other threads.
+  static void ClearAllInterpreterCaches()
+      REQUIRES(!Locks::thread_list_lock_, !Locks::thread_suspend_count_lock_);
+
   // Doesn't check that there is room.
   mirror::Object* AllocTlab(size_t bytes);
   void SetTlab(uint8_t* start, uint8_t* end, uint8_t* limit);
@@ -1103,6 +1191,23 @@ class Thread {
     tlsPtr_.rosalloc_runs[index] = run;
   }
 
+  // Counts an allocation from a RosAlloc size bracket, returns the saturated count.
+  uint8_t IncrementRosAllocBracketAllocations(size_t index) {
+    uint8_t* count = &rosalloc_bracket_allocations_[index];
+    if (*count != std::numeric_limits<uint8_t>::max()) {
+      ++*count;
+    }
+    return *count;
+  }
+
+  uint8_t GetRosAllocBracketAllocations(size_t index) const {
+    return rosalloc_bracket_allocations_[index];
+  }
+
+  void ResetRosAllocBracketAllocations(size_t index) {
+    rosalloc_bracket_allocations_[index] = 0;
+  }
+
   bool ProtectStack(bool fatal_on_error = true);
   bool UnprotectStack();
 
@@ -1468,7 +1573,7 @@ class Thread {
       thread_local_limit(nullptr),
       thread_local_objects(0), mterp_current_ibase(nullptr), mterp_default_ibase(nullptr),
       mterp_alt_ibase(nullptr), thread_local_alloc_stack_top(nullptr),
-      thread_local_alloc_stack_end(nullptr),
+      thread_local_alloc_stack_end(nullptr), interpreter_cache(nullptr),
       flip_function(nullptr), method_verifier(nullptr), thread_local_mark_stack(nullptr) {
       std::fill(held_mutexes, held_mutexes + kLockLevelCount, nullptr);
     }
@@ -1608,13 +1713,17 @@ class Thread {
     void* mterp_default_ibase;
     void* mterp_alt_ibase;
 
-    // There are RosAlloc::kNumThreadLocalSizeBrackets thread-local size brackets per thread.
+    // There are RosAlloc::kMaxNumThreadLocalSizeBrackets thread-local size brackets per thread.
+    // The allocation entrypoints only use the first RosAlloc::kNumThreadLocalSizeBrackets.
     void* rosalloc_runs[kNumRosAllocThreadLocalSizeBracketsInThread];
 
     // Thread-local allocation stack data/routines.
     StackReference<mirror::Object>* thread_local_alloc_stack_top;
     StackReference<mirror::Object>* thread_local_alloc_stack_end;
 
+    // Points to interpreter_cache_, for the mterp assembly.
+    InterpreterCache* interpreter_cache;
+
     // Support for Mutex lock hierarchy bug detection.
     BaseMutex* held_mutexes[kLockLevelCount];
 
@@ -1656,6 +1765,25 @@ class Thread {
   // By default this is true.
   bool can_call_into_java_;
 
+  // Non-zero while the thread holds on to an array of instrumentation listeners, including while
+  // it is suspended by a listener.
+  uint32_t instrumentation_dispatch_depth_;
+
+  // Owned by the Trace, see GetTraceSampleBuffer().
+  TraceSampleBuffer* trace_sample_buffer_;
+
+  // Allocations from each RosAlloc size bracket, used to decide which of the larger brackets get a
+  // thread-local run and to find the idle ones. Only the brackets past the ones that always get a
+  // thread-local run are counted.
+  uint8_t rosalloc_bracket_allocations_[kNumRosAllocThreadLocalSizeBracketsInThread];
+
+  TlabSizingState tlab_sizing_state_;
+
+  AllocSampleState alloc_sample_state_;
+
+  // Resolved fields and methods of the dex instructions this thread interpreted recently.
+  InterpreterCache interpreter_cache_;
+
   friend class Dbg;  // For SetStateUnsafe.
   friend class gc::collector::SemiSpace;  // For getting stack traces.
   friend class Runtime;  // For CreatePeer.
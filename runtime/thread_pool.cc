@@ -16,7 +16,9 @@
 
 #include "thread_pool.h"
 
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -75,6 +77,36 @@ void ThreadPoolWorker::SetPthreadPriority(int priority) {
 #endif
 }
 
+bool ThreadPoolWorker::SetCpuAffinity(const std::vector<uint32_t>& cpus) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (uint32_t cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+#if defined(ART_TARGET_ANDROID)
+  int result = sched_setaffinity(pthread_gettid_np(pthread_), sizeof(cpu_set), &cpu_set);
+  if (result != 0) {
+    PLOG(WARNING) << "Failed to set the CPU affinity of " << name_;
+    return false;
+  }
+#else
+  int result = pthread_setaffinity_np(pthread_, sizeof(cpu_set), &cpu_set);
+  if (result != 0) {
+    errno = result;
+    PLOG(WARNING) << "Failed to set the CPU affinity of " << name_;
+    return false;
+  }
+#endif
+  return true;
+#else
+  UNUSED(cpus);
+  return false;
+#endif
+}
+
 void ThreadPoolWorker::Run() {
   Thread* self = Thread::Current();
   Task* task = nullptr;
@@ -62,6 +62,9 @@ class ThreadPoolWorker {
   // Set the "nice" priorty for this worker.
   void SetPthreadPriority(int priority);
 
+  // Restrict this worker to the given CPUs. Returns false if that is not supported or failed.
+  bool SetCpuAffinity(const std::vector<uint32_t>& cpus);
+
   Thread* GetThread() const { return thread_; }
 
  protected:
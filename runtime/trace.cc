@@ -19,9 +19,13 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <unordered_set>
+
 #include "android-base/stringprintf.h"
 
 #include "art_method-inl.h"
+#include "barrier.h"
 #include "base/casts.h"
 #include "base/enums.h"
 #include "base/stl_util.h"
@@ -34,6 +38,7 @@
 #include "dex_file-inl.h"
 #include "gc/scoped_gc_critical_section.h"
 #include "instrumentation.h"
+#include "leb128.h"
 #include "mirror/class-inl.h"
 #include "mirror/dex_cache-inl.h"
 #include "mirror/object_array-inl.h"
@@ -55,6 +60,7 @@ static constexpr size_t TraceActionBits = MinimumBitsToStore(
 static constexpr uint8_t kOpNewMethod = 1U;
 static constexpr uint8_t kOpNewThread = 2U;
 static constexpr uint8_t kOpTraceSummary = 3U;
+static constexpr uint8_t kOpSamples = 4U;
 
 class BuildStackTraceVisitor : public StackVisitor {
  public:
@@ -82,6 +88,55 @@ class BuildStackTraceVisitor : public StackVisitor {
   DISALLOW_COPY_AND_ASSIGN(BuildStackTraceVisitor);
 };
 
+// Collects the methods of the stack of a thread, innermost first, into a reused vector.
+class SampleStackVisitor : public StackVisitor {
+ public:
+  SampleStackVisitor(Thread* thread, std::vector<ArtMethod*>* methods)
+      : StackVisitor(thread, nullptr, StackVisitor::StackWalkKind::kIncludeInlinedFrames),
+        methods_(methods) {}
+
+  bool VisitFrame() REQUIRES_SHARED(Locks::mutator_lock_) {
+    ArtMethod* m = GetMethod();
+    // Ignore runtime frames (in particular callee save).
+    if (!m->IsRuntimeMethod()) {
+      methods_->push_back(m->GetNonObsoleteMethod());
+    }
+    return true;
+  }
+
+ private:
+  std::vector<ArtMethod*>* const methods_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleStackVisitor);
+};
+
+// The encoded samples of one thread that are not yet written to the trace, and the previous
+// sample the next one is encoded against. Only the checkpoints of the thread append to the buffer
+// and only the sampling thread writes it out, after all checkpoints of a round have run, so the
+// buffer needs no lock.
+struct TraceSampleBuffer {
+  // The sampling thread writes out a buffer once it is half full. A sample that does not fit is
+  // dropped.
+  static constexpr size_t kCapacity = 32 * KB;
+
+  TraceSampleBuffer(pid_t thread_tid, uint32_t buffer_id) : tid(thread_tid), id(buffer_id) {}
+
+  const pid_t tid;
+  const uint32_t id;
+  std::vector<uint8_t> data;
+  // The previous sample, outermost frame first.
+  std::vector<ArtMethod*> stack;
+  // Scratch space for the next sample.
+  std::vector<ArtMethod*> new_stack;
+  // Trace method IDs of the methods this thread was seen in, to take the locks only once.
+  std::unordered_map<ArtMethod*, uint32_t> method_ids;
+  uint32_t last_thread_clock = 0u;
+  uint32_t last_wall_clock = 0u;
+  size_t dropped_samples = 0u;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceSampleBuffer);
+};
+
 static const char     kTraceTokenChar             = '*';
 static const uint16_t kTraceHeaderLength          = 32;
 static const uint32_t kTraceMagicValue            = 0x574f4c53;
@@ -235,6 +290,7 @@ static void GetSample(Thread* thread, void* arg) REQUIRES_SHARED(Locks::mutator_
 
 static void ClearThreadStackTraceAndClockBase(Thread* thread, void* arg ATTRIBUTE_UNUSED) {
   thread->SetTraceClockBase(0);
+  thread->SetTraceSampleBuffer(nullptr);
   std::vector<ArtMethod*>* stack_trace = thread->GetStackTraceSample();
   thread->SetStackTraceSample(nullptr);
   delete stack_trace;
@@ -281,6 +337,164 @@ void Trace::CompareAndUpdateStackTrace(Thread* thread,
   }
 }
 
+class SampleCheckpoint FINAL : public Closure {
+ public:
+  SampleCheckpoint(Trace* trace, Thread* sampling_thread)
+      : trace_(trace), sampling_thread_(sampling_thread), barrier_(0) {}
+
+  void Run(Thread* thread) OVERRIDE REQUIRES_SHARED(Locks::mutator_lock_) {
+    // Note thread and self may not be equal if thread was already suspended at the point of the
+    // request.
+    if (thread != sampling_thread_) {
+      trace_->RecordSample(thread);
+    }
+    barrier_.Pass(Thread::Current());
+  }
+
+  void WaitForThreadsToRunThroughCheckpoint(size_t threads_running_checkpoint) {
+    Thread* self = Thread::Current();
+    ScopedThreadStateChange tsc(self, kWaitingForCheckPointsToRun);
+    barrier_.Increment(self, threads_running_checkpoint);
+  }
+
+ private:
+  Trace* const trace_;
+  Thread* const sampling_thread_;
+  Barrier barrier_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleCheckpoint);
+};
+
+void Trace::SampleAllThreads(Thread* self) {
+  SampleCheckpoint checkpoint(this, self);
+  size_t threads_running_checkpoint;
+  {
+    ScopedObjectAccess soa(self);
+    threads_running_checkpoint = Runtime::Current()->GetThreadList()->RunCheckpoint(&checkpoint);
+  }
+  if (threads_running_checkpoint != 0) {
+    checkpoint.WaitForThreadsToRunThroughCheckpoint(threads_running_checkpoint);
+  }
+}
+
+void Trace::RecordSample(Thread* thread) {
+  TraceSampleBuffer* buffer = thread->GetTraceSampleBuffer();
+  if (buffer == nullptr) {
+    buffer = NewSampleBuffer(thread);
+  }
+  std::vector<ArtMethod*>* stack = &buffer->new_stack;
+  stack->clear();
+  SampleStackVisitor visitor(thread, stack);
+  visitor.WalkStack();
+  std::reverse(stack->begin(), stack->end());
+
+  // Only encode the frames above the ones the previous sample has in common with this one.
+  const std::vector<ArtMethod*>& old_stack = buffer->stack;
+  size_t common = 0u;
+  while (common != old_stack.size() && common != stack->size() &&
+         old_stack[common] == (*stack)[common]) {
+    ++common;
+  }
+  const size_t popped = old_stack.size() - common;
+  const size_t pushed = stack->size() - common;
+  static constexpr size_t kMaxLeb128Size = 5u;
+  if (buffer->data.size() + (4u + pushed) * kMaxLeb128Size > TraceSampleBuffer::kCapacity) {
+    // Leave the previous sample as is, the next one is encoded against it.
+    ++buffer->dropped_samples;
+    return;
+  }
+  if (buffer->data.capacity() == 0u) {
+    buffer->data.reserve(TraceSampleBuffer::kCapacity);
+  }
+
+  uint32_t thread_clock_diff = 0;
+  uint32_t wall_clock_diff = 0;
+  ReadClocks(thread, &thread_clock_diff, &wall_clock_diff);
+  if (UseThreadCpuClock()) {
+    EncodeUnsignedLeb128(&buffer->data, thread_clock_diff - buffer->last_thread_clock);
+    buffer->last_thread_clock = thread_clock_diff;
+  }
+  if (UseWallClock()) {
+    EncodeUnsignedLeb128(&buffer->data, wall_clock_diff - buffer->last_wall_clock);
+    buffer->last_wall_clock = wall_clock_diff;
+  }
+  EncodeUnsignedLeb128(&buffer->data, dchecked_integral_cast<uint32_t>(popped));
+  EncodeUnsignedLeb128(&buffer->data, dchecked_integral_cast<uint32_t>(pushed));
+  for (size_t i = common; i != stack->size(); ++i) {
+    EncodeUnsignedLeb128(&buffer->data, GetSampleMethodId(buffer, (*stack)[i]));
+  }
+  buffer->stack.swap(*stack);
+}
+
+TraceSampleBuffer* Trace::NewSampleBuffer(Thread* thread) {
+  MutexLock mu(Thread::Current(), *streaming_lock_);
+  if (RegisterThread(thread)) {
+    WriteThreadRecord(thread);
+  }
+  // IDs are not reused, the samples of a buffer are decoded against the previous ones.
+  sample_buffers_.emplace_back(new TraceSampleBuffer(thread->GetTid(), next_sample_buffer_id_++));
+  TraceSampleBuffer* buffer = sample_buffers_.back().get();
+  thread->SetTraceSampleBuffer(buffer);
+  return buffer;
+}
+
+uint32_t Trace::GetSampleMethodId(TraceSampleBuffer* buffer, ArtMethod* method) {
+  auto it = buffer->method_ids.find(method);
+  if (it != buffer->method_ids.end()) {
+    return it->second;
+  }
+  uint32_t id;
+  {
+    MutexLock mu(Thread::Current(), *streaming_lock_);
+    if (RegisterMethod(method)) {
+      // The method is named in the stream before the samples that use it are written out.
+      WriteMethodRecord(method);
+    }
+    id = EncodeTraceMethod(method);
+  }
+  buffer->method_ids.emplace(method, id);
+  return id;
+}
+
+void Trace::FlushSampleBuffers(bool all) {
+  Thread* self = Thread::Current();
+  std::unordered_set<TraceSampleBuffer*> live_buffers;
+  if (all) {
+    // A thread leaves the thread list before it is deleted and runs no checkpoint after that, so
+    // the buffers that no thread in the list points to belong to threads that exited.
+    MutexLock mu(self, *Locks::thread_list_lock_);
+    for (Thread* thread : Runtime::Current()->GetThreadList()->GetList()) {
+      live_buffers.insert(thread->GetTraceSampleBuffer());
+    }
+  }
+  MutexLock mu(self, *streaming_lock_);
+  for (const std::unique_ptr<TraceSampleBuffer>& buffer : sample_buffers_) {
+    if (!buffer->data.empty() &&
+        (all || buffer->data.size() >= TraceSampleBuffer::kCapacity / 2)) {
+      uint8_t header[13];
+      Append2LE(header, 0);
+      header[2] = kOpSamples;
+      Append2LE(header + 3, static_cast<uint16_t>(buffer->tid));
+      Append4LE(header + 5, buffer->id);
+      Append4LE(header + 9, static_cast<uint32_t>(buffer->data.size()));
+      WriteToBuf(header, sizeof(header));
+      WriteToBuf(buffer->data.data(), buffer->data.size());
+      buffer->data.clear();
+    }
+  }
+  if (all) {
+    auto end = std::partition(sample_buffers_.begin(),
+                              sample_buffers_.end(),
+                              [&live_buffers](const std::unique_ptr<TraceSampleBuffer>& buffer) {
+                                return live_buffers.find(buffer.get()) != live_buffers.end();
+                              });
+    for (auto it = end; it != sample_buffers_.end(); ++it) {
+      dropped_samples_ += (*it)->dropped_samples;
+    }
+    sample_buffers_.erase(end, sample_buffers_.end());
+  }
+}
+
 void* Trace::RunSamplingThread(void* arg) {
   Runtime* runtime = Runtime::Current();
   intptr_t interval_us = reinterpret_cast<intptr_t>(arg);
@@ -288,6 +502,9 @@ void* Trace::RunSamplingThread(void* arg) {
   CHECK(runtime->AttachCurrentThread("Sampling Profiler", true, runtime->GetSystemThreadGroup(),
                                      !runtime->IsAotCompiler()));
 
+  // How often all sample buffers are written out, in sampling rounds.
+  static constexpr size_t kRoundsPerFullFlush = 1024u;
+  size_t rounds = 0u;
   while (true) {
     usleep(interval_us);
     ScopedTrace trace("Profile sampling");
@@ -300,7 +517,12 @@ void* Trace::RunSamplingThread(void* arg) {
         break;
       }
     }
-    {
+    if (the_trace->UsesSampleBuffers()) {
+      // The trace outlives the loop, StopTracing joins this thread before deleting it.
+      the_trace->SampleAllThreads(self);
+      ++rounds;
+      the_trace->FlushSampleBuffers(/* all */ rounds % kRoundsPerFullFlush == 0u);
+    } else {
       ScopedSuspendAll ssa(__FUNCTION__);
       MutexLock mu(self, *Locks::thread_list_lock_);
       runtime->GetThreadList()->ForEach(GetSample, the_trace);
@@ -597,7 +819,8 @@ Trace::Trace(File* trace_file, const char* trace_name, size_t buffer_size, int f
       clock_source_(default_clock_source_),
       buffer_size_(std::max(kMinBufSize, buffer_size)),
       start_time_(MicroTime()), clock_overhead_ns_(GetClockOverheadNanoSeconds()), cur_offset_(0),
-      overflow_(false), interval_us_(0), streaming_lock_(nullptr),
+      overflow_(false), interval_us_(0), streaming_lock_(nullptr), next_sample_buffer_id_(0u),
+      dropped_samples_(0u),
       unique_methods_lock_(new Mutex("unique methods lock", kTracingUniqueMethodsLock)) {
   uint16_t trace_version = GetTraceVersion(clock_source_);
   if (output_mode == TraceOutputMode::kStreaming) {
@@ -656,6 +879,9 @@ void Trace::FinishTracing() {
 
   std::set<ArtMethod*> visited_methods;
   if (trace_output_mode_ == TraceOutputMode::kStreaming) {
+    if (UsesSampleBuffers()) {
+      FlushSampleBuffers(/* all */ true);
+    }
     // Clean up.
     STLDeleteValues(&seen_methods_);
   } else {
@@ -685,6 +911,18 @@ void Trace::FinishTracing() {
     size_t num_records = (final_offset - kTraceHeaderLength) / GetRecordSize(clock_source_);
     os << StringPrintf("num-method-calls=%zd\n", num_records);
   }
+  if (UsesSampleBuffers()) {
+    size_t dropped_samples;
+    {
+      MutexLock mu(Thread::Current(), *streaming_lock_);
+      dropped_samples = dropped_samples_;
+      for (const std::unique_ptr<TraceSampleBuffer>& buffer : sample_buffers_) {
+        dropped_samples += buffer->dropped_samples;
+      }
+    }
+    os << StringPrintf("sampling-interval-usec=%d\n", interval_us_);
+    os << StringPrintf("dropped-samples=%zd\n", dropped_samples);
+  }
   os << StringPrintf("clock-call-overhead-nsec=%d\n", clock_overhead_ns_);
   os << StringPrintf("vm=art\n");
   os << StringPrintf("pid=%d\n", getpid());
@@ -861,6 +1099,30 @@ bool Trace::RegisterThread(Thread* thread) {
   return false;
 }
 
+void Trace::WriteMethodRecord(ArtMethod* method) {
+  // Write a special block with the name.
+  std::string method_line(GetMethodLine(method));
+  uint8_t buf[5];
+  Append2LE(buf, 0);
+  buf[2] = kOpNewMethod;
+  Append2LE(buf + 3, static_cast<uint16_t>(method_line.length()));
+  WriteToBuf(buf, sizeof(buf));
+  WriteToBuf(reinterpret_cast<const uint8_t*>(method_line.c_str()), method_line.length());
+}
+
+void Trace::WriteThreadRecord(Thread* thread) {
+  // It might be better to postpone this. Threads might not have received names...
+  std::string thread_name;
+  thread->GetThreadName(thread_name);
+  uint8_t buf[7];
+  Append2LE(buf, 0);
+  buf[2] = kOpNewThread;
+  Append2LE(buf + 3, static_cast<uint16_t>(thread->GetTid()));
+  Append2LE(buf + 5, static_cast<uint16_t>(thread_name.length()));
+  WriteToBuf(buf, sizeof(buf));
+  WriteToBuf(reinterpret_cast<const uint8_t*>(thread_name.c_str()), thread_name.length());
+}
+
 std::string Trace::GetMethodLine(ArtMethod* method) {
   method = method->GetInterfaceMethodIfProxy(kRuntimePointerSize);
   return StringPrintf("%#x\t%s\t%s\t%s\t%s\n", (EncodeTraceMethod(method) << TraceActionBits),
@@ -967,26 +1229,10 @@ void Trace::LogMethodTraceEvent(Thread* thread, ArtMethod* method,
   if (trace_output_mode_ == TraceOutputMode::kStreaming) {
     MutexLock mu(Thread::Current(), *streaming_lock_);  // To serialize writing.
     if (RegisterMethod(method)) {
-      // Write a special block with the name.
-      std::string method_line(GetMethodLine(method));
-      uint8_t buf2[5];
-      Append2LE(buf2, 0);
-      buf2[2] = kOpNewMethod;
-      Append2LE(buf2 + 3, static_cast<uint16_t>(method_line.length()));
-      WriteToBuf(buf2, sizeof(buf2));
-      WriteToBuf(reinterpret_cast<const uint8_t*>(method_line.c_str()), method_line.length());
+      WriteMethodRecord(method);
     }
     if (RegisterThread(thread)) {
-      // It might be better to postpone this. Threads might not have received names...
-      std::string thread_name;
-      thread->GetThreadName(thread_name);
-      uint8_t buf2[7];
-      Append2LE(buf2, 0);
-      buf2[2] = kOpNewThread;
-      Append2LE(buf2 + 3, static_cast<uint16_t>(thread->GetTid()));
-      Append2LE(buf2 + 5, static_cast<uint16_t>(thread_name.length()));
-      WriteToBuf(buf2, sizeof(buf2));
-      WriteToBuf(reinterpret_cast<const uint8_t*>(thread_name.c_str()), thread_name.length());
+      WriteThreadRecord(thread);
     }
     WriteToBuf(stack_buf, sizeof(stack_buf));
   }
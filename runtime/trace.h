@@ -39,6 +39,7 @@ class ArtField;
 class ArtMethod;
 class DexFile;
 class Thread;
+struct TraceSampleBuffer;
 
 using DexIndexBitSet = std::bitset<65536>;
 
@@ -83,6 +84,27 @@ enum TracingMode {
 //
 // 32 bits of microseconds is 70 minutes.
 //
+// In streaming mode the records are interleaved with packets that start with a zero thread ID
+// and an op, which name new methods and threads or hold the trace summary. Sampling to a stream
+// writes no records. The stacks of each thread are instead sampled into a buffer of the thread
+// and written in packets of the form:
+//     u2  0
+//     u1  op (kOpSamples)
+//     u2  thread ID
+//     u4  buffer ID, unique within the trace
+//     u4  length of the samples, in bytes
+//     samples
+//
+// Sample format:
+//     uleb128  thread cpu time delta, in usec (when clock is "thread-cpu" or "dual" only)
+//     uleb128  wall time delta, in usec (when clock is "wall" or "dual" only)
+//     uleb128  number of frames popped from the top of the previous sample
+//     uleb128  number of frames pushed
+//     uleb128  method ID of each pushed frame, outermost first
+//
+// Time deltas and stacks are relative to the previous sample in the same buffer. The first
+// sample of a buffer starts from an empty stack and zero times.
+//
 // All values are stored in little-endian order.
 
 enum TraceAction {
@@ -139,6 +161,11 @@ class Trace FINAL : public instrumentation::InstrumentationListener {
   void CompareAndUpdateStackTrace(Thread* thread, std::vector<ArtMethod*>* stack_trace)
       REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!*unique_methods_lock_, !*streaming_lock_);
 
+  // Appends a sample of the stack of the thread to its sample buffer. Runs in a checkpoint, either
+  // on the thread itself or on the sampling thread when the thread is suspended.
+  void RecordSample(Thread* thread)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!*unique_methods_lock_, !*streaming_lock_);
+
   // InstrumentationListener implementation.
   void MethodEntered(Thread* thread, mirror::Object* this_object,
                      ArtMethod* method, uint32_t dex_pc)
@@ -193,7 +220,9 @@ class Trace FINAL : public instrumentation::InstrumentationListener {
         TraceOutputMode output_mode, TraceMode trace_mode);
 
   // The sampling interval in microseconds is passed as an argument.
-  static void* RunSamplingThread(void* arg) REQUIRES(!Locks::trace_lock_);
+  static void* RunSamplingThread(void* arg) REQUIRES(!Locks::trace_lock_)
+      // Calls into the trace it reads, see StopTracing.
+      NO_THREAD_SAFETY_ANALYSIS;
 
   static void StopTracing(bool finish_tracing, bool flush_file)
       REQUIRES(!Locks::mutator_lock_, !Locks::thread_list_lock_, !Locks::trace_lock_)
@@ -203,10 +232,29 @@ class Trace FINAL : public instrumentation::InstrumentationListener {
       // how to annotate this.
       NO_THREAD_SAFETY_ANALYSIS;
   void FinishTracing()
-      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!*unique_methods_lock_, !*streaming_lock_);
+      REQUIRES_SHARED(Locks::mutator_lock_)
+      REQUIRES(!Locks::thread_list_lock_, !*unique_methods_lock_, !*streaming_lock_);
 
   void ReadClocks(Thread* thread, uint32_t* thread_clock_diff, uint32_t* wall_clock_diff);
 
+  // Whether the threads are sampled with checkpoints into per-thread buffers, which is the case
+  // when sampling to a stream.
+  bool UsesSampleBuffers() const {
+    return trace_mode_ == TraceMode::kSampling && trace_output_mode_ == TraceOutputMode::kStreaming;
+  }
+
+  // Runs a checkpoint that records a sample of every thread and waits for it.
+  void SampleAllThreads(Thread* self)
+      REQUIRES(!Locks::mutator_lock_, !*unique_methods_lock_, !*streaming_lock_);
+  TraceSampleBuffer* NewSampleBuffer(Thread* thread)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!*streaming_lock_);
+  uint32_t GetSampleMethodId(TraceSampleBuffer* buffer, ArtMethod* method)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(!*unique_methods_lock_, !*streaming_lock_);
+  // Writes the samples of the buffers that are at least half full, or of all buffers if `all`.
+  // Writing all buffers also deletes the buffers of threads that exited. Must not run
+  // concurrently with the checkpoints.
+  void FlushSampleBuffers(bool all) REQUIRES(!Locks::thread_list_lock_, !*streaming_lock_);
+
   void LogMethodTraceEvent(Thread* thread, ArtMethod* method,
                            instrumentation::Instrumentation::InstrumentationEvent event,
                            uint32_t thread_clock_diff, uint32_t wall_clock_diff)
@@ -226,6 +274,12 @@ class Trace FINAL : public instrumentation::InstrumentationListener {
   bool RegisterThread(Thread* thread)
       REQUIRES(streaming_lock_);
 
+  // Write the name of a newly registered method or thread. Used for streaming.
+  void WriteMethodRecord(ArtMethod* method)
+      REQUIRES_SHARED(Locks::mutator_lock_) REQUIRES(streaming_lock_, !*unique_methods_lock_);
+  void WriteThreadRecord(Thread* thread)
+      REQUIRES(streaming_lock_);
+
   // Copy a temporary buffer to the main buffer. Used for streaming. Exposed here for lock
   // annotation.
   void WriteToBuf(const uint8_t* src, size_t src_size)
@@ -299,6 +353,11 @@ class Trace FINAL : public instrumentation::InstrumentationListener {
   Mutex* streaming_lock_;
   std::map<const DexFile*, DexIndexBitSet*> seen_methods_;
   std::unique_ptr<ThreadIDBitSet> seen_threads_;
+  // The sample buffers of the threads, see RecordSample().
+  std::vector<std::unique_ptr<TraceSampleBuffer>> sample_buffers_ GUARDED_BY(streaming_lock_);
+  uint32_t next_sample_buffer_id_ GUARDED_BY(streaming_lock_);
+  // The samples dropped by the deleted sample buffers.
+  size_t dropped_samples_ GUARDED_BY(streaming_lock_);
 
   // Bijective map from ArtMethod* to index.
   // Map from ArtMethod* to index in unique_methods_;
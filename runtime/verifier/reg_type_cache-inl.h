@@ -118,10 +118,24 @@ inline const RegType& RegTypeCache::JavaLangObject(bool precise) {
   }
 }
 
+template <typename Predicate>
+inline const RegType* RegTypeCache::FindInLookup(uint32_t hash, Predicate predicate) const {
+  // Chains run from the newest to the oldest entry, so the last match is the oldest.
+  const RegType* result = nullptr;
+  for (uint16_t id = lookup_buckets_[LookupBucket(hash)]; id != 0u; id = lookup_next_[id]) {
+    const RegType* entry = entries_[id];
+    if (predicate(entry)) {
+      result = entry;
+    }
+  }
+  return result;
+}
+
 template <class RegTypeType>
 inline RegTypeType& RegTypeCache::AddEntry(RegTypeType* new_entry) {
   DCHECK(new_entry != nullptr);
   entries_.push_back(new_entry);
+  AddToLookup(new_entry);
   if (new_entry->HasClass()) {
     mirror::Class* klass = new_entry->GetClass();
     DCHECK(!klass->IsPrimitive());
@@ -163,6 +163,94 @@ mirror::Class* RegTypeCache::ResolveClass(const char* descriptor, mirror::ClassL
   return klass;
 }
 
+const RegType* RegTypeCache::FindDescriptor(const StringPiece& descriptor, bool precise) {
+  auto matches = [&](const RegType* entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+    return MatchDescriptor(entry->GetId(), descriptor, precise);
+  };
+  return FindInLookup(HashDescriptor(descriptor), matches);
+}
+
+uint32_t RegTypeCache::HashDescriptor(const StringPiece& descriptor) {
+  uint32_t hash = 0u;
+  for (size_t i = 0; i < descriptor.size(); ++i) {
+    hash = hash * 31u + static_cast<uint8_t>(descriptor[i]);
+  }
+  return hash;
+}
+
+uint32_t RegTypeCache::HashClassDescriptor(const RegType& type) {
+  DCHECK(type.HasClass());
+  if (!type.descriptor_.empty()) {
+    return HashDescriptor(type.descriptor_);
+  }
+  std::string temp;
+  return HashDescriptor(type.GetClass()->GetDescriptor(&temp));
+}
+
+uint32_t RegTypeCache::HashMerged(const RegType& resolved_part, const BitVector& unresolved_types) {
+  uint32_t hash = resolved_part.GetId();
+  for (uint32_t idx : unresolved_types.Indexes()) {
+    hash = hash * 31u + idx;
+  }
+  return hash;
+}
+
+bool RegTypeCache::GetLookupHash(const RegType* entry, /* out */ uint32_t* hash) {
+  if (entry->IsConstantTypes()) {
+    ConstantKind kind = entry->IsConstantLo()
+        ? ConstantKind::kCat2Lo
+        : (entry->IsConstantHi() ? ConstantKind::kCat2Hi : ConstantKind::kCat1);
+    *hash = HashConstant(down_cast<const ConstantType*>(entry)->ConstantValue(), kind);
+    return true;
+  }
+  if (entry->IsUnresolvedMergedReference()) {
+    const UnresolvedMergedType* merged = down_cast<const UnresolvedMergedType*>(entry);
+    *hash = HashMerged(merged->GetResolvedPart(), merged->GetUnresolvedTypes());
+    return true;
+  }
+  if (entry->IsUnresolvedSuperClass()) {
+    *hash = HashUnresolvedSuperClass(
+        down_cast<const UnresolvedSuperClass*>(entry)->GetUnresolvedSuperClassChildId());
+    return true;
+  }
+  if (entry->HasClass()) {
+    *hash = HashClassDescriptor(*entry);
+    return true;
+  }
+  if (entry->descriptor_.empty()) {
+    return false;
+  }
+  *hash = HashDescriptor(entry->descriptor_);
+  return true;
+}
+
+void RegTypeCache::AddToLookup(const RegType* entry) {
+  DCHECK_EQ(lookup_next_.size() + 1u, entries_.size());
+  const uint16_t new_id = entry->GetId();
+  lookup_next_.push_back(0u);
+  uint32_t hash;
+  if (!GetLookupHash(entry, &hash)) {
+    return;
+  }
+  auto link = [this](uint16_t id, uint32_t id_hash) {
+    size_t bucket = LookupBucket(id_hash);
+    lookup_next_[id] = lookup_buckets_[bucket];
+    lookup_buckets_[bucket] = id;
+  };
+  if (entries_.size() - primitive_count_ > lookup_buckets_.size()) {
+    // Double the buckets to keep the chains short. Relinking in id order keeps each chain ordered
+    // from the newest to the oldest entry.
+    lookup_buckets_.assign(lookup_buckets_.size() * 2u, 0u);
+    for (uint16_t id = primitive_count_; id != new_id; ++id) {
+      uint32_t id_hash;
+      if (GetLookupHash(entries_[id], &id_hash)) {
+        link(id, id_hash);
+      }
+    }
+  }
+  link(new_id, hash);
+}
+
 StringPiece RegTypeCache::AddString(const StringPiece& string_piece) {
   char* ptr = arena_.AllocArray<char>(string_piece.length());
   memcpy(ptr, string_piece.data(), string_piece.length());
@@ -175,10 +263,9 @@ const RegType& RegTypeCache::From(mirror::ClassLoader* loader,
   StringPiece sp_descriptor(descriptor);
   // Try looking up the class in the cache first. We use a StringPiece to avoid continual strlen
   // operations on the descriptor.
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    if (MatchDescriptor(i, sp_descriptor, precise)) {
-      return *(entries_[i]);
-    }
+  const RegType* cached = FindDescriptor(sp_descriptor, precise);
+  if (cached != nullptr) {
+    return *cached;
   }
   // Class not found in the cache, will create a new type for that.
   // Try resolving class.
@@ -264,6 +351,8 @@ const RegType& RegTypeCache::FromClass(const char* descriptor, mirror::Class* kl
 
 RegTypeCache::RegTypeCache(bool can_load_classes, ScopedArenaAllocator& arena)
     : entries_(arena.Adapter(kArenaAllocVerifier)),
+      lookup_buckets_(kNumInitialLookupBuckets, 0u, arena.Adapter(kArenaAllocVerifier)),
+      lookup_next_(arena.Adapter(kArenaAllocVerifier)),
       klass_entries_(arena.Adapter(kArenaAllocVerifier)),
       can_load_classes_(can_load_classes),
       arena_(arena) {
@@ -276,7 +365,10 @@ RegTypeCache::RegTypeCache(bool can_load_classes, ScopedArenaAllocator& arena)
   // We want to have room for additional entries after inserting primitives and small
   // constants.
   entries_.reserve(kNumReserveEntries + kNumPrimitivesAndSmallConstants);
+  lookup_next_.reserve(kNumReserveEntries + kNumPrimitivesAndSmallConstants);
   FillPrimitiveAndSmallConstantTypes();
+  // The primitives and small constants have their own fast paths and are not in the lookup table.
+  lookup_next_.resize(entries_.size(), 0u);
 }
 
 RegTypeCache::~RegTypeCache() {
@@ -408,18 +500,20 @@ const RegType& RegTypeCache::FromUnresolvedMerge(const RegType& left,
   }
 
   // Check if entry already exists.
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    const RegType* cur_entry = entries_[i];
-    if (cur_entry->IsUnresolvedMergedReference()) {
-      const UnresolvedMergedType* cmp_type = down_cast<const UnresolvedMergedType*>(cur_entry);
-      const RegType& resolved_part = cmp_type->GetResolvedPart();
-      const BitVector& unresolved_part = cmp_type->GetUnresolvedTypes();
-      // Use SameBitsSet. "types" is expandable to allow merging in the components, but the
-      // BitVector in the final RegType will be made non-expandable.
-      if (&resolved_part == &resolved_parts_merged && types.SameBitsSet(&unresolved_part)) {
-        return *cur_entry;
-      }
+  auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+    if (!cur_entry->IsUnresolvedMergedReference()) {
+      return false;
     }
+    const UnresolvedMergedType* cmp_type = down_cast<const UnresolvedMergedType*>(cur_entry);
+    const RegType& resolved_part = cmp_type->GetResolvedPart();
+    const BitVector& unresolved_part = cmp_type->GetUnresolvedTypes();
+    // Use SameBitsSet. "types" is expandable to allow merging in the components, but the
+    // BitVector in the final RegType will be made non-expandable.
+    return &resolved_part == &resolved_parts_merged && types.SameBitsSet(&unresolved_part);
+  };
+  const RegType* cached = FindInLookup(HashMerged(resolved_parts_merged, types), matches);
+  if (cached != nullptr) {
+    return *cached;
   }
   return AddEntry(new (&arena_) UnresolvedMergedType(resolved_parts_merged,
                                                      types,
@@ -429,17 +523,14 @@ const RegType& RegTypeCache::FromUnresolvedMerge(const RegType& left,
 
 const RegType& RegTypeCache::FromUnresolvedSuperClass(const RegType& child) {
   // Check if entry already exists.
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    const RegType* cur_entry = entries_[i];
-    if (cur_entry->IsUnresolvedSuperClass()) {
-      const UnresolvedSuperClass* tmp_entry =
-          down_cast<const UnresolvedSuperClass*>(cur_entry);
-      uint16_t unresolved_super_child_id =
-          tmp_entry->GetUnresolvedSuperClassChildId();
-      if (unresolved_super_child_id == child.GetId()) {
-        return *cur_entry;
-      }
-    }
+  auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+    return cur_entry->IsUnresolvedSuperClass() &&
+        down_cast<const UnresolvedSuperClass*>(cur_entry)->GetUnresolvedSuperClassChildId() ==
+            child.GetId();
+  };
+  const RegType* cached = FindInLookup(HashUnresolvedSuperClass(child.GetId()), matches);
+  if (cached != nullptr) {
+    return *cached;
   }
   return AddEntry(new (&arena_) UnresolvedSuperClass(child.GetId(), this, entries_.size()));
 }
@@ -448,28 +539,30 @@ const UninitializedType& RegTypeCache::Uninitialized(const RegType& type, uint32
   UninitializedType* entry = nullptr;
   const StringPiece& descriptor(type.GetDescriptor());
   if (type.IsUnresolvedTypes()) {
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      const RegType* cur_entry = entries_[i];
-      if (cur_entry->IsUnresolvedAndUninitializedReference() &&
+    auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+      return cur_entry->IsUnresolvedAndUninitializedReference() &&
           down_cast<const UnresolvedUninitializedRefType*>(cur_entry)->GetAllocationPc()
               == allocation_pc &&
-          (cur_entry->GetDescriptor() == descriptor)) {
-        return *down_cast<const UnresolvedUninitializedRefType*>(cur_entry);
-      }
+          (cur_entry->GetDescriptor() == descriptor);
+    };
+    const RegType* cached = FindInLookup(HashDescriptor(descriptor), matches);
+    if (cached != nullptr) {
+      return *down_cast<const UnresolvedUninitializedRefType*>(cached);
     }
     entry = new (&arena_) UnresolvedUninitializedRefType(descriptor,
                                                          allocation_pc,
                                                          entries_.size());
   } else {
     mirror::Class* klass = type.GetClass();
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      const RegType* cur_entry = entries_[i];
-      if (cur_entry->IsUninitializedReference() &&
+    auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+      return cur_entry->IsUninitializedReference() &&
           down_cast<const UninitializedReferenceType*>(cur_entry)
               ->GetAllocationPc() == allocation_pc &&
-          cur_entry->GetClass() == klass) {
-        return *down_cast<const UninitializedReferenceType*>(cur_entry);
-      }
+          cur_entry->GetClass() == klass;
+    };
+    const RegType* cached = FindInLookup(HashClassDescriptor(type), matches);
+    if (cached != nullptr) {
+      return *down_cast<const UninitializedReferenceType*>(cached);
     }
     entry = new (&arena_) UninitializedReferenceType(klass,
                                                      descriptor,
@@ -484,23 +577,24 @@ const RegType& RegTypeCache::FromUninitialized(const RegType& uninit_type) {
 
   if (uninit_type.IsUnresolvedTypes()) {
     const StringPiece& descriptor(uninit_type.GetDescriptor());
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      const RegType* cur_entry = entries_[i];
-      if (cur_entry->IsUnresolvedReference() &&
-          cur_entry->GetDescriptor() == descriptor) {
-        return *cur_entry;
-      }
+    auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+      return cur_entry->IsUnresolvedReference() && cur_entry->GetDescriptor() == descriptor;
+    };
+    const RegType* cached = FindInLookup(HashDescriptor(descriptor), matches);
+    if (cached != nullptr) {
+      return *cached;
     }
     entry = new (&arena_) UnresolvedReferenceType(descriptor, entries_.size());
   } else {
     mirror::Class* klass = uninit_type.GetClass();
     if (uninit_type.IsUninitializedThisReference() && !klass->IsFinal()) {
       // For uninitialized "this reference" look for reference types that are not precise.
-      for (size_t i = primitive_count_; i < entries_.size(); i++) {
-        const RegType* cur_entry = entries_[i];
-        if (cur_entry->IsReference() && cur_entry->GetClass() == klass) {
-          return *cur_entry;
-        }
+      auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+        return cur_entry->IsReference() && cur_entry->GetClass() == klass;
+      };
+      const RegType* cached = FindInLookup(HashClassDescriptor(uninit_type), matches);
+      if (cached != nullptr) {
+        return *cached;
       }
       entry = new (&arena_) ReferenceType(klass, "", entries_.size());
     } else if (!klass->IsPrimitive()) {
@@ -515,11 +609,12 @@ const RegType& RegTypeCache::FromUninitialized(const RegType& uninit_type) {
       //       2) Checking whether the klass is instantiable and using conflict may produce a hard
       //          error when the value is used, which leads to a VerifyError, which is not the
       //          correct semantics.
-      for (size_t i = primitive_count_; i < entries_.size(); i++) {
-        const RegType* cur_entry = entries_[i];
-        if (cur_entry->IsPreciseReference() && cur_entry->GetClass() == klass) {
-          return *cur_entry;
-        }
+      auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+        return cur_entry->IsPreciseReference() && cur_entry->GetClass() == klass;
+      };
+      const RegType* cached = FindInLookup(HashClassDescriptor(uninit_type), matches);
+      if (cached != nullptr) {
+        return *cached;
       }
       entry = new (&arena_) PreciseReferenceType(klass,
                                                  uninit_type.GetDescriptor(),
@@ -535,21 +630,23 @@ const UninitializedType& RegTypeCache::UninitializedThisArgument(const RegType&
   UninitializedType* entry;
   const StringPiece& descriptor(type.GetDescriptor());
   if (type.IsUnresolvedTypes()) {
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      const RegType* cur_entry = entries_[i];
-      if (cur_entry->IsUnresolvedAndUninitializedThisReference() &&
-          cur_entry->GetDescriptor() == descriptor) {
-        return *down_cast<const UninitializedType*>(cur_entry);
-      }
+    auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+      return cur_entry->IsUnresolvedAndUninitializedThisReference() &&
+          cur_entry->GetDescriptor() == descriptor;
+    };
+    const RegType* cached = FindInLookup(HashDescriptor(descriptor), matches);
+    if (cached != nullptr) {
+      return *down_cast<const UninitializedType*>(cached);
     }
     entry = new (&arena_) UnresolvedUninitializedThisRefType(descriptor, entries_.size());
   } else {
     mirror::Class* klass = type.GetClass();
-    for (size_t i = primitive_count_; i < entries_.size(); i++) {
-      const RegType* cur_entry = entries_[i];
-      if (cur_entry->IsUninitializedThisReference() && cur_entry->GetClass() == klass) {
-        return *down_cast<const UninitializedType*>(cur_entry);
-      }
+    auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+      return cur_entry->IsUninitializedThisReference() && cur_entry->GetClass() == klass;
+    };
+    const RegType* cached = FindInLookup(HashClassDescriptor(type), matches);
+    if (cached != nullptr) {
+      return *down_cast<const UninitializedType*>(cached);
     }
     entry = new (&arena_) UninitializedThisReferenceType(klass, descriptor, entries_.size());
   }
@@ -557,13 +654,14 @@ const UninitializedType& RegTypeCache::UninitializedThisArgument(const RegType&
 }
 
 const ConstantType& RegTypeCache::FromCat1NonSmallConstant(int32_t value, bool precise) {
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    const RegType* cur_entry = entries_[i];
-    if (cur_entry->klass_.IsNull() && cur_entry->IsConstant() &&
+  auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+    return cur_entry->klass_.IsNull() && cur_entry->IsConstant() &&
         cur_entry->IsPreciseConstant() == precise &&
-        (down_cast<const ConstantType*>(cur_entry))->ConstantValue() == value) {
-      return *down_cast<const ConstantType*>(cur_entry);
-    }
+        (down_cast<const ConstantType*>(cur_entry))->ConstantValue() == value;
+  };
+  const RegType* cached = FindInLookup(HashConstant(value, ConstantKind::kCat1), matches);
+  if (cached != nullptr) {
+    return *down_cast<const ConstantType*>(cached);
   }
   ConstantType* entry;
   if (precise) {
@@ -575,12 +673,13 @@ const ConstantType& RegTypeCache::FromCat1NonSmallConstant(int32_t value, bool p
 }
 
 const ConstantType& RegTypeCache::FromCat2ConstLo(int32_t value, bool precise) {
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    const RegType* cur_entry = entries_[i];
-    if (cur_entry->IsConstantLo() && (cur_entry->IsPrecise() == precise) &&
-        (down_cast<const ConstantType*>(cur_entry))->ConstantValueLo() == value) {
-      return *down_cast<const ConstantType*>(cur_entry);
-    }
+  auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+    return cur_entry->IsConstantLo() && (cur_entry->IsPrecise() == precise) &&
+        (down_cast<const ConstantType*>(cur_entry))->ConstantValueLo() == value;
+  };
+  const RegType* cached = FindInLookup(HashConstant(value, ConstantKind::kCat2Lo), matches);
+  if (cached != nullptr) {
+    return *down_cast<const ConstantType*>(cached);
   }
   ConstantType* entry;
   if (precise) {
@@ -592,12 +691,13 @@ const ConstantType& RegTypeCache::FromCat2ConstLo(int32_t value, bool precise) {
 }
 
 const ConstantType& RegTypeCache::FromCat2ConstHi(int32_t value, bool precise) {
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    const RegType* cur_entry = entries_[i];
-    if (cur_entry->IsConstantHi() && (cur_entry->IsPrecise() == precise) &&
-        (down_cast<const ConstantType*>(cur_entry))->ConstantValueHi() == value) {
-      return *down_cast<const ConstantType*>(cur_entry);
-    }
+  auto matches = [&](const RegType* cur_entry) REQUIRES_SHARED(Locks::mutator_lock_) {
+    return cur_entry->IsConstantHi() && (cur_entry->IsPrecise() == precise) &&
+        (down_cast<const ConstantType*>(cur_entry))->ConstantValueHi() == value;
+  };
+  const RegType* cached = FindInLookup(HashConstant(value, ConstantKind::kCat2Hi), matches);
+  if (cached != nullptr) {
+    return *down_cast<const ConstantType*>(cached);
   }
   ConstantType* entry;
   if (precise) {
@@ -161,6 +161,8 @@ class RegTypeCache {
       REQUIRES_SHARED(Locks::mutator_lock_);
   bool MatchDescriptor(size_t idx, const StringPiece& descriptor, bool precise)
       REQUIRES_SHARED(Locks::mutator_lock_);
+  const RegType* FindDescriptor(const StringPiece& descriptor, bool precise)
+      REQUIRES_SHARED(Locks::mutator_lock_);
   const ConstantType& FromCat1NonSmallConstant(int32_t value, bool precise)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
@@ -168,6 +170,46 @@ class RegTypeCache {
   template <class RegTypeType>
   RegTypeType& AddEntry(RegTypeType* new_entry) REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // The kinds of constants, hashed with the value so that the halves of a wide constant do not
+  // share a chain with the 32-bit constant of the same value.
+  enum class ConstantKind : uint32_t {
+    kCat1,
+    kCat2Lo,
+    kCat2Hi,
+  };
+
+  static uint32_t HashDescriptor(const StringPiece& descriptor);
+  static uint32_t HashConstant(int32_t value, ConstantKind kind) {
+    return static_cast<uint32_t>(value) * 0x9e3779b1u + static_cast<uint32_t>(kind);
+  }
+  // Resolved types are keyed by the descriptor of their class rather than by the class, which
+  // can move. The imprecise references made from uninitialized this have no descriptor of their
+  // own, theirs is read from the class.
+  static uint32_t HashClassDescriptor(const RegType& type) REQUIRES_SHARED(Locks::mutator_lock_);
+  static uint32_t HashMerged(const RegType& resolved_part, const BitVector& unresolved_types);
+  static uint32_t HashUnresolvedSuperClass(uint16_t child_id) {
+    return static_cast<uint32_t>(child_id) * 0x85ebca6bu;
+  }
+
+  // Computes the hash that the lookup table keys the entry by: the descriptor of reference types,
+  // the value of constants and the parts of merged types and unresolved super classes. Returns
+  // false for entries that are never looked up.
+  static bool GetLookupHash(const RegType* entry, /* out */ uint32_t* hash)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  size_t LookupBucket(uint32_t hash) const {
+    return (hash ^ (hash >> 16)) & (lookup_buckets_.size() - 1u);
+  }
+
+  // Links the newest entry into the lookup table, growing the table when it is full.
+  void AddToLookup(const RegType* entry) REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Returns the oldest entry keyed by the hash for which the predicate holds, the entry a scan of
+  // entries_ in order would find, or null if there is none.
+  template <typename Predicate>
+  const RegType* FindInLookup(uint32_t hash, Predicate predicate) const
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Add a string piece to the arena allocator so that it stays live for the lifetime of the
   // verifier.
   StringPiece AddString(const StringPiece& string_piece);
@@ -183,6 +225,9 @@ class RegTypeCache {
   static const PreciseConstType* small_precise_constants_[kMaxSmallConstant -
                                                           kMinSmallConstant + 1];
 
+  // Initial number of lookup buckets, a power of two.
+  static constexpr size_t kNumInitialLookupBuckets = 64;
+
   static constexpr size_t kNumPrimitivesAndSmallConstants =
       12 + (kMaxSmallConstant - kMinSmallConstant + 1);
 
@@ -195,6 +240,13 @@ class RegTypeCache {
   // The actual storage for the RegTypes.
   ScopedArenaVector<const RegType*> entries_;
 
+  // Hash table over the entries, replacing scans of entries_ that are quadratic in the size of
+  // large methods. A bucket holds the id of the newest entry of its chain and lookup_next_,
+  // indexed by id, links each entry to the next older one.
+  // Id 0 is the undefined type, which is never in a chain, and ends the chains.
+  ScopedArenaVector<uint16_t> lookup_buckets_;
+  ScopedArenaVector<uint16_t> lookup_next_;
+
   // Fast lookup for quickly finding entries that have a matching class.
   ScopedArenaVector<std::pair<GcRoot<mirror::Class>, const RegType*>> klass_entries_;
 
@@ -18,6 +18,8 @@
 
 #include <set>
 
+#include "android-base/stringprintf.h"
+
 #include "base/bit_vector.h"
 #include "base/casts.h"
 #include "base/scoped_arena_allocator.h"
@@ -30,6 +32,8 @@
 namespace art {
 namespace verifier {
 
+using android::base::StringPrintf;
+
 class RegTypeTest : public CommonRuntimeTest {};
 
 TEST_F(RegTypeTest, ConstLoHi) {
@@ -416,6 +420,71 @@ TEST_F(RegTypeReferenceTest, UnresolvedUnintializedType) {
   EXPECT_TRUE(unresolved_unintialised.Equals(unresolved_unintialised_2));
 }
 
+TEST_F(RegTypeReferenceTest, ManyEntries) {
+  // Tests that lookups keep finding the interned types after the lookup table has grown.
+  ArenaStack stack(Runtime::Current()->GetArenaPool());
+  ScopedArenaAllocator allocator(&stack);
+  ScopedObjectAccess soa(Thread::Current());
+  RegTypeCache cache(true, allocator);
+  static constexpr int32_t kNumTypes = 500;
+  std::vector<std::string> descriptors;
+  std::vector<uint16_t> ids;
+  for (int32_t i = 0; i < kNumTypes; ++i) {
+    descriptors.push_back(StringPrintf("LDoesNotExist%d;", i));
+    ids.push_back(cache.FromDescriptor(nullptr, descriptors.back().c_str(), false).GetId());
+    ids.push_back(cache.FromCat1Const(1000 + i, false).GetId());
+    ids.push_back(cache.FromCat2ConstLo(1000 + i, true).GetId());
+    ids.push_back(cache.FromCat2ConstHi(1000 + i, true).GetId());
+  }
+  const size_t cache_size = cache.GetCacheSize();
+  for (int32_t i = 0; i < kNumTypes; ++i) {
+    const RegType& unresolved = cache.FromDescriptor(nullptr, descriptors[i].c_str(), false);
+    EXPECT_TRUE(unresolved.IsUnresolvedReference());
+    EXPECT_EQ(ids[4 * i], unresolved.GetId());
+    EXPECT_EQ(ids[4 * i + 1], cache.FromCat1Const(1000 + i, false).GetId());
+    EXPECT_EQ(ids[4 * i + 2], cache.FromCat2ConstLo(1000 + i, true).GetId());
+    EXPECT_EQ(ids[4 * i + 3], cache.FromCat2ConstHi(1000 + i, true).GetId());
+  }
+  // The constants of different kinds and precision are distinct.
+  EXPECT_NE(ids[1], cache.FromCat1Const(1000, true).GetId());
+  EXPECT_NE(ids[2], cache.FromCat2ConstLo(1000, false).GetId());
+  EXPECT_EQ(cache_size + 2u, cache.GetCacheSize());
+}
+
+TEST_F(RegTypeReferenceTest, InternedComposites) {
+  // Tests that the types keyed by their class or their parts are interned.
+  ArenaStack stack(Runtime::Current()->GetArenaPool());
+  ScopedArenaAllocator allocator(&stack);
+  ScopedObjectAccess soa(Thread::Current());
+  RegTypeCache cache(true, allocator);
+  const RegType& unresolved_ref = cache.FromDescriptor(nullptr, "Ljava/lang/DoesNotExist;", true);
+  const RegType& unresolved_ref_another =
+      cache.FromDescriptor(nullptr, "Ljava/lang/DoesNotExistEither;", true);
+  const RegType& merged = cache.FromUnresolvedMerge(
+      unresolved_ref, unresolved_ref_another, /* verifier */ nullptr);
+  EXPECT_EQ(merged.GetId(),
+            cache.FromUnresolvedMerge(
+                unresolved_ref, unresolved_ref_another, /* verifier */ nullptr).GetId());
+  const RegType& super_class = cache.FromUnresolvedSuperClass(unresolved_ref);
+  EXPECT_EQ(super_class.GetId(), cache.FromUnresolvedSuperClass(unresolved_ref).GetId());
+  EXPECT_NE(super_class.GetId(), cache.FromUnresolvedSuperClass(unresolved_ref_another).GetId());
+
+  const RegType& object = cache.JavaLangObject(/* precise */ false);
+  const RegType& uninit = cache.Uninitialized(object, 10);
+  EXPECT_EQ(uninit.GetId(), cache.Uninitialized(object, 10).GetId());
+  EXPECT_NE(uninit.GetId(), cache.Uninitialized(object, 12).GetId());
+  const RegType& precise = cache.FromUninitialized(uninit);
+  EXPECT_TRUE(precise.IsPreciseReference());
+  EXPECT_EQ(precise.GetId(), cache.FromUninitialized(cache.Uninitialized(object, 12)).GetId());
+  const RegType& uninit_this = cache.UninitializedThisArgument(object);
+  EXPECT_EQ(uninit_this.GetId(), cache.UninitializedThisArgument(object).GetId());
+  // Object is not final, so the initialized this is imprecise.
+  const RegType& this_ref = cache.FromUninitialized(uninit_this);
+  EXPECT_TRUE(this_ref.IsReference());
+  EXPECT_EQ(this_ref.GetId(), cache.FromUninitialized(uninit_this).GetId());
+  EXPECT_EQ(object.GetId(), this_ref.GetId());
+}
+
 TEST_F(RegTypeReferenceTest, Dump) {
   // Tests types for proper Dump messages.
   ArenaStack stack(Runtime::Current()->GetArenaPool());
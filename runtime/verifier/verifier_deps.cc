@@ -63,6 +63,14 @@ void VerifierDeps::MergeWith(const VerifierDeps& other,
   }
 }
 
+void VerifierDeps::CopyDexFileDeps(const VerifierDeps& other, const DexFile& dex_file) {
+  DexFileDeps* my_deps = GetDexFileDeps(dex_file);
+  const DexFileDeps* other_deps = other.GetDexFileDeps(dex_file);
+  DCHECK(my_deps != nullptr);
+  DCHECK(other_deps != nullptr);
+  *my_deps = *other_deps;
+}
+
 VerifierDeps::DexFileDeps* VerifierDeps::GetDexFileDeps(const DexFile& dex_file) {
   auto it = dex_deps_.find(&dex_file);
   return (it == dex_deps_.end()) ? nullptr : it->second.get();
@@ -867,6 +875,13 @@ bool VerifierDeps::ValidateDependencies(Handle<mirror::ClassLoader> class_loader
   return true;
 }
 
+bool VerifierDeps::ValidateDexFileDependencies(Handle<mirror::ClassLoader> class_loader,
+                                               const DexFile& dex_file,
+                                               Thread* self) const {
+  const DexFileDeps* deps = GetDexFileDeps(dex_file);
+  return deps != nullptr && VerifyDexFile(class_loader, dex_file, *deps, self);
+}
+
 // TODO: share that helper with other parts of the compiler that have
 // the same lookup pattern.
 static mirror::Class* FindClassAndClearException(ClassLinker* class_linker,
@@ -119,6 +119,19 @@ class VerifierDeps {
   bool ValidateDependencies(Handle<mirror::ClassLoader> class_loader, Thread* self) const
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Verify the encoded dependencies of `dex_file` are still valid. Dependencies only
+  // record outcomes that depend on the classpath, so the verification results of a
+  // dex file whose dependencies still hold can be reused even if other dex files
+  // need to be verified again.
+  bool ValidateDexFileDependencies(Handle<mirror::ClassLoader> class_loader,
+                                   const DexFile& dex_file,
+                                   Thread* self) const
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Replace the dependencies recorded for `dex_file` with the ones of `other`.
+  // `other` and `this` must both be for `dex_file`.
+  void CopyDexFileDeps(const VerifierDeps& other, const DexFile& dex_file);
+
   const std::vector<dex::TypeIndex>& GetUnverifiedClasses(const DexFile& dex_file) const {
     return GetDexFileDeps(dex_file)->unverified_classes_;
   }
@@ -332,6 +345,7 @@ class VerifierDeps {
   ART_FRIEND_TEST(VerifierDepsTest, EncodeDecode);
   ART_FRIEND_TEST(VerifierDepsTest, EncodeDecodeMulti);
   ART_FRIEND_TEST(VerifierDepsTest, VerifyDeps);
+  ART_FRIEND_TEST(VerifierDepsTest, PartialFastVerify);
   ART_FRIEND_TEST(VerifierDepsTest, CompilerDriver);
 };
 
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jni.h"
+
+#include "art_method-inl.h"
+#include "base/logging.h"
+#include "entrypoints/runtime_asm_entrypoints.h"
+#include "instrumentation.h"
+#include "mirror/class-inl.h"
+#include "runtime.h"
+#include "scoped_thread_state_change-inl.h"
+#include "ScopedUtfChars.h"
+
+namespace art {
+
+extern "C" JNIEXPORT jint JNICALL Java_Main_hotNative(JNIEnv*, jclass, jint value) {
+  return value + 1;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_Main_throwFromNative(JNIEnv* env, jclass) {
+  jclass exception_class = env->FindClass("java/lang/IllegalStateException");
+  CHECK(exception_class != nullptr);
+  env->ThrowNew(exception_class, "throwFromNative");
+}
+
+extern "C" JNIEXPORT void JNICALL Java_Main_callBack(JNIEnv* env, jclass cls) {
+  jmethodID callback = env->GetStaticMethodID(cls, "callback", "()V");
+  CHECK(callback != nullptr);
+  env->CallStaticVoidMethod(cls, callback);
+}
+
+// Switches the native method back to the GenericJNI trampoline, as when its JIT-compiled stub
+// is collected.
+extern "C" JNIEXPORT void JNICALL Java_Main_useGenericJni(JNIEnv* env,
+                                                          jclass,
+                                                          jclass cls,
+                                                          jstring method_name) {
+  ScopedObjectAccess soa(Thread::Current());
+  ScopedUtfChars chars(env, method_name);
+  CHECK(chars.c_str() != nullptr);
+  ArtMethod* method = soa.Decode<mirror::Class>(cls)->FindDeclaredDirectMethodByName(
+      chars.c_str(), kRuntimePointerSize);
+  CHECK(method != nullptr && method->IsNative());
+  Runtime::Current()->GetInstrumentation()->UpdateMethodsCode(method, GetQuickGenericJniStub());
+}
+
+}  // namespace art
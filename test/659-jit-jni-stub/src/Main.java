@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+  public static void main(String[] args) {
+    System.loadLibrary(args[0]);
+
+    // Exceptions thrown from native code through the GenericJNI trampoline.
+    testThrowFromNative();
+
+    if (hasJit()) {
+      testHotNative();
+
+      // The same exceptions through a JIT-compiled JNI stub.
+      ensureJitCompiled(Main.class, "throwFromNative");
+      assertTrue(isJitCompiled(Main.class, "throwFromNative"));
+      testThrowFromNative();
+
+      // callBack() is entered through GenericJNI, and the callback JIT-compiles its JNI stub
+      // while the GenericJNI frame is on the stack.
+      switchToJit = true;
+      callBack();
+      assertTrue(isJitCompiled(Main.class, "callBack"));
+
+      // callBack() is entered through its JIT-compiled stub, and the callback switches it back
+      // to GenericJNI while the stub frame is on the stack.
+      switchToJit = false;
+      callBack();
+      assertFalse(isJitCompiled(Main.class, "callBack"));
+    }
+    System.out.println("Done");
+  }
+
+  static void testHotNative() {
+    // The GenericJNI trampoline counts calls of the native method for the JIT.
+    int value = 0;
+    for (int i = 0; i < 10000000 && !isJitCompiled(Main.class, "hotNative"); ++i) {
+      value = hotNative(value);
+      if ((i % 10000) == 0) {
+        Thread.yield();
+      }
+    }
+    assertTrue(isJitCompiled(Main.class, "hotNative"));
+    assertEquals(value + 1, hotNative(value));
+  }
+
+  static void testThrowFromNative() {
+    for (int i = 0; i < 10; ++i) {
+      try {
+        throwFromNative();
+        throw new Error("Expected IllegalStateException");
+      } catch (IllegalStateException e) {
+        assertEquals("throwFromNative", e.getMessage());
+        StackTraceElement top = e.getStackTrace()[0];
+        assertEquals("throwFromNative", top.getMethodName());
+        assertTrue(top.isNativeMethod());
+      }
+    }
+  }
+
+  static void callback() {
+    checkStack();
+    if (switchToJit) {
+      ensureJitCompiled(Main.class, "callBack");
+    } else {
+      useGenericJni(Main.class, "callBack");
+    }
+    checkStack();
+    System.gc();
+    checkStack();
+  }
+
+  // Walks the stack with the native callBack() frame below us.
+  static void checkStack() {
+    StackTraceElement[] stack = new Throwable().getStackTrace();
+    assertEquals("checkStack", stack[0].getMethodName());
+    assertEquals("callback", stack[1].getMethodName());
+    assertEquals("callBack", stack[2].getMethodName());
+    assertTrue(stack[2].isNativeMethod());
+    assertEquals("main", stack[3].getMethodName());
+  }
+
+  static void assertTrue(boolean value) {
+    if (!value) {
+      throw new Error("Expected true");
+    }
+  }
+
+  static void assertFalse(boolean value) {
+    if (value) {
+      throw new Error("Expected false");
+    }
+  }
+
+  static void assertEquals(Object expected, Object actual) {
+    if (!expected.equals(actual)) {
+      throw new Error("Expected " + expected + ", got " + actual);
+    }
+  }
+
+  static boolean switchToJit;
+
+  static native int hotNative(int value);
+  static native void throwFromNative();
+  static native void callBack();
+  static native void useGenericJni(Class<?> cls, String methodName);
+
+  private static native boolean hasJit();
+  private static native boolean isJitCompiled(Class<?> cls, String methodName);
+  private static native void ensureJitCompiled(Class<?> cls, String methodName);
+}
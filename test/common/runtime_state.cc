@@ -205,8 +205,10 @@ extern "C" JNIEXPORT void JNICALL Java_Main_ensureJitCompiled(JNIEnv* env,
       // Sleep to yield to the compiler thread.
       usleep(1000);
       ScopedObjectAccess soa(self);
-      // Make sure there is a profiling info, required by the compiler.
-      ProfilingInfo::Create(self, method, /* retry_allocation */ true);
+      // Make sure there is a profiling info, required by the compiler. JNI stubs need none.
+      if (!method->IsNative()) {
+        ProfilingInfo::Create(self, method, /* retry_allocation */ true);
+      }
       // Will either ensure it's compiled or do the compilation itself.
       jit->CompileMethod(method, self, /* osr */ false);
     }
@@ -60,6 +60,19 @@ def WriteIntLE(f, val):
   asbytearray = bytearray(bytes)
   f.write(asbytearray)
 
+def ReadUnsignedLeb128(data, pos):
+  result = 0
+  shift = 0
+  while True:
+    if pos >= len(data):
+      raise MyException("Truncated samples")
+    byte = ord(data[pos])
+    pos += 1
+    result |= (byte & 0x7F) << shift
+    if (byte & 0x80) == 0:
+      return (result, pos)
+    shift += 7
+
 def Copy(input, output, length):
   buf = input.read(length)
   if len(buf) != length:
@@ -70,9 +83,11 @@ class Rewriter:
 
   def PrintHeader(self, header):
     header.write('*version\n');
-    header.write('3\n');
+    header.write('%d\n' % self._mVersion);
     header.write('data-file-overflow=false\n');
-    header.write('clock=dual\n');
+    # A single clock stream does not say which clock it used. The trace summary, if present,
+    # replaces this header with the real clock.
+    header.write('clock=%s\n' % ('dual' if self._mNumClocks == 2 else 'wall'));
     header.write('vm=art\n');
 
   def ProcessDataHeader(self, input, body):
@@ -87,8 +102,9 @@ class Rewriter:
       raise MyException("Does not seem to be a streaming trace: %d." % version)
     version = version ^ 0xf0
 
-    if version != 3:
-      raise MyException("Only support version 3")
+    if version != 2 and version != 3:
+      raise MyException("Only support version 2 and 3")
+    self._mVersion = version
 
     WriteShortLE(body, version)
 
@@ -108,6 +124,14 @@ class Rewriter:
       WriteShortLE(body, self._mRecordSize)
       offsetToData -= 2;
 
+    # A record is the thread ID, the method and action, and one 32-bit value per clock.
+    if self._mRecordSize == 10:
+      self._mNumClocks = 1
+    elif self._mRecordSize == 14:
+      self._mNumClocks = 2
+    else:
+      raise MyException("Unsupported record size: %d" % self._mRecordSize)
+
     # Skip over offsetToData bytes
     Copy(input, body, offsetToData)
 
@@ -130,7 +154,43 @@ class Rewriter:
     self._summary = str
     print 'Summary: \"%s\"' % str
 
-  def ProcessSpecial(self, input):
+  def WriteRecord(self, body, tid, methodAndAction, clocks):
+    WriteShortLE(body, tid)
+    WriteIntLE(body, methodAndAction)
+    for clock in clocks:
+      WriteIntLE(body, clock)
+
+  def ProcessSamples(self, input, body):
+    # Samples of one thread, delta-encoded against the previous sample of the same buffer.
+    # Turn them into method entry and exit records at the time of each sample.
+    tid = ReadShortLE(input)
+    bufferId = ReadIntLE(input)
+    length = ReadIntLE(input)
+    data = input.read(length)
+    if len(data) != length:
+      raise BufferUnderrun()
+    if bufferId not in self._sampleStacks:
+      self._sampleStacks[bufferId] = ([], [0] * self._mNumClocks)
+    (stack, clocks) = self._sampleStacks[bufferId]
+    pos = 0
+    while pos < length:
+      # One delta per clock of the trace, in the same order as in the records.
+      for i in range(self._mNumClocks):
+        (delta, pos) = ReadUnsignedLeb128(data, pos)
+        clocks[i] = (clocks[i] + delta) & 0xFFFFFFFF
+      (popped, pos) = ReadUnsignedLeb128(data, pos)
+      (pushed, pos) = ReadUnsignedLeb128(data, pos)
+      if popped > len(stack):
+        raise MyException("Samples pop more frames than were pushed")
+      for i in range(popped):
+        self.WriteRecord(body, tid, (stack.pop() << 2) | 1, clocks)
+      for i in range(pushed):
+        (methodId, pos) = ReadUnsignedLeb128(data, pos)
+        stack.append(methodId)
+        self.WriteRecord(body, tid, methodId << 2, clocks)
+    print 'Samples: thread %d, buffer %d, %d bytes' % (tid, bufferId, length)
+
+  def ProcessSpecial(self, input, body):
     code = ord(input.read(1))
     if code == 1:
       self.ProcessMethod(input)
@@ -138,6 +198,8 @@ class Rewriter:
       self.ProcessThread(input)
     elif code == 3:
       self.ProcessTraceSummary(input)
+    elif code == 4:
+      self.ProcessSamples(input, body)
     else:
       raise MyException("Unknown special!")
 
@@ -146,7 +208,7 @@ class Rewriter:
       while True:
         threadId = ReadShortLE(input)
         if threadId == 0:
-          self.ProcessSpecial(input)
+          self.ProcessSpecial(input, body)
         else:
           # Regular package, just copy
           WriteShortLE(body, threadId)
@@ -183,13 +245,14 @@ class Rewriter:
     header = open(filename + '.header', 'w')         # Header part
     body = open(filename + '.body', 'wb')            # Body part
 
-    self.PrintHeader(header)
-
     self.ProcessDataHeader(input, body)
 
+    self.PrintHeader(header)
+
     self._methods = []
     self._threads = []
     self._summary = None
+    self._sampleStacks = {}
     self.Process(input, body)
 
     self.Finalize(header)
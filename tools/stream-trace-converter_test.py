@@ -0,0 +1,176 @@
+#!/usr/bin/env python
+#
+# Copyright (C) 2017 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for stream-trace-converter.py. Each test encodes a streaming trace the way
+   runtime/trace.cc writes it, converts it and decodes the records of the body."""
+
+import imp
+import os
+import shutil
+import struct
+import tempfile
+import unittest
+
+converter = imp.load_source(
+    'stream_trace_converter',
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), 'stream-trace-converter.py'))
+
+def EncodeUnsignedLeb128(value):
+  out = bytearray()
+  while True:
+    byte = value & 0x7F
+    value >>= 7
+    if value == 0:
+      out.append(byte)
+      return out
+    out.append(byte | 0x80)
+
+class StreamWriter:
+  """Writes a streaming trace with either one or two clocks."""
+
+  def __init__(self, num_clocks):
+    self._num_clocks = num_clocks
+    self._data = bytearray()
+    if num_clocks == 2:
+      self._data += struct.pack('<IHHQH', 0x574f4c53, 3 | 0xf0, 32, 0, 14)
+      self._data += bytearray(32 - 18)
+    else:
+      self._data += struct.pack('<IHHQ', 0x574f4c53, 2 | 0xf0, 32, 0)
+      self._data += bytearray(32 - 16)
+    self._stacks = {}
+
+  def AddMethod(self, method_id, name):
+    line = '%#x\t%s\n' % (method_id << 2, name)
+    self._data += struct.pack('<HBH', 0, 1, len(line)) + line
+
+  def AddRecord(self, tid, method_and_action, clocks):
+    self._data += struct.pack('<HI', tid, method_and_action)
+    for clock in clocks:
+      self._data += struct.pack('<I', clock)
+
+  def AddSamples(self, tid, buffer_id, samples):
+    """Encodes (clocks, stack) samples against the previous sample of the buffer."""
+    (prev_clocks, prev_stack) = self._stacks.get(buffer_id, ([0] * self._num_clocks, []))
+    data = bytearray()
+    for (clocks, stack) in samples:
+      for i in range(self._num_clocks):
+        data += EncodeUnsignedLeb128(clocks[i] - prev_clocks[i])
+      common = 0
+      while (common < len(stack) and common < len(prev_stack) and
+             stack[common] == prev_stack[common]):
+        common += 1
+      data += EncodeUnsignedLeb128(len(prev_stack) - common)
+      data += EncodeUnsignedLeb128(len(stack) - common)
+      for method_id in stack[common:]:
+        data += EncodeUnsignedLeb128(method_id)
+      (prev_clocks, prev_stack) = (clocks, stack)
+    self._stacks[buffer_id] = (prev_clocks, prev_stack)
+    self._data += struct.pack('<HBHII', 0, 4, tid, buffer_id, len(data)) + data
+
+  def Write(self, filename):
+    with open(filename, 'wb') as f:
+      f.write(self._data)
+
+class StreamTraceConverterTest(unittest.TestCase):
+
+  def setUp(self):
+    self._dir = tempfile.mkdtemp()
+    self._trace = os.path.join(self._dir, 'trace')
+
+  def tearDown(self):
+    shutil.rmtree(self._dir)
+
+  def Convert(self, writer):
+    writer.Write(self._trace)
+    converter.Rewriter().ProcessFile(self._trace)
+    with open(self._trace + '.header') as f:
+      header = f.read()
+    with open(self._trace + '.body', 'rb') as f:
+      body = f.read()
+    return (header, body)
+
+  def DecodeRecords(self, body, header_size, num_clocks):
+    record_format = '<HI' + 'I' * num_clocks
+    record_size = struct.calcsize(record_format)
+    self.assertEqual(0, (len(body) - header_size) % record_size)
+    records = []
+    for pos in range(header_size, len(body), record_size):
+      record = struct.unpack_from(record_format, body, pos)
+      records.append((record[0], record[1], list(record[2:])))
+    return records
+
+  def ExpectedRecords(self, tid, samples):
+    """The enter and exit records that reproduce the stacks of the samples."""
+    records = []
+    stack = []
+    for (clocks, sample_stack) in samples:
+      common = 0
+      while (common < len(stack) and common < len(sample_stack) and
+             stack[common] == sample_stack[common]):
+        common += 1
+      while len(stack) > common:
+        records.append((tid, (stack.pop() << 2) | 1, clocks))
+      for method_id in sample_stack[common:]:
+        stack.append(method_id)
+        records.append((tid, method_id << 2, clocks))
+    return records
+
+  def RoundTrip(self, num_clocks):
+    writer = StreamWriter(num_clocks)
+    writer.AddMethod(1, 'A\tmain\t()V\tA.java')
+    writer.AddMethod(2, 'A\tfoo\t()V\tA.java')
+    writer.AddMethod(200, 'B\tbar\t()V\tB.java')
+    # A record written by method tracing is copied as is.
+    writer.AddRecord(7, 1 << 2, [5] * num_clocks)
+    samples1 = [
+        ([10, 20][:num_clocks], [1, 2]),
+        ([15, 300][:num_clocks], [1, 2, 200]),
+        ([400, 100000][:num_clocks], [1, 200]),
+        ([401, 100001][:num_clocks], []),
+    ]
+    samples2 = [
+        ([3, 4][:num_clocks], [200]),
+    ]
+    writer.AddSamples(3, 1, samples1[:2])
+    writer.AddSamples(4, 2, samples2)
+    # Later packets of the same buffer continue from the last sample of the previous one.
+    writer.AddSamples(3, 1, samples1[2:])
+    (header, body) = self.Convert(writer)
+
+    # The body starts with the non-streaming version of the header.
+    version = 3 if num_clocks == 2 else 2
+    self.assertEqual((0x574f4c53, version, 32), struct.unpack_from('<IHH', body))
+    thread3 = self.ExpectedRecords(3, samples1)
+    thread3_first_packet = len(self.ExpectedRecords(3, samples1[:2]))
+    expected = [(7, 1 << 2, [5] * num_clocks)]
+    expected += thread3[:thread3_first_packet]
+    expected += self.ExpectedRecords(4, samples2)
+    expected += thread3[thread3_first_packet:]
+    self.assertEqual(expected, self.DecodeRecords(body, 32, num_clocks))
+    return header
+
+  def testDualClock(self):
+    header = self.RoundTrip(2)
+    self.assertIn('*version\n3\n', header)
+    self.assertIn('clock=dual\n', header)
+
+  def testSingleClock(self):
+    header = self.RoundTrip(1)
+    self.assertIn('*version\n2\n', header)
+    self.assertNotIn('clock=dual\n', header)
+
+if __name__ == '__main__':
+  unittest.main()